@@ -0,0 +1,270 @@
+#include "frameRecording.h"
+#include "gifWriter.h"
+#include "imageAsset.h"
+#include <TFE_System/system.h>
+#include <TFE_FileSystem/filestream.h>
+#include <TFE_FileSystem/filewriterAsync.h>
+#include <TFE_FileSystem/deltaCodec.h>
+#include <TFE_FileSystem/paths.h>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+namespace TFE_FrameRecording
+{
+	//////////////////////////////////////////////////////////////////////
+	// File layout
+	//   FrameRecordingHeader
+	//   Records: u8 type, u32 payload size, payload
+	//     REC_PALETTE - 256 colors (u32).
+	//     REC_FRAME   - f64 time, then the pixels delta encoded against the previous frame (see TFE_DeltaCodec).
+	//                   The first frame is relative to a zeroed frame.
+	//     REC_END     - u32 frame count.
+	//////////////////////////////////////////////////////////////////////
+	enum FrameRecordingConstants
+	{
+		REC_VERSION = 1,
+		REC_WORD_SIZE = 8,			// Pixels compared at once.
+		REC_RECORD_HEADER_SIZE = 5,
+	};
+
+	enum RecordType
+	{
+		REC_PALETTE = 0,
+		REC_FRAME,
+		REC_END,
+	};
+
+	struct FrameRecordingHeader
+	{
+		char magic[4];
+		u32 version;
+		u32 width;
+		u32 height;
+	};
+	static const char c_recordingMagic[4] = { 'T', 'F', 'R', 'C' };
+
+	static FileWriterAsync::AsyncFileStream* s_stream = nullptr;
+	static u32 s_width;
+	static u32 s_height;
+	static u32 s_palette[256];
+	static bool s_paletteWritten;
+	static u32 s_frameCount;
+	static std::vector<u8> s_prevFrame;
+	static std::vector<u8> s_recordBuffer;
+
+	static void writeRecord(RecordType type, u8* record, u32 payloadSize)
+	{
+		// The first REC_RECORD_HEADER_SIZE bytes of 'record' are reserved for the header.
+		record[0] = u8(type);
+		memcpy(record + 1, &payloadSize, sizeof(u32));
+		FileWriterAsync::writeToStream(s_stream, record, REC_RECORD_HEADER_SIZE + payloadSize);
+	}
+
+	bool startRecording(const char* path, u32 width, u32 height)
+	{
+		if (s_stream || !width || !height) { return false; }
+		s_stream = FileWriterAsync::openStream(path);
+		if (!s_stream)
+		{
+			TFE_System::logWrite(LOG_ERROR, "FrameRecording", "Cannot open \"%s\" for recording.", path);
+			return false;
+		}
+
+		FrameRecordingHeader header;
+		memcpy(header.magic, c_recordingMagic, 4);
+		header.version = REC_VERSION;
+		header.width = width;
+		header.height = height;
+		FileWriterAsync::writeToStream(s_stream, &header, sizeof(FrameRecordingHeader));
+
+		s_width = width;
+		s_height = height;
+		s_paletteWritten = false;
+		s_frameCount = 0;
+
+		const u32 pixelCount = width * height;
+		s_prevFrame.assign(pixelCount, 0);
+		// The buffer is shared by every record type, so it has to fit the palette even if the frames are tiny.
+		const size_t frameSize = sizeof(f64) + TFE_DeltaCodec::getMaxEncodedSize(pixelCount, REC_WORD_SIZE);
+		s_recordBuffer.resize(REC_RECORD_HEADER_SIZE + std::max(frameSize, sizeof(u32) * 256));
+		return true;
+	}
+
+	void addFrame(const u8* pixels, const u32* palette, f64 time)
+	{
+		if (!s_stream) { return; }
+
+		if (!s_paletteWritten || memcmp(palette, s_palette, sizeof(u32) * 256))
+		{
+			memcpy(s_palette, palette, sizeof(u32) * 256);
+			memcpy(s_recordBuffer.data() + REC_RECORD_HEADER_SIZE, s_palette, sizeof(u32) * 256);
+			writeRecord(REC_PALETTE, s_recordBuffer.data(), sizeof(u32) * 256);
+			s_paletteWritten = true;
+		}
+
+		u8* payload = s_recordBuffer.data() + REC_RECORD_HEADER_SIZE;
+		u8* out = payload;
+		memcpy(out, &time, sizeof(f64));
+		out += sizeof(f64);
+
+		out = TFE_DeltaCodec::encode(pixels, s_prevFrame.data(), s_width * s_height, REC_WORD_SIZE, out);
+
+		assert(out <= s_recordBuffer.data() + s_recordBuffer.size());
+		writeRecord(REC_FRAME, s_recordBuffer.data(), u32(out - payload));
+		s_frameCount++;
+	}
+
+	void endRecording()
+	{
+		if (!s_stream) { return; }
+
+		memcpy(s_recordBuffer.data() + REC_RECORD_HEADER_SIZE, &s_frameCount, sizeof(u32));
+		writeRecord(REC_END, s_recordBuffer.data(), sizeof(u32));
+		const size_t size = FileWriterAsync::closeStream(s_stream);
+		s_stream = nullptr;
+
+		TFE_System::logWrite(LOG_MSG, "FrameRecording", "Recorded %u frames at %ux%u, %0.2f MB.", s_frameCount, s_width, s_height, f64(size) / (1024.0 * 1024.0));
+		s_prevFrame.clear();
+		s_recordBuffer.clear();
+	}
+
+	bool isRecording()
+	{
+		return s_stream != nullptr;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Conversion
+	//////////////////////////////////////////////////////////////////////
+	// Applies a frame record to 'frame' and returns false if the record is corrupt.
+	static bool decodeFrame(const u8* data, u32 size, u8* frame, u32 pixelCount, f64* time)
+	{
+		const u8* end = data + size;
+		if (size < sizeof(f64)) { return false; }
+		memcpy(time, data, sizeof(f64));
+		data += sizeof(f64);
+
+		return TFE_DeltaCodec::decode(data, end, frame, pixelCount, REC_WORD_SIZE) == end;
+	}
+
+	static bool isGifPath(const char* path)
+	{
+		const size_t len = strlen(path);
+		if (len < 4) { return false; }
+		const char* ext = path + len - 4;
+		return ext[0] == '.' && (ext[1] | 0x20) == 'g' && (ext[2] | 0x20) == 'i' && (ext[3] | 0x20) == 'f';
+	}
+
+	bool convert(const char* srcPath, const char* dstPath)
+	{
+		FileStream file;
+		if (!file.open(srcPath, FileStream::MODE_READ))
+		{
+			TFE_System::logWrite(LOG_ERROR, "FrameRecording", "Cannot open recording \"%s\".", srcPath);
+			return false;
+		}
+
+		FrameRecordingHeader header;
+		if (file.readBuffer(&header, sizeof(FrameRecordingHeader)) != sizeof(FrameRecordingHeader) ||
+			memcmp(header.magic, c_recordingMagic, 4) || header.version != REC_VERSION || !header.width || !header.height ||
+			header.width > 16384 || header.height > 16384)
+		{
+			TFE_System::logWrite(LOG_ERROR, "FrameRecording", "\"%s\" is not a valid frame recording.", srcPath);
+			file.close();
+			return false;
+		}
+
+		const bool toGif = isGifPath(dstPath);
+		if (toGif && !TFE_GIF::startIndexedRecording(dstPath, header.width, header.height))
+		{
+			file.close();
+			return false;
+		}
+
+		// Strip the extension from the image sequence name.
+		char baseName[TFE_MAX_PATH];
+		strncpy(baseName, dstPath, TFE_MAX_PATH - 1);
+		baseName[TFE_MAX_PATH - 1] = 0;
+		char* ext = strrchr(baseName, '.');
+		if (ext && !strchr(ext, '/') && !strchr(ext, '\\')) { *ext = 0; }
+
+		const u32 pixelCount = header.width * header.height;
+		std::vector<u8> frame(pixelCount, 0);
+		std::vector<u32> image(toGif ? 0 : pixelCount);
+		std::vector<u8> payload;
+		u32 palette[256] = { 0 };
+		u32 frameCount = 0;
+		bool valid = true;
+
+		u8 recordHeader[REC_RECORD_HEADER_SIZE];
+		while (file.readBuffer(recordHeader, REC_RECORD_HEADER_SIZE) == REC_RECORD_HEADER_SIZE)
+		{
+			u32 size;
+			memcpy(&size, recordHeader + 1, sizeof(u32));
+			if (size > file.getSize() - file.getLoc())
+			{
+				valid = false;
+				break;
+			}
+			payload.resize(size);
+			if (size) { file.readBuffer(payload.data(), size); }
+
+			const u8 type = recordHeader[0];
+			if (type == REC_END)
+			{
+				break;
+			}
+			else if (type == REC_PALETTE && size == sizeof(u32) * 256)
+			{
+				memcpy(palette, payload.data(), sizeof(u32) * 256);
+			}
+			else if (type == REC_FRAME)
+			{
+				f64 time;
+				if (!decodeFrame(payload.data(), size, frame.data(), pixelCount, &time))
+				{
+					valid = false;
+					break;
+				}
+
+				if (toGif)
+				{
+					TFE_GIF::addIndexedFrame(frame.data(), palette, time, true);
+				}
+				else
+				{
+					for (u32 p = 0; p < pixelCount; p++)
+					{
+						image[p] = palette[frame[p]] | 0xff000000;
+					}
+					char imagePath[TFE_MAX_PATH];
+					snprintf(imagePath, TFE_MAX_PATH, "%s_%05u.png", baseName, frameCount);
+					TFE_Image::writeImage(imagePath, header.width, header.height, image.data());
+				}
+				frameCount++;
+			}
+			else
+			{
+				valid = false;
+				break;
+			}
+		}
+		file.close();
+		if (toGif)
+		{
+			TFE_GIF::endIndexedRecording();
+		}
+
+		if (!valid)
+		{
+			TFE_System::logWrite(LOG_WARNING, "FrameRecording", "\"%s\" is corrupt or truncated, converted the first %u frames.", srcPath, frameCount);
+		}
+		else
+		{
+			TFE_System::logWrite(LOG_MSG, "FrameRecording", "Converted %u frames from \"%s\".", frameCount, srcPath);
+		}
+		return frameCount > 0;
+	}
+}
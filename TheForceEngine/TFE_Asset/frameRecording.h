@@ -0,0 +1,26 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// The Force Engine Frame Recording
+// Lossless recording of the 8-bit framebuffer, cheap enough to leave
+// running while playing.
+//
+// Each frame is stored as the XOR of the previous frame, run-length
+// encoded in 8 pixel words so unchanged areas cost almost nothing.
+// Palette changes are stored as separate records. The file is
+// written through FileWriterAsync and can be converted to a GIF or
+// a PNG sequence offline.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+namespace TFE_FrameRecording
+{
+	bool startRecording(const char* path, u32 width, u32 height);
+	// 'palette' is 256 colors (0xAABBGGRR), it is only written when it changes. 'time' is in seconds.
+	void addFrame(const u8* pixels, const u32* palette, f64 time);
+	void endRecording();
+	bool isRecording();
+
+	// Offline conversion, a GIF is written if 'dstPath' ends with ".gif", otherwise each frame is written as an image
+	// named <dstPath>_<frame>.png
+	bool convert(const char* srcPath, const char* dstPath);
+}
@@ -2,6 +2,9 @@
 #include <TFE_System/system.h>
 #include <TFE_FileSystem/filestream.h>
 #include <TFE_FileSystem/paths.h>
+#include <TFE_System/Threads/thread.h>
+#include <TFE_System/Threads/signal.h>
+#include <TFE_System/Threads/spscQueue.h>
 #include <assert.h>
 #include <algorithm>
 #include <vector>
@@ -65,4 +68,427 @@ namespace TFE_GIF
 		msf_gif_free(result);
 		return true;
 	}
-}
\ No newline at end of file
+
+	//////////////////////////////////////////////////////////////////////
+	// Indexed recording
+	// The framebuffer is already palettized, so frames are LZW encoded
+	// directly instead of being quantized again.
+	//////////////////////////////////////////////////////////////////////
+	enum IndexedGifConstants
+	{
+		GIF_FRAME_POOL = 8,			// Must be a power of two.
+		GIF_MIN_DELAY = 2,			// In 1/100th of a second, many viewers show shorter delays as 1/10th of a second.
+		GIF_POLL_MS = 10,			// The worker polls for frames so adding a frame never wakes it directly.
+		GIF_LZW_MIN_CODE_SIZE = 8,
+		GIF_LZW_MAX_CODE = 4095,
+		GIF_LZW_HASH_BITS = 13,
+		GIF_LZW_HASH_SIZE = 1 << GIF_LZW_HASH_BITS,
+	};
+
+	struct IndexedFrame
+	{
+		std::vector<u8> pixels;
+		u32 palette[256];
+		f64 time;
+	};
+
+	struct LzwState
+	{
+		// Each entry is (prefix << 20) | (byte << 12) | code, 0 is empty.
+		u32 table[GIF_LZW_HASH_SIZE];
+		u32 bits;
+		u32 bitCount;
+		u32 blockSize;
+		u8  block[256];
+	};
+
+	static FileStream s_indexedFile;
+	static u32 s_indexedWidth;
+	static u32 s_indexedHeight;
+	static IndexedFrame s_indexedFrames[GIF_FRAME_POOL];
+	static SpscQueue<IndexedFrame*, GIF_FRAME_POOL> s_freeFrames;		// Worker -> caller.
+	static SpscQueue<IndexedFrame*, GIF_FRAME_POOL> s_readyFrames;		// Caller -> worker.
+	static Thread* s_indexedThread = nullptr;
+	static Signal* s_indexedSignal = nullptr;
+	static atomic_bool s_indexedRunning(false);
+	static bool s_indexedRecording = false;
+	static f64 s_lastFrameTime;
+	static u32 s_droppedFrames;
+
+	// Worker thread state.
+	static IndexedFrame* s_prevFrame;	// The last frame written.
+	static IndexedFrame* s_heldFrame;	// Waiting for the next frame to determine its delay.
+	static u32 s_globalPalette[256];
+	static f64 s_startTime;
+	static u32 s_writtenDelay;			// Total delay written so far, in 1/100th of a second.
+	static u32 s_writtenFrames;
+	static LzwState s_lzw;
+
+	TFE_THREADRET TFE_STDCALL indexedGifFunc(void* userData);
+
+	bool startIndexedRecording(const char* path, u32 width, u32 height)
+	{
+		if (s_indexedRecording || !width || !height || width > 0xffff || height > 0xffff) { return false; }
+		if (!s_indexedFile.open(path, FileStream::MODE_WRITE))
+		{
+			TFE_System::logWrite(LOG_ERROR, "GIF", "Cannot open \"%s\" for recording.", path);
+			return false;
+		}
+
+		s_indexedWidth = width;
+		s_indexedHeight = height;
+		IndexedFrame* frame;
+		while (s_freeFrames.pop(&frame));
+		while (s_readyFrames.pop(&frame));
+		for (u32 i = 0; i < GIF_FRAME_POOL; i++)
+		{
+			s_indexedFrames[i].pixels.resize(width * height);
+			s_freeFrames.push(&s_indexedFrames[i]);
+		}
+		s_prevFrame = nullptr;
+		s_heldFrame = nullptr;
+		s_writtenDelay = 0;
+		s_writtenFrames = 0;
+		s_lastFrameTime = -1.0;
+		s_droppedFrames = 0;
+
+		if (!s_indexedSignal)
+		{
+			s_indexedSignal = Signal::create();
+		}
+		s_indexedRunning.store(true);
+		s_indexedThread = Thread::create("GifThread", indexedGifFunc, nullptr);
+		if (!s_indexedThread || !s_indexedThread->run())
+		{
+			delete s_indexedThread;
+			s_indexedThread = nullptr;
+			s_indexedFile.close();
+			return false;
+		}
+		s_indexedRecording = true;
+		return true;
+	}
+
+	bool addIndexedFrame(const u8* pixels, const u32* palette, f64 time, bool waitForWorker)
+	{
+		if (!s_indexedRecording) { return false; }
+		if (s_lastFrameTime >= 0.0 && time - s_lastFrameTime < f64(GIF_MIN_DELAY) / 100.0) { return false; }
+
+		IndexedFrame* frame;
+		while (!s_freeFrames.pop(&frame))
+		{
+			if (!waitForWorker)
+			{
+				s_droppedFrames++;
+				return false;
+			}
+			TFE_System::sleep(1);
+		}
+		memcpy(frame->pixels.data(), pixels, s_indexedWidth * s_indexedHeight);
+		memcpy(frame->palette, palette, sizeof(u32) * 256);
+		frame->time = time;
+		s_readyFrames.push(frame);
+
+		s_lastFrameTime = time;
+		return true;
+	}
+
+	void endIndexedRecording()
+	{
+		if (!s_indexedRecording) { return; }
+
+		s_indexedRunning.store(false);
+		s_indexedSignal->fire();
+		s_indexedThread->waitOnExit();
+		delete s_indexedThread;
+		s_indexedThread = nullptr;
+		s_indexedRecording = false;
+
+		TFE_System::logWrite(LOG_MSG, "GIF", "Recorded %u frames, %u dropped.", s_writtenFrames, s_droppedFrames);
+	}
+
+	bool isIndexedRecording()
+	{
+		return s_indexedRecording;
+	}
+
+	void writeU8(u8 value)
+	{
+		s_indexedFile.writeBuffer(&value, 1);
+	}
+
+	void writeU16(u16 value)
+	{
+		const u8 bytes[] = { u8(value), u8(value >> 8) };
+		s_indexedFile.writeBuffer(bytes, 2);
+	}
+
+	void writeColorTable(const u32* palette)
+	{
+		u8 colors[256 * 3];
+		for (u32 i = 0; i < 256; i++)
+		{
+			colors[i * 3 + 0] = u8(palette[i]);
+			colors[i * 3 + 1] = u8(palette[i] >> 8);
+			colors[i * 3 + 2] = u8(palette[i] >> 16);
+		}
+		s_indexedFile.writeBuffer(colors, sizeof(colors));
+	}
+
+	void writeHeader(const u32* palette)
+	{
+		s_indexedFile.writeBuffer("GIF89a", 6);
+		writeU16(u16(s_indexedWidth));
+		writeU16(u16(s_indexedHeight));
+		writeU8(0xf7);		// 256 entry global color table.
+		writeU8(0);			// Background color.
+		writeU8(0);			// Pixel aspect ratio.
+		memcpy(s_globalPalette, palette, sizeof(u32) * 256);
+		writeColorTable(palette);
+
+		// Loop forever.
+		const u8 loop[] = { 0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+		s_indexedFile.writeBuffer(loop, sizeof(loop));
+	}
+
+	////////////////////////////////////
+	// LZW
+	////////////////////////////////////
+	void lzwFlushBlock()
+	{
+		if (!s_lzw.blockSize) { return; }
+		writeU8(u8(s_lzw.blockSize));
+		s_indexedFile.writeBuffer(s_lzw.block, s_lzw.blockSize);
+		s_lzw.blockSize = 0;
+	}
+
+	void lzwWriteCode(u32 code, u32 codeSize)
+	{
+		s_lzw.bits |= code << s_lzw.bitCount;
+		s_lzw.bitCount += codeSize;
+		while (s_lzw.bitCount >= 8)
+		{
+			s_lzw.block[s_lzw.blockSize++] = u8(s_lzw.bits);
+			s_lzw.bits >>= 8;
+			s_lzw.bitCount -= 8;
+			if (s_lzw.blockSize == 255) { lzwFlushBlock(); }
+		}
+	}
+
+	void lzwClearTable()
+	{
+		memset(s_lzw.table, 0, sizeof(s_lzw.table));
+	}
+
+	// Returns the slot of the (prefix, byte) string, which is either empty or holds the string.
+	u32 lzwFind(u32 key)
+	{
+		u32 slot = (key * 2654435761u) >> (32 - GIF_LZW_HASH_BITS);
+		while (s_lzw.table[slot] && (s_lzw.table[slot] >> 12) != key)
+		{
+			slot = (slot + 1) & (GIF_LZW_HASH_SIZE - 1);
+		}
+		return slot;
+	}
+
+	// Encode the rectangle of the frame as image data.
+	void lzwEncodeRect(const u8* pixels, u32 stride, u32 width, u32 height)
+	{
+		const u32 clearCode = 1 << GIF_LZW_MIN_CODE_SIZE;
+		u32 codeSize = GIF_LZW_MIN_CODE_SIZE + 1;
+		u32 maxCode = clearCode + 1;
+
+		writeU8(GIF_LZW_MIN_CODE_SIZE);
+		s_lzw.bits = 0;
+		s_lzw.bitCount = 0;
+		s_lzw.blockSize = 0;
+		lzwClearTable();
+		lzwWriteCode(clearCode, codeSize);
+
+		u32 curCode = pixels[0];
+		for (u32 y = 0; y < height; y++)
+		{
+			const u8* row = pixels + y * stride;
+			for (u32 x = (y == 0) ? 1 : 0; x < width; x++)
+			{
+				const u32 key = (curCode << 8) | row[x];
+				const u32 slot = lzwFind(key);
+				if (s_lzw.table[slot])
+				{
+					curCode = s_lzw.table[slot] & 0xfff;
+					continue;
+				}
+
+				// Finish the current string and add the new one to the dictionary.
+				lzwWriteCode(curCode, codeSize);
+				maxCode++;
+				s_lzw.table[slot] = (key << 12) | maxCode;
+				if (maxCode >= (1u << codeSize))
+				{
+					codeSize++;
+				}
+				if (maxCode == GIF_LZW_MAX_CODE)
+				{
+					lzwWriteCode(clearCode, codeSize);
+					lzwClearTable();
+					codeSize = GIF_LZW_MIN_CODE_SIZE + 1;
+					maxCode = clearCode + 1;
+				}
+				curCode = row[x];
+			}
+		}
+		lzwWriteCode(curCode, codeSize);
+		lzwWriteCode(clearCode, codeSize);
+		lzwWriteCode(clearCode + 1, GIF_LZW_MIN_CODE_SIZE + 1);
+		if (s_lzw.bitCount)
+		{
+			lzwWriteCode(0, 8 - s_lzw.bitCount);
+		}
+		lzwFlushBlock();
+		writeU8(0);
+	}
+
+	////////////////////////////////////
+	// Frames
+	////////////////////////////////////
+	// Find the rectangle that changed since the previous frame, returns false if nothing changed.
+	bool getDeltaRect(const u8* prev, const u8* cur, u32* x0, u32* y0, u32* x1, u32* y1)
+	{
+		const u32 width = s_indexedWidth;
+		const u32 height = s_indexedHeight;
+		s32 top = 0, bot = s32(height) - 1;
+		while (top <= bot && memcmp(prev + top * width, cur + top * width, width) == 0) { top++; }
+		if (top > bot) { return false; }
+		while (memcmp(prev + bot * width, cur + bot * width, width) == 0) { bot--; }
+
+		u32 left = width - 1, right = 0;
+		for (s32 y = top; y <= bot; y++)
+		{
+			const u8* prevRow = prev + y * width;
+			const u8* curRow = cur + y * width;
+			u32 l = 0;
+			while (l < left && prevRow[l] == curRow[l]) { l++; }
+			u32 r = width - 1;
+			while (r > right && prevRow[r] == curRow[r]) { r--; }
+			left = std::min(left, l);
+			right = std::max(right, r);
+		}
+		right = std::max(left, right);
+
+		*x0 = left;
+		*y0 = u32(top);
+		*x1 = right + 1;
+		*y1 = u32(bot) + 1;
+		return true;
+	}
+
+	void writeFrame(const IndexedFrame* frame, const IndexedFrame* prev, u32 delay)
+	{
+		if (!s_writtenFrames)
+		{
+			writeHeader(frame->palette);
+		}
+
+		// Only the pixels that changed need to be stored, unless the palette changed which affects every pixel.
+		u32 x0 = 0, y0 = 0, x1 = s_indexedWidth, y1 = s_indexedHeight;
+		if (prev && memcmp(prev->palette, frame->palette, sizeof(u32) * 256) == 0)
+		{
+			if (!getDeltaRect(prev->pixels.data(), frame->pixels.data(), &x0, &y0, &x1, &y1))
+			{
+				// Nothing changed, store a single pixel to keep the timing.
+				x1 = 1;
+				y1 = 1;
+			}
+		}
+		const bool localPalette = memcmp(s_globalPalette, frame->palette, sizeof(u32) * 256) != 0;
+
+		// Graphic control extension: leave the previous frame in place.
+		const u8 control[] = { 0x21, 0xf9, 0x04, 0x04, u8(delay), u8(delay >> 8), 0x00, 0x00 };
+		s_indexedFile.writeBuffer(control, sizeof(control));
+
+		writeU8(0x2c);
+		writeU16(u16(x0));
+		writeU16(u16(y0));
+		writeU16(u16(x1 - x0));
+		writeU16(u16(y1 - y0));
+		writeU8(localPalette ? 0x87 : 0x00);
+		if (localPalette)
+		{
+			writeColorTable(frame->palette);
+		}
+		lzwEncodeRect(frame->pixels.data() + y0 * s_indexedWidth + x0, s_indexedWidth, x1 - x0, y1 - y0);
+
+		s_writtenDelay += delay;
+		s_writtenFrames++;
+	}
+
+	// Write the held frame, its delay lasts until 'endTime'.
+	void writeHeldFrame(f64 endTime)
+	{
+		// Base the delay on the total time so rounding errors do not add up.
+		const u32 endDelay = u32((endTime - s_startTime) * 100.0 + 0.5);
+		const u32 delay = std::max(endDelay > s_writtenDelay ? endDelay - s_writtenDelay : 0u, u32(GIF_MIN_DELAY));
+		writeFrame(s_heldFrame, s_prevFrame, delay);
+
+		if (s_prevFrame)
+		{
+			s_freeFrames.push(s_prevFrame);
+		}
+		s_prevFrame = s_heldFrame;
+		s_heldFrame = nullptr;
+	}
+
+	void processFrame(IndexedFrame* frame)
+	{
+		if (!s_heldFrame)
+		{
+			if (!s_prevFrame)
+			{
+				s_startTime = frame->time;
+			}
+			s_heldFrame = frame;
+			return;
+		}
+
+		// Identical frames extend the delay of the held frame instead.
+		if (memcmp(s_heldFrame->palette, frame->palette, sizeof(u32) * 256) == 0 &&
+			memcmp(s_heldFrame->pixels.data(), frame->pixels.data(), s_indexedWidth * s_indexedHeight) == 0)
+		{
+			s_freeFrames.push(frame);
+			return;
+		}
+
+		writeHeldFrame(frame->time);
+		s_heldFrame = frame;
+	}
+
+	TFE_THREADRET TFE_STDCALL indexedGifFunc(void* userData)
+	{
+		IndexedFrame* frame;
+		f64 lastTime = 0.0;
+		while (1)
+		{
+			// Frames added before recording ended are always visible after reading the flag.
+			const bool running = s_indexedRunning.load();
+			while (s_readyFrames.pop(&frame))
+			{
+				lastTime = frame->time;
+				processFrame(frame);
+			}
+			if (!running) { break; }
+			s_indexedSignal->wait(GIF_POLL_MS);
+		}
+
+		if (s_heldFrame)
+		{
+			// The last frame is shown for the minimum delay past the last frame time.
+			writeHeldFrame(std::max(lastTime, s_heldFrame->time) + f64(GIF_MIN_DELAY) / 100.0);
+		}
+		if (s_writtenFrames)
+		{
+			writeU8(0x3b);
+		}
+		s_indexedFile.close();
+		return (TFE_THREADRET)0;
+	}
+}
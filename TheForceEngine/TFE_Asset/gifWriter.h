@@ -11,4 +11,16 @@ namespace TFE_GIF
 	bool startGif(const char* path, u32 width, u32 height, u32 fps);
 	void addFrame(const u8* imageData);
 	bool write();
+
+	// Indexed recording from an 8-bit framebuffer and its 256 color palette (0xAABBGGRR).
+	// Frames are copied on the calling thread and encoded and written on a worker thread,
+	// only the rectangle that changed since the previous frame is stored.
+	bool startIndexedRecording(const char* path, u32 width, u32 height);
+	// 'time' is in seconds and sets the frame delays, frames closer than the minimum GIF delay are skipped.
+	// Returns false if the frame was skipped or dropped because the worker thread is behind,
+	// set 'waitForWorker' to wait instead of dropping frames when converting offline.
+	bool addIndexedFrame(const u8* pixels, const u32* palette, f64 time, bool waitForWorker = false);
+	// Waits for the remaining frames to be written.
+	void endIndexedRecording();
+	bool isIndexedRecording();
 }
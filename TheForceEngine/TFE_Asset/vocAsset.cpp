@@ -6,6 +6,7 @@
 #include <TFE_Archive/archive.h>
 #include <TFE_System/parser.h>
 #include <TFE_Audio/audioSystem.h>
+#include <TFE_Settings/settings.h>
 #include <TFE_FileSystem/filestream.h>
 #include <TFE_FileSystem/paths.h>
 #include <assert.h>
@@ -20,8 +21,10 @@ namespace TFE_VocAsset
 	static VocList s_vocAssetList;
 	static std::vector<u8> s_buffer;
 	static const char* c_defaultGob = "SOUNDS.GOB";
+	static size_t s_floatDataSize = 0;	// Memory used by sounds converted to float.
 
 	bool parseVoc(SoundBuffer* voc);
+	void convertToFloat(SoundBuffer* voc);
 
 	bool loadSoundFile(const char* name)
 	{
@@ -63,6 +66,7 @@ namespace TFE_VocAsset
 			delete voc;
 			return nullptr;
 		}
+		convertToFloat(voc);
 
 		s_vocAssets[name] = voc;
 		voc->id = (u32)s_vocAssetList.size();
@@ -76,11 +80,12 @@ namespace TFE_VocAsset
 		for (; iVoc != s_vocAssetList.end(); ++iVoc)
 		{
 			SoundBuffer* voc = *iVoc;
-			delete[] voc->data;
+			free(voc->data);
 			delete voc;
 		}
 		s_vocAssets.clear();
 		s_vocAssetList.clear();
+		s_floatDataSize = 0;
 	}
 
 	s32 getIndex(const char* name)
@@ -103,6 +108,7 @@ namespace TFE_VocAsset
 			delete voc;
 			return -1;
 		}
+		convertToFloat(voc);
 
 		s_vocAssets[name] = voc;
 		voc->id = (u32)s_vocAssetList.size();
@@ -211,6 +217,32 @@ namespace TFE_VocAsset
 		voc->loopEnd = voc->size;
 	}
 
+	// Convert the 8-bit samples to normalized float once, so the mixer can use them directly.
+	// Sounds that do not fit in the memory budget are left as-is and converted while mixing.
+	void convertToFloat(SoundBuffer* voc)
+	{
+		const size_t budget = size_t(std::max(0, TFE_Settings::getSoundSettings()->floatSampleBudget)) << 20;
+		const size_t floatSize = sizeof(f32) * voc->size;
+		if (voc->type != SOUND_DATA_8BIT || s_floatDataSize + floatSize > budget)
+		{
+			return;
+		}
+
+		f32* data = (f32*)malloc(floatSize);
+		if (!data) { return; }
+
+		// This must match the conversion in the mixer.
+		const u8* src = voc->data;
+		for (u32 i = 0; i < voc->size; i++)
+		{
+			data[i] = f32(src[i]) * (2.0f / 255.0f) - 1.0f;
+		}
+		free(voc->data);
+		voc->data = (u8*)data;
+		voc->type = SOUND_DATA_FLOAT;
+		s_floatDataSize += floatSize;
+	}
+
 	bool parseVoc(SoundBuffer* voc)
 	{
 		if (s_buffer.empty() || !voc) { return false; }
@@ -1,6 +1,9 @@
 #include "audioDevice.h"
+#include "wavWriter.h"
 #include <TFE_System/system.h>
 #include "RtAudio.h"
+#include <algorithm>
+#include <vector>
 
 //This system uses "RtAudio" as the low level, cross platform interface to the Audio system.
 //https://www.music.mcgill.ca/~gary/rtaudio/
@@ -15,12 +18,40 @@ namespace TFE_AudioDevice
 	static RtAudio::DeviceInfo s_OutputInfo;
 
 	static u32  s_audioFrameSize;
+	static u32  s_outputSampleRate = 0;
 	static bool s_streamStarted;
 
-	bool init(u32 audioFrameSize)
+	// Null device.
+	static bool s_nullDevice = false;
+	static StreamCallback s_nullCallback = nullptr;
+	static void* s_nullUserData = nullptr;
+	static u32 s_nullChannels = 0;
+	static f64 s_nullTime = 0.0;		// Virtual stream time in seconds.
+	static u64 s_nullFrameCount = 0;	// Frames pulled so far.
+	static std::vector<f32> s_nullBuffer;
+	static WavWriter* s_wavOutput = nullptr;
+
+	bool init(u32 audioFrameSize, bool nullDevice)
 	{
+		s_streamStarted  = false;
+		s_audioFrameSize = audioFrameSize;
+		s_nullDevice = nullDevice;
+		if (s_nullDevice)
+		{
+			TFE_System::logWrite(LOG_MSG, "Audio", "Using the null audio device.");
+			return true;
+		}
+
 		s_device = new RtAudio();
 		if (!s_device) { return false; }
+		if (s_device->getDeviceCount() == 0)
+		{
+			TFE_System::logWrite(LOG_WARNING, "Audio", "No audio devices found, using the null audio device.");
+			delete s_device;
+			s_device = nullptr;
+			s_nullDevice = true;
+			return true;
+		}
 
 		s_outputDevice = s_device->getDefaultOutputDevice();
 		s_inputDevice  = s_device->getDefaultInputDevice();
@@ -28,9 +59,6 @@ namespace TFE_AudioDevice
 		s_InputInfo  = s_device->getDeviceInfo(s_inputDevice);
 		s_OutputInfo = s_device->getDeviceInfo(s_outputDevice);
 
-		s_streamStarted  = false;
-		s_audioFrameSize = audioFrameSize;
-
 		return true;
 	}
 
@@ -38,6 +66,7 @@ namespace TFE_AudioDevice
 	{
 		stopOutput();
 		delete s_device;
+		s_device = nullptr;
 	}
 
 	void errorCallback(RtAudioError::Type type, const std::string &errorText)
@@ -47,6 +76,19 @@ namespace TFE_AudioDevice
 
 	bool startOutput(StreamCallback callback, void* userData, u32 channels, u32 sampleRate)
 	{
+		if (s_nullDevice)
+		{
+			s_nullCallback = callback;
+			s_nullUserData = userData;
+			s_nullChannels = channels;
+			s_nullTime = 0.0;
+			s_nullFrameCount = 0;
+			s_nullBuffer.resize(s_audioFrameSize * channels);
+			s_streamStarted = true;
+			s_outputSampleRate = sampleRate;
+			TFE_System::logWrite(LOG_MSG, "Audio", "Null Output Stream: %u channels at %u Hz, %u frames per buffer.", channels, s_outputSampleRate, s_audioFrameSize);
+			return true;
+		}
 		if (!s_device) { return false; }
 
 		RtAudio::StreamParameters  outParam;
@@ -64,12 +106,20 @@ namespace TFE_AudioDevice
 		s_device->openStream(param[0], param[1], RTAUDIO_FLOAT32, sampleRate, &s_audioFrameSize, callback, userData, &options, errorCallback);
 		s_device->startStream();
 		s_streamStarted = true;
+		s_outputSampleRate = s_device->getStreamSampleRate();
+		TFE_System::logWrite(LOG_MSG, "Audio", "Output Stream: %u channels at %u Hz, %u frames per buffer.", channels, s_outputSampleRate, s_audioFrameSize);
 
 		return true;
 	}
 
 	void stopOutput()
 	{
+		if (s_nullDevice)
+		{
+			endWavOutput();
+			s_streamStarted = false;
+			return;
+		}
 		if (s_device && s_streamStarted)
 		{
 			TFE_System::logWrite(LOG_MSG, "Audio", "Stop Audio Stream.");
@@ -77,4 +127,64 @@ namespace TFE_AudioDevice
 			s_streamStarted = false;
 		}
 	}
+
+	u32 getPreferredSampleRate()
+	{
+		// Fallback to 44.1 kHz if the device does not report a preferred rate.
+		return s_OutputInfo.preferredSampleRate ? s_OutputInfo.preferredSampleRate : 44100u;
+	}
+
+	u32 getOutputSampleRate()
+	{
+		return s_outputSampleRate;
+	}
+
+	bool isNullDevice()
+	{
+		return s_nullDevice;
+	}
+
+	void updateNullOutput(f64 dt)
+	{
+		if (!s_nullDevice || !s_streamStarted) { return; }
+
+		// The frame count is derived from the total virtual time so rounding errors do not accumulate.
+		s_nullTime += dt;
+		const u64 targetFrameCount = u64(s_nullTime * f64(s_outputSampleRate) + 0.5);
+		while (s_nullFrameCount < targetFrameCount)
+		{
+			const u32 frameCount = u32(std::min(u64(s_audioFrameSize), targetFrameCount - s_nullFrameCount));
+			const f64 streamTime = f64(s_nullFrameCount) / f64(s_outputSampleRate);
+			s_nullCallback(s_nullBuffer.data(), nullptr, frameCount, streamTime, 0u, s_nullUserData);
+			if (s_wavOutput)
+			{
+				TFE_WAV::writeFrames(s_wavOutput, s_nullBuffer.data(), frameCount);
+			}
+			s_nullFrameCount += frameCount;
+		}
+	}
+
+	bool startWavOutput(const char* path)
+	{
+		if (!s_nullDevice || !s_streamStarted) { return false; }
+
+		endWavOutput();
+		s_wavOutput = TFE_WAV::startWav(path, s_outputSampleRate, s_nullChannels);
+		if (!s_wavOutput)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Audio", "Cannot open '%s' for writing.", path);
+			return false;
+		}
+		TFE_System::logWrite(LOG_MSG, "Audio", "Writing audio output to '%s'.", path);
+		return true;
+	}
+
+	void endWavOutput()
+	{
+		if (s_wavOutput)
+		{
+			TFE_WAV::endWav(s_wavOutput);
+			s_wavOutput = nullptr;
+		}
+	}
 }
@@ -24,9 +24,24 @@ typedef s32(*StreamCallback)(void* outputBuffer, void* inputBuffer, u32 nFrames,
 
 namespace TFE_AudioDevice
 {
-	bool init(u32 audioFrameSize = 256u);
+	// The null device does not play anything, instead the stream callback is pulled at a fixed virtual rate by
+	// updateNullOutput() and the output can be written to a WAV file. It is used automatically if there is no output device.
+	bool init(u32 audioFrameSize = 256u, bool nullDevice = false);
 	void destroy();
 
 	bool startOutput(StreamCallback callback, void* userData = 0, u32 channels = 2, u32 sampleRate = 44100);
 	void stopOutput();
+
+	// Null device only.
+	bool isNullDevice();
+	// Pull 'dt' seconds of audio from the stream callback.
+	void updateNullOutput(f64 dt);
+	// Write the output stream to a WAV file, the output must already be started.
+	bool startWavOutput(const char* path);
+	void endWavOutput();
+
+	// The native sample rate of the output device, so the mixer can avoid another resampling step in the OS.
+	u32 getPreferredSampleRate();
+	// The sample rate of the running output stream.
+	u32 getOutputSampleRate();
 };
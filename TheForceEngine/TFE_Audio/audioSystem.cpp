@@ -5,37 +5,26 @@
 #include <TFE_System/system.h>
 #include <TFE_System/math.h>
 #include <TFE_Settings/settings.h>
+#include <TFE_System/profiler.h>
+#include <TFE_System/Threads/spscQueue.h>
 #include <TFE_FrontEndUI/console.h>
 #include <assert.h>
 #include <algorithm>
-
-// TODO: Add a command queue to avoid locking on the audio thread.
-// Commands for adding/removing sources, changing volume, etc.
-/*
-#include <atomic>
-typedef std::atomic_int  s32_atomic;
-typedef std::atomic_uint u32_atomic;
-#define atomicFetchAdd(a,b)   std::atomic_fetch_add(a,b)
-#define atomicWrite(a, value) std::atomic_store(a, value)
-#define atomicRead(a)         std::atomic_load(a)
-
-u32 writeBuffer;
-u32_atomic readBuffer;	// just keep incrementing and fixup after read.
-
-writeBuffer = 0;
-atomicWrite(&readBuffer, BUFFER_COUNT - 1);
-
-// Write data to [writeBuffer]
-// ...
-// Mark the readBuffer = writeBuffer
-atomicWrite(&readBuffer, writeBuffer);
-// Increment writeBuffer for next frame.
-writeBuffer = (writeBuffer + 1) % BUFFER_COUNT;
-
-// Read current buffer index in the audio thread.
-u32 index = atomicRead(&readBuffer);
-*/
-
+#include <vector>
+
+// The mixer uses SSE when available, which is always the case for x64 builds.
+#if defined(_M_X64) || defined(__SSE2__)
+#define AUDIO_MIX_SSE 1
+#include <emmintrin.h>
+#endif
+
+// The game thread and the audio thread do not share source state directly.
+// The game thread owns s_sources[] and sends discrete changes (play, stop, buffer changes)
+// to the mixer through a lock-free command queue. Per-frame parameters such as the volume and
+// stereo seperation computed from the listener and source positions are published through a
+// triple buffer. The mixer sends "finished" events back through a second queue, which are
+// processed on the game thread (so finished callbacks are also called on the game thread).
+// This way neither thread ever waits on the other.
 // Comment out the desired sigmoid function and comment all of the others.
 //#define AUDIO_SIGMOID_CLIP 1
 #define AUDIO_SIGMOID_TANH 1
@@ -48,6 +37,76 @@ enum SoundSourceFlags
 	SND_FLAG_LOOPING  = (1 << 2),
 	SND_FLAG_PLAYING  = (1 << 3),
 	SND_FLAG_FINISHED = (1 << 4),
+	SND_FLAG_VIRTUAL  = (1 << 5),	// Playing but not mixed, either inaudible or culled by the real voice limit.
+};
+
+enum AudioCommandType
+{
+	ACMD_PLAY = 0,		// Start playing a source from the beginning.
+	ACMD_STOP,			// Stop playing a source.
+	ACMD_SET_BUFFER,	// Change the source buffer and restart.
+	ACMD_STOP_ALL,		// Stop all sources.
+};
+
+enum AudioConstants
+{
+	AUDIO_COMMAND_CAPACITY = 1024,
+	AUDIO_EVENT_CAPACITY   = 256,
+	MIX_PARAMS_DIRTY       = (1 << 31),
+	MIX_PARAMS_INDEX_MASK  = 3,
+	MIX_BLOCK_SIZE         = 256,	// Voices are mixed in blocks of up to this many frames.
+	RESAMPLE_PHASE_BITS    = 8,
+	RESAMPLE_PHASE_COUNT   = (1 << RESAMPLE_PHASE_BITS),
+	RESAMPLE_MAX_TAPS      = 16,
+	RESAMPLE_MAX_STEP      = 8,		// Sources may be at most 8x the output rate.
+	RESAMPLE_INPUT_SIZE    = MIX_BLOCK_SIZE * RESAMPLE_MAX_STEP + RESAMPLE_MAX_TAPS,
+};
+
+// Commands sent from the game thread to the mixer.
+struct AudioCommand
+{
+	AudioCommandType type;
+	s32 slot;
+	u32 gen;
+	u32 flags;
+	const SoundBuffer* buffer;
+	f32 volume;
+	f32 seperation;
+	u32 seq;		// Set by pushCommand(), the mixer checks that commands arrive exactly once and in order.
+};
+
+// Events sent from the mixer back to the game thread.
+struct AudioEvent
+{
+	s32 slot;
+	u32 gen;
+	u32 seq;
+};
+
+// The mixer copy of a sound source, only accessed on the audio thread.
+struct MixVoice
+{
+	const SoundBuffer* buffer;
+	u32 sampleIndex;
+	u32 sampleFrac;		// Fractional part of the play cursor (0.32 fixed point).
+	u64 step;			// Cursor step per output sample (32.32 fixed point).
+	u32 flags;
+	u32 gen;
+	f32 volume;
+	f32 seperation;
+	// Gains used for the previous block, so changes can be ramped. Negative if the voice has not been mixed yet.
+	f32 gainL;
+	f32 gainR;
+};
+
+// Source parameters computed once per frame on the game thread.
+// A parameter set is only applied to a voice if the generation matches, so stale values never leak into a reused slot.
+struct MixParams
+{
+	u32 gen[MAX_SOUND_SOURCES];
+	f32 volume[MAX_SOUND_SOURCES];
+	f32 seperation[MAX_SOUND_SOURCES];
+	u8  isVirtual[MAX_SOUND_SOURCES];
 };
 
 struct SoundSource
@@ -58,7 +117,9 @@ struct SoundSource
 	f32 seperation;		//stereo seperation.
 	u32 sampleIndex;
 	u32 flags;
+	s32 priority;
 	s32 slot;
+	u32 gen;			// Incremented each time the source starts playing, used to match mixer events.
 
 	// Sound data.
 	const SoundBuffer* buffer;
@@ -82,45 +143,114 @@ namespace TFE_Audio
 	static const f32 c_stereoSwing   = 0.45f;	// 0.0 = mono positional audio (sound equal in both speakers), 0.5 = full swing (i.e. sound to the left is ONLY heard in the left speaker).
 	static const f32 c_channelLimit  = 1.0f;
 	static const f32 c_soundHeadroom = 0.35f;	// approximately 1 / sqrt(8); assuming 8 uncorrelated sounds playing at full volume.
+	static const f32 c_virtualVolume = 0.002f;	// Sources quieter than this (about -54 dB) are virtual.
 
 	// Client volume controls, ranging from [0, 1]
 	static f32 s_soundFxVolume = 1.0f;
 	// Internal sound scale based on the client volume and headroom.
-	static f32 s_soundFxScale = s_soundFxVolume * c_soundHeadroom;	// actual volume scale based on client set volume and headroom.
+	static atomic_f32 s_soundFxScale(s_soundFxVolume * c_soundHeadroom);	// actual volume scale based on client set volume and headroom.
 
+	// Game thread state.
 	static u32 s_sourceCount;
 	static Vec3f s_listener;
-	// TODO: This will need to be buffered to avoid locks.
 	static SoundSource s_sources[MAX_SOUND_SOURCES];
-	static Mutex s_mutex;
-	static bool s_paused = false;
+	static s32 s_freeSlots[MAX_SOUND_SOURCES];		// Slots that have been freed below s_sourceCount, so allocation does not search.
+	static u32 s_freeSlotCount = 0;
+	static s32 s_audibleSlots[MAX_SOUND_SOURCES];
+	static u32 s_paramsWrite = 0;
+	static atomic_bool s_paused(false);
+
+	// Shared between threads.
+	static SpscQueue<AudioCommand, AUDIO_COMMAND_CAPACITY> s_commands;
+	static SpscQueue<AudioEvent, AUDIO_EVENT_CAPACITY> s_events;
+	static MixParams s_mixParams[3];
+	static atomic_u32 s_paramsMiddle(2);
+	static atomic_u32 s_underrunCount(0);
+	// Sequence numbers of the queues, each side counts the entries it has pushed or popped. A gap, repeat or
+	// out of order entry is counted in 's_queueSeqErrors' and should never happen.
+	static u32 s_commandPushSeq = 0;		// Game thread.
+	static atomic_u32 s_commandPopSeq(0);	// Audio thread, read by the stress test.
+	static u32 s_eventPushSeq = 0;			// Audio thread.
+	static u32 s_eventPopSeq = 0;			// Game thread.
+	static atomic_u32 s_queueSeqErrors(0);
+	static std::atomic<AudioThreadCallback> s_audioThreadCallback(nullptr);
+	static bool s_nullDeviceRequested = false;
+
+	// Audio thread state.
+	static MixVoice s_voices[MAX_SOUND_SOURCES];
+	static u32 s_voiceCount = 0;
+	static u32 s_paramsRead = 1;
+	static f32 s_voiceScratch[MIX_BLOCK_SIZE];
+	static f32 s_inputScratch[RESAMPLE_INPUT_SIZE];
+
+	// Resampling
+	// The mixer runs at the native rate of the output device, sources are resampled from their own rate.
+	static const u32 c_defaultSampleRate = 11025u;
+	static const u32 c_resampleTaps[RESAMPLE_COUNT] = { 2u, 8u, 16u };
+	static atomic_u32 s_mixRate(c_defaultSampleRate);
+	static atomic_s32 s_resampleQuality(RESAMPLE_SINC8);
+	alignas(16) static f32 s_resampleKernel[RESAMPLE_COUNT][RESAMPLE_PHASE_COUNT * RESAMPLE_MAX_TAPS];
+
+	// Stats, copied to the game thread so they can be displayed as profiler counters.
+	static s32 s_audioUnderruns = 0;
+	static s32 s_audioDroppedCommands = 0;
+	static s32 s_audioActiveSources = 0;
+	static s32 s_audioRealVoices = 0;
+	static s32 s_audioVirtualVoices = 0;
 
 	s32 audioCallback(void *outputBuffer, void* inputBuffer, u32 bufferSize, f64 streamTime, u32 status, void* userData);
 	void setSoundVolumeConsole(const ConsoleArgList& args);
 	void getSoundVolumeConsole(const ConsoleArgList& args);
-
-	bool init()
+	void audioBenchmarkConsole(const ConsoleArgList& args);
+	void audioStressConsole(const ConsoleArgList& args);
+	void setResampleQualityConsole(const ConsoleArgList& args);
+	void audioWavConsole(const ConsoleArgList& args);
+	void buildResampleKernels();
+	void mixer_setVoiceStep(MixVoice* voice);
+	void processMixerEvents();
+	void resetSources();
+
+	bool init(bool nullDevice)
 	{
 		TFE_System::logWrite(LOG_MSG, "Startup", "TFE_AudioSystem::init");
 		s_sourceCount = 0u;
 		s_listener = { 0 };
 
-		MUTEX_INITIALIZE(&s_mutex);
-
 		CCMD("setSoundVolume", setSoundVolumeConsole, 1, "Sets the sound volume, range is 0.0 to 1.0");
 		CCMD("getSoundVolume", getSoundVolumeConsole, 0, "Get the current sound volume.");
+		CCMD("audioBenchmark", audioBenchmarkConsole, 0, "Benchmark the sound mixer offline, 128 voices for 10 seconds at each resampling quality.");
+		CCMD("audioStress", audioStressConsole, 0, "Flood the mixer command and finished-sound queues from the game thread for a number of seconds (default 5) - audioStress 10");
+		CCMD("setResampleQuality", setResampleQualityConsole, 1, "Sets the audio resampling quality: 0 = linear, 1 = 8-tap sinc, 2 = 16-tap sinc.");
+		CCMD("audioWav", audioWavConsole, 0, "Write the audio output to a WAV file using the null device: audioWav output.wav, stop with no arguments.");
 
 		TFE_Settings_Sound* soundSettings = TFE_Settings::getSoundSettings();
 		setVolume(soundSettings->soundFxVolume);
+		setResampleQuality(ResampleQuality(soundSettings->resampleQuality));
+		buildResampleKernels();
 
 		memset(s_sources, 0, sizeof(SoundSource) * MAX_SOUND_SOURCES);
+		memset(s_voices, 0, sizeof(MixVoice) * MAX_SOUND_SOURCES);
+		memset(s_mixParams, 0, sizeof(MixParams) * 3);
 		for (s32 i = 0; i < MAX_SOUND_SOURCES; i++)
 		{
 			s_sources[i].slot = i;
 		}
 
-		bool res = TFE_AudioDevice::init();
-		res |= TFE_AudioDevice::startOutput(audioCallback, nullptr, 2u, 11025u);
+		TFE_COUNTER(s_audioUnderruns, "Audio Underruns");
+		TFE_COUNTER(s_audioDroppedCommands, "Audio Dropped Commands");
+		TFE_COUNTER(s_audioActiveSources, "Audio Active Sources");
+		TFE_COUNTER(s_audioRealVoices, "Audio Real Voices");
+		TFE_COUNTER(s_audioVirtualVoices, "Audio Virtual Voices");
+
+		s_nullDeviceRequested = nullDevice;
+		bool res = TFE_AudioDevice::init(256u, nullDevice);
+		// Mix at the native device rate so the OS does not have to resample again.
+		s_mixRate.store(TFE_AudioDevice::getPreferredSampleRate());
+		res |= TFE_AudioDevice::startOutput(audioCallback, nullptr, 2u, s_mixRate.load());
+		if (TFE_AudioDevice::getOutputSampleRate())
+		{
+			s_mixRate.store(TFE_AudioDevice::getOutputSampleRate());
+		}
 		return res;
 	}
 
@@ -130,25 +260,98 @@ namespace TFE_Audio
 		stopAllSounds();
 
 		TFE_AudioDevice::destroy();
-		MUTEX_DESTROY(&s_mutex);
+	}
+
+	void updateOutput(f64 dt)
+	{
+		// The null device has no audio thread, so the game thread mixes the audio for the frame.
+		TFE_AudioDevice::updateNullOutput(dt);
+	}
+
+	// Restart the output on a different device. The mix rate is kept so the voices and any
+	// generated audio are unaffected.
+	bool switchDevice(bool nullDevice)
+	{
+		if (TFE_AudioDevice::isNullDevice() == nullDevice) { return true; }
+
+		TFE_AudioDevice::destroy();
+		bool res = TFE_AudioDevice::init(256u, nullDevice);
+		res &= TFE_AudioDevice::startOutput(audioCallback, nullptr, 2u, s_mixRate.load());
+		return res;
+	}
+
+	bool startWavCapture(const char* path)
+	{
+		if (!switchDevice(true)) { return false; }
+		return TFE_AudioDevice::startWavOutput(path);
+	}
+
+	void endWavCapture()
+	{
+		TFE_AudioDevice::endWavOutput();
+		if (!s_nullDeviceRequested)
+		{
+			switchDevice(false);
+		}
+	}
+
+	// Send a command to the mixer, this never blocks.
+	bool pushCommand(const AudioCommand& cmd)
+	{
+		AudioCommand seqCmd = cmd;
+		seqCmd.seq = s_commandPushSeq;
+		if (!s_commands.push(seqCmd))
+		{
+			s_audioDroppedCommands++;
+			return false;
+		}
+		s_commandPushSeq++;
+		return true;
+	}
+
+	// Receive an event from the mixer, checking that it is the next one sent.
+	static bool popEvent(AudioEvent* evt)
+	{
+		if (!s_events.pop(evt)) { return false; }
+		if (evt->seq != s_eventPopSeq)
+		{
+			s_queueSeqErrors++;
+			assert(0);
+		}
+		s_eventPopSeq = evt->seq + 1;
+		return true;
 	}
 
 	void stopAllSounds()
 	{
-		MUTEX_LOCK(&s_mutex);
+		resetSources();
+
+		AudioCommand cmd = { ACMD_STOP_ALL };
+		pushCommand(cmd);
+
+		// Any pending events refer to sources that no longer exist.
+		AudioEvent evt;
+		while (popEvent(&evt));
+	}
+
+	void resetSources()
+	{
 		s_sourceCount = 0u;
-		memset(s_sources, 0, sizeof(SoundSource) * MAX_SOUND_SOURCES);
+		s_freeSlotCount = 0u;
 		for (s32 i = 0; i < MAX_SOUND_SOURCES; i++)
 		{
+			// Keep the generation so that events from before the reset are never matched to new sounds.
+			const u32 gen = s_sources[i].gen;
+			memset(&s_sources[i], 0, sizeof(SoundSource));
 			s_sources[i].slot = i;
+			s_sources[i].gen = gen;
 		}
-		MUTEX_UNLOCK(&s_mutex);
 	}
 
 	void setVolume(f32 volume)
 	{
 		s_soundFxVolume = volume;
-		s_soundFxScale = s_soundFxVolume * c_soundHeadroom;
+		s_soundFxScale.store(s_soundFxVolume * c_soundHeadroom);
 	}
 
 	f32 getVolume()
@@ -156,6 +359,16 @@ namespace TFE_Audio
 		return s_soundFxVolume;
 	}
 
+	void setResampleQuality(ResampleQuality quality)
+	{
+		s_resampleQuality.store(std::max(0, std::min(s32(quality), s32(RESAMPLE_COUNT) - 1)));
+	}
+
+	ResampleQuality getResampleQuality()
+	{
+		return ResampleQuality(s_resampleQuality.load());
+	}
+
 	void pause()
 	{
 		s_paused = true;
@@ -166,20 +379,73 @@ namespace TFE_Audio
 		s_paused = false;
 	}
 
-	// Issue - too many locks, wasted time looping over inactive sources.
-	// TODO: Reduce audio thread cost and remove locks:
-	// 1. SoundSource base array.
-	// 2. SoundSource active array, only contains active sounds, sounds with data, etc.
-	// 3. Add small queue with finished sounds; do cleanup during main thread update().
-	//
-	// Better:
-	// Keep threads data seperate.
-	// Add command buffer.
-	// Add/Remove from main thread (add sound when play is called, set volume, etc.)
-	// Setup finished queue to handle sounds finishing.
+	u32 getMixSampleRate()
+	{
+		return s_mixRate.load();
+	}
+
+	void setAudioThreadCallback(AudioThreadCallback callback)
+	{
+		s_audioThreadCallback.store(callback);
+	}
+
+	// Publish the per-frame source parameters to the mixer.
+	void publishMixParams()
+	{
+		MixParams* params = &s_mixParams[s_paramsWrite];
+		for (u32 s = 0; s < MAX_SOUND_SOURCES; s++)
+		{
+			const SoundSource* snd = &s_sources[s];
+			params->gen[s] = (s < s_sourceCount && (snd->flags & SND_FLAG_PLAYING)) ? snd->gen : 0u;
+			params->volume[s] = snd->volume;
+			params->seperation[s] = snd->seperation;
+			params->isVirtual[s] = (snd->flags & SND_FLAG_VIRTUAL) ? 1 : 0;
+		}
+		// Swap the write buffer with the middle buffer and flag it as new for the mixer.
+		s_paramsWrite = s_paramsMiddle.exchange(s_paramsWrite | MIX_PARAMS_DIRTY) & MIX_PARAMS_INDEX_MASK;
+	}
+
+	// Decide which playing sources are mixed, the rest are virtual.
+	// Inaudible sources are always virtual, if there are still too many the highest priority and then loudest sources are kept.
+	void selectRealVoices()
+	{
+		u32 audibleCount = 0;
+		SoundSource* snd = s_sources;
+		for (u32 s = 0; s < s_sourceCount; s++, snd++)
+		{
+			if (!(snd->flags & SND_FLAG_PLAYING)) { continue; }
+
+			snd->flags |= SND_FLAG_VIRTUAL;
+			if (snd->volume >= c_virtualVolume)
+			{
+				s_audibleSlots[audibleCount++] = s32(s);
+			}
+		}
+
+		u32 realCount = audibleCount;
+		if (audibleCount > MAX_REAL_VOICES)
+		{
+			realCount = MAX_REAL_VOICES;
+			std::nth_element(s_audibleSlots, s_audibleSlots + realCount, s_audibleSlots + audibleCount, [](s32 a, s32 b)
+			{
+				const SoundSource* sa = &s_sources[a];
+				const SoundSource* sb = &s_sources[b];
+				if (sa->priority != sb->priority) { return sa->priority > sb->priority; }
+				if (sa->volume != sb->volume) { return sa->volume > sb->volume; }
+				return a < b;
+			});
+		}
+		for (u32 i = 0; i < realCount; i++)
+		{
+			s_sources[s_audibleSlots[i]].flags &= ~SND_FLAG_VIRTUAL;
+		}
+		s_audioRealVoices = s32(realCount);
+	}
 
 	void update(const Vec3f* listenerPos, const Vec3f* listenerDir)
 	{
+		processMixerEvents();
+
 		// Currently positional audio only accounts for the "horizontal plane"
 		// TODO: Support proper HRTF as an option, though we want to keep the "old school" handling in for the classic mode.
 		Vec2f listDirXZ = { listenerDir->x, listenerDir->z };
@@ -228,32 +494,112 @@ namespace TFE_Audio
 				}
 			}
 		}
+		selectRealVoices();
+		publishMixParams();
+
+		s_audioUnderruns = (s32)s_underrunCount.load(std::memory_order_relaxed);
+		s_audioActiveSources = 0;
+		for (u32 s = 0; s < s_sourceCount; s++)
+		{
+			if (s_sources[s].flags & SND_FLAG_PLAYING) { s_audioActiveSources++; }
+		}
+		s_audioVirtualVoices = s_audioActiveSources - s_audioRealVoices;
 	}
 
-	// One shot, play and forget. Only do this if the client needs no control until stopAllSounds() is called.
-	// Note that looping one shots are valid.
-	bool playOneShot(SoundType type, f32 volume, f32 stereoSeperation, const SoundBuffer* buffer, bool looping, const Vec3f* pos, bool copyPosition, SoundFinishedCallback finishedCallback, void* cbUserData, s32 cbArg)
+	// Take a slot from the free list, or a new slot past the current sources.
+	SoundSource* allocateSource()
 	{
-		if (!buffer) { return false; }
+		// Handle finished sounds first so their slots can be reused.
+		processMixerEvents();
 
-		MUTEX_LOCK(&s_mutex);
-		// Find the first inactive source.
-		SoundSource* snd = s_sources;
-		SoundSource* newSource = nullptr;
-		for (u32 s = 0; s < s_sourceCount; s++, snd++)
+		while (s_freeSlotCount)
 		{
-			if (!(snd->flags&SND_FLAG_ACTIVE))
+			// The source count may have shrunk below the slot since it was freed.
+			const s32 slot = s_freeSlots[--s_freeSlotCount];
+			if (!(s_sources[slot].flags & SND_FLAG_ACTIVE))
 			{
-				newSource = snd;
-				break;
+				s_sourceCount = std::max(s_sourceCount, u32(slot + 1));
+				s_sources[slot].priority = SOUND_PRIORITY_NORMAL;
+				return &s_sources[slot];
 			}
 		}
-		if (!newSource && s_sourceCount < MAX_SOUND_SOURCES)
+		if (s_sourceCount < MAX_SOUND_SOURCES)
 		{
-			newSource = &s_sources[s_sourceCount];
+			SoundSource* newSource = &s_sources[s_sourceCount];
+			newSource->priority = SOUND_PRIORITY_NORMAL;
 			s_sourceCount++;
+			return newSource;
+		}
+		return nullptr;
+	}
+
+	void releaseSource(SoundSource* source)
+	{
+		if (source->flags & SND_FLAG_ACTIVE)
+		{
+			s_freeSlots[s_freeSlotCount++] = source->slot;
+		}
+		source->flags &= ~(SND_FLAG_PLAYING | SND_FLAG_ACTIVE | SND_FLAG_VIRTUAL);
+	}
+
+	// Called on the game thread when the mixer has finished playing a source.
+	void sourceFinished(SoundSource* source)
+	{
+		releaseSource(source);
+		if (source->finishedCallback)
+		{
+			source->finishedCallback(source->finishedUserData, source->finishedArg);
+		}
+	}
+
+	void sendPlayCommand(SoundSource* source)
+	{
+		// Skip 0 so that it always means "no source".
+		source->gen++;
+		if (source->gen == 0) { source->gen++; }
+
+		AudioCommand cmd;
+		cmd.type = ACMD_PLAY;
+		cmd.slot = source->slot;
+		cmd.gen = source->gen;
+		cmd.flags = source->flags & SND_FLAG_LOOPING;
+		cmd.buffer = source->buffer;
+		cmd.volume = source->volume;
+		cmd.seperation = source->seperation;
+		if (!pushCommand(cmd))
+		{
+			// The mixer will never see this sound, so finish it right away.
+			sourceFinished(source);
+		}
+	}
+
+	void processMixerEvents()
+	{
+		AudioEvent evt;
+		while (popEvent(&evt))
+		{
+			SoundSource* source = &s_sources[evt.slot];
+			// Ignore events from previous uses of the slot.
+			if (evt.gen == source->gen && (source->flags & SND_FLAG_ACTIVE))
+			{
+				sourceFinished(source);
+			}
 		}
 
+		// Shrink the number of sources until an active source is found.
+		while (s_sourceCount > 0 && !(s_sources[s_sourceCount - 1].flags & SND_FLAG_ACTIVE))
+		{
+			s_sourceCount--;
+		}
+	}
+
+	// One shot, play and forget. Only do this if the client needs no control until stopAllSounds() is called.
+	// Note that looping one shots are valid.
+	bool playOneShot(SoundType type, f32 volume, f32 stereoSeperation, const SoundBuffer* buffer, bool looping, const Vec3f* pos, bool copyPosition, SoundFinishedCallback finishedCallback, void* cbUserData, s32 cbArg, s32 priority)
+	{
+		if (!buffer) { return false; }
+
+		SoundSource* newSource = allocateSource();
 		if (newSource)
 		{
 			newSource->type = type;
@@ -279,8 +625,9 @@ namespace TFE_Audio
 			newSource->finishedCallback = finishedCallback;
 			newSource->finishedUserData = cbUserData;
 			newSource->finishedArg = cbArg;
+			newSource->priority = priority;
+			sendPlayCommand(newSource);
 		}
-		MUTEX_UNLOCK(&s_mutex);
 
 		return newSource != nullptr;
 	}
@@ -290,24 +637,7 @@ namespace TFE_Audio
 	{
 		if (!buffer) { return nullptr; }
 
-		MUTEX_LOCK(&s_mutex);
-		// Find the first inactive source.
-		SoundSource* snd = s_sources;
-		SoundSource* newSource = nullptr;
-		for (u32 s = 0; s < s_sourceCount; s++, snd++)
-		{
-			if (!(snd->flags&SND_FLAG_ACTIVE))
-			{
-				newSource = snd;
-				break;
-			}
-		}
-		if (!newSource && s_sourceCount < MAX_SOUND_SOURCES)
-		{
-			newSource = &s_sources[s_sourceCount];
-			s_sourceCount++;
-		}
-
+		SoundSource* newSource = allocateSource();
 		if (newSource)
 		{
 			newSource->type = type;
@@ -329,7 +659,6 @@ namespace TFE_Audio
 			newSource->finishedCallback = nullptr;
 			newSource->finishedUserData = nullptr;
 		}
-		MUTEX_UNLOCK(&s_mutex);
 
 		return newSource;
 	}
@@ -360,29 +689,29 @@ namespace TFE_Audio
 		{
 			return;
 		}
-		
-		MUTEX_LOCK(&s_mutex);
-			source->flags |= SND_FLAG_PLAYING;
-			if (looping) { source->flags |= SND_FLAG_LOOPING; }
-			source->sampleIndex = 0u;
-		MUTEX_UNLOCK(&s_mutex);
+
+		source->flags |= SND_FLAG_PLAYING;
+		if (looping) { source->flags |= SND_FLAG_LOOPING; }
+		source->sampleIndex = 0u;
+		sendPlayCommand(source);
 	}
 
 	void stopSource(SoundSource* source)
 	{
 		if (!source) { return; }
-		MUTEX_LOCK(&s_mutex);
-			source->flags &= ~SND_FLAG_PLAYING;
-		MUTEX_UNLOCK(&s_mutex);
+		source->flags &= ~(SND_FLAG_PLAYING | SND_FLAG_VIRTUAL);
+
+		AudioCommand cmd = { ACMD_STOP, source->slot };
+		pushCommand(cmd);
 	}
 	
 	void freeSource(SoundSource* source)
 	{
 		if (!source) { return; }
-		MUTEX_LOCK(&s_mutex);
-			source->flags &= ~SND_FLAG_PLAYING;
-			source->flags &= ~SND_FLAG_ACTIVE;
-		MUTEX_UNLOCK(&s_mutex);
+		releaseSource(source);
+
+		AudioCommand cmd = { ACMD_STOP, source->slot };
+		pushCommand(cmd);
 	}
 
 	void setSourceVolume(SoundSource* source, f32 volume)
@@ -395,6 +724,12 @@ namespace TFE_Audio
 		source->seperation = std::max(0.0f, std::min(stereoSeperation, 1.0f));
 	}
 
+	void setSourcePriority(SoundSource* source, s32 priority)
+	{
+		source->priority = priority;
+	}
+
+	// Positions are only read on the game thread in update(), the mixer receives the resulting volume and seperation.
 	void setSourcePosition(SoundSource* source, const Vec3f* pos)
 	{
 		source->localPos = *pos;
@@ -403,10 +738,12 @@ namespace TFE_Audio
 	// This will restart the sound and change the buffer.
 	void setSourceBuffer(SoundSource* source, const SoundBuffer* buffer)
 	{
-		MUTEX_LOCK(&s_mutex);
-			source->sampleIndex = 0u;
-			source->buffer = buffer;
-		MUTEX_UNLOCK(&s_mutex);
+		source->sampleIndex = 0u;
+		source->buffer = buffer;
+
+		AudioCommand cmd = { ACMD_SET_BUFFER, source->slot };
+		cmd.buffer = buffer;
+		pushCommand(cmd);
 	}
 
 	bool isSourcePlaying(SoundSource* source)
@@ -423,121 +760,792 @@ namespace TFE_Audio
 	static const f32 c_scale[] = { 2.0f / 255.0f, 2.0f / 65535.0f, 1.0f };
 	static const f32 c_offset[] = { -1.0f, -1.0f, 0.0f };
 
-	void cleanupSources()
+	// Apply commands from the game thread, called at the start of each mix.
+	void mixer_processCommands()
 	{
-		// call any finished callbacks.
-		for (u32 s = 0; s < s_sourceCount; s++)
+		AudioCommand cmd;
+		u32 seq = s_commandPopSeq.load(std::memory_order_relaxed);
+		while (s_commands.pop(&cmd))
 		{
-			if (s_sources[s].flags&SND_FLAG_FINISHED)
+			if (cmd.seq != seq)
+			{
+				s_queueSeqErrors++;
+				assert(0);
+			}
+			seq = cmd.seq + 1;
+			s_commandPopSeq.store(seq, std::memory_order_release);
+
+			MixVoice* voice = &s_voices[cmd.slot];
+			switch (cmd.type)
 			{
-				s_sources[s].flags &= ~SND_FLAG_FINISHED;
-				s_sources[s].flags &= ~SND_FLAG_ACTIVE;
-				if (s_sources[s].finishedCallback)
+				case ACMD_PLAY:
 				{
-					s_sources[s].finishedCallback(s_sources[s].finishedUserData, s_sources[s].finishedArg);
-				}
+					voice->buffer = cmd.buffer;
+					voice->sampleIndex = 0u;
+					mixer_setVoiceStep(voice);
+					voice->flags = SND_FLAG_PLAYING | cmd.flags;
+					voice->gen = cmd.gen;
+					voice->volume = cmd.volume;
+					voice->seperation = cmd.seperation;
+					voice->gainL = -1.0f;
+					voice->gainR = -1.0f;
+					s_voiceCount = std::max(s_voiceCount, u32(cmd.slot + 1));
+				} break;
+				case ACMD_STOP:
+				{
+					voice->flags = 0u;
+				} break;
+				case ACMD_SET_BUFFER:
+				{
+					voice->buffer = cmd.buffer;
+					voice->sampleIndex = 0u;
+					mixer_setVoiceStep(voice);
+				} break;
+				case ACMD_STOP_ALL:
+				{
+					for (u32 s = 0; s < s_voiceCount; s++)
+					{
+						s_voices[s].flags = 0u;
+					}
+					s_voiceCount = 0u;
+				} break;
 			}
 		}
+	}
 
-		const s32 end = (s32)s_sourceCount - 1;
-		//shrink the number of sources until an active source is found.
-		for (s32 s = end; s >= 0; s--)
+	// Pick up the latest source parameters from the game thread, if they have changed.
+	void mixer_updateParams()
+	{
+		if (!(s_paramsMiddle.load() & MIX_PARAMS_DIRTY))
 		{
-			if (s_sources[s].flags&SND_FLAG_ACTIVE)
+			return;
+		}
+		s_paramsRead = s_paramsMiddle.exchange(s_paramsRead) & MIX_PARAMS_INDEX_MASK;
+
+		const MixParams* params = &s_mixParams[s_paramsRead];
+		MixVoice* voice = s_voices;
+		for (u32 s = 0; s < s_voiceCount; s++, voice++)
+		{
+			if (voice->gen == params->gen[s])
 			{
-				break;
+				voice->volume = params->volume[s];
+				voice->seperation = params->seperation[s];
+				voice->flags = params->isVirtual[s] ? (voice->flags | SND_FLAG_VIRTUAL) : (voice->flags & ~SND_FLAG_VIRTUAL);
 			}
-			s_sourceCount--;
+		}
+	}
+
+	// Send finished events back to the game thread. If the queue is full the voice stays flagged and is sent next time.
+	void mixer_sendEvents()
+	{
+		MixVoice* voice = s_voices;
+		for (u32 s = 0; s < s_voiceCount; s++, voice++)
+		{
+			if (voice->flags & SND_FLAG_FINISHED)
+			{
+				AudioEvent evt = { (s32)s, voice->gen, s_eventPushSeq };
+				if (!s_events.push(evt))
+				{
+					break;
+				}
+				s_eventPushSeq++;
+				voice->flags &= ~SND_FLAG_FINISHED;
+			}
+		}
+
+		// Shrink the number of voices until an active voice is found.
+		while (s_voiceCount > 0 && !s_voices[s_voiceCount - 1].flags)
+		{
+			s_voiceCount--;
 		}
 	}
 		
-	f32 sampleBuffer(u32 index, SoundDataType type, const u8* data)
+	// Convert 'count' samples starting at 'index' to float, the range must be inside of the buffer.
+	void mixer_convertSamples(const SoundBuffer* buffer, u32 index, u32 count, f32* dst)
 	{
-		f32 sampleValue;
+		const SoundDataType type = buffer->type;
+		const f32 scale  = c_scale[type];
+		const f32 offset = c_offset[type];
 		switch (type)
 		{
-			case SOUND_DATA_8BIT:  { sampleValue = (f32)data[index]; } break;
-			case SOUND_DATA_16BIT: { sampleValue = (f32)(*((u16*)data + index)); } break;
-			case SOUND_DATA_FLOAT: { sampleValue = *((f32*)data + index); } break;
-		};
+			case SOUND_DATA_8BIT:
+			{
+				const u8* src = buffer->data + index;
+				for (u32 i = 0; i < count; i++) { dst[i] = f32(src[i]) * scale + offset; }
+			} break;
+			case SOUND_DATA_16BIT:
+			{
+				const u16* src = (u16*)buffer->data + index;
+				for (u32 i = 0; i < count; i++) { dst[i] = f32(src[i]) * scale + offset; }
+			} break;
+			case SOUND_DATA_FLOAT:
+			{
+				memcpy(dst, (f32*)buffer->data + index, sizeof(f32) * count);
+			} break;
+		}
+	}
+
+	// The number of samples in the loop, or 0 if the voice does not loop.
+	u32 mixer_getLoopLength(const MixVoice* voice)
+	{
+		const SoundBuffer* buffer = voice->buffer;
+		return ((voice->flags & SND_FLAG_LOOPING) && buffer->loopStart < buffer->size) ? buffer->size - buffer->loopStart : 0u;
+	}
 
-		return sampleValue * c_scale[type] + c_offset[type];
+	void mixer_finishVoice(MixVoice* voice)
+	{
+		voice->flags &= ~(SND_FLAG_PLAYING | SND_FLAG_VIRTUAL);
+		voice->flags |= SND_FLAG_FINISHED;
+		voice->sampleIndex = 0u;
+		voice->sampleFrac = 0u;
 	}
-		
-	// Audio callback
-	s32 audioCallback(void *outputBuffer, void* inputBuffer, u32 bufferSize, f64 streamTime, u32 status, void* userData)
+
+	// Convert up to 'count' samples of the voice into 'out', advancing the play cursor and handling loops.
+	// This is used when the source rate matches the output rate.
+	// Returns the number of samples written, which is less than 'count' if the voice finished.
+	u32 mixer_convertSpan(MixVoice* voice, f32* out, u32 count)
 	{
-		f32* buffer = (f32*)outputBuffer;
-	
-		MUTEX_LOCK(&s_mutex);
-		for (u32 i = 0; i < bufferSize; i++, buffer += 2)
-		{
-			f32 valueLeft  = 0.0f;
-			f32 valueRight = 0.0f;
-			
-			SoundSource* snd = s_sources;
-			for (u32 s = 0; s < s_sourceCount && !s_paused; s++, snd++)
-			{
-				if (!(snd->flags&SND_FLAG_PLAYING)) { continue; }
-				assert(snd->buffer->data);
-
-				// Compute the sample value.
-				const f32 sampleValue = sampleBuffer(snd->sampleIndex, snd->buffer->type, snd->buffer->data) * s_soundFxScale;
-				// Stereo Seperation.
-				const f32 sepSq = snd->seperation*snd->seperation;
-				const f32 invSepSq = (1.0f - snd->seperation) * (1.0f - snd->seperation);
-				valueLeft  += std::max(snd->volume - sepSq, 0.0f) * sampleValue;
-				valueRight += std::max(snd->volume - invSepSq, 0.0f) * sampleValue;
-
-				snd->sampleIndex++;
-				if (snd->sampleIndex >= snd->buffer->size)
+		const SoundBuffer* buffer = voice->buffer;
+		assert(buffer->data);
+
+		u32 written = 0;
+		while (written < count)
+		{
+			const u32 index = voice->sampleIndex;
+			const u32 spanCount = std::min(count - written, buffer->size - index);
+			mixer_convertSamples(buffer, index, spanCount, out + written);
+			written += spanCount;
+			voice->sampleIndex += spanCount;
+
+			if (voice->sampleIndex >= buffer->size)
+			{
+				if (mixer_getLoopLength(voice))
 				{
-					if (snd->flags&SND_FLAG_LOOPING)
+					voice->sampleIndex = buffer->loopStart;
+				}
+				else
+				{
+					mixer_finishVoice(voice);
+					break;
+				}
+			}
+		}
+		return written;
+	}
+
+	// Advance the play cursor of a virtual voice by 'count' output samples without producing any audio.
+	void mixer_advanceVoice(MixVoice* voice, u32 count)
+	{
+		const SoundBuffer* buffer = voice->buffer;
+		const u64 end = u64(buffer->size) << 32;
+		const u64 pos = ((u64(voice->sampleIndex) << 32) | voice->sampleFrac) + voice->step * count;
+		if (pos < end)
+		{
+			voice->sampleIndex = u32(pos >> 32);
+			voice->sampleFrac  = u32(pos);
+			return;
+		}
+
+		const u32 loopLength = mixer_getLoopLength(voice);
+		if (!loopLength)
+		{
+			mixer_finishVoice(voice);
+			return;
+		}
+		voice->sampleIndex = buffer->loopStart + u32(((pos >> 32) - buffer->size) % loopLength);
+		voice->sampleFrac  = u32(pos);
+	}
+
+	// Gather 'count' samples starting at 'first' (which may be negative), wrapping around the loop.
+	// Samples before the start or past the end of a non-looping sound are silent.
+	void mixer_gatherSamples(const MixVoice* voice, s64 first, u32 count, f32* dst)
+	{
+		const SoundBuffer* buffer = voice->buffer;
+		const u32 loopLength = mixer_getLoopLength(voice);
+		s64 pos = first;
+		while (count)
+		{
+			u32 spanCount;
+			if (pos < 0)
+			{
+				spanCount = u32(std::min(s64(count), -pos));
+				memset(dst, 0, sizeof(f32) * spanCount);
+			}
+			else if (pos >= s64(buffer->size))
+			{
+				if (loopLength)
+				{
+					pos = buffer->loopStart + (pos - buffer->size) % loopLength;
+					continue;
+				}
+				memset(dst, 0, sizeof(f32) * count);
+				break;
+			}
+			else
+			{
+				spanCount = u32(std::min(s64(count), s64(buffer->size) - pos));
+				mixer_convertSamples(buffer, u32(pos), spanCount, dst);
+			}
+			dst += spanCount;
+			pos += spanCount;
+			count -= spanCount;
+		}
+	}
+
+	inline f32 mixer_dot(const f32* samples, const f32* kernel, u32 taps)
+	{
+	#if defined(AUDIO_MIX_SSE)
+		if (taps >= 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (u32 t = 0; t < taps; t += 4)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(samples + t), _mm_load_ps(kernel + t)));
+			}
+			// Horizontal add.
+			sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+			return _mm_cvtss_f32(sum);
+		}
+	#endif
+		f32 sum = 0.0f;
+		for (u32 t = 0; t < taps; t++)
+		{
+			sum += samples[t] * kernel[t];
+		}
+		return sum;
+	}
+
+	// Resample up to 'count' output samples of the voice into 'out' using the polyphase filter for the given quality.
+	// Returns the number of samples written, which is less than 'count' if the voice finished.
+	u32 mixer_resampleSpan(MixVoice* voice, f32* out, u32 count, f32* input, ResampleQuality quality)
+	{
+		const SoundBuffer* buffer = voice->buffer;
+		assert(buffer->data);
+
+		const u32 taps = c_resampleTaps[quality];
+		const f32* kernels = s_resampleKernel[quality];
+		const u64 step = voice->step;
+		const u32 loopLength = mixer_getLoopLength(voice);
+		u64 pos = (u64(voice->sampleIndex) << 32) | voice->sampleFrac;
+
+		// A non-looping voice stops once the cursor passes the end of the sound.
+		u32 outCount = count;
+		bool finished = false;
+		if (!loopLength)
+		{
+			const u64 end = u64(buffer->size) << 32;
+			const u64 remaining = (pos < end) ? (end - pos + step - 1) / step : 0;
+			if (remaining <= outCount)
+			{
+				outCount = u32(remaining);
+				finished = true;
+			}
+		}
+
+		if (outCount)
+		{
+			// Gather the input samples covered by this span, including the filter history and lookahead.
+			// Float sounds are read in place unless the span crosses the start or end of the sound.
+			const s64 basePos = s64(pos >> 32);
+			const u32 inputCount = u32(((pos + step * (outCount - 1)) >> 32) - (pos >> 32)) + taps;
+			const s64 firstInput = basePos - (s64(taps / 2) - 1);
+			const f32* src = input;
+			if (buffer->type == SOUND_DATA_FLOAT && firstInput >= 0 && firstInput + inputCount <= s64(buffer->size))
+			{
+				src = (const f32*)buffer->data + firstInput;
+			}
+			else
+			{
+				mixer_gatherSamples(voice, firstInput, inputCount, input);
+			}
+
+			for (u32 i = 0; i < outCount; i++, pos += step)
+			{
+				const u32 inputIndex = u32(s64(pos >> 32) - basePos);
+				const u32 phase = u32(pos >> (32 - RESAMPLE_PHASE_BITS)) & (RESAMPLE_PHASE_COUNT - 1);
+				out[i] = mixer_dot(src + inputIndex, kernels + phase * RESAMPLE_MAX_TAPS, taps);
+			}
+		}
+
+		if (finished)
+		{
+			mixer_finishVoice(voice);
+			return outCount;
+		}
+
+		// Wrap the cursor around the loop.
+		u64 index = pos >> 32;
+		if (index >= buffer->size)
+		{
+			index = buffer->loopStart + (index - buffer->size) % loopLength;
+		}
+		voice->sampleIndex = u32(index);
+		voice->sampleFrac  = u32(pos);
+		return outCount;
+	}
+
+	// Compute how far the voice advances through its buffer for each output sample, in 32.32 fixed point.
+	void mixer_setVoiceStep(MixVoice* voice)
+	{
+		const u32 mixRate = s_mixRate.load();
+		const u32 srcRate = voice->buffer && voice->buffer->sampleRate ? voice->buffer->sampleRate : c_defaultSampleRate;
+		voice->step = mixRate ? (u64(srcRate) << 32) / mixRate : (1ull << 32);
+		voice->step = std::min(voice->step, u64(RESAMPLE_MAX_STEP) << 32);
+		voice->sampleFrac = 0u;
+	}
+
+	// Build the polyphase filter tables, each phase holds the filter taps for one fractional position between samples.
+	void buildResampleKernels()
+	{
+		const f64 pi = 3.14159265358979323846;
+		for (s32 q = 0; q < RESAMPLE_COUNT; q++)
+		{
+			const s32 taps = (s32)c_resampleTaps[q];
+			const s32 halfTaps = taps / 2;
+			for (s32 p = 0; p < RESAMPLE_PHASE_COUNT; p++)
+			{
+				const f64 frac = f64(p) / f64(RESAMPLE_PHASE_COUNT);
+				f32* kernel = &s_resampleKernel[q][p * RESAMPLE_MAX_TAPS];
+				memset(kernel, 0, sizeof(f32) * RESAMPLE_MAX_TAPS);
+
+				f64 sum = 0.0;
+				for (s32 t = 0; t < taps; t++)
+				{
+					// Distance from the tap to the resampled position, in input samples.
+					const f64 x = f64(t - (halfTaps - 1)) - frac;
+					f64 weight;
+					if (q == RESAMPLE_LINEAR)
+					{
+						weight = std::max(0.0, 1.0 - fabs(x));
+					}
+					else
+					{
+						// Sinc with a slightly lowered cutoff, to reduce imaging, and a Blackman window.
+						const f64 cutoff = 0.95;
+						const f64 sinc = fabs(x) < 1e-9 ? cutoff : sin(pi * x * cutoff) / (pi * x);
+						const f64 w = 0.5 + 0.5 * x / f64(halfTaps);	// [0, 1] across the filter.
+						const f64 window = (w <= 0.0 || w >= 1.0) ? 0.0 : 0.42 - 0.5 * cos(2.0 * pi * w) + 0.08 * cos(4.0 * pi * w);
+						weight = sinc * window;
+					}
+					kernel[t] = f32(weight);
+					sum += weight;
+				}
+				// Normalize so the filter has unity gain at DC.
+				for (s32 t = 0; t < taps && sum != 0.0; t++)
+				{
+					kernel[t] = f32(kernel[t] / sum);
+				}
+			}
+		}
+	}
+
+	// Accumulate a mono span into the interleaved stereo output, ramping the gains from (gainL, gainR) by (stepL, stepR) per sample.
+	void mixer_accumulate(f32* output, const f32* samples, u32 count, f32 gainL, f32 gainR, f32 stepL, f32 stepR)
+	{
+		u32 i = 0;
+	#if defined(AUDIO_MIX_SSE)
+		__m128 gL = _mm_add_ps(_mm_set1_ps(gainL), _mm_mul_ps(_mm_set1_ps(stepL), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+		__m128 gR = _mm_add_ps(_mm_set1_ps(gainR), _mm_mul_ps(_mm_set1_ps(stepR), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+		const __m128 dL = _mm_set1_ps(stepL * 4.0f);
+		const __m128 dR = _mm_set1_ps(stepR * 4.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 s = _mm_loadu_ps(samples + i);
+			const __m128 left  = _mm_mul_ps(s, gL);
+			const __m128 right = _mm_mul_ps(s, gR);
+			// Interleave into L0 R0 L1 R1 | L2 R2 L3 R3
+			f32* dst = output + i * 2;
+			_mm_storeu_ps(dst,     _mm_add_ps(_mm_loadu_ps(dst),     _mm_unpacklo_ps(left, right)));
+			_mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), _mm_unpackhi_ps(left, right)));
+			gL = _mm_add_ps(gL, dL);
+			gR = _mm_add_ps(gR, dR);
+		}
+	#endif
+		for (; i < count; i++)
+		{
+			output[i * 2 + 0] += samples[i] * (gainL + stepL * f32(i));
+			output[i * 2 + 1] += samples[i] * (gainR + stepR * f32(i));
+		}
+	}
+
+	// Accumulate a float voice at the output rate directly from its buffer, so no conversion or copy is required.
+	void mixer_accumulateFloatSpan(MixVoice* voice, f32* output, u32 count, f32 gainL, f32 gainR, f32 stepL, f32 stepR)
+	{
+		const SoundBuffer* buffer = voice->buffer;
+		const f32* data = (f32*)buffer->data;
+		u32 written = 0;
+		while (written < count)
+		{
+			const u32 index = voice->sampleIndex;
+			const u32 spanCount = std::min(count - written, buffer->size - index);
+			mixer_accumulate(output + written * 2, data + index, spanCount, gainL + stepL * f32(written), gainR + stepR * f32(written), stepL, stepR);
+			written += spanCount;
+			voice->sampleIndex += spanCount;
+
+			if (voice->sampleIndex >= buffer->size)
+			{
+				if (mixer_getLoopLength(voice))
+				{
+					voice->sampleIndex = buffer->loopStart;
+				}
+				else
+				{
+					mixer_finishVoice(voice);
+					break;
+				}
+			}
+		}
+	}
+
+	// Audio outside of the [-1, 1] range will cause overflow, which is a major artifact.
+	// Instead the audio needs to be limited in range, which can be done in several ways.
+	// Sigmoid functions map an arbitrary range into [-1, 1] generall along an S-Curve, allowing us to avoid overflow.
+	void mixer_limit(f32* output, u32 count)
+	{
+		u32 i = 0;
+	#if defined(AUDIO_SIGMOID_CLIP)		// Not really a Sigmoid function but acts in a similar way, naively mapping to the required range.
+	#if defined(AUDIO_MIX_SSE)
+		const __m128 limit = _mm_set1_ps(c_channelLimit);
+		const __m128 negLimit = _mm_set1_ps(-c_channelLimit);
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(output + i, _mm_max_ps(negLimit, _mm_min_ps(_mm_loadu_ps(output + i), limit)));
+		}
+	#endif
+		for (; i < count; i++)
+		{
+			output[i] = std::max(-c_channelLimit, std::min(output[i], c_channelLimit));
+		}
+	#elif defined(AUDIO_SIGMOID_TANH)	// Considered one of the most "musical sounding" sigmoid functions, it avoids hard clipping.
+		// Note the usable range is approximately -4.8 to 4.8 so the volumes should be adjusted to stay within those ranges when possible.
+		// Still much better than the effect -1 to 1 range with hard clipping and cheaper than the more accurate library tanh(). :)
+	#if defined(AUDIO_MIX_SSE)
+		// Same series as TFE_Math::tanhf_series(), the input is clamped to the usable range and the output to [-1, 1].
+		const __m128 range = _mm_set1_ps(4.8f), negRange = _mm_set1_ps(-4.8f);
+		const __m128 one = _mm_set1_ps(1.0f), negOne = _mm_set1_ps(-1.0f);
+		const __m128 a0 = _mm_set1_ps(135135.0f), a1 = _mm_set1_ps(17325.0f), a2 = _mm_set1_ps(378.0f);
+		const __m128 b1 = _mm_set1_ps(62370.0f), b2 = _mm_set1_ps(3150.0f), b3 = _mm_set1_ps(28.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x  = _mm_max_ps(negRange, _mm_min_ps(_mm_loadu_ps(output + i), range));
+			const __m128 x2 = _mm_mul_ps(x, x);
+			const __m128 a = _mm_mul_ps(x, _mm_add_ps(a0, _mm_mul_ps(x2, _mm_add_ps(a1, _mm_mul_ps(x2, _mm_add_ps(a2, x2))))));
+			const __m128 b = _mm_add_ps(a0, _mm_mul_ps(x2, _mm_add_ps(b1, _mm_mul_ps(x2, _mm_add_ps(b2, _mm_mul_ps(x2, b3))))));
+			_mm_storeu_ps(output + i, _mm_max_ps(negOne, _mm_min_ps(_mm_div_ps(a, b), one)));
+		}
+	#endif
+		for (; i < count; i++)
+		{
+			output[i] = TFE_Math::tanhf_series(output[i]);
+		}
+	#elif defined(AUDIO_SIGMOID_RCP_SQRT)
+		for (; i < count; i++)
+		{
+			output[i] = output[i] / sqrtf(1.0f + output[i] * output[i]);
+		}
+	#endif
+	}
+
+	// Mix the voices into the interleaved stereo output, one voice at a time over each block.
+	// This is seperate from the audio callback so it can also be used for offline rendering and benchmarking.
+	// The output is not limited, which is left to the caller so other audio can be added first.
+	// 'scratch' must hold MIX_BLOCK_SIZE samples and 'input' RESAMPLE_INPUT_SIZE samples.
+	void mixer_mixVoices(MixVoice* voices, u32 voiceCount, f32 soundFxScale, ResampleQuality quality, f32* output, u32 frameCount, f32* scratch, f32* input)
+	{
+		memset(output, 0, sizeof(f32) * frameCount * 2);
+
+		for (u32 blockStart = 0; blockStart < frameCount; blockStart += MIX_BLOCK_SIZE)
+		{
+			const u32 blockCount = std::min(frameCount - blockStart, u32(MIX_BLOCK_SIZE));
+			f32* blockOut = output + blockStart * 2;
+
+			MixVoice* voice = voices;
+			for (u32 s = 0; s < voiceCount; s++, voice++)
+			{
+				if (!(voice->flags & SND_FLAG_PLAYING)) { continue; }
+
+				// Virtual voices keep their place in the sound without being mixed. A voice that was just made virtual
+				// is mixed for one more block while fading out, and voices that become real fade in from silence.
+				const bool isVirtual = (voice->flags & SND_FLAG_VIRTUAL) != 0;
+				if (isVirtual && voice->gainL <= 0.0f && voice->gainR <= 0.0f)
+				{
+					voice->gainL = 0.0f;
+					voice->gainR = 0.0f;
+					mixer_advanceVoice(voice, blockCount);
+					continue;
+				}
+
+				// Stereo Seperation, computed once per block.
+				const f32 sepSq    = voice->seperation * voice->seperation;
+				const f32 invSepSq = (1.0f - voice->seperation) * (1.0f - voice->seperation);
+				const f32 targetL = isVirtual ? 0.0f : std::max(voice->volume - sepSq,    0.0f) * soundFxScale;
+				const f32 targetR = isVirtual ? 0.0f : std::max(voice->volume - invSepSq, 0.0f) * soundFxScale;
+				// New voices start at the target gain, otherwise ramp across the block to avoid zipper noise.
+				if (voice->gainL < 0.0f)
+				{
+					voice->gainL = targetL;
+					voice->gainR = targetR;
+				}
+				const f32 stepL = (targetL - voice->gainL) / f32(blockCount);
+				const f32 stepR = (targetR - voice->gainR) / f32(blockCount);
+
+				// Sources at the output rate are simply converted, otherwise they are resampled.
+				if (voice->step == (1ull << 32) && !voice->sampleFrac)
+				{
+					if (voice->buffer->type == SOUND_DATA_FLOAT)
 					{
-						snd->sampleIndex = snd->buffer->loopStart;
+						mixer_accumulateFloatSpan(voice, blockOut, blockCount, voice->gainL, voice->gainR, stepL, stepR);
 					}
 					else
 					{
-						snd->flags &= ~SND_FLAG_PLAYING;
-						snd->flags |= SND_FLAG_FINISHED;
-						snd->sampleIndex = 0u;
+						const u32 count = mixer_convertSpan(voice, scratch, blockCount);
+						mixer_accumulate(blockOut, scratch, count, voice->gainL, voice->gainR, stepL, stepR);
 					}
 				}
+				else
+				{
+					const u32 count = mixer_resampleSpan(voice, scratch, blockCount, input, quality);
+					mixer_accumulate(blockOut, scratch, count, voice->gainL, voice->gainR, stepL, stepR);
+				}
+				voice->gainL = targetL;
+				voice->gainR = targetR;
 			}
+		}
+	}
+
+	// Audio callback
+	s32 audioCallback(void *outputBuffer, void* inputBuffer, u32 bufferSize, f64 streamTime, u32 status, void* userData)
+	{
+		// The null device calls back from the main thread, which keeps its own name.
+		static thread_local bool s_threadNamed = false;
+		if (!s_threadNamed && !TFE_AudioDevice::isNullDevice())
+		{
+			TFE_THREAD_NAME("Audio");
+			s_threadNamed = true;
+		}
+		TFE_ZONE("Audio Mix");
 
-			// Audio outside of the [-1, 1] range will cause overflow, which is a major artifact.
-			// Instead the audio needs to be limited in range, which can be done in several ways.
-			// Sigmoid functions map an arbitrary range into [-1, 1] generall along an S-Curve, allowing us to avoid overflow.
-		#if defined(AUDIO_SIGMOID_CLIP)		// Not really a Sigmoid function but acts in a similar way, naively mapping to the required range.
-			valueLeft  = std::max(-c_channelLimit, std::min(valueLeft,  c_channelLimit));
-			valueRight = std::max(-c_channelLimit, std::min(valueRight, c_channelLimit));
-		#elif defined(AUDIO_SIGMOID_TANH)	// Considered one of the most "musical sounding" sigmoid functions, it avoids hard clipping.
-			// Note the usable range is approximately -4.8 to 4.8 so the volumes should be adjusted to stay within those ranges when possible.
-			// Still much better than the effect -1 to 1 range with hard clipping and cheaper than the more accurate library tanh(). :)
-			valueLeft  = TFE_Math::tanhf_series(valueLeft);
-			valueRight = TFE_Math::tanhf_series(valueRight);
-		#elif defined(AUDIO_SIGMOID_RCP_SQRT)
-			valueLeft  = valueLeft  / sqrtf(1.0f + valueLeft  * valueLeft);
-			valueRight = valueRight / sqrtf(1.0f + valueRight * valueRight);
-		#endif
-
-			//stereo output.
-			buffer[0] = valueLeft;
-			buffer[1] = valueRight;
-		}
-		cleanupSources();
-		MUTEX_UNLOCK(&s_mutex);
+		if (status & AUDIO_STATUS_OUTPUT_UNDERFLOW)
+		{
+			s_underrunCount++;
+		}
+
+		mixer_processCommands();
+		mixer_updateParams();
+
+		f32* buffer = (f32*)outputBuffer;
+		if (s_paused.load())
+		{
+			memset(buffer, 0, sizeof(f32) * bufferSize * 2);
+		}
+		else
+		{
+			mixer_mixVoices(s_voices, s_voiceCount, s_soundFxScale.load(), getResampleQuality(), buffer, bufferSize, s_voiceScratch, s_inputScratch);
+		}
+		// Music and other generated audio is added even while the sound effects are paused.
+		AudioThreadCallback callback = s_audioThreadCallback.load();
+		if (callback)
+		{
+			callback(buffer, bufferSize);
+		}
+		mixer_limit(buffer, bufferSize * 2);
+		mixer_sendEvents();
 
 		return 0;
 	}
+
+	void audioWavConsole(const ConsoleArgList& args)
+	{
+		char res[TFE_MAX_PATH + 64];
+		if (args.size() < 2)
+		{
+			endWavCapture();
+			TFE_Console::addToHistory("Audio WAV output stopped.");
+			return;
+		}
+
+		if (startWavCapture(args[1].c_str()))
+		{
+			sprintf(res, "Writing audio to \"%s\" at %u Hz.", args[1].c_str(), s_mixRate.load());
+		}
+		else
+		{
+			sprintf(res, "Cannot write audio to \"%s\".", args[1].c_str());
+		}
+		TFE_Console::addToHistory(res);
+	}
+
+	// Offline mixer benchmark: mixes 128 looping voices for 10 seconds of output at each resampling quality,
+	// without touching the live voices. Sources are at the original 11025 Hz and the output is at the mixer rate.
+	void audioBenchmarkConsole(const ConsoleArgList& args)
+	{
+		const u32 srcRate = c_defaultSampleRate;
+		const u32 mixRate = s_mixRate.load();
+		const u32 bufferFrames = 256u;
+		const u32 bufferCount = mixRate * 10u / bufferFrames;
+		const char* c_qualityNames[] = { "Linear", "Sinc 8", "Sinc 16" };
+
+		// A synthetic 8-bit looping sound, one second long.
+		std::vector<u8> data(srcRate);
+		for (u32 i = 0; i < srcRate; i++)
+		{
+			data[i] = u8(128 + 100 * sinf(f32(i) * 0.05f));
+		}
+		SoundBuffer testBuffer = {};
+		testBuffer.type = SOUND_DATA_8BIT;
+		testBuffer.size = srcRate;
+		testBuffer.sampleRate = srcRate;
+		testBuffer.loopStart = 0;
+		testBuffer.loopEnd = srcRate;
+		testBuffer.data = data.data();
+
+		std::vector<MixVoice> voices(MAX_SOUND_SOURCES);
+		std::vector<f32> output(bufferFrames * 2);
+		std::vector<f32> scratch(MIX_BLOCK_SIZE);
+		std::vector<f32> input(RESAMPLE_INPUT_SIZE);
+
+		for (s32 q = 0; q < RESAMPLE_COUNT; q++)
+		{
+			for (u32 s = 0; s < MAX_SOUND_SOURCES; s++)
+			{
+				voices[s] = {};
+				voices[s].buffer = &testBuffer;
+				mixer_setVoiceStep(&voices[s]);
+				voices[s].sampleIndex = (s * 97) % srcRate;
+				voices[s].flags = SND_FLAG_PLAYING | SND_FLAG_LOOPING;
+				voices[s].gen = 1;
+				voices[s].volume = 0.5f + 0.5f * f32(s & 1);
+				voices[s].seperation = f32(s) / f32(MAX_SOUND_SOURCES);
+				voices[s].gainL = -1.0f;
+				voices[s].gainR = -1.0f;
+			}
+
+			const u64 start = TFE_System::getCurrentTimeInTicks();
+			for (u32 b = 0; b < bufferCount; b++)
+			{
+				// Change the parameters each buffer to exercise the gain ramps.
+				voices[b % MAX_SOUND_SOURCES].volume = f32(b & 7) / 7.0f;
+				mixer_mixVoices(voices.data(), MAX_SOUND_SOURCES, s_soundFxScale.load(), ResampleQuality(q), output.data(), bufferFrames, scratch.data(), input.data());
+				mixer_limit(output.data(), bufferFrames * 2);
+			}
+			const f64 usPerBuffer = TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - start) * 1000000.0 / f64(bufferCount);
+
+			char res[256];
+			sprintf(res, "Audio Mixer [%s]: %u voices, %u -> %u Hz, %u frames: %0.2f us per buffer, %0.3f us per voice.",
+				c_qualityNames[q], MAX_SOUND_SOURCES, srcRate, mixRate, bufferFrames, usPerBuffer, usPerBuffer / f64(MAX_SOUND_SOURCES));
+			TFE_Console::addToHistory(res);
+			TFE_System::logWrite(LOG_MSG, "Audio", "%s", res);
+		}
+	}
+
+	// Shared with the finished callbacks, which may still be called after the stress test returns.
+	struct AudioStressStats
+	{
+		u32 started;
+		u32 finished;
+	};
+	static AudioStressStats s_stressStats;
+	static u8 s_stressData[64];
+	static SoundBuffer s_stressBuffer;
+
+	void audioStressFinished(void* userData, s32 arg)
+	{
+		s_stressStats.finished++;
+	}
+
+	// Stress test of the queues between the game thread and the live mixer. For the given number of seconds, the game thread
+	// keeps half of the sources busy with silent one-shots that finish within a mix block (flooding the finished-sound queue)
+	// and starts and frees other sources until the command queue overflows, once per millisecond. Every one-shot must finish,
+	// either through a mixer event or right away if its play command was dropped. The test fails if a command or event is
+	// lost, repeated or arrives out of order (see 's_queueSeqErrors'), or if the mixer does not consume every command pushed.
+	void audioStressConsole(const ConsoleArgList& args)
+	{
+		if (TFE_AudioDevice::isNullDevice())
+		{
+			TFE_Console::addToHistory("The audio stress test needs a live output device.");
+			return;
+		}
+		const f64 seconds = args.size() >= 2 ? f64(TFE_Console::getFloatArg(args[1])) : 5.0;
+
+		memset(s_stressData, 128, sizeof(s_stressData));
+		s_stressBuffer = {};
+		s_stressBuffer.type = SOUND_DATA_8BIT;
+		s_stressBuffer.size = sizeof(s_stressData);
+		s_stressBuffer.sampleRate = c_defaultSampleRate;
+		s_stressBuffer.loopStart = 0;
+		s_stressBuffer.loopEnd = sizeof(s_stressData);
+		s_stressBuffer.data = s_stressData;
+		s_stressStats = {};
+
+		const s32 droppedStart = s_audioDroppedCommands;
+		const u32 underrunStart = s_underrunCount.load();
+		const u32 seqErrorStart = s_queueSeqErrors.load();
+		u32 commandCount = 0;
+		u32 maxPending = 0;
+
+		const u64 start = TFE_System::getCurrentTimeInTicks();
+		while (TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - start) < seconds)
+		{
+			// Stop adding commands once the queue overflows, then let the mixer catch up.
+			const s32 droppedCount = s_audioDroppedCommands;
+			while (s_stressStats.started - s_stressStats.finished < MAX_SOUND_SOURCES / 2 && s_audioDroppedCommands == droppedCount &&
+				playOneShot(SOUND_2D, 0.0f, 0.5f, &s_stressBuffer, false, nullptr, false, audioStressFinished, nullptr, 0, SOUND_PRIORITY_LOW))
+			{
+				s_stressStats.started++;
+				commandCount++;
+			}
+			maxPending = std::max(maxPending, s_stressStats.started - s_stressStats.finished);
+
+			for (u32 i = 0; i < AUDIO_COMMAND_CAPACITY && s_audioDroppedCommands == droppedCount; i++)
+			{
+				SoundSource* source = createSoundSource(SOUND_2D, 0.0f, 0.5f, &s_stressBuffer, nullptr, false);
+				if (!source) { break; }
+				playSource(source, false);
+				freeSource(source);
+				commandCount += 2;
+			}
+			TFE_System::sleep(1);
+		}
+
+		// Give the mixer time to consume the remaining commands and finish the remaining one-shots.
+		const u64 drainStart = TFE_System::getCurrentTimeInTicks();
+		while ((s_stressStats.finished < s_stressStats.started || s_commandPopSeq.load(std::memory_order_acquire) != s_commandPushSeq) &&
+			TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - drainStart) < 1.0)
+		{
+			processMixerEvents();
+			TFE_System::sleep(1);
+		}
+		const u32 unconsumed = s_commandPushSeq - s_commandPopSeq.load(std::memory_order_acquire);
+		const u32 seqErrors = s_queueSeqErrors.load() - seqErrorStart;
+		const u32 unfinished = s_stressStats.started - s_stressStats.finished;
+		const bool passed = !unconsumed && !seqErrors && !unfinished;
+
+		char res[320];
+		sprintf(res, "Audio Stress %s: %0.1f seconds, %u commands, %d dropped, %u unconsumed, %u out of sequence, %u one-shots, %u finished, %u pending at most, %u unfinished, %u underruns.",
+			passed ? "passed" : "FAILED", seconds, commandCount, s_audioDroppedCommands - droppedStart, unconsumed, seqErrors, s_stressStats.started,
+			s_stressStats.finished, maxPending, unfinished, s_underrunCount.load() - underrunStart);
+		TFE_Console::addToHistory(res);
+		TFE_System::logWrite(passed ? LOG_MSG : LOG_ERROR, "Audio", "%s", res);
+	}
+
+	void setResampleQualityConsole(const ConsoleArgList& args)
+	{
+		if (args.size() < 2) { return; }
+
+		setResampleQuality(ResampleQuality(s32(TFE_Console::getFloatArg(args[1]))));
+
+		TFE_Settings_Sound* soundSettings = TFE_Settings::getSoundSettings();
+		soundSettings->resampleQuality = getResampleQuality();
+		TFE_Settings::writeToDisk();
+	}
 		
 	// Console functions.
 	void setSoundVolumeConsole(const ConsoleArgList& args)
 	{
 		if (args.size() < 2) { return; }
 
-		s_soundFxVolume = TFE_Console::getFloatArg(args[1]);
-		s_soundFxScale = s_soundFxVolume * c_soundHeadroom;
+		setVolume(TFE_Console::getFloatArg(args[1]));
 
 		TFE_Settings_Sound* soundSettings = TFE_Settings::getSoundSettings();
 		soundSettings->soundFxVolume = s_soundFxVolume;
@@ -40,10 +40,31 @@ enum SoundType
 	SOUND_3D,		// 3D positional sound effect.
 };
 
+// Resampling quality, used when the source sample rate does not match the output rate.
+enum ResampleQuality
+{
+	RESAMPLE_LINEAR = 0,	// Linear interpolation, 2 taps.
+	RESAMPLE_SINC8,			// Windowed-sinc, 8 taps.
+	RESAMPLE_SINC16,		// Windowed-sinc, 16 taps.
+	RESAMPLE_COUNT
+};
+
+// Sources with a higher priority are kept real (mixed) first when there are more audible sources than real voices.
+enum SoundPriority
+{
+	SOUND_PRIORITY_LOW    = 0,
+	SOUND_PRIORITY_NORMAL = 64,
+	SOUND_PRIORITY_HIGH   = 128,
+};
+
 #define MONO_SEPERATION 0.5f
-#define MAX_SOUND_SOURCES 128
+// Sources that can be playing at once, sources that are not real voices are virtual - their play cursor advances but they are not mixed.
+#define MAX_SOUND_SOURCES 256
+#define MAX_REAL_VOICES 64
 
 typedef void (*SoundFinishedCallback)(void* userData, s32 arg);
+// Called on the audio thread to add generated audio, such as synthesized music, to the interleaved stereo mix.
+typedef void (*AudioThreadCallback)(f32* buffer, u32 frameCount);
 
 namespace TFE_Audio
 {
@@ -54,22 +75,37 @@ namespace TFE_Audio
 	static const f32 c_clipDistance = 140.0f;
 
 	// functions
-	bool init();
+	// The null device pulls audio at the game time rate instead of playing it, see updateOutput().
+	bool init(bool nullDevice = false);
 	void shutdown();
+	// Called once per frame with the frame time, only does anything when using the null device.
+	void updateOutput(f64 dt);
+	// Write the mixed output to a WAV file. This switches to the null device so the output
+	// follows game time - with a fixed time step the same session produces identical audio.
+	bool startWavCapture(const char* path);
+	void endWavCapture();
 	void stopAllSounds();
 
 	void setVolume(f32 volume);
 	f32  getVolume();
+	void setResampleQuality(ResampleQuality quality);
+	ResampleQuality getResampleQuality();
 	void pause();
 	void resume();
 
+	// The sample rate that sounds are mixed and output at.
+	u32  getMixSampleRate();
+	// Set a callback that runs on the audio thread after the sounds are mixed, pass nullptr to clear it.
+	// The callback may still be running after it is cleared until the audio system is shutdown.
+	void setAudioThreadCallback(AudioThreadCallback callback = nullptr);
+
 	// Update position audio and other audio effects.
 	void update(const Vec3f* listenerPos, const Vec3f* listenerDir);
 
 	// One shot, play and forget. Only do this if the client needs no control until stopAllSounds() is called.
 	// Note that looping one shots are valid though may generate too many sound sources if not used carefully.
 	bool playOneShot(SoundType type, f32 volume, f32 stereoSeperation, const SoundBuffer* buffer, bool looping, const Vec3f* pos = nullptr, bool copyPosition = false,
-					 SoundFinishedCallback finishedCallback = nullptr, void* cbUserData = nullptr, s32 cbArg = 0);
+					 SoundFinishedCallback finishedCallback = nullptr, void* cbUserData = nullptr, s32 cbArg = 0, s32 priority = SOUND_PRIORITY_NORMAL);
 
 	// Sound source that the client holds onto.
 	SoundSource* createSoundSource(SoundType type, f32 volume, f32 stereoSeperation, const SoundBuffer* buffer, const Vec3f* pos = nullptr, bool copyPosition = false);
@@ -78,6 +114,7 @@ namespace TFE_Audio
 	void freeSource(SoundSource* source);
 	void setSourceVolume(SoundSource* source, f32 volume);
 	void setSourceStereoSeperation(SoundSource* source, f32 stereoSeperation);
+	void setSourcePriority(SoundSource* source, s32 priority);
 	// This will restart the sound and change the buffer.
 	void setSourceBuffer(SoundSource* source, const SoundBuffer* buffer);
 	void setSourcePosition(SoundSource* source, const Vec3f* pos);
@@ -1,17 +1,30 @@
+#include <cstring>
+
 #include "midiPlayer.h"
 #include "midiDevice.h"
+#include "midiSynth.h"
+#include "audioSystem.h"
+#include "wavWriter.h"
 #include <TFE_Asset/gmidAsset.h>
 #include <TFE_System/system.h>
+#include <TFE_System/profiler.h>
 #include <TFE_System/Threads/thread.h>
+#include <TFE_System/Threads/signal.h>
 #include <TFE_Settings/settings.h>
+#include <TFE_FileSystem/paths.h>
+#include <TFE_FileSystem/fileutil.h>
 #include <TFE_FrontEndUI/console.h>
 #include <algorithm>
+#include <vector>
+#include <math.h>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN 1
 #include <Windows.h>
+#include <mmsystem.h>
 #undef min
 #undef max
+#pragma comment( lib, "winmm.lib" )
 #endif
 
 namespace TFE_MidiPlayer
@@ -28,6 +41,9 @@ namespace TFE_MidiPlayer
 		const GMidiAsset* asset;
 		MidiRuntimeTrack tracks[8];
 		bool loop;
+		// Events are sent to the synthesizer if set, otherwise to the Midi device.
+		MidiSynth* synth;
+		u8 channelSrcVolume[16];
 	};
 
 	enum Transition
@@ -40,7 +56,15 @@ namespace TFE_MidiPlayer
 	};
 
 	static const f32 c_musicVolumeScale = 0.5f;
-	static MidiRuntime s_runtime;
+	static const u32 c_offlineBlockSize = 256u;
+	// OS waits are only accurate to about a millisecond, the remainder is spent yielding.
+	static const f64 c_waitPrecision = 0.001;
+
+	// The runtime is owned by the thread driving the music: the midi thread for an external device
+	// or the audio thread for the synthesizer. The game thread only makes requests through the atomics below.
+	static MidiRuntime s_runtime = {};
+	static std::atomic<const GMidiAsset*> s_pendingSong(nullptr);
+	static atomic_bool s_pendingLoop;
 	static atomic_bool s_isPlaying;
 	static atomic_bool s_changeVolume;
 	static atomic_bool s_pauseMusic;
@@ -48,53 +72,97 @@ namespace TFE_MidiPlayer
 	static f32 s_masterVolume = 1.0f;
 	static f32 s_masterVolumeScaled = s_masterVolume * c_musicVolumeScale;
 	static Thread* s_thread = nullptr;
+	static Signal* s_requestSignal = nullptr;	// wakes the midi thread when the game thread makes a request.
+	static MidiSynth* s_synth = nullptr;
+	static u32 s_synthSampleRate = 0;
 
 	static atomic_bool s_runMusicThread;
-	static atomic_bool s_resetThreadLocalTime;
+	static bool s_wasPlaying = false;
+	static bool s_wasPaused = false;
+
+	// Event timing error relative to the ideal schedule, written by the thread driving the music.
+	static atomic_u32 s_timingEventCount(0);
+	static std::atomic<u64> s_timingErrorSum(0);	// nanoseconds.
+	static atomic_u32 s_timingErrorMax(0);			// nanoseconds.
 
-	static u8 s_channelSrcVolume[16] = { 0 };
-		
 	TFE_THREADRET midiUpdateFunc(void* userData);
-	void stopAllNotes();
-	void changeVolume();
+	void synthAudioCallback(f32* buffer, u32 frameCount);
+	void stopAllNotes(MidiRuntime* runtime);
+	void changeVolume(MidiRuntime* runtime);
+	bool loadSoundFont();
 
 	// Console Functions
 	void setMusicVolumeConsole(const ConsoleArgList& args);
 	void getMusicVolumeConsole(const ConsoleArgList& args);
+	void renderMusicConsole(const ConsoleArgList& args);
+	void musicTimingConsole(const ConsoleArgList& args);
 
 	bool init()
 	{
 		TFE_System::logWrite(LOG_MSG, "Startup", "TFE_MidiPlayer::init");
 
-		bool res = TFE_MidiDevice::init();
-		TFE_MidiDevice::selectDevice(0);
 		s_runMusicThread.store(true);
 		s_isPlaying.store(false);
 		s_pauseMusic.store(false);
 		s_transition.store(TRANSITION_NONE);
-		s_resetThreadLocalTime.store(true);
-
-		s_thread = Thread::create("MidiThread", midiUpdateFunc, nullptr);
-		if (s_thread)
-		{
-			s_thread->run();
-		}
+		s_pendingSong.store(nullptr);
 
 		CCMD("setMusicVolume", setMusicVolumeConsole, 1, "Sets the music volume, range is 0.0 to 1.0");
 		CCMD("getMusicVolume", getMusicVolumeConsole, 0, "Get the current music volume where 0 = silent, 1 = maximum.");
+		CCMD("renderMusic", renderMusicConsole, 1, "Render a song offline with the synthesizer: renderMusic song.gmd [seconds] [output.wav]");
+		CCMD("musicTiming", musicTimingConsole, 0, "Display and reset the music event timing error relative to the ideal schedule.");
 
 		TFE_Settings_Sound* soundSettings = TFE_Settings::getSoundSettings();
 		setVolume(soundSettings->musicVolume);
 
+		// The synthesizer is driven from the audio thread, so no music thread is required.
+		if (soundSettings->midiSynth && loadSoundFont())
+		{
+			s_synthSampleRate = TFE_Audio::getMixSampleRate();
+			s_synth = TFE_MidiSynth::createSynth(s_synthSampleRate, soundSettings->midiSynthVoices);
+		}
+		s_runtime.synth = s_synth;
+		if (s_synth)
+		{
+			TFE_Audio::setAudioThreadCallback(synthAudioCallback);
+			return true;
+		}
+
+		bool res = TFE_MidiDevice::init();
+		TFE_MidiDevice::selectDevice(0);
+
+	#ifdef _WIN32
+		// Request 1ms timer resolution so the midi thread wakes up close to each event.
+		timeBeginPeriod(1);
+	#endif
+		s_requestSignal = Signal::create();
+		s_thread = Thread::create("MidiThread", midiUpdateFunc, nullptr);
+		if (s_thread)
+		{
+			s_thread->run();
+		}
 		return res && s_thread;
 	}
 
 	void destroy()
 	{
 		TFE_System::logWrite(LOG_MSG, "MidiPlayer", "Shutdown");
-		// Destroy the thread before shutting down the Midi Device.
 		stop();
+
+		if (s_synth)
+		{
+			// The audio system is shutdown first, so the callback is no longer running.
+			TFE_Audio::setAudioThreadCallback(nullptr);
+			TFE_MidiSynth::destroySynth(s_synth);
+			s_synth = nullptr;
+			s_runtime.synth = nullptr;
+		}
+		TFE_MidiSynth::freeSoundFont();
+
+		if (!s_thread) { return; }
+		// Destroy the thread before shutting down the Midi Device.
 		s_runMusicThread.store(false);
+		s_requestSignal->fire();
 		if (s_thread->isPaused())
 		{
 			s_thread->resume();
@@ -102,35 +170,56 @@ namespace TFE_MidiPlayer
 		s_thread->waitOnExit();
 
 		delete s_thread;
+		delete s_requestSignal;
+		s_thread = nullptr;
+		s_requestSignal = nullptr;
 		TFE_MidiDevice::destroy();
+	#ifdef _WIN32
+		timeEndPeriod(1);
+	#endif
 	}
 
-	void playSong(const GMidiAsset* gmidAsset, bool loop)
+	bool loadSoundFont()
 	{
-		s_runtime.asset = gmidAsset;
-		s_runtime.loop = loop;
-		for (u32 i = 0; i < gmidAsset->trackCount; i++)
+		if (TFE_MidiSynth::isSoundFontLoaded()) { return true; }
+
+		// The SoundFont path is either absolute or relative to the program folder.
+		const char* soundFont = TFE_Settings::getSoundSettings()->soundFont;
+		char path[TFE_MAX_PATH];
+		if (FileUtil::exists(soundFont))
 		{
-			s_runtime.tracks[i].curTick   = 0;
-			s_runtime.tracks[i].lastEvent = -1;
-			s_runtime.tracks[i].msPerTick = gmidAsset->tracks[i].msPerTick;
+			strcpy(path, soundFont);
 		}
+		else
+		{
+			TFE_Paths::appendPath(PATH_PROGRAM, soundFont, path);
+		}
+		return TFE_MidiSynth::loadSoundFont(path);
+	}
 
-		for (u32 i = 0; i < 16; i++)
+	// The synthesizer picks up requests on the next audio callback, the midi thread has to be woken up.
+	void wakeMusicThread()
+	{
+		if (s_requestSignal)
 		{
-			s_channelSrcVolume[i] = CHANNEL_MAX_VOLUME;
+			s_requestSignal->fire();
 		}
-		changeVolume();
+	}
 
+	void playSong(const GMidiAsset* gmidAsset, bool loop)
+	{
+		// The song is started by the thread driving the music.
+		s_pendingLoop.store(loop);
+		s_pendingSong.store(gmidAsset);
 		s_isPlaying.store(true);
-		s_resetThreadLocalTime.store(true);
+		wakeMusicThread();
 
-		if (s_thread->isPaused())
+		if (s_thread && s_thread->isPaused())
 		{
 			s_thread->resume();
 		}
 	}
-	
+
 	void setVolume(f32 volume)
 	{
 		s_masterVolume = volume;
@@ -144,203 +233,400 @@ namespace TFE_MidiPlayer
 
 	void pause()
 	{
+		// The notes are stopped by the thread driving the music.
 		s_pauseMusic.store(true);
-		stopAllNotes();
+		wakeMusicThread();
 	}
 
 	void resume()
 	{
 		s_pauseMusic.store(false);
+		wakeMusicThread();
 	}
-	
+
 	void stop()
 	{
 		s_isPlaying.store(false);
 		resume();
 	}
 
-	void changeVolume()
+	void sendMessage(MidiRuntime* runtime, u8 arg0, u8 arg1, u8 arg2 = 0)
+	{
+		if (runtime->synth)
+		{
+			TFE_MidiSynth::sendMessage(runtime->synth, arg0, arg1, arg2);
+		}
+		else
+		{
+			TFE_MidiDevice::sendMessage(arg0, arg1, arg2);
+		}
+	}
+
+	void changeVolume(MidiRuntime* runtime)
 	{
 		for (u32 i = 0; i < 16; i++)
 		{
-			TFE_MidiDevice::sendMessage(MID_CONTROL_CHANGE + i, MID_VOLUME_MSB, u8(s_channelSrcVolume[i] * s_masterVolumeScaled));
+			sendMessage(runtime, MID_CONTROL_CHANGE + i, MID_VOLUME_MSB, u8(runtime->channelSrcVolume[i] * s_masterVolumeScaled));
 		}
 	}
 
-	void stopAllNotes()
+	void stopAllNotes(MidiRuntime* runtime)
 	{
 		for (u32 i = 0; i < 16; i++)
 		{
-			TFE_MidiDevice::sendMessage(MID_CONTROL_CHANGE + i, MID_ALL_NOTES_OFF);
+			sendMessage(runtime, MID_CONTROL_CHANGE + i, MID_ALL_NOTES_OFF);
 		}
 	}
-		
-	// Thread Function
-	TFE_THREADRET midiUpdateFunc(void* userData)
+
+	//////////////////////////////////////////////////////////////////////
+	// Sequencer
+	//////////////////////////////////////////////////////////////////////
+	// Advance the song by 'dt' seconds and send all of the events up to the new time.
+	void sequencer_advance(MidiRuntime* runtime, f64 dt)
 	{
-		bool runThread = true;
-		bool wasPlaying = false;
-		s32 loopStart = -1;
-		u64 localTime = 0;
-		while (runThread)
+		if (!runtime->asset || !runtime->asset->trackCount) { return; }
+
+		const u32 i = 0;
+		const Track* track = &runtime->asset->tracks[i];
+		MidiRuntimeTrack* runtimeTrack = &runtime->tracks[i];
+		if ((u32)runtimeTrack->curTick >= track->length)
+		{
+			return;
+		}
+
+		const f64 prevTick = runtimeTrack->curTick;
+		f64 nextTick = prevTick + dt * 1000.0 / runtimeTrack->msPerTick;
+
+		u32 start = (u32)prevTick;
+		u32 end   = (u32)nextTick;
+
+		const u32 evtCount = (u32)track->eventList.size();
+		const MidiTrackEvent* evt = track->eventList.data();
+		bool breakFromLoop = false;
+		for (u32 e = u32(runtimeTrack->lastEvent + 1); e < evtCount && !breakFromLoop; e++)
 		{
-			if (!s_isPlaying.load())
+			if (evt[e].tick >= start && evt[e].tick <= end)
 			{
-				if (wasPlaying)
+				runtimeTrack->lastEvent = e;
+				switch (evt[e].type)
 				{
-					// Stop all of the notes.
-					stopAllNotes();
-					wasPlaying = false;
-					localTime = 0u;
-					loopStart = -1;
+					case MTK_TEMPO:
+						runtimeTrack->msPerTick = track->tempoEvents[evt[e].index].msPerTick;
+						break;
+					case MTK_MARKER:
+					{
+						const MidiMarker* marker = &track->markers[evt[e].index];
+						TFE_System::logWrite(LOG_MSG, "iMuse", "Marker Track %d, \"%s\"", i, marker->name);
+					} break;
+					case MTK_MIDI:
+					{
+						const MidiEvent* midiEvt = &track->midiEvents[evt[e].index];
+						const u8 type = midiEvt->channel >= 0 ? midiEvt->type + midiEvt->channel : midiEvt->type;
+						// TODO: Track notes on and off so that hanging notes can be handled manually.
+						//       Apparently not all midi devices support MID_ALL_NOTES_OFF.
+						if ((midiEvt->type&0xf0) == MID_CONTROL_CHANGE && midiEvt->data[0] == MID_VOLUME_MSB)
+						{
+							const s32 channelIndex = midiEvt->type & 0x0f;
+							runtime->channelSrcVolume[channelIndex] = midiEvt->data[1];
+							sendMessage(runtime, type, midiEvt->data[0], u8(runtime->channelSrcVolume[channelIndex] * s_masterVolumeScaled));
+						}
+						else
+						{
+							sendMessage(runtime, type, midiEvt->data[0], midiEvt->data[1]);
+						}
+					} break;
+					case MTK_IMUSE:
+					{
+						const iMuseEvent* imuse = &track->imuseEvents[evt[e].index];
+						switch (imuse->cmd)
+						{
+							case IMUSE_START_NEW:
+							{
+							} break;
+							case IMUSE_STALK_TRANS:
+							{
+							} break;
+							case IMUSE_FIGHT_TRANS:
+							{
+							} break;
+							case IMUSE_ENGAGE_TRANS:
+							{
+							} break;
+							case IMUSE_FROM_FIGHT:
+							{
+							} break;
+							case IMUSE_FROM_STALK:
+							{
+							} break;
+							case IMUSE_FROM_BOSS:
+							{
+							} break;
+							case IMUSE_CLEAR_CALLBACK:
+							{
+								//clearCallback();
+							} break;
+							case IMUSE_TO:
+							{
+								//setCallback();
+							} break;
+							case IMUSE_LOOP_START:
+							{
+							} break;
+							case IMUSE_LOOP_END:
+							{
+								nextTick = imuse->arg[0].nArg;
+								runtimeTrack->lastEvent = -1;
+								breakFromLoop = true;
+								stopAllNotes(runtime);
+							} break;
+						};
+					} break;
 				}
-
-				runThread = s_runMusicThread.load();
-				if (runThread) { TFE_System::sleep(16); }
-				continue;
 			}
-			wasPlaying = true;
-
-			if (s_changeVolume.exchange(false))
+			else if (evt[e].tick > end)
 			{
-				changeVolume();
+				break;
 			}
+		}
+
+		runtimeTrack->curTick = nextTick;
+	}
+
+	// Returns the time in seconds until the next event or a negative value if there are no more events.
+	f64 sequencer_getTimeToNextEvent(const MidiRuntime* runtime)
+	{
+		if (!runtime->asset || !runtime->asset->trackCount) { return -1.0; }
+
+		const Track* track = &runtime->asset->tracks[0];
+		const MidiRuntimeTrack* runtimeTrack = &runtime->tracks[0];
+		const u32 curTick = (u32)runtimeTrack->curTick;
+		const u32 evtCount = (u32)track->eventList.size();
+		if (curTick >= track->length) { return -1.0; }
+
+		// Events before the current tick are skipped by sequencer_advance(), which happens after looping.
+		u32 nextEvent = u32(runtimeTrack->lastEvent + 1);
+		while (nextEvent < evtCount && track->eventList[nextEvent].tick < curTick)
+		{
+			nextEvent++;
+		}
+		if (nextEvent >= evtCount) { return -1.0; }
+
+		const f64 ticks = f64(track->eventList[nextEvent].tick) - runtimeTrack->curTick;
+		return std::max(ticks, 0.0) * runtimeTrack->msPerTick * 0.001;
+	}
+
+	void recordTimingError(f64 error)
+	{
+		const u32 errorNs = u32(std::min(fabs(error) * 1.0e9, 4.0e9));
+		s_timingEventCount++;
+		s_timingErrorSum += errorNs;
+		if (errorNs > s_timingErrorMax.load())
+		{
+			s_timingErrorMax.store(errorNs);
+		}
+	}
+
+	void sequencer_begin(MidiRuntime* runtime, const GMidiAsset* song, bool loop)
+	{
+		runtime->asset = song;
+		runtime->loop = loop;
+		for (u32 i = 0; i < song->trackCount; i++)
+		{
+			runtime->tracks[i].curTick   = 0;
+			runtime->tracks[i].lastEvent = -1;
+			runtime->tracks[i].msPerTick = song->tracks[i].msPerTick;
+		}
+
+		for (u32 i = 0; i < 16; i++)
+		{
+			runtime->channelSrcVolume[i] = CHANNEL_MAX_VOLUME;
+		}
+		changeVolume(runtime);
+		// Send the events at the start of the song right away.
+		sequencer_advance(runtime, 0.0);
+	}
 
-			if (s_pauseMusic.load())
+	// Handle the requests from the game thread, returns true if the song should advance.
+	bool sequencer_handleRequests(MidiRuntime* runtime)
+	{
+		const GMidiAsset* song = s_pendingSong.exchange(nullptr);
+		if (song)
+		{
+			stopAllNotes(runtime);
+			sequencer_begin(runtime, song, s_pendingLoop.load());
+		}
+
+		if (!s_isPlaying.load())
+		{
+			if (s_wasPlaying)
 			{
-				TFE_System::updateThreadLocal(&localTime);
-				continue;
+				stopAllNotes(runtime);
+				s_wasPlaying = false;
 			}
+			return false;
+		}
+		s_wasPlaying = true;
+
+		if (s_changeVolume.exchange(false))
+		{
+			changeVolume(runtime);
+		}
+
+		const bool paused = s_pauseMusic.load();
+		if (paused && !s_wasPaused)
+		{
+			stopAllNotes(runtime);
+		}
+		s_wasPaused = paused;
+		return !paused && runtime->asset;
+	}
 
-			// Returns the current value while atomically updating the variable.
-			bool resetLocalTime = s_resetThreadLocalTime.exchange(false);
-			if (resetLocalTime)
+	// Render 'frameCount' frames of the synthesizer while advancing the song, the synthesizer is
+	// rendered up to each event before it is sent so the events are sample accurate.
+	void sequencer_render(MidiRuntime* runtime, bool advance, u32 sampleRate, f32* buffer, u32 frameCount)
+	{
+		const f64 secondsPerFrame = 1.0 / f64(sampleRate);
+		u32 frame = 0;
+		while (frame < frameCount)
+		{
+			u32 count = frameCount - frame;
+			f64 timeToEvent = -1.0;
+			if (advance)
 			{
-				stopAllNotes();
-				localTime = 0u;
-				loopStart = -1;
+				timeToEvent = sequencer_getTimeToNextEvent(runtime);
+				if (timeToEvent >= 0.0)
+				{
+					count = std::max(1u, std::min(u32(ceil(timeToEvent * f64(sampleRate))), count));
+				}
 			}
-			const f64 dt = TFE_System::updateThreadLocal(&localTime);
-			const u32 transition = s_transition.load();
 
-			const u32 trackCount = s_runtime.asset->trackCount;
-			bool allTracksFinished = true;
-			if (trackCount)
+			TFE_MidiSynth::render(runtime->synth, buffer + frame * 2, count);
+			if (advance)
 			{
-				const u32 i = 0;
-				const Track* track = &s_runtime.asset->tracks[i];
-				MidiRuntimeTrack* runtimeTrack = &s_runtime.tracks[i];
-				if ((u32)runtimeTrack->curTick >= track->length)
+				const f64 elapsed = f64(count) * secondsPerFrame;
+				// The event is sent at the start of the next frame, compare against the ideal time.
+				if (timeToEvent >= 0.0 && timeToEvent <= elapsed)
 				{
-					continue;
+					recordTimingError(elapsed - timeToEvent);
 				}
+				sequencer_advance(runtime, elapsed);
+			}
+			frame += count;
+		}
+	}
+
+	// Audio thread callback used with the synthesizer.
+	void synthAudioCallback(f32* buffer, u32 frameCount)
+	{
+		const bool advance = sequencer_handleRequests(&s_runtime);
+		sequencer_render(&s_runtime, advance, s_synthSampleRate, buffer, frameCount);
+	}
+
+	f64 getTimeInSeconds()
+	{
+		return TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks());
+	}
+
+	// Wait until 'deadline' (in seconds), returns false if woken early by a request from the game thread.
+	bool waitUntil(f64 deadline)
+	{
+		// Wait on the OS until just before the deadline, then yield for the remainder.
+		const f64 waitTime = deadline - getTimeInSeconds() - c_waitPrecision;
+		if (waitTime > 0.0 && s_requestSignal->wait(u32(waitTime * 1000.0)))
+		{
+			return false;
+		}
+		while (getTimeInSeconds() < deadline)
+		{
+			if (s_requestSignal->wait(0)) { return false; }
+			TFE_System::sleep(0);
+		}
+		return true;
+	}
 
-				allTracksFinished = false;
-				const f64 prevTick = runtimeTrack->curTick;
-				f64 nextTick = prevTick + dt * 1000.0 / runtimeTrack->msPerTick;
+	// Thread Function, used with an external Midi device.
+	// The thread sleeps until the next event is due or the game thread makes a request, so it uses almost no CPU.
+	TFE_THREADRET midiUpdateFunc(void* userData)
+	{
+		TFE_THREAD_NAME("Midi");
+
+		bool runThread = true;
+		u64 localTime = 0;
+		while (runThread)
+		{
+			if (!sequencer_handleRequests(&s_runtime))
+			{
+				// Restart the local time so that the song does not skip ahead when it starts or resumes.
+				localTime = 0u;
+				s_requestSignal->wait();
+				runThread = s_runMusicThread.load();
+				continue;
+			}
 
-				u32 start = (u32)prevTick;
-				u32 end   = (u32)nextTick;
+			// Send the events that are due.
+			const f64 dt = TFE_System::updateThreadLocal(&localTime);
+			{
+				TFE_ZONE("Midi Events");
+				sequencer_advance(&s_runtime, dt);
+			}
 
-				const u32 evtCount = (u32)track->eventList.size();
-				const MidiTrackEvent* evt = track->eventList.data();
-				bool breakFromLoop = false;
-				for (u32 e = u32(runtimeTrack->lastEvent + 1); e < evtCount && !breakFromLoop; e++)
+			const f64 timeToEvent = sequencer_getTimeToNextEvent(&s_runtime);
+			if (timeToEvent < 0.0)
+			{
+				// The song has finished.
+				s_requestSignal->wait();
+			}
+			else
+			{
+				const f64 deadline = getTimeInSeconds() + timeToEvent;
+				if (waitUntil(deadline))
 				{
-					if (evt[e].tick >= start && evt[e].tick <= end)
-					{
-						runtimeTrack->lastEvent = e;
-						switch (evt[e].type)
-						{
-							case MTK_TEMPO:
-								runtimeTrack->msPerTick = track->tempoEvents[evt[e].index].msPerTick;
-								break;
-							case MTK_MARKER:
-							{
-								const MidiMarker* marker = &track->markers[evt[e].index];
-								TFE_System::logWrite(LOG_MSG, "iMuse", "Marker Track %d, \"%s\"", i, marker->name);
-							} break;
-							case MTK_MIDI:
-							{
-								const MidiEvent* midiEvt = &track->midiEvents[evt[e].index];
-								const u8 type = midiEvt->channel >= 0 ? midiEvt->type + midiEvt->channel : midiEvt->type;
-								// TODO: Track notes on and off so that hanging notes can be handled manually.
-								//       Apparently not all midi devices support MID_ALL_NOTES_OFF.
-								if ((midiEvt->type&0xf0) == MID_CONTROL_CHANGE && midiEvt->data[0] == MID_VOLUME_MSB)
-								{
-									const s32 channelIndex = midiEvt->type & 0x0f;
-									s_channelSrcVolume[channelIndex] = midiEvt->data[1];
-									TFE_MidiDevice::sendMessage(type, midiEvt->data[0], u8(s_channelSrcVolume[channelIndex] * s_masterVolumeScaled));
-								}
-								else
-								{
-									TFE_MidiDevice::sendMessage(type, midiEvt->data[0], midiEvt->data[1]);
-								}
-							} break;
-							case MTK_IMUSE:
-							{
-								const iMuseEvent* imuse = &track->imuseEvents[evt[e].index];
-								switch (imuse->cmd)
-								{
-									case IMUSE_START_NEW:
-									{
-									} break;
-									case IMUSE_STALK_TRANS:
-									{
-									} break;
-									case IMUSE_FIGHT_TRANS:
-									{
-									} break;
-									case IMUSE_ENGAGE_TRANS:
-									{
-									} break;
-									case IMUSE_FROM_FIGHT:
-									{
-									} break;
-									case IMUSE_FROM_STALK:
-									{
-									} break;
-									case IMUSE_FROM_BOSS:
-									{
-									} break;
-									case IMUSE_CLEAR_CALLBACK:
-									{
-										//clearCallback();
-									} break;
-									case IMUSE_TO:
-									{
-										//setCallback();
-									} break;
-									case IMUSE_LOOP_START:
-									{
-									} break;
-									case IMUSE_LOOP_END:
-									{
-										nextTick = imuse->arg[0].nArg;
-										runtimeTrack->lastEvent = -1;
-										breakFromLoop = true;
-										stopAllNotes();
-									} break;
-								};
-							} break;
-						}
-					}
-					else if (evt[e].tick > end)
-					{
-						break;
-					}
+					recordTimingError(getTimeInSeconds() - deadline);
 				}
-
-				runtimeTrack->curTick = nextTick;
 			}
 			runThread = s_runMusicThread.load();
-			// Give other threads a chance to run...
-			//if (runThread) { TFE_System::sleep(0); }
 		};
-		
+
 		return (TFE_THREADRET)0;
 	}
 
+	//////////////////////////////////////////////////////////////////////
+	// Offline rendering
+	//////////////////////////////////////////////////////////////////////
+	bool renderSong(const GMidiAsset* song, f32 seconds, u32 sampleRate, u32 maxVoices, std::vector<f32>* output, MidiRenderStats* stats)
+	{
+		if (!song || !loadSoundFont()) { return false; }
+
+		MidiSynth* synth = TFE_MidiSynth::createSynth(sampleRate, maxVoices);
+		if (!synth) { return false; }
+
+		// Use a private runtime so the song currently playing is not disturbed.
+		MidiRuntime runtime = {};
+		runtime.synth = synth;
+
+		const u32 frameCount = u32(seconds * f32(sampleRate));
+		output->assign(frameCount * 2, 0.0f);
+
+		const u64 start = TFE_System::getCurrentTimeInTicks();
+		u32 peakVoices = 0;
+		sequencer_begin(&runtime, song, false);
+		for (u32 frame = 0; frame < frameCount; frame += c_offlineBlockSize)
+		{
+			const u32 count = std::min(frameCount - frame, c_offlineBlockSize);
+			sequencer_render(&runtime, true, sampleRate, output->data() + frame * 2, count);
+			peakVoices = std::max(peakVoices, TFE_MidiSynth::getActiveVoiceCount(synth));
+		}
+
+		if (stats)
+		{
+			stats->renderTime = TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - start);
+			stats->peakVoices = peakVoices;
+			stats->stolenVoices = TFE_MidiSynth::getStolenVoiceCount(synth);
+		}
+		TFE_MidiSynth::destroySynth(synth);
+		return true;
+	}
+
 	// Console Functions
 	void setMusicVolumeConsole(const ConsoleArgList& args)
 	{
@@ -349,6 +635,7 @@ namespace TFE_MidiPlayer
 		s_masterVolume = TFE_Console::getFloatArg(args[1]);
 		s_masterVolumeScaled = s_masterVolume * c_musicVolumeScale;
 		s_changeVolume.store(true);
+		wakeMusicThread();
 
 		TFE_Settings_Sound* soundSettings = TFE_Settings::getSoundSettings();
 		soundSettings->musicVolume = s_masterVolume;
@@ -361,4 +648,57 @@ namespace TFE_MidiPlayer
 		sprintf(res, "Sound Volume: %2.3f", s_masterVolume);
 		TFE_Console::addToHistory(res);
 	}
+
+	void musicTimingConsole(const ConsoleArgList& args)
+	{
+		const u32 count = s_timingEventCount.exchange(0);
+		const u64 errorSum = s_timingErrorSum.exchange(0);
+		const u32 errorMax = s_timingErrorMax.exchange(0);
+
+		char res[256];
+		sprintf(res, "Music event timing (%s): %u events, mean error %0.1f us, max error %0.1f us.", s_synth ? "synthesizer" : "midi device",
+			count, count ? f64(errorSum) / f64(count) * 0.001 : 0.0, f64(errorMax) * 0.001);
+		TFE_Console::addToHistory(res);
+	}
+
+	void renderMusicConsole(const ConsoleArgList& args)
+	{
+		if (args.size() < 2) { return; }
+
+		char res[256];
+		const GMidiAsset* song = TFE_GmidAsset::get(args[1].c_str());
+		if (!song)
+		{
+			sprintf(res, "Cannot find song \"%s\".", args[1].c_str());
+			TFE_Console::addToHistory(res);
+			return;
+		}
+
+		const f32 seconds = args.size() >= 3 ? std::max(TFE_Console::getFloatArg(args[2]), 0.0f) : 60.0f;
+		const u32 sampleRate = TFE_Audio::getMixSampleRate();
+		const u32 maxVoices = TFE_Settings::getSoundSettings()->midiSynthVoices;
+
+		std::vector<f32> output;
+		MidiRenderStats stats;
+		if (!renderSong(song, seconds, sampleRate, maxVoices, &output, &stats))
+		{
+			TFE_Console::addToHistory("Cannot render the song, the SoundFont could not be loaded.");
+			return;
+		}
+
+		sprintf(res, "Rendered %0.1f seconds of \"%s\" in %0.3f seconds (%0.1fx realtime), peak voices %u, stolen voices %u.",
+			seconds, song->name, stats.renderTime, stats.renderTime > 0.0 ? f64(seconds) / stats.renderTime : 0.0, stats.peakVoices, stats.stolenVoices);
+		TFE_Console::addToHistory(res);
+		TFE_System::logWrite(LOG_MSG, "MidiPlayer", "%s", res);
+
+		if (args.size() >= 4)
+		{
+			WavWriter* wav = TFE_WAV::startWav(args[3].c_str(), sampleRate, 2);
+			if (wav)
+			{
+				TFE_WAV::writeFrames(wav, output.data(), u32(output.size() / 2));
+				TFE_WAV::endWav(wav);
+			}
+		}
+	}
 }
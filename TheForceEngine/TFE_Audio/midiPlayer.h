@@ -1,7 +1,15 @@
 #pragma once
 #include <TFE_System/types.h>
+#include <vector>
 struct GMidiAsset;
 
+struct MidiRenderStats
+{
+	f64 renderTime;		// seconds.
+	u32 peakVoices;
+	u32 stolenVoices;
+};
+
 namespace TFE_MidiPlayer
 {
 	bool init();
@@ -15,4 +23,8 @@ namespace TFE_MidiPlayer
 	void pause();
 	void resume();
 	void stop();
+
+	// Render a song with the synthesizer without an audio device, for benchmarking and regression tests.
+	// The output is interleaved stereo at 'sampleRate', the currently playing song is not affected.
+	bool renderSong(const GMidiAsset* song, f32 seconds, u32 sampleRate, u32 maxVoices, std::vector<f32>* output, MidiRenderStats* stats = nullptr);
 };
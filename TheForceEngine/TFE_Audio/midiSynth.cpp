@@ -0,0 +1,1076 @@
+#include <cstring>
+
+#include "midiSynth.h"
+#include "midi.h"
+#include <TFE_System/system.h>
+#include <TFE_FileSystem/filestream.h>
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+// Voices are rendered with SSE when available, which is always the case for x64 builds.
+#if defined(_M_X64) || defined(__SSE2__)
+#define SYNTH_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Reference: SoundFont Technical Specification, version 2.04 (E-mu Systems).
+// Supported: sample playback with linear interpolation, key and velocity ranges, sample loops, tuning,
+// pan, initial attenuation, the volume envelope, exclusive classes, sustain and pitch bend.
+// Not supported: modulators, the filter, LFOs, the modulation envelope, reverb and chorus.
+
+namespace TFE_MidiSynth
+{
+	enum SynthConstants
+	{
+		SYNTH_BLOCK_SIZE = 64,		// Envelopes and gains are updated once per block and ramped across it.
+		SYNTH_CHANNEL_COUNT = 16,
+		SYNTH_PERCUSSION_CHANNEL = 9,
+		SYNTH_PERCUSSION_BANK = 128,
+		SYNTH_MAX_VOICES = 256,
+	};
+
+	// SF2 record sizes.
+	enum Sf2RecordSize
+	{
+		SF2_PHDR_SIZE = 38,
+		SF2_BAG_SIZE = 4,
+		SF2_GEN_SIZE = 4,
+		SF2_INST_SIZE = 22,
+		SF2_SHDR_SIZE = 46,
+	};
+
+	// SF2 generators, only those used by the synthesizer are listed.
+	enum Sf2Generator
+	{
+		GEN_START_OFFSET = 0,
+		GEN_END_OFFSET = 1,
+		GEN_LOOP_START_OFFSET = 2,
+		GEN_LOOP_END_OFFSET = 3,
+		GEN_START_COARSE_OFFSET = 4,
+		GEN_END_COARSE_OFFSET = 12,
+		GEN_PAN = 17,
+		GEN_DELAY_VOL_ENV = 33,
+		GEN_ATTACK_VOL_ENV = 34,
+		GEN_HOLD_VOL_ENV = 35,
+		GEN_DECAY_VOL_ENV = 36,
+		GEN_SUSTAIN_VOL_ENV = 37,
+		GEN_RELEASE_VOL_ENV = 38,
+		GEN_INSTRUMENT = 41,
+		GEN_KEY_RANGE = 43,
+		GEN_VEL_RANGE = 44,
+		GEN_LOOP_START_COARSE_OFFSET = 45,
+		GEN_KEYNUM = 46,
+		GEN_VELOCITY = 47,
+		GEN_ATTENUATION = 48,
+		GEN_LOOP_END_COARSE_OFFSET = 50,
+		GEN_COARSE_TUNE = 51,
+		GEN_FINE_TUNE = 52,
+		GEN_SAMPLE_ID = 53,
+		GEN_SAMPLE_MODES = 54,
+		GEN_SCALE_TUNING = 56,
+		GEN_EXCLUSIVE_CLASS = 57,
+		GEN_ROOT_KEY = 58,
+		GEN_COUNT = 61
+	};
+
+	enum LoopMode
+	{
+		LOOP_NONE = 0,
+		LOOP_CONTINUOUS = 1,
+		LOOP_UNTIL_RELEASE = 3,
+	};
+
+	enum EnvelopeSegment
+	{
+		ENV_DELAY = 0,
+		ENV_ATTACK,
+		ENV_HOLD,
+		ENV_DECAY,
+		ENV_SUSTAIN,
+		ENV_RELEASE,
+		ENV_DONE
+	};
+
+	// A sample mapped to a key and velocity range, flattened from the preset and instrument zones at load time.
+	struct SynthRegion
+	{
+		u8  loKey, hiKey;
+		u8  loVel, hiVel;
+		u32 start, end;
+		u32 loopStart, loopEnd;
+		u32 loopMode;
+		s32 rootKey;
+		s32 keynum;			// overrides the played key if >= 0.
+		s32 exclusiveClass;
+		f32 tune;			// semitones, including the sample pitch correction.
+		f32 scaleTuning;	// semitones per key.
+		f32 sampleRate;
+		f32 gain;			// initial attenuation as a linear gain.
+		f32 pan;			// [-0.5, 0.5]
+		// Volume envelope, times are in seconds.
+		f32 delay, attack, hold, decay, release;
+		f32 sustain;		// linear level.
+	};
+
+	struct SynthPreset
+	{
+		char name[21];
+		u16 bank;
+		u16 program;
+		u32 firstRegion;
+		u32 regionCount;
+	};
+
+	struct SoundFont
+	{
+		std::vector<f32> samples;	// converted to float once at load time.
+		std::vector<SynthRegion> regions;
+		std::vector<SynthPreset> presets;
+	};
+
+	struct SynthChannel
+	{
+		const SynthPreset* preset;
+		u8   bank;
+		u8   program;
+		u8   volume;
+		u8   expression;
+		u8   pan;
+		u8   rpnLsb;
+		u8   rpnMsb;
+		bool sustain;
+		f32  bend;		// semitones.
+		f32  bendRange;	// semitones.
+	};
+
+	struct SynthVoice
+	{
+		const SynthRegion* region;
+		u32  noteId;	// note-on order, used to find the oldest voice.
+		u8   channel;
+		u8   key;
+		bool released;	// the note is off, the voice is in its release or will stop at the end of the sample.
+		bool held;		// the note is off but is held by the sustain pedal.
+
+		u64 pos;		// 32.32 fixed point sample position.
+		u64 step;		// 32.32 fixed point step per output frame.
+		f32 pitch;		// semitones relative to the root key, excluding the pitch bend.
+		f32 noteGain;	// region and velocity gain.
+		f32 gainL;		// channel gain and pan from the previous block, negative until the first block is rendered.
+		f32 gainR;
+
+		EnvelopeSegment segment;
+		f32 env;
+		u32 segmentFrames;	// frames left in the delay, attack or hold segment.
+		f32 envStep;		// per frame increase during the attack.
+		f32 envFactor;		// per frame multiplier during the decay and release.
+	};
+}
+
+struct MidiSynth
+{
+	u32 sampleRate;
+	u32 maxVoices;
+	u32 activeCount;	// active voices are packed at the start of the voice list.
+	u32 noteId;
+	u32 stolenCount;
+	TFE_MidiSynth::SynthChannel channels[TFE_MidiSynth::SYNTH_CHANNEL_COUNT];
+	std::vector<TFE_MidiSynth::SynthVoice> voices;
+	f32 scratch[TFE_MidiSynth::SYNTH_BLOCK_SIZE];
+};
+
+namespace TFE_MidiSynth
+{
+	static const f32 c_envSilence = 0.0001f;		// -80 dB
+	static const f32 c_fastRelease = 0.005f;		// seconds, used when cutting off a voice.
+	static const f32 c_halfPi = 1.57079632679f;
+	// Attenuation is scaled to match E-mu hardware (and so the way most SoundFonts were authored), as FluidSynth does.
+	static const f32 c_attenuationScale = 0.4f;
+
+	static SoundFont* s_soundFont = nullptr;
+
+	//////////////////////////////////////////////////////////////////////
+	// SoundFont loading
+	//////////////////////////////////////////////////////////////////////
+	struct Sf2Table
+	{
+		const u8* data;
+		u32 count;
+	};
+
+	struct Sf2Chunks
+	{
+		const u8* smpl;
+		u32 smplSize;
+		Sf2Table phdr, pbag, pgen;
+		Sf2Table inst, ibag, igen;
+		Sf2Table shdr;
+	};
+
+	inline u16 read16(const u8* data)
+	{
+		u16 value;
+		memcpy(&value, data, sizeof(u16));
+		return value;
+	}
+
+	inline u32 read32(const u8* data)
+	{
+		u32 value;
+		memcpy(&value, data, sizeof(u32));
+		return value;
+	}
+
+	inline bool isChunk(const u8* data, const char* id)
+	{
+		return memcmp(data, id, 4) == 0;
+	}
+
+	void readTable(const u8* data, u32 size, u32 recordSize, Sf2Table* table)
+	{
+		table->data = data;
+		table->count = size / recordSize;
+	}
+
+	void readListChunk(const u8* data, u32 size, Sf2Chunks* chunks)
+	{
+		const u8* end = data + size;
+		while (data + 8 <= end)
+		{
+			const u32 chunkSize = read32(data + 4);
+			const u8* body = data + 8;
+			if (chunkSize > u32(end - body)) { break; }
+
+			if (isChunk(data, "smpl")) { chunks->smpl = body; chunks->smplSize = chunkSize; }
+			else if (isChunk(data, "phdr")) { readTable(body, chunkSize, SF2_PHDR_SIZE, &chunks->phdr); }
+			else if (isChunk(data, "pbag")) { readTable(body, chunkSize, SF2_BAG_SIZE,  &chunks->pbag); }
+			else if (isChunk(data, "pgen")) { readTable(body, chunkSize, SF2_GEN_SIZE,  &chunks->pgen); }
+			else if (isChunk(data, "inst")) { readTable(body, chunkSize, SF2_INST_SIZE, &chunks->inst); }
+			else if (isChunk(data, "ibag")) { readTable(body, chunkSize, SF2_BAG_SIZE,  &chunks->ibag); }
+			else if (isChunk(data, "igen")) { readTable(body, chunkSize, SF2_GEN_SIZE,  &chunks->igen); }
+			else if (isChunk(data, "shdr")) { readTable(body, chunkSize, SF2_SHDR_SIZE, &chunks->shdr); }
+
+			data = body + chunkSize + (chunkSize & 1);
+		}
+	}
+
+	bool readChunks(const u8* data, u32 size, Sf2Chunks* chunks)
+	{
+		memset(chunks, 0, sizeof(Sf2Chunks));
+		if (size < 12 || !isChunk(data, "RIFF") || !isChunk(data + 8, "sfbk"))
+		{
+			return false;
+		}
+
+		const u8* end = data + std::min(size, read32(data + 4) + 8u);
+		const u8* chunk = data + 12;
+		while (chunk + 8 <= end)
+		{
+			const u32 chunkSize = read32(chunk + 4);
+			const u8* body = chunk + 8;
+			if (chunkSize > u32(end - body)) { break; }
+
+			// The sample data is in the "sdta" list and the instruments in the "pdta" list.
+			if (isChunk(chunk, "LIST") && chunkSize >= 4)
+			{
+				readListChunk(body + 4, chunkSize - 4, chunks);
+			}
+			chunk = body + chunkSize + (chunkSize & 1);
+		}
+
+		// Each table ends with a terminal record.
+		return chunks->smpl && chunks->phdr.count >= 2 && chunks->pbag.count >= 1 && chunks->pgen.count >= 1 &&
+		       chunks->inst.count >= 2 && chunks->ibag.count >= 1 && chunks->igen.count >= 1 && chunks->shdr.count >= 1;
+	}
+
+	void setInstrumentDefaults(s32* gen)
+	{
+		memset(gen, 0, sizeof(s32) * GEN_COUNT);
+		gen[GEN_DELAY_VOL_ENV]   = -12000;
+		gen[GEN_ATTACK_VOL_ENV]  = -12000;
+		gen[GEN_HOLD_VOL_ENV]    = -12000;
+		gen[GEN_DECAY_VOL_ENV]   = -12000;
+		gen[GEN_RELEASE_VOL_ENV] = -12000;
+		gen[GEN_KEY_RANGE] = 127 << 8;
+		gen[GEN_VEL_RANGE] = 127 << 8;
+		gen[GEN_KEYNUM]    = -1;
+		gen[GEN_VELOCITY]  = -1;
+		gen[GEN_ROOT_KEY]  = -1;
+		gen[GEN_SCALE_TUNING] = 100;
+	}
+
+	void setPresetDefaults(s32* gen)
+	{
+		// Preset generators are relative to the instrument values.
+		memset(gen, 0, sizeof(s32) * GEN_COUNT);
+		gen[GEN_KEY_RANGE] = 127 << 8;
+		gen[GEN_VEL_RANGE] = 127 << 8;
+	}
+
+	// Generators that are not allowed at the preset level (or are handled seperately) are not added to the instrument values.
+	bool isPresetAdditive(u32 oper)
+	{
+		switch (oper)
+		{
+			case GEN_START_OFFSET:
+			case GEN_END_OFFSET:
+			case GEN_LOOP_START_OFFSET:
+			case GEN_LOOP_END_OFFSET:
+			case GEN_START_COARSE_OFFSET:
+			case GEN_END_COARSE_OFFSET:
+			case GEN_LOOP_START_COARSE_OFFSET:
+			case GEN_LOOP_END_COARSE_OFFSET:
+			case GEN_INSTRUMENT:
+			case GEN_KEY_RANGE:
+			case GEN_VEL_RANGE:
+			case GEN_KEYNUM:
+			case GEN_VELOCITY:
+			case GEN_SAMPLE_ID:
+			case GEN_SAMPLE_MODES:
+			case GEN_EXCLUSIVE_CLASS:
+			case GEN_ROOT_KEY:
+				return false;
+		}
+		return true;
+	}
+
+	// Read the generators of a zone, returns the value of the terminal generator (instrument or sample) or -1 for a global zone.
+	s32 readZone(const Sf2Table& bags, const Sf2Table& gens, u32 bag, Sf2Generator terminal, s32* gen)
+	{
+		if (bag + 1 >= bags.count) { return -1; }
+		const u32 first = read16(bags.data + bag * SF2_BAG_SIZE);
+		const u32 last  = std::min(u32(read16(bags.data + (bag + 1) * SF2_BAG_SIZE)), gens.count);
+		for (u32 g = first; g < last; g++)
+		{
+			const u8* rec = gens.data + g * SF2_GEN_SIZE;
+			const u16 oper = read16(rec);
+			if (oper == terminal)
+			{
+				return read16(rec + 2);
+			}
+			else if (oper == GEN_KEY_RANGE || oper == GEN_VEL_RANGE)
+			{
+				gen[oper] = rec[2] | (rec[3] << 8);
+			}
+			else if (oper < GEN_COUNT)
+			{
+				gen[oper] = s16(read16(rec + 2));
+			}
+		}
+		return -1;
+	}
+
+	f32 timecentsToSeconds(s32 timecents)
+	{
+		return powf(2.0f, f32(std::max(-12000, std::min(timecents, 8000))) / 1200.0f);
+	}
+
+	f32 centibelsToGain(f32 centibels)
+	{
+		return powf(10.0f, -centibels / 200.0f);
+	}
+
+	bool makeRegion(const s32* instGen, const s32* presetGen, const u8* shdr, u32 sampleCount, SynthRegion* region)
+	{
+		s32 gen[GEN_COUNT];
+		for (u32 i = 0; i < GEN_COUNT; i++)
+		{
+			gen[i] = instGen[i] + (isPresetAdditive(i) ? presetGen[i] : 0);
+		}
+
+		// The key and velocity ranges are the intersection of the preset and instrument ranges.
+		const s32 loKey = std::max(instGen[GEN_KEY_RANGE] & 0xff, presetGen[GEN_KEY_RANGE] & 0xff);
+		const s32 hiKey = std::min(instGen[GEN_KEY_RANGE] >> 8,   presetGen[GEN_KEY_RANGE] >> 8);
+		const s32 loVel = std::max(instGen[GEN_VEL_RANGE] & 0xff, presetGen[GEN_VEL_RANGE] & 0xff);
+		const s32 hiVel = std::min(instGen[GEN_VEL_RANGE] >> 8,   presetGen[GEN_VEL_RANGE] >> 8);
+		if (loKey > hiKey || loVel > hiVel) { return false; }
+
+		// ROM samples are not available.
+		const u16 sampleType = read16(shdr + 44);
+		if (sampleType & 0x8000) { return false; }
+
+		const s64 lastSample = s64(sampleCount) - 1;
+		const s64 start = s64(read32(shdr + 20)) + gen[GEN_START_OFFSET] + s64(gen[GEN_START_COARSE_OFFSET]) * 32768;
+		const s64 end   = s64(read32(shdr + 24)) + gen[GEN_END_OFFSET]   + s64(gen[GEN_END_COARSE_OFFSET]) * 32768;
+		const s64 loopStart = s64(read32(shdr + 28)) + gen[GEN_LOOP_START_OFFSET] + s64(gen[GEN_LOOP_START_COARSE_OFFSET]) * 32768;
+		const s64 loopEnd   = s64(read32(shdr + 32)) + gen[GEN_LOOP_END_OFFSET]   + s64(gen[GEN_LOOP_END_COARSE_OFFSET]) * 32768;
+
+		region->loKey = u8(loKey);
+		region->hiKey = u8(hiKey);
+		region->loVel = u8(loVel);
+		region->hiVel = u8(hiVel);
+		// The sample at 'end' is read when interpolating, the format guarantees padding after each sample.
+		region->start = u32(std::max(s64(0), std::min(start, lastSample)));
+		region->end   = u32(std::max(s64(region->start), std::min(end, lastSample)));
+		if (region->end <= region->start) { return false; }
+		region->loopStart = u32(std::max(s64(region->start), std::min(loopStart, s64(region->end))));
+		region->loopEnd   = u32(std::max(s64(region->start), std::min(loopEnd,   s64(region->end))));
+		region->loopMode  = u32(gen[GEN_SAMPLE_MODES] & 3);
+		if (region->loopMode == 2 || region->loopEnd <= region->loopStart)
+		{
+			region->loopMode = LOOP_NONE;
+		}
+
+		const u8 originalPitch = shdr[40];
+		const s8 pitchCorrection = s8(shdr[41]);
+		region->rootKey = gen[GEN_ROOT_KEY] >= 0 ? gen[GEN_ROOT_KEY] : (originalPitch <= 127 ? originalPitch : 60);
+		region->keynum  = gen[GEN_KEYNUM];
+		region->exclusiveClass = gen[GEN_EXCLUSIVE_CLASS];
+		region->tune = f32(gen[GEN_COARSE_TUNE]) + f32(gen[GEN_FINE_TUNE] + pitchCorrection) / 100.0f;
+		region->scaleTuning = f32(gen[GEN_SCALE_TUNING]) / 100.0f;
+		region->sampleRate  = f32(std::max(read32(shdr + 36), 1u));
+		region->gain = centibelsToGain(f32(std::max(0, std::min(gen[GEN_ATTENUATION], 1440))) * c_attenuationScale);
+		region->pan  = f32(std::max(-500, std::min(gen[GEN_PAN], 500))) / 1000.0f;
+
+		region->delay   = timecentsToSeconds(gen[GEN_DELAY_VOL_ENV]);
+		region->attack  = timecentsToSeconds(gen[GEN_ATTACK_VOL_ENV]);
+		region->hold    = timecentsToSeconds(gen[GEN_HOLD_VOL_ENV]);
+		region->decay   = timecentsToSeconds(gen[GEN_DECAY_VOL_ENV]);
+		region->release = timecentsToSeconds(gen[GEN_RELEASE_VOL_ENV]);
+		region->sustain = centibelsToGain(f32(std::max(0, std::min(gen[GEN_SUSTAIN_VOL_ENV], 1440))));
+		return true;
+	}
+
+	void addInstrumentRegions(SoundFont* font, const Sf2Chunks& chunks, u32 instrument, const s32* presetGen)
+	{
+		const u32 firstBag = read16(chunks.inst.data + instrument * SF2_INST_SIZE + 20);
+		const u32 lastBag  = read16(chunks.inst.data + (instrument + 1) * SF2_INST_SIZE + 20);
+
+		s32 globalGen[GEN_COUNT];
+		setInstrumentDefaults(globalGen);
+		for (u32 bag = firstBag; bag < lastBag; bag++)
+		{
+			s32 gen[GEN_COUNT];
+			memcpy(gen, globalGen, sizeof(s32) * GEN_COUNT);
+			const s32 sample = readZone(chunks.ibag, chunks.igen, bag, GEN_SAMPLE_ID, gen);
+			if (sample < 0)
+			{
+				// Only the first zone may be a global zone.
+				if (bag == firstBag) { memcpy(globalGen, gen, sizeof(s32) * GEN_COUNT); }
+				continue;
+			}
+			if (u32(sample) >= chunks.shdr.count) { continue; }
+
+			SynthRegion region;
+			if (makeRegion(gen, presetGen, chunks.shdr.data + sample * SF2_SHDR_SIZE, (u32)font->samples.size(), &region))
+			{
+				font->regions.push_back(region);
+			}
+		}
+	}
+
+	bool buildSoundFont(SoundFont* font, const Sf2Chunks& chunks)
+	{
+		const u32 sampleCount = chunks.smplSize / 2;
+		font->samples.resize(sampleCount);
+		for (u32 i = 0; i < sampleCount; i++)
+		{
+			font->samples[i] = f32(s16(read16(chunks.smpl + i * 2))) * (1.0f / 32768.0f);
+		}
+
+		// The last preset header is the terminal record.
+		const u32 presetCount = chunks.phdr.count - 1;
+		font->presets.resize(presetCount);
+		for (u32 p = 0; p < presetCount; p++)
+		{
+			const u8* phdr = chunks.phdr.data + p * SF2_PHDR_SIZE;
+			SynthPreset* preset = &font->presets[p];
+			memcpy(preset->name, phdr, 20);
+			preset->name[20] = 0;
+			preset->program = read16(phdr + 20);
+			preset->bank = read16(phdr + 22);
+			preset->firstRegion = (u32)font->regions.size();
+
+			const u32 firstBag = read16(phdr + 24);
+			const u32 lastBag  = read16(phdr + SF2_PHDR_SIZE + 24);
+			s32 globalGen[GEN_COUNT];
+			setPresetDefaults(globalGen);
+			for (u32 bag = firstBag; bag < lastBag; bag++)
+			{
+				s32 gen[GEN_COUNT];
+				memcpy(gen, globalGen, sizeof(s32) * GEN_COUNT);
+				const s32 instrument = readZone(chunks.pbag, chunks.pgen, bag, GEN_INSTRUMENT, gen);
+				if (instrument < 0)
+				{
+					if (bag == firstBag) { memcpy(globalGen, gen, sizeof(s32) * GEN_COUNT); }
+					continue;
+				}
+				if (u32(instrument) + 1 >= chunks.inst.count) { continue; }
+
+				addInstrumentRegions(font, chunks, instrument, gen);
+			}
+			preset->regionCount = (u32)font->regions.size() - preset->firstRegion;
+		}
+		return !font->presets.empty() && !font->regions.empty();
+	}
+
+	bool loadSoundFont(const char* path)
+	{
+		freeSoundFont();
+
+		void* data = nullptr;
+		const u32 size = FileStream::readContents(path, &data);
+		if (!size)
+		{
+			TFE_System::logWrite(LOG_ERROR, "MidiSynth", "Cannot read SoundFont \"%s\".", path);
+			free(data);
+			return false;
+		}
+
+		Sf2Chunks chunks;
+		if (!readChunks((const u8*)data, size, &chunks))
+		{
+			TFE_System::logWrite(LOG_ERROR, "MidiSynth", "Invalid SoundFont \"%s\".", path);
+			free(data);
+			return false;
+		}
+		// SoundFonts made for the AWE cards may only reference samples in the sound card ROM.
+		if (!chunks.smplSize)
+		{
+			TFE_System::logWrite(LOG_ERROR, "MidiSynth", "SoundFont \"%s\" has no sample data, it requires sound card ROM samples.", path);
+			free(data);
+			return false;
+		}
+
+		SoundFont* font = new SoundFont();
+		const bool res = buildSoundFont(font, chunks);
+		free(data);
+		if (!res)
+		{
+			TFE_System::logWrite(LOG_ERROR, "MidiSynth", "SoundFont \"%s\" has no usable instruments.", path);
+			delete font;
+			return false;
+		}
+
+		TFE_System::logWrite(LOG_MSG, "MidiSynth", "Loaded SoundFont \"%s\": %u presets, %u regions, %u samples.",
+			path, (u32)font->presets.size(), (u32)font->regions.size(), (u32)font->samples.size());
+		s_soundFont = font;
+		return true;
+	}
+
+	void freeSoundFont()
+	{
+		delete s_soundFont;
+		s_soundFont = nullptr;
+	}
+
+	bool isSoundFontLoaded()
+	{
+		return s_soundFont != nullptr;
+	}
+
+	const SynthPreset* findPreset(u32 bank, u32 program)
+	{
+		if (!s_soundFont) { return nullptr; }
+
+		// Fallback to the General Midi bank, or the standard drum kit, if the exact preset does not exist.
+		const u32 fallbackBank = bank >= SYNTH_PERCUSSION_BANK ? SYNTH_PERCUSSION_BANK : 0u;
+		const u32 fallbackProgram = bank >= SYNTH_PERCUSSION_BANK ? 0u : program;
+		const SynthPreset* fallback = nullptr;
+		for (size_t i = 0; i < s_soundFont->presets.size(); i++)
+		{
+			const SynthPreset* preset = &s_soundFont->presets[i];
+			if (preset->bank == bank && preset->program == program)
+			{
+				return preset;
+			}
+			else if (!fallback && preset->bank == fallbackBank && preset->program == fallbackProgram)
+			{
+				fallback = preset;
+			}
+		}
+		return fallback;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Voices
+	//////////////////////////////////////////////////////////////////////
+	// Per frame multiplier that falls by 100 dB over the given time, the decay and release are linear in dB.
+	f32 envelope_getFactor(f32 seconds, u32 sampleRate)
+	{
+		return powf(10.0f, -5.0f / std::max(seconds * f32(sampleRate), 1.0f));
+	}
+
+	void envelope_enter(const MidiSynth* synth, SynthVoice* voice, EnvelopeSegment segment)
+	{
+		const SynthRegion* region = voice->region;
+		const f32 rate = f32(synth->sampleRate);
+		voice->segment = segment;
+		switch (segment)
+		{
+			case ENV_DELAY:
+				voice->env = 0.0f;
+				voice->segmentFrames = u32(region->delay * rate);
+				break;
+			case ENV_ATTACK:
+				voice->segmentFrames = std::max(u32(region->attack * rate), 1u);
+				voice->envStep = (1.0f - voice->env) / f32(voice->segmentFrames);
+				break;
+			case ENV_HOLD:
+				voice->env = 1.0f;
+				voice->segmentFrames = u32(region->hold * rate);
+				break;
+			case ENV_DECAY:
+				voice->envFactor = envelope_getFactor(region->decay, synth->sampleRate);
+				break;
+			case ENV_SUSTAIN:
+				voice->env = region->sustain;
+				break;
+			case ENV_RELEASE:
+				voice->envFactor = envelope_getFactor(region->release, synth->sampleRate);
+				break;
+			case ENV_DONE:
+				voice->env = 0.0f;
+				break;
+		}
+	}
+
+	void envelope_advance(const MidiSynth* synth, SynthVoice* voice, u32 frames)
+	{
+		while (frames)
+		{
+			switch (voice->segment)
+			{
+				case ENV_DELAY:
+				case ENV_ATTACK:
+				case ENV_HOLD:
+				{
+					const u32 count = std::min(frames, voice->segmentFrames);
+					if (voice->segment == ENV_ATTACK)
+					{
+						voice->env += voice->envStep * f32(count);
+					}
+					voice->segmentFrames -= count;
+					frames -= count;
+					if (!voice->segmentFrames)
+					{
+						envelope_enter(synth, voice, EnvelopeSegment(voice->segment + 1));
+					}
+				} break;
+				case ENV_DECAY:
+				{
+					voice->env *= powf(voice->envFactor, f32(frames));
+					frames = 0;
+					if (voice->env <= voice->region->sustain)
+					{
+						envelope_enter(synth, voice, voice->region->sustain > c_envSilence ? ENV_SUSTAIN : ENV_DONE);
+					}
+				} break;
+				case ENV_RELEASE:
+				{
+					voice->env *= powf(voice->envFactor, f32(frames));
+					frames = 0;
+					if (voice->env < c_envSilence)
+					{
+						envelope_enter(synth, voice, ENV_DONE);
+					}
+				} break;
+				case ENV_SUSTAIN:
+				case ENV_DONE:
+					frames = 0;
+					break;
+			}
+		}
+	}
+
+	void voice_updatePitch(const MidiSynth* synth, SynthVoice* voice)
+	{
+		const f64 semitones = f64(voice->pitch + synth->channels[voice->channel].bend);
+		const f64 ratio = pow(2.0, semitones / 12.0) * f64(voice->region->sampleRate) / f64(synth->sampleRate);
+		voice->step = u64(std::min(ratio, 64.0) * 4294967296.0);
+	}
+
+	void voice_release(const MidiSynth* synth, SynthVoice* voice)
+	{
+		voice->released = true;
+		voice->held = false;
+		if (voice->segment < ENV_RELEASE)
+		{
+			envelope_enter(synth, voice, ENV_RELEASE);
+		}
+	}
+
+	// Quickly fade out a voice that has been cut off by another note.
+	void voice_cut(const MidiSynth* synth, SynthVoice* voice)
+	{
+		voice_release(synth, voice);
+		voice->envFactor = std::min(voice->envFactor, envelope_getFactor(c_fastRelease, synth->sampleRate));
+	}
+
+	void voice_free(MidiSynth* synth, u32 index)
+	{
+		synth->activeCount--;
+		synth->voices[index] = synth->voices[synth->activeCount];
+	}
+
+	SynthVoice* voice_allocate(MidiSynth* synth)
+	{
+		if (synth->activeCount < synth->maxVoices)
+		{
+			return &synth->voices[synth->activeCount++];
+		}
+
+		// Steal the quietest voice, preferring released notes, and the oldest voice when they are equally quiet.
+		u32 best = 0;
+		f32 bestLevel = FLT_MAX;
+		for (u32 v = 0; v < synth->activeCount; v++)
+		{
+			const SynthVoice* voice = &synth->voices[v];
+			const f32 level = voice->env * voice->noteGain * (voice->released ? 0.1f : 1.0f);
+			if (level < bestLevel || (level == bestLevel && s32(voice->noteId - synth->voices[best].noteId) < 0))
+			{
+				best = v;
+				bestLevel = level;
+			}
+		}
+		synth->stolenCount++;
+		return &synth->voices[best];
+	}
+
+	void voice_start(MidiSynth* synth, SynthVoice* voice, const SynthRegion* region, u8 channel, u8 key, u8 velocity)
+	{
+		const f32 velocityScale = f32(velocity) / 127.0f;
+		const s32 playKey = region->keynum >= 0 ? region->keynum : key;
+
+		voice->region = region;
+		voice->noteId = synth->noteId++;
+		voice->channel = channel;
+		voice->key = key;
+		voice->released = false;
+		voice->held = false;
+		voice->pos = u64(region->start) << 32;
+		voice->pitch = f32(playKey - region->rootKey) * region->scaleTuning + region->tune;
+		voice->noteGain = region->gain * velocityScale * velocityScale;
+		voice->gainL = -1.0f;
+		voice->gainR = -1.0f;
+		envelope_enter(synth, voice, ENV_DELAY);
+		voice_updatePitch(synth, voice);
+	}
+
+	// Interpolate the voice samples into 'output', returns the number of frames written which is less than
+	// 'frameCount' if the sample ends.
+	u32 voice_readSamples(SynthVoice* voice, f32* output, u32 frameCount)
+	{
+		const SynthRegion* region = voice->region;
+		const f32* samples = s_soundFont->samples.data();
+		const bool looping = region->loopMode == LOOP_CONTINUOUS || (region->loopMode == LOOP_UNTIL_RELEASE && !voice->released);
+		const u64 loopEnd = u64(region->loopEnd) << 32;
+		const u64 loopLength = u64(region->loopEnd - region->loopStart) << 32;
+		const u64 end = u64(region->end) << 32;
+		const u64 step = voice->step;
+
+		u64 pos = voice->pos;
+		u32 i = 0;
+		for (; i < frameCount; i++, pos += step)
+		{
+			u32 next;
+			if (looping)
+			{
+				while (pos >= loopEnd) { pos -= loopLength; }
+				next = u32(pos >> 32) + 1;
+				if (next >= region->loopEnd) { next = region->loopStart; }
+			}
+			else
+			{
+				if (pos >= end) { break; }
+				next = u32(pos >> 32) + 1;
+			}
+			const u32 index = u32(pos >> 32);
+			const f32 frac = f32(u32(pos)) * (1.0f / 4294967296.0f);
+			output[i] = samples[index] + (samples[next] - samples[index]) * frac;
+		}
+		voice->pos = pos;
+		return i;
+	}
+
+	// Add mono samples to the interleaved stereo output, ramping the gains across the span.
+	void accumulate(f32* output, const f32* input, u32 count, f32 gainL, f32 gainR, f32 stepL, f32 stepR)
+	{
+		u32 i = 0;
+	#if defined(SYNTH_SSE)
+		__m128 gainLo = _mm_setr_ps(gainL, gainR, gainL + stepL, gainR + stepR);
+		__m128 gainHi = _mm_add_ps(gainLo, _mm_setr_ps(2.0f * stepL, 2.0f * stepR, 2.0f * stepL, 2.0f * stepR));
+		const __m128 step = _mm_setr_ps(4.0f * stepL, 4.0f * stepR, 4.0f * stepL, 4.0f * stepR);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 samples = _mm_loadu_ps(input + i);
+			f32* out = output + i * 2;
+			_mm_storeu_ps(out,     _mm_add_ps(_mm_loadu_ps(out),     _mm_mul_ps(_mm_unpacklo_ps(samples, samples), gainLo)));
+			_mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(_mm_unpackhi_ps(samples, samples), gainHi)));
+			gainLo = _mm_add_ps(gainLo, step);
+			gainHi = _mm_add_ps(gainHi, step);
+		}
+		gainL += stepL * f32(i);
+		gainR += stepR * f32(i);
+	#endif
+		for (; i < count; i++)
+		{
+			output[i * 2 + 0] += input[i] * gainL;
+			output[i * 2 + 1] += input[i] * gainR;
+			gainL += stepL;
+			gainR += stepR;
+		}
+	}
+
+	// Render one block of the voice, returns false once the voice has finished.
+	bool voice_render(MidiSynth* synth, SynthVoice* voice, f32* output, u32 frameCount)
+	{
+		const SynthChannel* channel = &synth->channels[voice->channel];
+		const f32 envStart = voice->env;
+		envelope_advance(synth, voice, frameCount);
+		const f32 envEnd = voice->env;
+
+		// Channel volume and expression follow the usual squared Midi curve, the pan is equal power.
+		const f32 volume = f32(channel->volume) / 127.0f;
+		const f32 expression = f32(channel->expression) / 127.0f;
+		const f32 gain = voice->noteGain * volume * volume * expression * expression;
+		const f32 pan = std::max(-0.5f, std::min(voice->region->pan + (f32(channel->pan) - 64.0f) / 128.0f, 0.5f));
+		const f32 targetL = gain * cosf((pan + 0.5f) * c_halfPi);
+		const f32 targetR = gain * sinf((pan + 0.5f) * c_halfPi);
+		if (voice->gainL < 0.0f)
+		{
+			voice->gainL = targetL;
+			voice->gainR = targetR;
+		}
+
+		const f32 startL = voice->gainL * envStart, startR = voice->gainR * envStart;
+		const f32 endL = targetL * envEnd, endR = targetR * envEnd;
+		const f32 scale = 1.0f / f32(frameCount);
+		const u32 count = voice_readSamples(voice, synth->scratch, frameCount);
+		accumulate(output, synth->scratch, count, startL, startR, (endL - startL) * scale, (endR - startR) * scale);
+
+		voice->gainL = targetL;
+		voice->gainR = targetR;
+		return count == frameCount && voice->segment != ENV_DONE;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Channel messages
+	//////////////////////////////////////////////////////////////////////
+	void noteOff(MidiSynth* synth, u8 channel, u8 key)
+	{
+		const bool sustain = synth->channels[channel].sustain;
+		for (u32 v = 0; v < synth->activeCount; v++)
+		{
+			SynthVoice* voice = &synth->voices[v];
+			if (voice->channel != channel || voice->key != key || voice->released || voice->held) { continue; }
+
+			if (sustain) { voice->held = true; }
+			else { voice_release(synth, voice); }
+		}
+	}
+
+	void noteOn(MidiSynth* synth, u8 channel, u8 key, u8 velocity)
+	{
+		if (!velocity)
+		{
+			noteOff(synth, channel, key);
+			return;
+		}
+
+		const SynthPreset* preset = synth->channels[channel].preset;
+		if (!preset) { return; }
+
+		const SynthRegion* region = &s_soundFont->regions[preset->firstRegion];
+		for (u32 r = 0; r < preset->regionCount; r++, region++)
+		{
+			if (key < region->loKey || key > region->hiKey || velocity < region->loVel || velocity > region->hiVel) { continue; }
+
+			// Notes in the same exclusive class cut each other off, such as open and closed hi-hats.
+			if (region->exclusiveClass)
+			{
+				for (u32 v = 0; v < synth->activeCount; v++)
+				{
+					SynthVoice* voice = &synth->voices[v];
+					if (voice->channel == channel && voice->region->exclusiveClass == region->exclusiveClass)
+					{
+						voice_cut(synth, voice);
+					}
+				}
+			}
+			voice_start(synth, voice_allocate(synth), region, channel, key, velocity);
+		}
+	}
+
+	void resetControllers(SynthChannel* channel)
+	{
+		channel->expression = 127;
+		channel->sustain = false;
+		channel->bend = 0.0f;
+		channel->rpnLsb = 127;
+		channel->rpnMsb = 127;
+	}
+
+	void controlChange(MidiSynth* synth, u8 channelIndex, u8 controller, u8 value)
+	{
+		SynthChannel* channel = &synth->channels[channelIndex];
+		switch (controller)
+		{
+			case MID_BANK_SELECT_MSB:
+				// Applied on the next program change.
+				channel->bank = value;
+				break;
+			case MID_VOLUME_MSB:
+				channel->volume = value;
+				break;
+			case MID_PAN_MSB:
+				channel->pan = value;
+				break;
+			case MID_EXPRESSION_MSB:
+				channel->expression = value;
+				break;
+			case MID_SUSTAIN_SWITCH:
+				channel->sustain = value >= 64;
+				if (!channel->sustain)
+				{
+					for (u32 v = 0; v < synth->activeCount; v++)
+					{
+						SynthVoice* voice = &synth->voices[v];
+						if (voice->channel == channelIndex && voice->held) { voice_release(synth, voice); }
+					}
+				}
+				break;
+			case MID_RPN_LSB:
+				channel->rpnLsb = value;
+				break;
+			case MID_RPN_MSB:
+				channel->rpnMsb = value;
+				break;
+			case MID_DATA_ENTRY_MSB:
+				// RPN 0: pitch bend range in semitones.
+				if (channel->rpnMsb == 0 && channel->rpnLsb == 0)
+				{
+					channel->bendRange = f32(value);
+				}
+				break;
+			case MID_ALL_SOUND_OFF:
+				for (u32 v = 0; v < synth->activeCount;)
+				{
+					if (synth->voices[v].channel == channelIndex) { voice_free(synth, v); }
+					else { v++; }
+				}
+				break;
+			case MID_ALL_CTRL_OFF:
+				resetControllers(channel);
+				break;
+			case MID_ALL_NOTES_OFF:
+				for (u32 v = 0; v < synth->activeCount; v++)
+				{
+					SynthVoice* voice = &synth->voices[v];
+					if (voice->channel == channelIndex && !voice->released) { voice_release(synth, voice); }
+				}
+				break;
+		}
+	}
+
+	void programChange(MidiSynth* synth, u8 channelIndex, u8 program)
+	{
+		SynthChannel* channel = &synth->channels[channelIndex];
+		const u32 bank = channelIndex == SYNTH_PERCUSSION_CHANNEL ? SYNTH_PERCUSSION_BANK : channel->bank;
+		channel->program = program;
+		channel->preset = findPreset(bank, program);
+	}
+
+	void pitchBend(MidiSynth* synth, u8 channelIndex, u8 lsb, u8 msb)
+	{
+		SynthChannel* channel = &synth->channels[channelIndex];
+		channel->bend = f32(s32((msb << 7) | lsb) - 8192) / 8192.0f * channel->bendRange;
+		for (u32 v = 0; v < synth->activeCount; v++)
+		{
+			if (synth->voices[v].channel == channelIndex) { voice_updatePitch(synth, &synth->voices[v]); }
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// API
+	//////////////////////////////////////////////////////////////////////
+	MidiSynth* createSynth(u32 sampleRate, u32 maxVoices)
+	{
+		if (!s_soundFont || !sampleRate) { return nullptr; }
+
+		MidiSynth* synth = new MidiSynth();
+		synth->sampleRate = sampleRate;
+		synth->maxVoices = std::max(1u, std::min(maxVoices, u32(SYNTH_MAX_VOICES)));
+		synth->voices.resize(synth->maxVoices);
+		synth->stolenCount = 0;
+		synth->noteId = 0;
+		reset(synth);
+		return synth;
+	}
+
+	void destroySynth(MidiSynth* synth)
+	{
+		delete synth;
+	}
+
+	void reset(MidiSynth* synth)
+	{
+		synth->activeCount = 0;
+		for (u32 c = 0; c < SYNTH_CHANNEL_COUNT; c++)
+		{
+			SynthChannel* channel = &synth->channels[c];
+			channel->bank = 0;
+			channel->volume = 100;
+			channel->pan = 64;
+			channel->bendRange = 2.0f;
+			resetControllers(channel);
+			programChange(synth, u8(c), 0);
+		}
+	}
+
+	void sendMessage(MidiSynth* synth, u8 arg0, u8 arg1, u8 arg2)
+	{
+		const u8 channel = arg0 & 0x0f;
+		arg1 &= 0x7f;
+		arg2 &= 0x7f;
+		switch (arg0 & 0xf0)
+		{
+			case MID_NOTE_OFF:
+				noteOff(synth, channel, arg1);
+				break;
+			case MID_NOTE_ON:
+				noteOn(synth, channel, arg1, arg2);
+				break;
+			case MID_CONTROL_CHANGE:
+				controlChange(synth, channel, arg1, arg2);
+				break;
+			case MID_PROGRAM_CHANGE:
+				programChange(synth, channel, arg1);
+				break;
+			case MID_PITCH_BEND:
+				pitchBend(synth, channel, arg1, arg2);
+				break;
+		}
+	}
+
+	void render(MidiSynth* synth, f32* output, u32 frameCount)
+	{
+		for (u32 v = 0; v < synth->activeCount;)
+		{
+			SynthVoice* voice = &synth->voices[v];
+			bool playing = true;
+			for (u32 blockStart = 0; blockStart < frameCount && playing; blockStart += SYNTH_BLOCK_SIZE)
+			{
+				const u32 blockCount = std::min(frameCount - blockStart, u32(SYNTH_BLOCK_SIZE));
+				playing = voice_render(synth, voice, output + blockStart * 2, blockCount);
+			}
+
+			// Finished voices are replaced by the last active voice, which is rendered next.
+			if (playing) { v++; }
+			else { voice_free(synth, v); }
+		}
+	}
+
+	u32 getActiveVoiceCount(const MidiSynth* synth)
+	{
+		return synth->activeCount;
+	}
+
+	u32 getStolenVoiceCount(const MidiSynth* synth)
+	{
+		return synth->stolenCount;
+	}
+}
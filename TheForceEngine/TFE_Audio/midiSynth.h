@@ -0,0 +1,36 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// The Force Engine SoundFont Synthesizer
+// A small wavetable synthesizer that plays Midi messages using the
+// samples and instruments from a SoundFont 2 (SF2) file.
+//
+// The caller drives the synthesizer directly - messages are applied
+// immediately and audio is rendered on demand - so events land on the
+// exact sample they are sent at. It runs from the audio thread during
+// gameplay or offline for benchmarking and regression tests.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+struct MidiSynth;
+
+namespace TFE_MidiSynth
+{
+	// The SoundFont is shared by all synthesizers and is read-only once loaded.
+	// It must not be freed while any synthesizer still exists.
+	bool loadSoundFont(const char* path);
+	void freeSoundFont();
+	bool isSoundFontLoaded();
+
+	// Polyphony is limited to 'maxVoices' which bounds the CPU cost, voices are stolen once the limit is reached.
+	MidiSynth* createSynth(u32 sampleRate, u32 maxVoices);
+	void destroySynth(MidiSynth* synth);
+	// Stop all voices immediately and reset the channel state.
+	void reset(MidiSynth* synth);
+
+	void sendMessage(MidiSynth* synth, u8 arg0, u8 arg1, u8 arg2 = 0);
+	// Render and add 'frameCount' interleaved stereo frames to the output.
+	void render(MidiSynth* synth, f32* output, u32 frameCount);
+
+	u32 getActiveVoiceCount(const MidiSynth* synth);
+	u32 getStolenVoiceCount(const MidiSynth* synth);
+};
@@ -0,0 +1,82 @@
+#include "wavWriter.h"
+#include <TFE_System/system.h>
+#include <TFE_FileSystem/filestream.h>
+
+struct WavWriter
+{
+	FileStream file;
+	u32 sampleRate;
+	u32 channels;
+	u32 dataSize;
+};
+
+namespace TFE_WAV
+{
+	enum WavConstants
+	{
+		WAV_FORMAT_FLOAT = 3,
+		WAV_HEADER_SIZE = 44,
+	};
+
+	void writeHeader(WavWriter* wav)
+	{
+		const u32 sampleRate = wav->sampleRate;
+		const u32 riffSize = WAV_HEADER_SIZE - 8 + wav->dataSize;
+		const u32 fmtSize = 16;
+		const u16 format = WAV_FORMAT_FLOAT;
+		const u16 channels = u16(wav->channels);
+		const u16 blockAlign = u16(wav->channels * sizeof(f32));
+		const u16 bitsPerSample = 32;
+		const u32 bytesPerSecond = sampleRate * blockAlign;
+
+		FileStream* file = &wav->file;
+		file->writeBuffer("RIFF", 4);
+		file->write(&riffSize);
+		file->writeBuffer("WAVEfmt ", 8);
+		file->write(&fmtSize);
+		file->write(&format);
+		file->write(&channels);
+		file->write(&sampleRate);
+		file->write(&bytesPerSecond);
+		file->write(&blockAlign);
+		file->write(&bitsPerSample);
+		file->writeBuffer("data", 4);
+		file->write(&wav->dataSize);
+	}
+
+	WavWriter* startWav(const char* path, u32 sampleRate, u32 channels)
+	{
+		WavWriter* wav = new WavWriter();
+		if (!wav->file.open(path, FileStream::MODE_WRITE))
+		{
+			TFE_System::logWrite(LOG_ERROR, "WavWriter", "Cannot open \"%s\" for writing.", path);
+			delete wav;
+			return nullptr;
+		}
+		wav->sampleRate = sampleRate;
+		wav->channels = channels;
+		wav->dataSize = 0;
+		// The sizes are written again once they are known.
+		writeHeader(wav);
+		return wav;
+	}
+
+	void writeFrames(WavWriter* wav, const f32* samples, u32 frameCount)
+	{
+		const u32 size = frameCount * wav->channels * sizeof(f32);
+		wav->file.writeBuffer(samples, size);
+		wav->dataSize += size;
+	}
+
+	bool endWav(WavWriter* wav)
+	{
+		if (!wav) { return false; }
+
+		wav->file.seek(0);
+		writeHeader(wav);
+		wav->file.close();
+
+		delete wav;
+		return true;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// The Force Engine WAV Writer
+// Streams interleaved 32-bit float audio to a WAV file, the header
+// sizes are filled in when the file is finished.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+struct WavWriter;
+
+namespace TFE_WAV
+{
+	WavWriter* startWav(const char* path, u32 sampleRate, u32 channels);
+	void writeFrames(WavWriter* wav, const f32* samples, u32 frameCount);
+	bool endWav(WavWriter* wav);
+}
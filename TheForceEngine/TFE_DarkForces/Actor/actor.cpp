@@ -12,10 +12,14 @@
 #include <TFE_DarkForces/player.h>
 #include <TFE_Jedi/Level/rsector.h>
 #include <TFE_Jedi/Level/rwall.h>
+#include <TFE_Jedi/Level/level.h>
 #include <TFE_Jedi/InfSystem/message.h>
 #include <TFE_Jedi/Sound/soundSystem.h>
 #include <TFE_Jedi/Memory/list.h>
 #include <TFE_Jedi/Memory/allocator.h>
+#include <TFE_FrontEndUI/console.h>
+#include <TFE_System/profiler.h>
+#include <vector>
 
 using namespace TFE_Jedi;
 
@@ -37,6 +41,22 @@ namespace TFE_DarkForces
 	static ActorInternalState s_istate = { 0 };
 	static List* s_physicsActors = nullptr;
 
+	// TFE: AI update LOD, disabled by default since it changes how distant enemies behave.
+	// Awake actors that are far from the player or in sectors that are not connected to the player's sector
+	// are updated every few ticks instead of every frame.
+	static bool s_aiLod = false;
+	static s32  s_aiLodDistance = 300;		// Beyond the maximum sight distance of 256 units.
+	static s32  s_aiLodAdjoinDepth = 4;
+	static s32  s_aiLodInterval = 16;		// Ticks between updates when throttled.
+	static std::vector<u32> s_aiLodSectorStamp;
+	static std::vector<RSector*> s_aiLodSectorQueue;
+	static u32  s_aiLodStamp = 0;
+	static RSector* s_aiLodPlayerSector = nullptr;
+	// Statistics for the last update.
+	static s32  s_aiActiveCount = 0;
+	static s32  s_aiThrottledCount = 0;
+	static s32  s_aiSleepingCount = 0;
+
 	///////////////////////////////////////////
 	// Shared State
 	///////////////////////////////////////////
@@ -64,6 +84,124 @@ namespace TFE_DarkForces
 		memset(&s_actorState, 0, sizeof(ActorState));
 		s_istate.objCollisionEnabled = JTRUE;
 		list_clear(s_physicsActors);
+		s_aiLodPlayerSector = nullptr;
+	}
+
+	void console_aiStats(const ConsoleArgList& args)
+	{
+		char res[256];
+		sprintf(res, "AI actors: %d active, %d throttled, %d asleep. LOD is %s.", s_aiActiveCount, s_aiThrottledCount, s_aiSleepingCount, s_aiLod ? "enabled" : "disabled");
+		TFE_Console::addToHistory(res);
+	}
+
+	void actor_initLod()
+	{
+		CVAR_BOOL(s_aiLod, "d_aiLod", CVFLAG_DO_NOT_SERIALIZE, "Update distant AI actors at a lower rate, this changes how the game plays.");
+		CVAR_INT(s_aiLodDistance, "d_aiLodDistance", CVFLAG_DO_NOT_SERIALIZE, "Distance from the player, in units, where AI actors are updated at a lower rate.");
+		CVAR_INT(s_aiLodAdjoinDepth, "d_aiLodAdjoinDepth", CVFLAG_DO_NOT_SERIALIZE, "AI actors more than this many adjoins away from the player's sector are updated at a lower rate.");
+		CVAR_INT(s_aiLodInterval, "d_aiLodInterval", CVFLAG_DO_NOT_SERIALIZE, "Ticks between updates of AI actors using the lower rate (145 ticks per second).");
+		CCMD("aiStats", console_aiStats, 0, "Show how many AI actors are active, throttled by the AI LOD or asleep.");
+		TFE_COUNTER(s_aiActiveCount, "AI Active Actors");
+		TFE_COUNTER(s_aiThrottledCount, "AI Throttled Actors");
+	}
+
+	void actor_getLodSettings(ActorLodSettings* settings)
+	{
+		settings->enabled = s_aiLod ? 1 : 0;
+		settings->distance = s_aiLodDistance;
+		settings->adjoinDepth = s_aiLodAdjoinDepth;
+		settings->interval = s_aiLodInterval;
+	}
+
+	void actor_setLodSettings(const ActorLodSettings* settings)
+	{
+		s_aiLod = settings->enabled != 0;
+		s_aiLodDistance = settings->distance;
+		s_aiLodAdjoinDepth = settings->adjoinDepth;
+		s_aiLodInterval = settings->interval;
+		// The connected sectors depend on the adjoin depth.
+		s_aiLodPlayerSector = nullptr;
+	}
+
+	// Mark the sectors within d_aiLodAdjoinDepth adjoins of the player's sector, only when the player changes sectors.
+	static void actorLod_updateConnectedSectors()
+	{
+		RSector* playerSector = s_playerObject ? s_playerObject->sector : nullptr;
+		if (s_aiLodSectorStamp.size() != s_sectorCount)
+		{
+			s_aiLodSectorStamp.assign(s_sectorCount, 0);
+			s_aiLodPlayerSector = nullptr;
+		}
+		if (!playerSector || playerSector == s_aiLodPlayerSector) { return; }
+		s_aiLodPlayerSector = playerSector;
+		s_aiLodStamp++;
+
+		s_aiLodSectorQueue.clear();
+		s_aiLodSectorQueue.push_back(playerSector);
+		s_aiLodSectorStamp[playerSector->index] = s_aiLodStamp;
+		size_t begin = 0;
+		for (s32 depth = 0; depth < s_aiLodAdjoinDepth; depth++)
+		{
+			const size_t end = s_aiLodSectorQueue.size();
+			for (size_t i = begin; i < end; i++)
+			{
+				RSector* sector = s_aiLodSectorQueue[i];
+				RWall* wall = sector->walls;
+				for (s32 w = 0; w < sector->wallCount; w++, wall++)
+				{
+					RSector* next = wall->nextSector;
+					if (next && s_aiLodSectorStamp[next->index] != s_aiLodStamp)
+					{
+						s_aiLodSectorStamp[next->index] = s_aiLodStamp;
+						s_aiLodSectorQueue.push_back(next);
+					}
+				}
+			}
+			begin = end;
+		}
+	}
+
+	static JBool actorLod_isNear(SecObject* obj)
+	{
+		if (!s_aiLodPlayerSector || !obj->sector) { return JTRUE; }
+		if (s_aiLodSectorStamp[obj->sector->index] != s_aiLodStamp) { return JFALSE; }
+		const fixed16_16 dist = distApprox(obj->posWS.x, obj->posWS.z, s_playerObject->posWS.x, s_playerObject->posWS.z);
+		return dist <= intToFixed16(s_aiLodDistance) ? JTRUE : JFALSE;
+	}
+
+	// Returns JFALSE if the actor skips this frame. Otherwise s_deltaTime is set to cover the frames it skipped,
+	// the caller restores it afterward.
+	static JBool actorLod_update(ActorLogic* logic)
+	{
+		if (!s_aiLod)
+		{
+			s_aiActiveCount++;
+			return JTRUE;
+		}
+
+		const JBool fullRate = (logic->lodWakeTick > s_curTick || actorLod_isNear(logic->logic.obj)) ? JTRUE : JFALSE;
+		const Tick interval = Tick(clamp(s_aiLodInterval, 1, TICKS_PER_SECOND));
+		if (fullRate)
+		{
+			s_aiActiveCount++;
+		}
+		else
+		{
+			s_aiThrottledCount++;
+			if (logic->lodPrevTick && s_curTick < logic->lodPrevTick + interval)
+			{
+				logic->lodSkipCount++;
+				return JFALSE;
+			}
+		}
+
+		if (logic->lodSkipCount && s_curTick > logic->lodPrevTick)
+		{
+			s_deltaTime = min(div16(intToFixed16(s_curTick - logic->lodPrevTick), FIXED(TICKS_PER_SECOND)), MAX_DELTA_TIME);
+		}
+		logic->lodPrevTick = s_curTick;
+		logic->lodSkipCount = 0;
+		return JTRUE;
 	}
 
 	void actor_loadSounds()
@@ -137,7 +275,7 @@ namespace TFE_DarkForces
 		
 	void actor_createTask()
 	{
-		s_istate.actorLogics = allocator_create(sizeof(ActorLogic));
+		s_istate.actorLogics = allocator_createSlab(sizeof(ActorLogic), 64, "Actor Logic");
 		s_istate.actorTask = createSubTask("actor", actorLogicTaskFunc, actorLogicMsgFunc);
 		s_istate.actorPhysicsTask = createSubTask("physics", actorPhysicsTaskFunc);
 	}
@@ -157,6 +295,9 @@ namespace TFE_DarkForces
 		logic->vel = { 0, 0, 0 };
 		logic->freeTask = nullptr;
 		logic->flags = 4;
+		logic->lodPrevTick = 0;
+		logic->lodWakeTick = 0;
+		logic->lodSkipCount = 0;
 
 		obj_addLogic(obj, (Logic*)logic, s_istate.actorTask, actorLogicCleanupFunc);
 		if (setupFunc)
@@ -1826,6 +1967,11 @@ namespace TFE_DarkForces
 		ActorLogic* actorLogic = (ActorLogic*)logic;
 		s_actorState.curLogic = (Logic*)logic;
 		SecObject* obj = s_actorState.curLogic->obj;
+		// TFE: AI update LOD, run at the full rate for a while after being woken up or hurt.
+		if (msg == MSG_WAKEUP || msg == MSG_DAMAGE || msg == MSG_EXPLOSION)
+		{
+			actorLogic->lodWakeTick = s_curTick + TICKS(5);
+		}
 		for (s32 i = 0; i < ACTOR_MAX_AI; i++)
 		{
 			AiActor* aiActor = actorLogic->aiActors[ACTOR_MAX_AI - 1 - i];
@@ -1992,6 +2138,15 @@ namespace TFE_DarkForces
 
 			if (msg == MSG_RUN_TASK)
 			{
+				const fixed16_16 frameDeltaTime = s_deltaTime;
+				s_aiActiveCount = 0;
+				s_aiThrottledCount = 0;
+				s_aiSleepingCount = 0;
+				if (s_aiLod)
+				{
+					actorLod_updateConnectedSectors();
+				}
+
 				ActorLogic* actorLogic = (ActorLogic*)allocator_getHead(s_istate.actorLogics);
 				while (actorLogic)
 				{
@@ -1999,6 +2154,7 @@ namespace TFE_DarkForces
 					u32 flags = actorLogic->flags;
 					if ((flags & 1) && (flags & 4))
 					{
+						s_aiSleepingCount++;
 						if (actorLogic->nextTick < s_curTick)
 						{
 							actorLogic->nextTick = s_curTick + actorLogic->delay;
@@ -2010,7 +2166,7 @@ namespace TFE_DarkForces
 							}
 						}
 					}
-					else
+					else if (actorLod_update(actorLogic))
 					{
 						s_actorState.curLogic = (Logic*)actorLogic;
 						s_actorState.curAnimation = nullptr;
@@ -2050,6 +2206,7 @@ namespace TFE_DarkForces
 								}
 							}
 						}
+						s_deltaTime = frameDeltaTime;
 					}
 
 					actorLogic = (ActorLogic*)allocator_getNext(s_istate.actorLogics);
@@ -95,6 +95,10 @@ struct ActorLogic
 
 	// Added for TFE, for debugging.
 	SubActorType type[ACTOR_MAX_AI];
+	// Added for TFE, AI update LOD (see actor_initLod()).
+	Tick lodPrevTick;	// Tick of the last update.
+	Tick lodWakeTick;	// Updated at the full rate until this tick, after being woken up or hurt.
+	u32  lodSkipCount;	// Frames skipped since the last update.
 };
 
 struct ActorState
@@ -107,6 +111,15 @@ struct ActorState
 	u32 stormtrooperAlertIndex;
 };
 
+// TFE: AI update LOD settings, these change the simulation so demos store them.
+struct ActorLodSettings
+{
+	s32 enabled;
+	s32 distance;
+	s32 adjoinDepth;
+	s32 interval;
+};
+
 namespace TFE_DarkForces
 {
 	void actor_clearState();
@@ -116,6 +129,10 @@ namespace TFE_DarkForces
 	void actor_addPhysicsActorToWorld(PhysicsActor* actor);
 	void actor_removePhysicsActorFromWorld(PhysicsActor* phyActor);
 	void actor_createTask();
+	// TFE: Register the AI update LOD settings and statistics, it is disabled by default.
+	void actor_initLod();
+	void actor_getLodSettings(ActorLodSettings* settings);
+	void actor_setLodSettings(const ActorLodSettings* settings);
 
 	ActorLogic* actor_setupActorLogic(SecObject* obj, LogicSetupFunc* setupFunc);
 	AiActor* actor_createAiActor(Logic* logic);
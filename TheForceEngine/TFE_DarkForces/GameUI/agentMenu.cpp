@@ -112,6 +112,11 @@ namespace TFE_DarkForces
 		delt_resetState();
 	}
 
+	void agentMenu_leave()
+	{
+		s_displayInit = JFALSE;
+	}
+
 	JBool agentMenu_update(s32* levelIndex)
 	{
 		if (!s_loaded)
@@ -12,6 +12,10 @@ namespace TFE_DarkForces
 	// levelIndex will hold the selected level index (1 - 14).
 	JBool agentMenu_update(s32* levelIndex);
 
+	// TFE: Leave the menu without selecting a mission, such as when playing a demo.
+	// The display is setup again the next time the menu is updated.
+	void agentMenu_leave();
+
 	// Reset Presistent State.
 	void agentMenu_resetState();
 }
@@ -303,20 +303,30 @@ namespace TFE_DarkForces
 	}
 
 	void agent_readSavedDataForLevel(s32 agentId, s32 levelIndex)
+	{
+		u8 inv[32];
+		s32 ammo[10];
+		if (agent_readSavedInventory(agentId, levelIndex, inv, ammo))
+		{
+			player_readInfo(inv, ammo);
+		}
+	}
+
+	JBool agent_readSavedInventory(s32 agentId, s32 levelIndex, u8* inv, s32* ammo)
 	{
 		FileStream file;
 		if (!openDarkPilotConfig(&file))
 		{
 			TFE_System::logWrite(LOG_ERROR, "Agent", "Cannot open DarkPilo.cfg");
-			return;
+			return JFALSE;
 		}
 		LevelSaveData levelData;
 		agent_readConfigData(&file, agentId, &levelData);
 		file.close();
 
-		s32* ammo = &levelData.ammo[(levelIndex - 1) * 10];
-		u8* inv = &levelData.inv[(levelIndex - 1) * 32];
-		player_readInfo(inv, ammo);
+		memcpy(ammo, &levelData.ammo[(levelIndex - 1) * 10], sizeof(s32) * 10);
+		memcpy(inv, &levelData.inv[(levelIndex - 1) * 32], 32);
+		return JTRUE;
 	}
 
 	// Creates a new Dark Pilot config file, which is used for saving.
@@ -48,6 +48,8 @@ namespace TFE_DarkForces
 	JBool agent_readConfigData(FileStream* file, s32 agentId, LevelSaveData* saveData);
 	JBool agent_writeAgentConfigData(FileStream* file, s32 agentId, const LevelSaveData* saveData);
 	void  agent_readSavedDataForLevel(s32 agentId, s32 levelIndex);
+	// Read the saved inventory (32 items) and ammo (10 values) the agent starts the level with.
+	JBool agent_readSavedInventory(s32 agentId, s32 levelIndex, u8* inv, s32* ammo);
 	void  agent_saveLevelCompletion(u8 diff, s32 levelIndex);
 	s32   agent_saveInventory(s32 agentId, s32 nextLevel);
 	void  agent_createNewAgent(s32 agentId, AgentData* data);
@@ -109,7 +109,7 @@ namespace TFE_DarkForces
 		}
 		if (!s_spriteAnimList)
 		{
-			s_spriteAnimList = allocator_create(sizeof(SpriteAnimLogic));
+			s_spriteAnimList = allocator_createSlab(sizeof(SpriteAnimLogic), 32, "Sprite Anim Logic");
 		}
 
 		SpriteAnimLogic* anim = (SpriteAnimLogic*)allocator_newItem(s_spriteAnimList);
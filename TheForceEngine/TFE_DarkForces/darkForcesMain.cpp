@@ -10,6 +10,7 @@
 #include "mission.h"
 #include "player.h"
 #include "projectile.h"
+#include "random.h"
 #include "time.h"
 #include "weapon.h"
 #include "vueLogic.h"
@@ -17,7 +18,11 @@
 #include "GameUI/escapeMenu.h"
 #include <TFE_DarkForces/Actor/actor.h>
 #include <TFE_Memory/memoryRegion.h>
+#include <TFE_Game/snapshot.h>
+#include <TFE_Input/replay.h>
+#include <TFE_FrontEndUI/console.h>
 #include <TFE_System/system.h>
+#include <TFE_RenderBackend/renderBackend.h>
 #include <TFE_FileSystem/paths.h>
 #include <TFE_FileSystem/filestream.h>
 #include <TFE_Audio/midiPlayer.h>
@@ -105,6 +110,7 @@ namespace TFE_DarkForces
 	static JBool s_useJediPath = JFALSE;
 	static JBool s_hudModeStd = JTRUE;
 	static const char* s_launchLevelName = nullptr;
+	static s32 s_launchLevelIndex = 0;
 	static GameMessages s_localMessages;
 	static GameMessages s_hotKeyMessages;
 	static TextureData* s_diskErrorImg = nullptr;
@@ -124,6 +130,51 @@ namespace TFE_DarkForces
 	static s32 s_levelIndex;
 	static s32 s_cutsceneIndex;
 	static JBool s_abortLevel;
+
+	// TFE: In-memory snapshots.
+	static f32 s_snapshotInterval = 0.0f;	// Seconds between automatic snapshots, 0 = disabled.
+	static f64 s_lastSnapshotTime = 0.0;
+
+	// TFE: Checks that a moving elevator finishes its move after a snapshot is restored, see console_snapshotTest().
+	enum SnapshotTest
+	{
+		SNAPSHOT_TEST_NONE = 0,
+		SNAPSHOT_TEST_WAIT_STOP,	// Wait for the elevator to reach its next stop, then restore the snapshot.
+		SNAPSHOT_TEST_WAIT_FINISH,	// Wait for the elevator to reach the same stop again.
+	};
+	static const f64 c_snapshotTestTimeout = 30.0;
+	static SnapshotTest s_snapshotTest = SNAPSHOT_TEST_NONE;
+	static InfElevator* s_snapshotTestElev = nullptr;
+	static Stop* s_snapshotTestStop = nullptr;
+	static f64 s_snapshotTestStart = 0.0;
+
+	// TFE: Demo recording and playback, see TFE_Input/replay.h
+	enum DemoMode
+	{
+		DEMO_NONE = 0,
+		DEMO_RECORD,
+		DEMO_PLAY,
+	};
+
+	// Everything needed to start the level in the same state as the recording.
+	struct DemoStart
+	{
+		s32 levelIndex;
+		u32 randomSeed;
+		u8  difficulty;
+		u8  inv[32];
+		s32 ammo[10];
+		PlayerInfo playerInfo;
+		TimeState time;
+		ActorLodSettings aiLod;
+	};
+
+	static DemoMode s_demoPending = DEMO_NONE;	// Recording or playback begins with the next level.
+	static DemoStart s_demoStart;
+	static char s_demoPath[TFE_MAX_PATH];
+	static JBool s_demoQuitOnEnd = JFALSE;
+	static JBool s_demoPlaying = JFALSE;
+	static ActorLodSettings s_demoSavedLod;		// The AI LOD settings to restore after playback.
 		
 	/////////////////////////////////////////////
 	// Forward Declarations
@@ -144,6 +195,14 @@ namespace TFE_DarkForces
 	void pauseLevelSound();
 	void resumeLevelSound();
 	void startLevelMusic(s32 levelIndex);
+	void snapshot_init();
+	void snapshot_update();
+	void demo_init();
+	void demo_update();
+	JBool demo_playPending(s32* levelIndex);
+	void demo_startLevel(s32 levelIndex);
+	void launchLevel_init();
+	JBool launchLevel_pending(s32* levelIndex);
 
 	/////////////////////////////////////////////
 	// API
@@ -171,6 +230,10 @@ namespace TFE_DarkForces
 
 		// TFE Specific
 		actorDebug_init();
+		actor_initLod();
+		snapshot_init();
+		demo_init();
+		launchLevel_init();
 
 		return true;
 	}
@@ -209,6 +272,18 @@ namespace TFE_DarkForces
 		vue_resetState();
 		// Free debug data
 		actorDebug_free();
+		TFE_Snapshot::shutdown();
+		TFE_Input::replay_stop();
+		if (s_demoPlaying)
+		{
+			actor_setLodSettings(&s_demoSavedLod);
+		}
+		s_demoPending = DEMO_NONE;
+		s_demoPlaying = JFALSE;
+		s_demoQuitOnEnd = JFALSE;
+		s_demoPath[0] = 0;
+		s_launchLevelName = nullptr;
+		s_launchLevelIndex = 0;
 	}
 
 	void DarkForces::pauseGame(bool pause)
@@ -216,6 +291,11 @@ namespace TFE_DarkForces
 		mission_pause(pause ? JTRUE : JFALSE);
 	}
 
+	u32 DarkForces::getCurrentTick()
+	{
+		return s_curTick;
+	}
+
 	/**********The basic structure of the Dark Forces main loop is as follows:***************
 	while (1)  // <- This will be replaced by the function call from the main TFE loop.
 	{
@@ -279,6 +359,7 @@ namespace TFE_DarkForces
 	****************************************************/
 	void DarkForces::loopGame()
 	{
+		demo_update();
 		updateTime();
 
 		switch (s_state)
@@ -290,9 +371,14 @@ namespace TFE_DarkForces
 			} break;
 			case GSTATE_AGENT_MENU:
 			{
-				if (!agentMenu_update(&s_levelIndex))
+				// TFE: Demo playback and the -l command line option skip the menu and start the level directly.
+				const JBool skipMenu = demo_playPending(&s_levelIndex) || launchLevel_pending(&s_levelIndex);
+				if (skipMenu || !agentMenu_update(&s_levelIndex))
 				{
-					agent_updateAgentSavedData();
+					if (!skipMenu)
+					{
+						agent_updateAgentSavedData();
+					}
 				
 					s_invalidLevelIndex = JTRUE;
 					for (s32 i = 0; i < TFE_ARRAYSIZE(s_cutsceneData); i++)
@@ -324,6 +410,7 @@ namespace TFE_DarkForces
 			{
 				// At this point the mission has already been launched.
 				// The task system will take over. Basically every frame we just check to see if there are any tasks running.
+				snapshot_update();
 				if (!task_getCount())
 				{
 					// We have returned from the mission tasks.
@@ -331,8 +418,17 @@ namespace TFE_DarkForces
 					disableLevelMusic();
 					sound_stopAll();
 					agent_levelEndTask();
+					// Demos cover a single level.
+					TFE_Input::replay_stop();
 
-					if (!s_levelComplete)
+					if (TFE_RenderBackend::isHeadless())
+					{
+						// TFE: Headless runs cover a single level and leave the agent progress as-is.
+						TFE_System::logWrite(LOG_MSG, "DarkForcesMain", "Headless level finished, complete: %s.", s_levelComplete ? "yes" : "no");
+						TFE_System::postQuitMessage();
+						s_abortLevel = JTRUE;
+					}
+					else if (!s_levelComplete)
 					{
 						s_abortLevel = JTRUE;
 						s_cutsceneIndex--;
@@ -355,11 +451,386 @@ namespace TFE_DarkForces
 					region_clear(s_levelRegion);
 					region_clear(s_resRegion);
 					bitmap_setAllocator(s_gameRegion);
+					// Snapshots cannot be restored once the level is gone.
+					TFE_Snapshot::reset();
+					s_snapshotTest = SNAPSHOT_TEST_NONE;
 				}
 			} break;
 		}
 	}
 
+	/////////////////////////////////////////////
+	// TFE: Snapshots
+	/////////////////////////////////////////////
+	// Snapshots are only taken between task updates while a level is running.
+	static bool snapshot_canSave()
+	{
+		return s_state == GSTATE_MISSION && s_missionMode == MISSION_MODE_MAIN && task_getCount();
+	}
+
+	static void snapshot_restored(const char* msg)
+	{
+		// Sounds playing now do not belong to the restored state, looping sounds are restarted by their owners.
+		sound_stopAll();
+		inf_rebuildActiveSet();
+		s_lastSnapshotTime = TFE_System::getTime();
+		TFE_Console::addToHistory(msg);
+	}
+
+	void console_quickSave(const ConsoleArgList& args)
+	{
+		if (!snapshot_canSave())
+		{
+			TFE_Console::addToHistory("Snapshots can only be saved while in a level.");
+			return;
+		}
+		const u64 start = TFE_System::getCurrentTimeInTicks();
+		TFE_Snapshot::save();
+		const f64 time = TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - start);
+		s_lastSnapshotTime = TFE_System::getTime();
+
+		char res[256];
+		sprintf(res, "Snapshot saved in %0.2f ms, %u older snapshots kept.", time * 1000.0, TFE_Snapshot::getHistoryCount());
+		TFE_Console::addToHistory(res);
+	}
+
+	void console_quickLoad(const ConsoleArgList& args)
+	{
+		if (!snapshot_canSave() || !TFE_Snapshot::restore())
+		{
+			TFE_Console::addToHistory("There is no snapshot to restore for this level.");
+			return;
+		}
+		snapshot_restored("Snapshot restored.");
+	}
+
+	void console_rewind(const ConsoleArgList& args)
+	{
+		const u32 count = args.size() >= 2 ? (u32)strtoul(args[1].c_str(), nullptr, 10) : 1;
+		if (!snapshot_canSave() || !TFE_Snapshot::rewind(count))
+		{
+			char res[256];
+			sprintf(res, "Cannot rewind %u snapshots, %u are available.", count, TFE_Snapshot::getHistoryCount());
+			TFE_Console::addToHistory(res);
+			return;
+		}
+		snapshot_restored("Rewound to an older snapshot.");
+	}
+
+	void console_snapshotTest(const ConsoleArgList& args)
+	{
+		if (!snapshot_canSave())
+		{
+			TFE_Console::addToHistory("The snapshot test can only be run while in a level.");
+			return;
+		}
+		s_snapshotTestElev = inf_getMovingElevator();
+		if (!s_snapshotTestElev)
+		{
+			TFE_Console::addToHistory("No elevator is moving, trigger one and run the test again.");
+			return;
+		}
+		s_snapshotTestStop = inf_getElevatorNextStop(s_snapshotTestElev);
+		TFE_Snapshot::save();
+		s_lastSnapshotTime = TFE_System::getTime();
+		s_snapshotTestStart = s_lastSnapshotTime;
+		s_snapshotTest = SNAPSHOT_TEST_WAIT_STOP;
+		TFE_Console::addToHistory("Snapshot saved, waiting for the elevator to reach its next stop.");
+	}
+
+	static void snapshot_endTest(const char* result)
+	{
+		char res[256];
+		sprintf(res, "Snapshot test %s, %d active elevator set errors.", result, inf_checkActiveSet());
+		TFE_Console::addToHistory(res);
+		s_snapshotTest = SNAPSHOT_TEST_NONE;
+		s_snapshotTestElev = nullptr;
+		s_snapshotTestStop = nullptr;
+	}
+
+	static void snapshot_updateTest()
+	{
+		const f64 time = TFE_System::getTime();
+		const JBool arrived = !inf_isElevatorMoving(s_snapshotTestElev) || inf_getElevatorNextStop(s_snapshotTestElev) != s_snapshotTestStop;
+		if (s_snapshotTest == SNAPSHOT_TEST_WAIT_STOP)
+		{
+			if (!arrived && time - s_snapshotTestStart < c_snapshotTestTimeout) { return; }
+			if (!TFE_Snapshot::restore())
+			{
+				snapshot_endTest("failed, the snapshot could not be restored");
+				return;
+			}
+			snapshot_restored("Snapshot restored, waiting for the elevator to finish its move again.");
+			s_snapshotTestStart = time;
+			s_snapshotTest = SNAPSHOT_TEST_WAIT_FINISH;
+		}
+		else if (arrived)
+		{
+			snapshot_endTest("passed");
+		}
+		else if (time - s_snapshotTestStart >= c_snapshotTestTimeout)
+		{
+			snapshot_endTest("failed, the elevator did not finish its move");
+		}
+	}
+
+	void snapshot_init()
+	{
+		// State outside of the game and level regions.
+		task_registerSnapshotState();
+		time_registerSnapshotState();
+		random_registerSnapshotState();
+		player_registerSnapshotState();
+		mission_registerSnapshotState();
+
+		CVAR_FLOAT(s_snapshotInterval, "d_snapshotInterval", CVFLAG_DO_NOT_SERIALIZE, "Seconds between automatic snapshots that can be rewound to while playing, 0 disables them.");
+		CCMD("quickSave", console_quickSave, 0, "Save a snapshot of the current level in memory.");
+		CCMD("quickLoad", console_quickLoad, 0, "Restore the last snapshot saved in the current level.");
+		CCMD("rewind", console_rewind, 0, "Restore an older snapshot, the count defaults to 1 - rewind 3");
+		CCMD("snapshotTest", console_snapshotTest, 0, "Snapshot a moving elevator, restore it once the elevator stops and check that it finishes its move again.");
+	}
+
+	void snapshot_update()
+	{
+		if (s_gamePaused || !snapshot_canSave()) { return; }
+		// Automatic snapshots would replace the one the test restores.
+		if (s_snapshotTest != SNAPSHOT_TEST_NONE)
+		{
+			snapshot_updateTest();
+			return;
+		}
+		if (s_snapshotInterval <= 0.0f) { return; }
+
+		const f64 time = TFE_System::getTime();
+		if (time - s_lastSnapshotTime >= s_snapshotInterval)
+		{
+			TFE_Snapshot::save();
+			s_lastSnapshotTime = time;
+		}
+	}
+
+	/////////////////////////////////////////////
+	// TFE: Demos
+	/////////////////////////////////////////////
+	// Hash of the state that diverges quickly if the replay doesn't match: time, random numbers, the player,
+	// object positions (AI, projectiles, pickups) and sector heights (elevators).
+	u32 demo_stateHash()
+	{
+		const u32 seed = random_getSeed();
+		u32 hash = TFE_Input::replay_hash(&s_curTick, sizeof(Tick));
+		hash = TFE_Input::replay_hash(&seed, sizeof(u32), hash);
+		hash = TFE_Input::replay_hash(&s_playerInfo, sizeof(PlayerInfo), hash);
+		hash = TFE_Input::replay_hash(&s_energy, sizeof(fixed16_16), hash);
+
+		for (u32 i = 0; i < s_sectorCount; i++)
+		{
+			const RSector* sector = &s_sectors[i];
+			hash = TFE_Input::replay_hash(&sector->floorHeight, sizeof(fixed16_16), hash);
+			hash = TFE_Input::replay_hash(&sector->ceilingHeight, sizeof(fixed16_16), hash);
+			for (s32 objIndex = 0, objListIndex = 0; objIndex < sector->objectCount && objListIndex < sector->objectCapacity; objListIndex++)
+			{
+				const SecObject* obj = sector->objectList[objListIndex];
+				if (!obj) { continue; }
+				objIndex++;
+
+				hash = TFE_Input::replay_hash(&obj->posWS, sizeof(vec3_fixed), hash);
+				hash = TFE_Input::replay_hash(&obj->yaw, sizeof(angle14_16), hash);
+			}
+		}
+		return hash;
+	}
+
+	static JBool demo_play(const char* path)
+	{
+		if (s_state != GSTATE_STARTUP_CUTSCENES && s_state != GSTATE_AGENT_MENU)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Demo", "Demos can only be played from the agent menu.");
+			return JFALSE;
+		}
+		if (!TFE_Input::replay_readStartData(path, &s_demoStart, sizeof(DemoStart)))
+		{
+			return JFALSE;
+		}
+		if (s_demoStart.levelIndex < 1 || s_demoStart.levelIndex > s_maxLevelIndex)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Demo", "Demo \"%s\" uses an invalid level %d.", path, s_demoStart.levelIndex);
+			return JFALSE;
+		}
+		strcpy(s_demoPath, path);
+		s_demoPending = DEMO_PLAY;
+		return JTRUE;
+	}
+
+	void console_demoRecord(const ConsoleArgList& args)
+	{
+		char path[TFE_MAX_PATH];
+		TFE_Paths::getUserFilePath(args.size() >= 2 ? args[1].c_str() : "demo.tfd", path);
+		if (TFE_Input::replay_isRecording() || TFE_Input::replay_isPlaying())
+		{
+			TFE_Console::addToHistory("A demo is already running, use demoStop first.");
+			return;
+		}
+		strcpy(s_demoPath, path);
+		s_demoPending = DEMO_RECORD;
+
+		char res[TFE_MAX_PATH + 64];
+		sprintf(res, "Recording to \"%s\" when the next level starts.", path);
+		TFE_Console::addToHistory(res);
+	}
+
+	void console_demoPlay(const ConsoleArgList& args)
+	{
+		char path[TFE_MAX_PATH];
+		TFE_Paths::getUserFilePath(args.size() >= 2 ? args[1].c_str() : "demo.tfd", path);
+		if (TFE_Input::replay_isRecording() || TFE_Input::replay_isPlaying())
+		{
+			TFE_Console::addToHistory("A demo is already running, use demoStop first.");
+			return;
+		}
+
+		char res[TFE_MAX_PATH + 64];
+		if (demo_play(path))
+		{
+			sprintf(res, "Playing \"%s\", see the log for the results.", path);
+		}
+		else
+		{
+			sprintf(res, "Cannot play \"%s\" - demos are played from the agent menu, see the log for details.", path);
+		}
+		TFE_Console::addToHistory(res);
+	}
+
+	void console_demoStop(const ConsoleArgList& args)
+	{
+		TFE_Input::replay_stop();
+		s_demoPending = DEMO_NONE;
+	}
+
+	void demo_init()
+	{
+		CCMD("demoRecord", console_demoRecord, 0, "Record the input of the next level, the file defaults to demo.tfd - demoRecord fight.tfd");
+		CCMD("demoPlay", console_demoPlay, 0, "Play a demo recorded with demoRecord from the agent menu - demoPlay fight.tfd");
+		CCMD("demoStop", console_demoStop, 0, "Stop recording or playing a demo.");
+
+		// From the command line, the game exits when the demo ends.
+		if (s_demoPath[0] && s_demoQuitOnEnd)
+		{
+			char path[TFE_MAX_PATH];
+			TFE_Paths::getUserFilePath(s_demoPath, path);
+			if (!demo_play(path))
+			{
+				s_demoQuitOnEnd = JFALSE;
+			}
+		}
+	}
+
+	void demo_update()
+	{
+		if (s_demoPlaying && !TFE_Input::replay_isPlaying())
+		{
+			s_demoPlaying = JFALSE;
+			actor_setLodSettings(&s_demoSavedLod);
+			if (s_demoQuitOnEnd)
+			{
+				TFE_System::postQuitMessage();
+			}
+		}
+	}
+
+	JBool demo_playPending(s32* levelIndex)
+	{
+		if (s_demoPending != DEMO_PLAY) { return JFALSE; }
+		agentMenu_leave();
+		*levelIndex = s_demoStart.levelIndex;
+		return JTRUE;
+	}
+
+	// Called when the mission is started, before the first task runs.
+	void demo_startLevel(s32 levelIndex)
+	{
+		if (s_demoPending == DEMO_PLAY && levelIndex == s_demoStart.levelIndex)
+		{
+			// Start from the recorded state rather than the agent's saved inventory.
+			player_readInfo(s_demoStart.inv, s_demoStart.ammo);
+			s_playerInfo = s_demoStart.playerInfo;
+			random_seed(s_demoStart.randomSeed);
+			time_setState(&s_demoStart.time);
+			actor_getLodSettings(&s_demoSavedLod);
+			actor_setLodSettings(&s_demoStart.aiLod);
+			if (s_demoStart.difficulty != s_agentData[s_agentId].difficulty)
+			{
+				TFE_System::logWrite(LOG_WARNING, "Demo", "The demo was recorded at difficulty %u, the agent uses %u.", s_demoStart.difficulty, s_agentData[s_agentId].difficulty);
+			}
+			s_demoPlaying = TFE_Input::replay_startPlayback(s_demoPath, demo_stateHash) ? JTRUE : JFALSE;
+			// The recorded frame times drive the game, even when running headless.
+			if (s_demoPlaying)
+			{
+				time_setFixedTicks(0);
+			}
+			else
+			{
+				actor_setLodSettings(&s_demoSavedLod);
+			}
+			s_demoPending = DEMO_NONE;
+			return;
+		}
+
+		DemoStart start = {};
+		if (agent_readSavedInventory(s_agentId, levelIndex, start.inv, start.ammo))
+		{
+			player_readInfo(start.inv, start.ammo);
+		}
+		if (s_demoPending == DEMO_RECORD)
+		{
+			start.levelIndex = levelIndex;
+			start.randomSeed = random_getSeed();
+			start.difficulty = s_agentData[s_agentId].difficulty;
+			start.playerInfo = s_playerInfo;
+			time_getState(&start.time);
+			actor_getLodSettings(&start.aiLod);
+			TFE_Input::replay_startRecording(s_demoPath, &start, sizeof(DemoStart), demo_stateHash);
+		}
+		s_demoPending = DEMO_NONE;
+	}
+
+	// TFE: Find the level given on the command line (-lSECBASE), it is started instead of showing the agent menu.
+	void launchLevel_init()
+	{
+		s_launchLevelIndex = 0;
+		if (s_launchLevelName)
+		{
+			for (s32 i = 0; i < s_maxLevelIndex; i++)
+			{
+				if (s_levelGamePaths[i] && strcasecmp(s_levelGamePaths[i], s_launchLevelName) == 0)
+				{
+					s_launchLevelIndex = i + 1;
+					break;
+				}
+			}
+			if (!s_launchLevelIndex)
+			{
+				TFE_System::logWrite(LOG_ERROR, "DarkForcesMain", "Cannot find the level \"%s\" to launch.", s_launchLevelName);
+			}
+			s_launchLevelName = nullptr;
+		}
+
+		// Nothing can drive the agent menu without a window, so a headless run needs a level or a demo.
+		if (TFE_RenderBackend::isHeadless() && !s_launchLevelIndex && !s_demoQuitOnEnd)
+		{
+			TFE_System::logWrite(LOG_ERROR, "DarkForcesMain", "Headless mode requires a level to launch (-lSECBASE) or a demo to play (--playdemo).");
+			TFE_System::postQuitMessage();
+		}
+	}
+
+	JBool launchLevel_pending(s32* levelIndex)
+	{
+		if (!s_launchLevelIndex) { return JFALSE; }
+		agentMenu_leave();
+		*levelIndex = s_launchLevelIndex;
+		s_launchLevelIndex = 0;
+		return JTRUE;
+	}
+
 	void loadCutsceneList()
 	{
 		s_cutsceneList = gameList_load("cutscene.lst");
@@ -446,7 +917,7 @@ namespace TFE_DarkForces
 				startLevelMusic(levelIndex);
 
 				agent_setLevelComplete(JFALSE);
-				agent_readSavedDataForLevel(s_agentId, levelIndex);
+				demo_startLevel(levelIndex);
 
 				// The load mission task should begin immediately once the Task System updates,
 				// so launchCurrentTask() is not required here.
@@ -473,7 +944,26 @@ namespace TFE_DarkForces
 			const char* arg = argv[i];
 			char c = arg[0];
 
-			if (c == '-' || c == '/' || c == '+')
+			// TFE: Play a demo and exit, --playdemo fight.tfd
+			if (strcasecmp(arg, "--playdemo") == 0 && i + 1 < argCount)
+			{
+				strncpy(s_demoPath, argv[++i], TFE_MAX_PATH - 1);
+				s_demoPath[TFE_MAX_PATH - 1] = 0;
+				s_demoQuitOnEnd = JTRUE;
+			}
+			// TFE: Headless simulation, advance a fixed number of ticks per frame - --headless [ticks] [frames]
+			else if (strcasecmp(arg, "--headless") == 0)
+			{
+				s32 ticks = 4;
+				if (i + 1 < argCount && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+				{
+					// The frame time is limited to 50ms, which is 7 ticks.
+					ticks = clamp(atoi(argv[++i]), 1, 7);
+				}
+				time_setFixedTicks(ticks);
+				TFE_System::setFixedTimeStep(f64(ticks) / f64(TICKS_PER_SECOND));
+			}
+			else if (c == '-' || c == '/' || c == '+')
 			{
 				c = arg[1];
 				if (c == 'c' || c == 'C')
@@ -14,5 +14,6 @@ namespace TFE_DarkForces
 		void pauseGame(bool pause) override;
 		void exitGame() override;
 		void loopGame() override;
+		u32  getCurrentTick() override;
 	};
 }
@@ -259,7 +259,7 @@ namespace TFE_DarkForces
 	void hitEffect_createTask()
 	{
 		hitEffect_clearState();
-		s_hitEffects = allocator_create(sizeof(HitEffect));
+		s_hitEffects = allocator_createSlab(sizeof(HitEffect), 32, "Hit Effect");
 		s_hitEffectTask = createSubTask("hitEffects", hitEffectTaskFunc);
 	}
 		
@@ -14,6 +14,7 @@
 #include <TFE_DarkForces/GameUI/escapeMenu.h>
 #include <TFE_DarkForces/logic.h>
 #include <TFE_Game/igame.h>
+#include <TFE_Game/snapshot.h>
 #include <TFE_Settings/settings.h>
 #include <TFE_RenderBackend/renderBackend.h>
 #include <TFE_Jedi/Level/rtexture.h>
@@ -345,11 +346,13 @@ namespace TFE_DarkForces
 
 				if (s_missionMode == MISSION_MODE_LOADING)
 				{
-					blitLoadingScreen();
+					if (!TFE_RenderBackend::isHeadless()) { blitLoadingScreen(); }
 				}
 				else if (s_missionMode == MISSION_MODE_MAIN)
 				{
 					updateScreensize();
+					// TFE: The world is still drawn when running headless, since auto-aim uses the sprites drawn by the renderer.
+					// The framebuffer is never presented, so a headless run simulates the same game as one with a window.
 					drawWorld(s_framebuffer, s_playerEye->sector, s_levelColorMap, s_lightSourceRamp);
 					weapon_draw(s_framebuffer, (DrawRect*)vfb_getScreenRect(VFB_RECT_UI));
 					handleVisionFx();
@@ -368,7 +371,7 @@ namespace TFE_DarkForces
 			{
 				handleGeneralInput();
 				handlePaletteFx();
-				if (s_drawAutomap)
+				if (s_drawAutomap && !TFE_RenderBackend::isHeadless())
 				{
 					automap_draw(s_framebuffer);
 				}
@@ -956,6 +959,13 @@ namespace TFE_DarkForces
 		}
 	}
 
+	void mission_registerSnapshotState()
+	{
+		SNAPSHOT_STATE(s_exitLevel);
+		SNAPSHOT_STATE(s_visionFxCountdown);
+		SNAPSHOT_STATE(s_visionFxEndCountdown);
+	}
+
 	void mission_pause(JBool pause)
 	{
 		s_gamePaused = pause;
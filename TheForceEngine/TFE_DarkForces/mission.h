@@ -26,6 +26,7 @@ namespace TFE_DarkForces
 	void mission_setLoadMissionTask(Task* task);
 	void mission_exitLevel();
 	void mission_pause(JBool pause);
+	void mission_registerSnapshotState();
 
 	void setScreenFxLevels(s32 healthFx, s32 shieldFx, s32 flashFx);
 	void disableNightvisionInternal();
@@ -8,6 +8,7 @@
 #include <TFE_Jedi/Sound/soundSystem.h>
 #include <TFE_Jedi/Task/task.h>
 #include <TFE_Jedi/Sound/soundSystem.h>
+#include <TFE_Memory/chunkedArray.h>
 
 using namespace TFE_Jedi;
 
@@ -28,7 +29,10 @@ namespace TFE_DarkForces
 	Task* s_gasmaskTask = nullptr;
 	Task* s_gasSectorTask = nullptr;
 
-	enum { MAX_PICKUP_FREE_ITEMS = 128 };
+	// TFE: Pickups are allocated from a pool, the original code never freed them.
+	static ChunkedArray* s_pickups = nullptr;
+
+	enum { MAX_PICKUP_FREE_ITEMS = 128, PICKUP_POOL_CHUNK_SIZE = 64 };
 	static Pickup* s_listToFree[MAX_PICKUP_FREE_ITEMS];
 	static s32 s_listToFreeCnt = 0;
 
@@ -47,6 +51,7 @@ namespace TFE_DarkForces
 	{
 		s_playerDying = 0;
 		s_listToFreeCnt = 0;
+		s_pickups = nullptr;
 		// Pointer to memory where player inventory is saved.
 		s_pickupTask = nullptr;
 		s_superchargeTask = nullptr;
@@ -115,11 +120,14 @@ namespace TFE_DarkForces
 	void pickup_cleanupFunc(Logic* logic)
 	{
 		deleteLogicAndObject(logic);
+		TFE_Memory::freeToChunkedArray(s_pickups, logic);
 	}
 
 	void pickup_createTask()
 	{
 		pickup_clearState();
+		s_pickups = TFE_Memory::createChunkedArray(sizeof(Pickup), PICKUP_POOL_CHUNK_SIZE, 1, s_levelRegion);
+		TFE_Memory::chunkedArrayTrackUsage(s_pickups, "Pickup");
 		s_pickupTask = createSubTask("pickups", pickTaskFunc, pickupItem);
 	}
 		
@@ -362,7 +370,7 @@ namespace TFE_DarkForces
 	// TODO: Move pickup data to an external data file to avoid hardcoding.
 	Logic* obj_createPickup(SecObject* obj, ItemId id)
 	{
-		Pickup* pickup = (Pickup*)level_alloc(sizeof(Pickup));
+		Pickup* pickup = (Pickup*)TFE_Memory::allocFromChunkedArray(s_pickups);
 		obj_addLogic(obj, (Logic*)pickup, s_pickupTask, pickup_cleanupFunc);
 
 		obj->entityFlags |= ETFLAG_PICKUP;
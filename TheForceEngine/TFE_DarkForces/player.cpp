@@ -15,6 +15,7 @@
 #include <TFE_Settings/settings.h>
 #include <TFE_Input/inputMapping.h>
 #include <TFE_Game/igame.h>
+#include <TFE_Game/snapshot.h>
 #include <TFE_DarkForces/mission.h>
 #include <TFE_Jedi/Level/level.h>
 #include <TFE_Jedi/InfSystem/infSystem.h>
@@ -276,6 +277,89 @@ namespace TFE_DarkForces
 		s_energy = FIXED(2);
 	}
 
+	// TFE: Player state outside of the game and level regions, so snapshots restore the controller along with the player info.
+	// The player ticks must be restored together with the game time or the frame delta wraps around after rewinding.
+	void player_registerSnapshotState()
+	{
+		// Controller
+		SNAPSHOT_STATE(s_externalYawSpd);
+		SNAPSHOT_STATE(s_playerPitch);
+		SNAPSHOT_STATE(s_playerRoll);
+		SNAPSHOT_STATE(s_forwardSpd);
+		SNAPSHOT_STATE(s_strafeSpd);
+		SNAPSHOT_STATE(s_maxMoveDist);
+		SNAPSHOT_STATE(s_playerStopAccel);
+		SNAPSHOT_STATE(s_minEyeDistFromFloor);
+		SNAPSHOT_STATE(s_postLandVel);
+		SNAPSHOT_STATE(s_landUpVel);
+		SNAPSHOT_STATE(s_playerVelX);
+		SNAPSHOT_STATE(s_playerUpVel);
+		SNAPSHOT_STATE(s_playerUpVel2);
+		SNAPSHOT_STATE(s_playerVelZ);
+		SNAPSHOT_STATE(s_externalVelX);
+		SNAPSHOT_STATE(s_externalVelZ);
+		SNAPSHOT_STATE(s_playerCrouchSpd);
+		SNAPSHOT_STATE(s_playerSpeed);
+		SNAPSHOT_STATE(s_prevDistFromFloor);
+		SNAPSHOT_STATE(s_wpnSin);
+		SNAPSHOT_STATE(s_wpnCos);
+		SNAPSHOT_STATE(s_moveDirX);
+		SNAPSHOT_STATE(s_moveDirZ);
+		SNAPSHOT_STATE(s_dist);
+		SNAPSHOT_STATE(s_distScale);
+		SNAPSHOT_STATE(s_levelAtten);
+		SNAPSHOT_STATE(s_curSafe);
+		SNAPSHOT_STATE(s_playerJumping);
+		SNAPSHOT_STATE(s_playerInWater);
+		SNAPSHOT_STATE(s_playerPos);
+		SNAPSHOT_STATE(s_playerObjHeight);
+		SNAPSHOT_STATE(s_playerObjPitch);
+		SNAPSHOT_STATE(s_playerObjYaw);
+		SNAPSHOT_STATE(s_playerObjSector);
+		SNAPSHOT_STATE(s_playerSlideWall);
+		// Shared
+		SNAPSHOT_STATE(s_playerInfo);
+		SNAPSHOT_STATE(s_playerLogic);
+		SNAPSHOT_STATE(s_goalItems);
+		SNAPSHOT_STATE(s_energy);
+		SNAPSHOT_STATE(s_lifeCount);
+		SNAPSHOT_STATE(s_playerLight);
+		SNAPSHOT_STATE(s_headwaveVerticalOffset);
+		SNAPSHOT_STATE(s_weaponLight);
+		SNAPSHOT_STATE(s_baseAtten);
+		SNAPSHOT_STATE(s_invincibility);
+		SNAPSHOT_STATE(s_wearingCleats);
+		SNAPSHOT_STATE(s_wearingGasmask);
+		SNAPSHOT_STATE(s_nightvisionActive);
+		SNAPSHOT_STATE(s_headlampActive);
+		SNAPSHOT_STATE(s_superCharge);
+		SNAPSHOT_STATE(s_superChargeHud);
+		SNAPSHOT_STATE(s_playerSecMoved);
+		SNAPSHOT_STATE(s_goals);
+		SNAPSHOT_STATE(s_playerSector);
+		SNAPSHOT_STATE(s_eyePos);
+		SNAPSHOT_STATE(s_pitch);
+		SNAPSHOT_STATE(s_yaw);
+		SNAPSHOT_STATE(s_roll);
+		SNAPSHOT_STATE(s_playerEyeFlags);
+		SNAPSHOT_STATE(s_playerTick);
+		SNAPSHOT_STATE(s_prevPlayerTick);
+		SNAPSHOT_STATE(s_nextShieldDmgTick);
+		SNAPSHOT_STATE(s_reviveTick);
+		SNAPSHOT_STATE(s_nextPainSndTick);
+		SNAPSHOT_STATE(s_playerYPos);
+		SNAPSHOT_STATE(s_camOffset);
+		SNAPSHOT_STATE(s_camOffsetPitch);
+		SNAPSHOT_STATE(s_camOffsetYaw);
+		SNAPSHOT_STATE(s_camOffsetRoll);
+		SNAPSHOT_STATE(s_playerYaw);
+		SNAPSHOT_STATE(s_playerHeight);
+		SNAPSHOT_STATE(s_playerRun);
+		SNAPSHOT_STATE(s_jumpScale);
+		SNAPSHOT_STATE(s_playerSlow);
+		SNAPSHOT_STATE(s_onMovingSurface);
+	}
+
 	void player_readInfo(u8* inv, s32* ammo)
 	{
 		assert(inv[0]);	// The player should always have the pistol.
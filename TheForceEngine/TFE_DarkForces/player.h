@@ -139,6 +139,7 @@ namespace TFE_DarkForces
 	extern SoundSourceID s_playerShieldHitSoundSource;
 
 	void player_init();
+	void player_registerSnapshotState();
 	void player_readInfo(u8* inv, s32* ammo);
 	void player_writeInfo(u8* inv, s32* ammo);
 	void player_clearEyeObject();
@@ -12,6 +12,8 @@
 #include <TFE_Jedi/Level/rwall.h>
 #include <TFE_Jedi/Memory/allocator.h>
 #include <TFE_Jedi/Sound/soundSystem.h>
+#include <TFE_System/profiler.h>
+#include <vector>
 
 using namespace TFE_Jedi;
 
@@ -79,6 +81,23 @@ namespace TFE_DarkForces
 	static fixed16_16 s_colObjAdjY;
 	static fixed16_16 s_colObjAdjZ;
 
+	// TFE: Straight-line projectiles (stdProjectileUpdateFunc) stored as a structure of arrays, so they can be
+	// integrated and tested against the walls of their current sector in one pass each frame.
+	struct ProjectileBatch
+	{
+		std::vector<ProjectileLogic*> logic;
+		std::vector<RSector*>   sector;
+		std::vector<fixed16_16> posX, posY, posZ;
+		std::vector<fixed16_16> velX, velY, velZ;
+		std::vector<fixed16_16> nextX, nextY, nextZ;
+		std::vector<u8>         clear;	// The path stays inside the sector, between the floor and ceiling.
+		fixed16_16 dt;
+		s32 count;
+	};
+	static ProjectileBatch s_projBatch = {};
+	static s32 s_projBatchCount = 0;
+	static s32 s_projBatchClearCount = 0;
+
 	// Task
 	static Task* s_projectileTask = nullptr;
 
@@ -92,6 +111,8 @@ namespace TFE_DarkForces
 	void proj_setTransform(ProjectileLogic* logic, angle14_32 pitch, angle14_32 yaw);
 	JBool proj_move(ProjectileLogic* logic);
 	JBool proj_getHitObj(ProjectileLogic* logic);
+	ProjectileHitType proj_handleHits(ProjectileLogic* logic, JBool envHit, JBool objHit);
+	void proj_batchUpdate();
 		
 	ProjectileHitType stdProjectileUpdateFunc(ProjectileLogic* logic);
 	ProjectileHitType landMineUpdateFunc(ProjectileLogic* logic);
@@ -128,6 +149,9 @@ namespace TFE_DarkForces
 		s_homingMissileFlightSnd = sound_Load("tracker.voc");
 		s_bobaBallCameraSnd      = sound_Load("fireball.voc");
 		s_landMineTriggerSnd     = sound_Load("beep-10.voc");
+
+		TFE_COUNTER(s_projBatchCount, "Projectiles Batched");
+		TFE_COUNTER(s_projBatchClearCount, "Projectiles Batched Clear");
 	}
 
 	void projectile_clearState()
@@ -135,12 +159,13 @@ namespace TFE_DarkForces
 		s_projectiles = nullptr;
 		s_projectileTask = nullptr;
 		s_projReflectOverrideYaw = 0;
+		s_projBatch.count = 0;
 	}
 
 	void projectile_createTask()
 	{
 		projectile_clearState();
-		s_projectiles = allocator_create(sizeof(ProjectileLogic));
+		s_projectiles = allocator_createSlab(sizeof(ProjectileLogic), 64, "Projectile Logic");
 		s_projectileTask = createSubTask("projectiles", projectileTaskFunc);
 	}
 
@@ -167,6 +192,7 @@ namespace TFE_DarkForces
 		projLogic->vel.y   = 0;
 		projLogic->vel.z   = 0;
 		projLogic->minDmg  = 0;
+		projLogic->batchIndex = -1;
 
 		obj_addLogic(projObj, (Logic*)projLogic, s_projectileTask, projectileLogicCleanupFunc);
 		
@@ -710,6 +736,9 @@ namespace TFE_DarkForces
 				}
 			}
 
+			// TFE: Move the straight-line projectiles as a batch before the per-projectile update.
+			proj_batchUpdate();
+
 			taskCtx->projLogic = (ProjectileLogic*)allocator_getHead(s_projectiles);
 			while (taskCtx->projLogic)
 			{
@@ -852,6 +881,39 @@ namespace TFE_DarkForces
 		projLogic->delta.y = mul16(projLogic->vel.y, dt);
 		projLogic->delta.z = mul16(projLogic->vel.z, dt);
 
+		// TFE: Use the batch results if the path is clear and nothing has changed since the batch was built,
+		// such as the velocity being adjusted by a moving floor.
+		const s32 index = projLogic->batchIndex;
+		projLogic->batchIndex = -1;
+		if (index >= 0 && index < s_projBatch.count && s_projBatch.clear[index] && s_projBatch.logic[index] == projLogic && s_projBatch.dt == dt)
+		{
+			SecObject* obj = projLogic->logic.obj;
+			if (obj->sector == s_projBatch.sector[index] && obj->posWS.x == s_projBatch.posX[index] && obj->posWS.y == s_projBatch.posY[index] &&
+				obj->posWS.z == s_projBatch.posZ[index] && projLogic->vel.x == s_projBatch.velX[index] && projLogic->vel.y == s_projBatch.velY[index] &&
+				projLogic->vel.z == s_projBatch.velZ[index])
+			{
+				// Setup the same state as proj_move() when nothing is hit.
+				s_hitWall = nullptr;
+				s_hitWater = JFALSE;
+				s_projSector = obj->sector;
+				s_projPath[0] = obj->sector;
+				s_projIter = 1;
+				s_projNextPosX = s_projBatch.nextX[index];
+				s_projNextPosY = s_projBatch.nextY[index];
+				s_projNextPosZ = s_projBatch.nextZ[index];
+
+				// Objects are still tested one projectile at a time, since projectiles can hit each other.
+				if (proj_getHitObj(projLogic))
+				{
+					return proj_handleHits(projLogic, JFALSE, JTRUE);
+				}
+				// The path doesn't cross any walls, so the projectile stays in the same sector.
+				obj->posWS.x = s_projNextPosX;
+				obj->posWS.y = s_projNextPosY;
+				obj->posWS.z = s_projNextPosZ;
+				return PHIT_NONE;
+			}
+		}
 		return proj_handleMovement(projLogic);
 	}
 
@@ -1040,9 +1102,15 @@ namespace TFE_DarkForces
 	// Returns 0 if it moved without hitting anything.
 	ProjectileHitType proj_handleMovement(ProjectileLogic* projLogic)
 	{
-		SecObject* obj = projLogic->logic.obj;
 		JBool envHit = proj_move(projLogic);
 		JBool objHit = proj_getHitObj(projLogic);
+		return proj_handleHits(projLogic, envHit, objHit);
+	}
+
+	// Handle the results of proj_move() and proj_getHitObj().
+	ProjectileHitType proj_handleHits(ProjectileLogic* projLogic, JBool envHit, JBool objHit)
+	{
+		SecObject* obj = projLogic->logic.obj;
 		if (objHit)
 		{
 			obj->posWS.y = s_colObjAdjY;
@@ -1197,6 +1265,88 @@ namespace TFE_DarkForces
 		return PHIT_NONE;
 	}
 
+	// TFE: Gather the straight-line projectiles still in flight, then integrate them and test their paths against
+	// the walls, floor and ceiling of their current sector in tight loops over the batch arrays. Projectiles whose
+	// path is not clear are left to proj_move() as before.
+	void proj_batchUpdate()
+	{
+		ProjectileBatch& batch = s_projBatch;
+		batch.logic.clear();
+		batch.sector.clear();
+		batch.posX.clear();
+		batch.posY.clear();
+		batch.posZ.clear();
+		batch.velX.clear();
+		batch.velY.clear();
+		batch.velZ.clear();
+		batch.dt = s_deltaTime;
+
+		const Tick curTick = s_curTick;
+		ProjectileLogic* projLogic = (ProjectileLogic*)allocator_getHead(s_projectiles);
+		while (projLogic)
+		{
+			projLogic->batchIndex = -1;
+			if (projLogic->updateFunc == stdProjectileUpdateFunc && curTick < projLogic->duration)
+			{
+				SecObject* obj = projLogic->logic.obj;
+				projLogic->batchIndex = s32(batch.logic.size());
+
+				batch.logic.push_back(projLogic);
+				batch.sector.push_back(obj->sector);
+				batch.posX.push_back(obj->posWS.x);
+				batch.posY.push_back(obj->posWS.y);
+				batch.posZ.push_back(obj->posWS.z);
+				batch.velX.push_back(projLogic->vel.x);
+				batch.velY.push_back(projLogic->vel.y);
+				batch.velZ.push_back(projLogic->vel.z);
+			}
+			projLogic = (ProjectileLogic*)allocator_getNext(s_projectiles);
+		}
+
+		const s32 count = s32(batch.logic.size());
+		batch.count = count;
+		batch.nextX.resize(count);
+		batch.nextY.resize(count);
+		batch.nextZ.resize(count);
+		batch.clear.resize(count);
+
+		// Integrate, this matches stdProjectileUpdateFunc() and proj_move().
+		const fixed16_16 dt = batch.dt;
+		for (s32 i = 0; i < count; i++)
+		{
+			batch.nextX[i] = batch.posX[i] + mul16(batch.velX[i], dt);
+			batch.nextY[i] = batch.posY[i] + mul16(batch.velY[i], dt);
+			batch.nextZ[i] = batch.posZ[i] + mul16(batch.velZ[i], dt);
+		}
+
+		// Test the paths against the current sector, this matches proj_move() when no wall is crossed.
+		s32 clearCount = 0;
+		for (s32 i = 0; i < count; i++)
+		{
+			RSector* sector = batch.sector[i];
+			batch.clear[i] = 0;
+			if (collision_wallCollisionFromPath(sector, batch.posX[i], batch.posZ[i], batch.nextX[i], batch.nextZ[i]))
+			{
+				continue;
+			}
+
+			fixed16_16 floorHeight, ceilHeight;
+			sector_getObjFloorAndCeilHeight(sector, batch.posY[i], &floorHeight, &ceilHeight);
+			// In the case of water, the real floor height is the actual floor.
+			if (sector->secHeight > 0)
+			{
+				floorHeight = sector->floorHeight;
+			}
+			if (batch.nextY[i] <= floorHeight && batch.nextY[i] >= ceilHeight)
+			{
+				batch.clear[i] = 1;
+				clearCount++;
+			}
+		}
+		s_projBatchCount = count;
+		s_projBatchClearCount = clearCount;
+	}
+
 	// Return JTRUE if something was hit during movement.
 	JBool proj_move(ProjectileLogic* projLogic)
 	{
@@ -95,6 +95,7 @@ namespace TFE_DarkForces
 		u32 flags;
 		s32 ua0;
 		s32 ua4;
+		s32 batchIndex;                   // TFE: Index into the straight-line projectile batch for the current frame, -1 if not batched.
 	};
 
 	// Startup the projectile system.
@@ -1,4 +1,5 @@
 #include "random.h"
+#include <TFE_Game/snapshot.h>
 
 namespace TFE_DarkForces
 {
@@ -41,4 +42,14 @@ namespace TFE_DarkForces
 	{
 		s_seed = seed;
 	}
+
+	u32 random_getSeed()
+	{
+		return s_seed;
+	}
+
+	void random_registerSnapshotState()
+	{
+		SNAPSHOT_STATE(s_seed);
+	}
 }  // TFE_DarkForces
\ No newline at end of file
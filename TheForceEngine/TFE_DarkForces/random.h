@@ -17,4 +17,6 @@ namespace TFE_DarkForces
 	s32 random_next();
 
 	void random_seed(u32 seed);
+	u32  random_getSeed();
+	void random_registerSnapshotState();
 }  // namespace TFE_DarkForces
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "time.h"
 #include <TFE_System/system.h>
+#include <TFE_Game/snapshot.h>
+#include <string.h>
 
 namespace TFE_DarkForces
 {
@@ -10,6 +12,7 @@ namespace TFE_DarkForces
 	fixed16_16 s_frameTicks[13] = { 0 };
 
 	JBool s_pauseTimeUpdate = JFALSE;
+	static s32 s_fixedTicks = 0;
 
 	Tick time_frameRateToDelay(u32 frameRate)
 	{
@@ -31,11 +34,50 @@ namespace TFE_DarkForces
 		s_pauseTimeUpdate = pause;
 	}
 
+	void time_setFixedTicks(s32 ticks)
+	{
+		s_fixedTicks = ticks > 0 ? ticks : 0;
+	}
+
+	void time_registerSnapshotState()
+	{
+		SNAPSHOT_STATE(s_curTick);
+		SNAPSHOT_STATE(s_prevTick);
+		SNAPSHOT_STATE(s_timeAccum);
+		SNAPSHOT_STATE(s_deltaTime);
+		SNAPSHOT_STATE(s_frameTicks);
+	}
+
+	void time_getState(TimeState* state)
+	{
+		state->timeAccum = s_timeAccum;
+		state->curTick = s_curTick;
+		state->prevTick = s_prevTick;
+		state->deltaTime = s_deltaTime;
+		memcpy(state->frameTicks, s_frameTicks, sizeof(s_frameTicks));
+	}
+
+	void time_setState(const TimeState* state)
+	{
+		s_timeAccum = state->timeAccum;
+		s_curTick = state->curTick;
+		s_prevTick = state->prevTick;
+		s_deltaTime = state->deltaTime;
+		memcpy(s_frameTicks, state->frameTicks, sizeof(s_frameTicks));
+	}
+
 	void updateTime()
 	{
 		if (!s_pauseTimeUpdate)
 		{
-			s_timeAccum += TFE_System::getDeltaTime() * TIMER_FREQ;
+			if (s_fixedTicks)
+			{
+				s_timeAccum += f64(s_fixedTicks);
+			}
+			else
+			{
+				s_timeAccum += TFE_System::getDeltaTime() * TIMER_FREQ;
+			}
 		}
 
 		Tick prevTick = s_curTick;
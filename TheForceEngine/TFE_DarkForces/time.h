@@ -46,10 +46,25 @@ namespace TFE_DarkForces
 	// Each computes dt*frameRate and the indexed framerate (i.e. s_frameTicks[12] = 12 fps).
 	extern fixed16_16 s_frameTicks[13];
 
+	// Full game time state, so it can be reproduced when replaying a recorded demo.
+	struct TimeState
+	{
+		f64 timeAccum;
+		Tick curTick;
+		Tick prevTick;
+		fixed16_16 deltaTime;
+		fixed16_16 frameTicks[13];
+	};
+
 	// Convert from frames per second (fps) to Ticks.
 	Tick time_frameRateToDelay(u32 frameRate);
 	Tick time_frameRateToDelay(s32 frameRate);
 	Tick time_frameRateToDelay(f32 frameRate);
 	void updateTime();
 	void time_pause(JBool pause);
+	// Advance the game time by exactly 'ticks' every frame instead of using the frame time, 0 = disabled.
+	void time_setFixedTicks(s32 ticks);
+	void time_registerSnapshotState();
+	void time_getState(TimeState* state);
+	void time_setState(const TimeState* state);
 }  // namespace TFE_DarkForces
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "deltaCodec.h"
+#include <assert.h>
+#include <string.h>
+
+namespace TFE_DeltaCodec
+{
+	template <typename T>
+	static inline T loadWord(const u8* data, size_t index)
+	{
+		T word;
+		memcpy(&word, data + index * sizeof(T), sizeof(T));
+		return word;
+	}
+
+	template <typename T>
+	static inline T loadPrevWord(const u8* prev, size_t index)
+	{
+		return prev ? loadWord<T>(prev, index) : T(0);
+	}
+
+	template <typename T>
+	static u8* encodeWords(const u8* cur, u8* prev, size_t size, u8* out)
+	{
+		const u32 wordCount = u32(size / sizeof(T));
+		u32 w = 0;
+		while (w < wordCount)
+		{
+			const u32 unchangedStart = w;
+			while (w < wordCount && loadWord<T>(cur, w) == loadPrevWord<T>(prev, w)) { w++; }
+			const u32 changedStart = w;
+			while (w < wordCount && loadWord<T>(cur, w) != loadPrevWord<T>(prev, w)) { w++; }
+
+			out = writeVarint(out, changedStart - unchangedStart);
+			out = writeVarint(out, w - changedStart);
+			for (u32 i = changedStart; i < w; i++)
+			{
+				const T delta = loadWord<T>(cur, i) ^ loadPrevWord<T>(prev, i);
+				memcpy(out, &delta, sizeof(T));
+				out += sizeof(T);
+			}
+		}
+		for (size_t b = size_t(wordCount) * sizeof(T); b < size; b++)
+		{
+			*out++ = prev ? cur[b] ^ prev[b] : cur[b];
+		}
+		if (prev)
+		{
+			memcpy(prev, cur, size);
+		}
+		return out;
+	}
+
+	size_t getMaxEncodedSize(size_t size, u32 wordSize)
+	{
+		const size_t wordCount = size / wordSize;
+		return size + (wordCount + 1) * 2 * MAX_VARINT_SIZE;
+	}
+
+	u8* encode(const u8* cur, u8* prev, size_t size, u32 wordSize, u8* out)
+	{
+		switch (wordSize)
+		{
+			case 1: return encodeWords<u8>(cur, prev, size, out);
+			case 2: return encodeWords<u16>(cur, prev, size, out);
+			case 4: return encodeWords<u32>(cur, prev, size, out);
+			case 8: return encodeWords<u64>(cur, prev, size, out);
+		}
+		assert(0);
+		return out;
+	}
+
+	const u8* decode(const u8* data, const u8* end, u8* dst, size_t size, u32 wordSize)
+	{
+		const u32 wordCount = u32(size / wordSize);
+		u32 w = 0;
+		while (w < wordCount)
+		{
+			u32 unchanged, changed;
+			data = readVarint(data, end, &unchanged);
+			if (data) { data = readVarint(data, end, &changed); }
+			if (!data || unchanged > wordCount - w) { return nullptr; }
+			w += unchanged;
+			if (changed > wordCount - w || size_t(end - data) < size_t(changed) * wordSize) { return nullptr; }
+
+			u8* out = dst + size_t(w) * wordSize;
+			const size_t changedSize = size_t(changed) * wordSize;
+			for (size_t i = 0; i < changedSize; i++)
+			{
+				out[i] ^= data[i];
+			}
+			data += changedSize;
+			w += changed;
+		}
+
+		const size_t tail = size - size_t(wordCount) * wordSize;
+		if (size_t(end - data) < tail) { return nullptr; }
+		for (size_t b = size - tail; b < size; b++)
+		{
+			dst[b] ^= *data++;
+		}
+		return data;
+	}
+
+	u8* writeVarint(u8* out, u32 value)
+	{
+		while (value >= 0x80)
+		{
+			*out++ = u8(value | 0x80);
+			value >>= 7;
+		}
+		*out++ = u8(value);
+		return out;
+	}
+
+	const u8* readVarint(const u8* data, const u8* end, u32* value)
+	{
+		*value = 0;
+		for (u32 shift = 0; data < end && shift < 32; shift += 7)
+		{
+			const u8 byte = *data++;
+			*value |= u32(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) { return data; }
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// XOR delta codec shared by frame recordings, snapshots and demos.
+// Data is compared a word at a time against the previous version and
+// stored as pairs of varints (unchanged words, changed words), each
+// followed by the changed words XOR the previous version. The pairs
+// cover every whole word, any bytes left over are stored as XOR bytes
+// at the end.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+namespace TFE_DeltaCodec
+{
+	enum
+	{
+		MAX_VARINT_SIZE = 5,
+	};
+
+	// Worst case size of encoding 'size' bytes: every other word changes.
+	size_t getMaxEncodedSize(size_t size, u32 wordSize);
+
+	// Encode 'cur' relative to 'prev', which is then updated to match 'cur'.
+	// If 'prev' is null the data is encoded relative to zeros, which only stores the non-zero words.
+	// 'wordSize' must be 1, 2, 4 or 8. Returns the end of the encoded data.
+	u8* encode(const u8* cur, u8* prev, size_t size, u32 wordSize, u8* out);
+	// XOR the encoded data into 'dst', which holds the previous version, to get the new version.
+	// Returns the end of the encoded data or null if it is corrupt.
+	const u8* decode(const u8* data, const u8* end, u8* dst, size_t size, u32 wordSize);
+
+	u8* writeVarint(u8* out, u32 value);
+	// Returns the data after the varint or null if it is truncated.
+	const u8* readVarint(const u8* data, const u8* end, u32* value);
+}
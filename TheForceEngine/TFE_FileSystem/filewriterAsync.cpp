@@ -1,8 +1,13 @@
-#pragma once
 #include "filewriterAsync.h"
+#include <TFE_FileSystem/filestream.h>
+#include <TFE_System/Threads/thread.h>
+#include <TFE_System/Threads/signal.h>
+#include <TFE_System/Threads/spscQueue.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <algorithm>
 #include <vector>
 
 #ifdef _WIN32
@@ -27,9 +32,9 @@ namespace FileWriterAsync
 	s32 s_freeRequests[MAX_REQUEST_COUNT];
 	s32 s_processRequest[MAX_REQUEST_COUNT];
 
-	std::atomic<s32> s_requestCount = 0;
-	std::atomic<s32> s_freeRequestCount = 0;
-	std::atomic<s32> s_processRequestCount = 0;
+	std::atomic<s32> s_requestCount{ 0 };
+	std::atomic<s32> s_freeRequestCount{ 0 };
+	std::atomic<s32> s_processRequestCount{ 0 };
 
 	void CALLBACK fileWrittenCallback(DWORD dwErrorCode, DWORD dwBytesTransferred, LPOVERLAPPED lpOverlapped)
 	{
@@ -47,7 +52,7 @@ namespace FileWriterAsync
 		}
 
 		request.buffer.clear();
-		s_freeRequests[s_freeRequestCount++] = id;
+		s_freeRequests[s_freeRequestCount++] = s32(id);
 	}
 
 	bool writeFileToDisk(const char* path, u8* data, size_t dataSize, FileWriteCompletionCallback completionCallback, void* userData)
@@ -75,7 +80,7 @@ namespace FileWriterAsync
 		request->callback = completionCallback;
 		request->userData = userData;
 
-		HANDLE hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, NULL);
+		HANDLE hFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, NULL);
 		if (hFile == INVALID_HANDLE_VALUE)
 		{
 			TFE_System::logWrite(LOG_ERROR, "AsyncFileWrite", "Cannot create file handle for: %s", path);
@@ -97,4 +102,166 @@ namespace FileWriterAsync
 		return true;
 	}
 #endif
+
+	//////////////////////////////////////////////////////////////////////
+	// Streams
+	//////////////////////////////////////////////////////////////////////
+	enum AsyncStreamConstants
+	{
+		ASYNC_STREAM_BLOCK_SIZE = 256 * 1024,
+		ASYNC_STREAM_MAX_BLOCKS = 64,	// Must be a power of two, up to 16 MB waiting to be written per stream.
+		ASYNC_STREAM_POLL_MS = 10,		// The worker polls for blocks so writing never wakes it directly.
+	};
+
+	struct StreamBlock
+	{
+		u8* data;
+		u32 size;
+	};
+
+	struct AsyncFileStream
+	{
+		FileStream file;
+		Thread* thread;
+		Signal* signal;
+		atomic_bool running;
+
+		SpscQueue<StreamBlock*, ASYNC_STREAM_MAX_BLOCKS> freeBlocks;	// Worker -> caller.
+		SpscQueue<StreamBlock*, ASYNC_STREAM_MAX_BLOCKS> readyBlocks;	// Caller -> worker.
+		StreamBlock* blocks[ASYNC_STREAM_MAX_BLOCKS];
+		u32 blockCount;
+		StreamBlock* curBlock;
+		size_t totalSize;
+	};
+
+	TFE_THREADRET TFE_STDCALL asyncStreamFunc(void* userData)
+	{
+		AsyncFileStream* stream = (AsyncFileStream*)userData;
+		bool running = true;
+		while (running)
+		{
+			stream->signal->wait(ASYNC_STREAM_POLL_MS);
+			// Read the flag before emptying the queue so no block pushed before closing is missed.
+			running = stream->running.load();
+
+			StreamBlock* block;
+			while (stream->readyBlocks.pop(&block))
+			{
+				stream->file.writeBuffer(block->data, block->size);
+				block->size = 0;
+				stream->freeBlocks.push(block);
+			}
+		}
+		return (TFE_THREADRET)0;
+	}
+
+	static void freeStream(AsyncFileStream* stream)
+	{
+		for (u32 i = 0; i < stream->blockCount; i++)
+		{
+			delete[] stream->blocks[i]->data;
+			delete stream->blocks[i];
+		}
+		delete stream->signal;
+		delete stream;
+	}
+
+	AsyncFileStream* openStream(const char* path)
+	{
+		AsyncFileStream* stream = new AsyncFileStream();
+		if (!stream->file.open(path, FileStream::MODE_WRITE))
+		{
+			TFE_System::logWrite(LOG_ERROR, "AsyncFileWrite", "Cannot open stream: %s", path);
+			delete stream;
+			return nullptr;
+		}
+		stream->blockCount = 0;
+		stream->curBlock = nullptr;
+		stream->totalSize = 0;
+		stream->signal = Signal::create();
+		stream->running.store(true);
+		stream->thread = Thread::create("AsyncFileStream", asyncStreamFunc, stream);
+		if (!stream->thread || !stream->thread->run())
+		{
+			TFE_System::logWrite(LOG_ERROR, "AsyncFileWrite", "Cannot start the stream thread for: %s", path);
+			delete stream->thread;
+			stream->file.close();
+			freeStream(stream);
+			return nullptr;
+		}
+		return stream;
+	}
+
+	static StreamBlock* getFreeBlock(AsyncFileStream* stream)
+	{
+		StreamBlock* block;
+		if (stream->freeBlocks.pop(&block))
+		{
+			return block;
+		}
+		if (stream->blockCount < ASYNC_STREAM_MAX_BLOCKS)
+		{
+			block = new StreamBlock();
+			block->data = new u8[ASYNC_STREAM_BLOCK_SIZE];
+			block->size = 0;
+			stream->blocks[stream->blockCount++] = block;
+			return block;
+		}
+		// The disk cannot keep up, wait rather than lose data.
+		while (!stream->freeBlocks.pop(&block))
+		{
+			stream->signal->fire();
+			TFE_System::sleep(1);
+		}
+		return block;
+	}
+
+	bool writeToStream(AsyncFileStream* stream, const void* data, size_t size)
+	{
+		if (!stream) { return false; }
+
+		const u8* src = (const u8*)data;
+		stream->totalSize += size;
+		while (size)
+		{
+			if (!stream->curBlock)
+			{
+				stream->curBlock = getFreeBlock(stream);
+			}
+			StreamBlock* block = stream->curBlock;
+			const u32 copySize = u32(std::min(size, size_t(ASYNC_STREAM_BLOCK_SIZE - block->size)));
+			memcpy(block->data + block->size, src, copySize);
+			block->size += copySize;
+			src  += copySize;
+			size -= copySize;
+
+			if (block->size == ASYNC_STREAM_BLOCK_SIZE)
+			{
+				stream->readyBlocks.push(block);
+				stream->curBlock = nullptr;
+			}
+		}
+		return true;
+	}
+
+	size_t closeStream(AsyncFileStream* stream)
+	{
+		if (!stream) { return 0; }
+		// Only the worker pushes to 'freeBlocks', an empty block is simply freed with the others below.
+		if (stream->curBlock && stream->curBlock->size)
+		{
+			stream->readyBlocks.push(stream->curBlock);
+		}
+		stream->curBlock = nullptr;
+
+		stream->running.store(false);
+		stream->signal->fire();
+		stream->thread->waitOnExit();
+		delete stream->thread;
+		stream->file.close();
+
+		const size_t totalSize = stream->totalSize;
+		freeStream(stream);
+		return totalSize;
+	}
 };
@@ -11,5 +11,15 @@ typedef void(*FileWriteCompletionCallback)(size_t bytesWritten, void* userData,
 
 namespace FileWriterAsync
 {
+	struct AsyncFileStream;
+
 	bool writeFileToDisk(const char* path, u8* data, size_t dataSize, FileWriteCompletionCallback completionCallback = nullptr, void* userData = nullptr);
+
+	// Streams a file that is written over time, such as a recording.
+	// Data is copied into blocks which are written to disk by a worker thread, so the caller only waits on the disk
+	// if it gets more than ASYNC_STREAM_MAX_BLOCKS behind. Each stream should only be written from one thread.
+	AsyncFileStream* openStream(const char* path);
+	bool writeToStream(AsyncFileStream* stream, const void* data, size_t size);
+	// Waits for the remaining data to be written and returns the total size of the file.
+	size_t closeStream(AsyncFileStream* stream);
 };
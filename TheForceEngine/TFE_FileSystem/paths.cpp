@@ -120,6 +120,18 @@ namespace TFE_Paths
 		snprintf(path, bufferLen, "%s%s", getPath(pathType), filename);
 	}
 
+	void getUserFilePath(const char* name, char* path, size_t bufferLen/* = TFE_MAX_PATH*/)
+	{
+		if (strchr(name, ':') || name[0] == '/' || name[0] == '\\')
+		{
+			snprintf(path, bufferLen, "%s", name);
+		}
+		else
+		{
+			appendPath(PATH_USER_DOCUMENTS, name, path, bufferLen);
+		}
+	}
+
 	void fixupPathAsDirectory(char* fullPath)
 	{
 		size_t len = strlen(fullPath);
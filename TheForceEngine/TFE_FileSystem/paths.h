@@ -38,6 +38,8 @@ namespace TFE_Paths
 	const char* getPath(TFE_PathType pathType);
 	bool hasPath(TFE_PathType pathType);
 	void appendPath(TFE_PathType pathType, const char* filename, char* path, size_t bufferLen = TFE_MAX_PATH);
+	// Absolute paths are used as-is, relative paths are placed in the user documents folder.
+	void getUserFilePath(const char* name, char* path, size_t bufferLen = TFE_MAX_PATH);
 	void fixupPathAsDirectory(char* fullPath);
 
 	void clearSearchPaths();
@@ -392,6 +392,26 @@ namespace TFE_Console
 		startClose();
 	}
 
+	void c_fixedTimeStep(const ConsoleArgList& args)
+	{
+		char msg[256];
+		if (args.size() > 1)
+		{
+			const f64 rate = strtod(args[1].c_str(), nullptr);
+			TFE_System::setFixedTimeStep(rate > 0.0 ? 1.0 / rate : 0.0);
+		}
+		const f64 timeStep = TFE_System::getFixedTimeStep();
+		if (timeStep > 0.0)
+		{
+			sprintf(msg, "Fixed time step: %0.2f fps", 1.0 / timeStep);
+		}
+		else
+		{
+			strcpy(msg, "Fixed time step disabled.");
+		}
+		s_history.push_back({ c_historyDefaultColor, msg });
+	}
+
 	void c_echo(const ConsoleArgList& args)
 	{
 		if (args.size() > 1 && args[1].length())
@@ -641,6 +661,7 @@ namespace TFE_Console
 		CCMD("clear", c_clear, 0, "Clear the console history.");
 		CCMD("cmdHelp", c_cmdHelp, 1, "Displays help/usage for the specified command - cmdHelp Cmd");
 		CCMD("exit", c_exit, 0, "Close the console.");
+		CCMD("fixedTimeStep", c_fixedTimeStep, 0, "Step game time at a fixed rate for reproducible sessions, 0 uses the real time - fixedTimeStep 60");
 		CCMD_NOREPEAT("echo", c_echo, 1, "Print the string to the console - echo \"String to print\"");
 		CCMD("list", c_list, 0, "Lists all console commands.");
 		CCMD("listVar", c_listVar, 0, "Lists all variables that can be read and/or modified.");
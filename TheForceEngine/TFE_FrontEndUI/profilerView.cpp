@@ -9,49 +9,108 @@
 #include <TFE_Ui/ui.h>
 #include <TFE_Ui/markdown.h>
 #include <TFE_System/parser.h>
+#include <TFE_FrontEndUI/console.h>
 
 #include <TFE_Ui/imGUI/imgui.h>
 #include <algorithm>
+#include <vector>
 
 namespace TFE_ProfilerView
 {
 	static bool s_open = false;
+	static bool s_flatView = false;
+
+	struct FlatZone
+	{
+		const char* name;
+		f64 timeSelfAve;
+	};
+	static std::vector<FlatZone> s_flatZones;
+
+	void profilerOverheadConsole(const ConsoleArgList& args);
+	void profilerTraceConsole(const ConsoleArgList& args);
+	void profilerFoldedConsole(const ConsoleArgList& args);
 
 	bool init()
 	{
+		CCMD("profilerOverhead", profilerOverheadConsole, 0, "Measure the cost of entering and leaving a profiler zone.");
+		CCMD("profilerFolded", profilerFoldedConsole, 0, "Write the time per zone path since the last call as folded stacks for flamegraph tools - profilerFolded stacks.txt");
+		CCMD("profilerTrace", profilerTraceConsole, 0, "Record frames to a Chrome trace (JSON) for Perfetto, stop early with no arguments - profilerTrace 300 trace.json");
 		return true;
 	}
 
-	void destroy()
+	void profilerOverheadConsole(const ConsoleArgList& args)
 	{
+		char res[256];
+		sprintf(res, "Profiler zone overhead: %0.1f ns per zone.", TFE_Profiler::measureZoneOverhead());
+		TFE_Console::addToHistory(res);
 	}
 
-	void update()
+	void profilerTraceConsole(const ConsoleArgList& args)
 	{
-		if (!s_open) { return; }
+		char res[TFE_MAX_PATH + 64];
+		if (args.size() < 2)
+		{
+			TFE_Profiler::stopTrace();
+			TFE_Console::addToHistory("Profiler trace stopped.");
+			return;
+		}
 
-		ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
-		ImGui::SetNextWindowSize(ImVec2(800, 768));
-		ImGui::Begin("Profiler View", &s_open);
+		const u32 frameCount = (u32)strtoul(args[1].c_str(), nullptr, 10);
+		char path[TFE_MAX_PATH];
+		if (args.size() >= 3)
+		{
+			strncpy(path, args[2].c_str(), TFE_MAX_PATH - 1);
+			path[TFE_MAX_PATH - 1] = 0;
+		}
+		else
+		{
+			TFE_Paths::appendPath(PATH_USER_DOCUMENTS, "trace.json", path);
+		}
 
-		ImGui::LabelText("##Label", "Counters");
-		ImGui::Separator();
-		u32 counterCount = TFE_Profiler::getCounterCount();
-		ImGui::Indent();
-		for (u32 c = 0; c < counterCount; c++)
+		if (TFE_Profiler::startTrace(path, frameCount))
 		{
-			TFE_CounterInfo info;
-			TFE_Profiler::getCounterInfo(c, &info);
-			ImGui::Text("%d", info.value); ImGui::SameLine(64);
-			ImGui::Text("%s", info.name);
+			sprintf(res, "Recording %u frames to \"%s\".", frameCount, path);
 		}
-		ImGui::Unindent();
+		else
+		{
+			sprintf(res, "Cannot start a trace, one is already recording or the frame count is 0.");
+		}
+		TFE_Console::addToHistory(res);
+	}
 
-		ImGui::Spacing();
-		ImGui::LabelText("##Label", "Zones");
-		ImGui::Separator();
+	void profilerFoldedConsole(const ConsoleArgList& args)
+	{
+		char res[TFE_MAX_PATH + 64];
+		char path[TFE_MAX_PATH];
+		if (args.size() >= 2)
+		{
+			strncpy(path, args[1].c_str(), TFE_MAX_PATH - 1);
+			path[TFE_MAX_PATH - 1] = 0;
+		}
+		else
+		{
+			TFE_Paths::appendPath(PATH_USER_DOCUMENTS, "stacks.txt", path);
+		}
 
-		const f64 timeInFrame = TFE_Profiler::getTimeInFrame();
+		if (TFE_Profiler::writeFoldedStacks(path))
+		{
+			sprintf(res, "Wrote folded stacks to \"%s\".", path);
+		}
+		else
+		{
+			sprintf(res, "Cannot write folded stacks to \"%s\".", path);
+		}
+		TFE_Console::addToHistory(res);
+	}
+
+	void destroy()
+	{
+	}
+
+	// Zones per call path, showing the inclusive time (and fraction of the parent) followed by the exclusive time.
+	void drawZoneTree(f64 timeInFrame)
+	{
 		ImGui::Indent();
 		ImGui::Text("%0.3fms", timeInFrame * 1000.0);
 		ImGui::SameLine(f32(128));
@@ -71,6 +130,8 @@ namespace TFE_ProfilerView
 
 			ImGui::Text("%0.3fms (%6.03f%%)", info.timeInZoneAve * 1000.0, info.fractOfParentAve * 100.0);
 			ImGui::SameLine(f32(180 + 16*(info.level + 1)));
+			ImGui::Text("%0.3fms", info.timeSelfAve * 1000.0);
+			ImGui::SameLine(f32(250 + 16*(info.level + 1)));
 			ImGui::Text("%s  [%s:%u]", info.name, info.func, info.lineNumber);
 
 			for (u32 l = 0; l < info.level; l++)
@@ -80,6 +141,152 @@ namespace TFE_ProfilerView
 		}
 		ImGui::Unindent();
 		ImGui::Unindent();
+	}
+
+	// Exclusive time summed over every path of each zone, most expensive first.
+	void drawFlatZones()
+	{
+		s_flatZones.clear();
+		const u32 zoneCount = TFE_Profiler::getZoneCount();
+		for (u32 z = 0; z < zoneCount; z++)
+		{
+			TFE_ZoneInfo info;
+			TFE_Profiler::getZoneInfo(z, &info);
+			if (info.zoneId >= s_flatZones.size())
+			{
+				s_flatZones.resize(info.zoneId + 1, { nullptr, 0.0 });
+			}
+			s_flatZones[info.zoneId].name = info.name;
+			s_flatZones[info.zoneId].timeSelfAve += info.timeSelfAve;
+		}
+		std::sort(s_flatZones.begin(), s_flatZones.end(), [](const FlatZone& a, const FlatZone& b) { return a.timeSelfAve > b.timeSelfAve; });
+
+		const f64 timeInFrame = TFE_Profiler::getTimeInFrame();
+		ImGui::Indent();
+		for (size_t z = 0; z < s_flatZones.size() && s_flatZones[z].name; z++)
+		{
+			ImGui::Text("%0.3fms (%6.03f%%)", s_flatZones[z].timeSelfAve * 1000.0, timeInFrame > 0.0 ? s_flatZones[z].timeSelfAve * 100.0 / timeInFrame : 0.0);
+			ImGui::SameLine(f32(180));
+			ImGui::Text("%s", s_flatZones[z].name);
+		}
+		ImGui::Unindent();
+	}
+
+	// Draw one row per thread showing its zones over the previous frame, nested zones are drawn below their parents.
+	void drawThreadTimelines(f64 timeInFrame)
+	{
+		static const ImU32 c_depthColors[] =
+		{
+			IM_COL32(64, 128, 200, 255),
+			IM_COL32(64, 180, 100, 255),
+			IM_COL32(200, 160, 48, 255),
+			IM_COL32(180, 80, 160, 255),
+		};
+		const f32 rowHeight = 14.0f;
+		const f32 labelWidth = 96.0f;
+
+		ImGui::Spacing();
+		ImGui::LabelText("##Label", "Threads");
+		ImGui::Separator();
+		if (timeInFrame <= 0.0) { return; }
+
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		const ImVec2 mouse = ImGui::GetIO().MousePos;
+		const u32 threadCount = TFE_Profiler::getThreadCount();
+		for (u32 t = 0; t < threadCount; t++)
+		{
+			TFE_ThreadInfo thread;
+			TFE_Profiler::getThreadInfo(t, &thread);
+
+			const ImVec2 origin = ImGui::GetCursorScreenPos();
+			const f32 width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 64.0f);
+			const f32 height = rowHeight * f32(thread.maxDepth + 1);
+			const f32 x0 = origin.x + labelWidth;
+			const f64 scale = f64(width) / timeInFrame;
+
+			if (thread.droppedEvents)
+			{
+				ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", thread.name);
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("%u events dropped this frame.", thread.droppedEvents);
+				}
+			}
+			else
+			{
+				ImGui::Text("%s", thread.name);
+			}
+			drawList->AddRectFilled(ImVec2(x0, origin.y), ImVec2(x0 + width, origin.y + height), IM_COL32(32, 32, 32, 255));
+
+			for (u32 i = 0; i < thread.intervalCount; i++)
+			{
+				const TFE_ZoneInterval& interval = thread.intervals[i];
+				const ImVec2 p0(x0 + f32(interval.start * scale), origin.y + rowHeight * f32(interval.depth));
+				const ImVec2 p1(std::max(x0 + f32(interval.end * scale), p0.x + 1.0f), p0.y + rowHeight - 1.0f);
+				drawList->AddRectFilled(p0, p1, c_depthColors[interval.depth & 3]);
+
+				const char* name = TFE_Profiler::getZoneName(interval.zoneId);
+				if (p1.x - p0.x > 32.0f)
+				{
+					drawList->PushClipRect(p0, p1, true);
+					drawList->AddText(ImVec2(p0.x + 2.0f, p0.y), IM_COL32(255, 255, 255, 255), name);
+					drawList->PopClipRect();
+				}
+				if (mouse.x >= p0.x && mouse.x < p1.x && mouse.y >= p0.y && mouse.y < p1.y)
+				{
+					ImGui::SetTooltip("%s\n%0.3fms (%0.3fms - %0.3fms)", name, (interval.end - interval.start) * 1000.0,
+						interval.start * 1000.0, interval.end * 1000.0);
+				}
+			}
+			ImGui::SetCursorScreenPos(ImVec2(origin.x, origin.y + height + 4.0f));
+			ImGui::Dummy(ImVec2(0.0f, 0.0f));
+		}
+	}
+
+	void update()
+	{
+		if (!s_open) { return; }
+
+		ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+		ImGui::SetNextWindowSize(ImVec2(800, 768));
+		ImGui::Begin("Profiler View", &s_open);
+
+		ImGui::LabelText("##Label", "Counters");
+		ImGui::Separator();
+		u32 counterCount = TFE_Profiler::getCounterCount();
+		ImGui::Indent();
+		for (u32 c = 0; c < counterCount; c++)
+		{
+			TFE_CounterInfo info;
+			TFE_Profiler::getCounterInfo(c, &info);
+			ImGui::Text("%d", info.value); ImGui::SameLine(64);
+			ImGui::Text("%s", info.name);
+		}
+		ImGui::Unindent();
+
+		ImGui::Spacing();
+		ImGui::LabelText("##Label", "Zones");
+		ImGui::Separator();
+
+		// Measure the zone overhead once when the view is first opened.
+		if (TFE_Profiler::getZoneOverhead() == 0.0)
+		{
+			TFE_Profiler::measureZoneOverhead();
+		}
+		ImGui::Text("Zone overhead: %0.1f ns", TFE_Profiler::getZoneOverhead());
+		ImGui::Checkbox("Flat (exclusive time per zone)", &s_flatView);
+
+		const f64 timeInFrame = TFE_Profiler::getTimeInFrame();
+		if (s_flatView)
+		{
+			drawFlatZones();
+		}
+		else
+		{
+			drawZoneTree(timeInFrame);
+		}
+
+		drawThreadTimelines(timeInFrame);
 
 		ImGui::End();
 	}
@@ -1,5 +1,6 @@
 #include "igame.h"
 #include <TFE_FrontEndUI/console.h>
+#include <TFE_System/system.h>
 #include <TFE_DarkForces/darkForcesMain.h>
 #include <TFE_Outlaws/outlawsMain.h>
 
@@ -36,6 +37,81 @@ void displayMemoryUsage(const ConsoleArgList& args)
 	TFE_Console::addToHistory("-------------------------------------------------------------------");
 }
 
+#ifdef TFE_MEMORY_ANALYTICS
+MemoryRegion* getRegionByName(const char* name)
+{
+	if (strcasecmp(name, "game") == 0) { return s_gameRegion; }
+	if (strcasecmp(name, "level") == 0) { return s_levelRegion; }
+	if (strcasecmp(name, "res") == 0 || strcasecmp(name, "resources") == 0) { return s_resRegion; }
+	return nullptr;
+}
+
+void displayMemoryStats(const ConsoleArgList& args)
+{
+	MemoryRegion* regions[] = { s_gameRegion, s_levelRegion, s_resRegion };
+	char res[256];
+	for (s32 r = 0; r < TFE_ARRAYSIZE(regions); r++)
+	{
+		if (!regions[r]) { continue; }
+
+		RegionStats stats;
+		region_getStats(regions[r], &stats);
+		TFE_Console::addToHistory("-------------------------------------------------------------------");
+		sprintf(res, "Region '%s': %zu used of %zu, %u live allocations", region_getName(regions[r]), stats.used, stats.capacity, stats.liveAllocCount);
+		TFE_Console::addToHistory(res);
+		sprintf(res, "Free: %zu bytes in %u slots, largest %zu, fragmentation %.1f%%", stats.freeBytes, stats.freeSlotCount, stats.largestFree, stats.fragmentation * 100.0f);
+		TFE_Console::addToHistory(res);
+		sprintf(res, "Blocks added: %u, failed allocations: %u", stats.newBlockCount, stats.failedAllocCount);
+		TFE_Console::addToHistory(res);
+		TFE_Console::addToHistory("Bin | Size Range    | Free Slots | Free Bytes | Allocs   | From Larger Bin");
+		for (s32 b = 0; b < REGION_BIN_COUNT; b++)
+		{
+			u32 minSize, maxSize;
+			region_getBinRange(b, &minSize, &maxSize);
+			char range[32];
+			if (b == REGION_BIN_COUNT - 1) { sprintf(range, "%u+", minSize); }
+			else { sprintf(range, "%u-%u", minSize, maxSize); }
+
+			sprintf(res, "%3d | %-13s | %10u | %10zu | %8u | %u", b, range, stats.binFreeSlots[b], stats.binFreeBytes[b], stats.binAllocCount[b], stats.binLargerCount[b]);
+			TFE_Console::addToHistory(res);
+		}
+	}
+	TFE_Console::addToHistory("-------------------------------------------------------------------");
+}
+
+// memoryTags [game|level|res] [count]
+// Shows the tags with the most live memory, the full list is written to the log.
+void displayMemoryTags(const ConsoleArgList& args)
+{
+	MemoryRegion* region = args.size() >= 2 ? getRegionByName(args[1].c_str()) : s_levelRegion;
+	const u32 count = args.size() >= 3 ? (u32)strtoul(args[2].c_str(), nullptr, 10) : 20;
+	if (!region)
+	{
+		TFE_Console::addToHistory("Unknown region, use game, level or res.");
+		return;
+	}
+
+	std::vector<RegionTagStats> tags;
+	region_getLiveAllocationsByTag(region, &tags);
+
+	char res[256];
+	TFE_System::logWrite(LOG_MSG, "Memory", "Live allocations in region '%s' by tag:", region_getName(region));
+	TFE_Console::addToHistory("-------------------------------------------------------------------");
+	TFE_Console::addToHistory("Size        | Count    | Tag");
+	TFE_Console::addToHistory("-------------------------------------------------------------------");
+	for (size_t i = 0; i < tags.size(); i++)
+	{
+		sprintf(res, "%11zu | %8u | %s", tags[i].size, tags[i].count, tags[i].tag.c_str());
+		if (i < count)
+		{
+			TFE_Console::addToHistory(res);
+		}
+		TFE_System::logWrite(LOG_MSG, "Memory", "%s", res);
+	}
+	TFE_Console::addToHistory("-------------------------------------------------------------------");
+}
+#endif
+
 void game_init()
 {
 	s_gameRegion  = region_create("game",  GAME_MEMORY_BASE);	// Region for "permanent" game allocations.
@@ -43,6 +119,10 @@ void game_init()
 	s_resRegion   = region_create("resources", RES_MEMORY_BASE);	// Region for "per-level" resource allocations.
 
 	CCMD("displayMemoryUsage", displayMemoryUsage, 0, "Display memory usage.");
+#ifdef TFE_MEMORY_ANALYTICS
+	CCMD("memoryStats", displayMemoryStats, 0, "Display fragmentation and per-bin allocation statistics for each memory region.");
+	CCMD("memoryTags", displayMemoryTags, 0, "Display the live allocations of a region by tag (defaults to level), the full list is written to the log - memoryTags res 50");
+#endif
 }
 
 void game_destroy()
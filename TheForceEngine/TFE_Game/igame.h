@@ -11,16 +11,28 @@ extern MemoryRegion* s_gameRegion;
 extern MemoryRegion* s_levelRegion;
 extern MemoryRegion* s_resRegion;	// Region for level-specific resources.
 
+#ifdef TFE_MEMORY_ANALYTICS
+#define game_alloc(size) TFE_Memory::region_allocTagged(s_gameRegion, size, __FILE__, __LINE__)
+#define game_realloc(ptr, size) TFE_Memory::region_reallocTagged(s_gameRegion, ptr, size, __FILE__, __LINE__)
+
+#define level_alloc(size) TFE_Memory::region_allocTagged(s_levelRegion, size, __FILE__, __LINE__)
+#define level_realloc(ptr, size) TFE_Memory::region_reallocTagged(s_levelRegion, ptr, size, __FILE__, __LINE__)
+
+#define res_alloc(size) TFE_Memory::region_allocTagged(s_resRegion, size, __FILE__, __LINE__)
+#define res_realloc(ptr, size) TFE_Memory::region_reallocTagged(s_resRegion, ptr, size, __FILE__, __LINE__)
+#else
 #define game_alloc(size) TFE_Memory::region_alloc(s_gameRegion, size)
 #define game_realloc(ptr, size) TFE_Memory::region_realloc(s_gameRegion, ptr, size)
-#define game_free(ptr) TFE_Memory::region_free(s_gameRegion, ptr)
 
 #define level_alloc(size) TFE_Memory::region_alloc(s_levelRegion, size)
 #define level_realloc(ptr, size) TFE_Memory::region_realloc(s_levelRegion, ptr, size)
-#define level_free(ptr) TFE_Memory::region_free(s_levelRegion, ptr)
 
 #define res_alloc(size) TFE_Memory::region_alloc(s_resRegion, size)
 #define res_realloc(ptr, size) TFE_Memory::region_realloc(s_resRegion, ptr, size)
+#endif
+
+#define game_free(ptr) TFE_Memory::region_free(s_gameRegion, ptr)
+#define level_free(ptr) TFE_Memory::region_free(s_levelRegion, ptr)
 #define res_free(ptr) TFE_Memory::region_free(s_resRegion, ptr)
 
 struct IGame
@@ -29,6 +41,8 @@ struct IGame
 	virtual void exitGame() = 0;
 	virtual void pauseGame(bool pause) = 0;
 	virtual void loopGame() {};
+	// Current game time in the game's own ticks, used to report the simulation rate.
+	virtual u32 getCurrentTick() { return 0; }
 		
 	GameID id;
 };
@@ -0,0 +1,339 @@
+#include "snapshot.h"
+#include "igame.h"
+#include <TFE_Memory/memoryRegion.h>
+#include <TFE_FileSystem/deltaCodec.h>
+#include <TFE_System/system.h>
+#include <TFE_System/Threads/thread.h>
+#include <TFE_System/Threads/signal.h>
+#include <TFE_System/Threads/spscQueue.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <string>
+
+using namespace TFE_Memory;
+
+namespace TFE_Snapshot
+{
+	enum SnapshotConstants
+	{
+		SNAPSHOT_HISTORY_MAX = 64,					// Must be a power of two.
+		SNAPSHOT_HISTORY_MAX_SIZE = 64 * 1024 * 1024,	// The oldest entries are dropped once the history is larger.
+		SNAPSHOT_WORD_SIZE = 8,
+		SNAPSHOT_REGION_GAME = 0,
+		SNAPSHOT_REGION_LEVEL,
+		SNAPSHOT_REGION_COUNT,
+	};
+
+	struct StateBlock
+	{
+		std::string name;
+		u8* data;
+		u32 size;
+	};
+
+	// The changes between a snapshot and the one before it. Region changes are stored as XOR so they can be
+	// reverted, they are compressed by the worker thread and must not be touched until 'compressed' is set.
+	struct HistoryEntry
+	{
+		std::vector<u8> changes[SNAPSHOT_REGION_COUNT];
+		std::vector<u8> prevState;
+		atomic_bool compressed;
+	};
+
+	static std::vector<StateBlock> s_stateBlocks;
+	static std::vector<u8> s_state;		// Registered state of the latest snapshot.
+	static RegionSnapshot* s_regionSnapshot[SNAPSHOT_REGION_COUNT] = { nullptr };
+	static bool s_hasSnapshot = false;
+	static std::deque<HistoryEntry*> s_history;
+
+	static Thread* s_thread = nullptr;
+	static Signal* s_signal = nullptr;
+	static atomic_bool s_running(false);
+	static SpscQueue<HistoryEntry*, SNAPSHOT_HISTORY_MAX> s_compressQueue;
+
+	static MemoryRegion* getRegion(s32 index)
+	{
+		return index == SNAPSHOT_REGION_GAME ? s_gameRegion : s_levelRegion;
+	}
+
+	void registerState(const char* name, void* data, u32 size)
+	{
+		for (size_t i = 0; i < s_stateBlocks.size(); i++)
+		{
+			if (s_stateBlocks[i].data == data) { return; }
+		}
+		s_stateBlocks.push_back({ name, (u8*)data, size });
+	}
+
+	static size_t getStateSize()
+	{
+		size_t size = 0;
+		for (size_t i = 0; i < s_stateBlocks.size(); i++)
+		{
+			size += s_stateBlocks[i].size;
+		}
+		return size;
+	}
+
+	/////////////////////////////////////////////
+	// Compression
+	// The changes are mostly zero since only part of each changed page is different, so they are delta encoded
+	// against zeros, which skips the runs of zero words: u32 size, then the encoded changes (see TFE_DeltaCodec).
+	/////////////////////////////////////////////
+	static void compress(const std::vector<u8>& src, std::vector<u8>& dst)
+	{
+		const u32 size = u32(src.size());
+		dst.resize(sizeof(u32) + TFE_DeltaCodec::getMaxEncodedSize(size, SNAPSHOT_WORD_SIZE));
+
+		u8* out = dst.data();
+		memcpy(out, &size, sizeof(u32));
+		out += sizeof(u32);
+		out = TFE_DeltaCodec::encode(src.data(), nullptr, size, SNAPSHOT_WORD_SIZE, out);
+
+		dst.resize(out - dst.data());
+		dst.shrink_to_fit();
+	}
+
+	static bool decompress(const std::vector<u8>& src, std::vector<u8>& dst)
+	{
+		if (src.size() < sizeof(u32)) { return false; }
+		u32 size;
+		memcpy(&size, src.data(), sizeof(u32));
+		dst.assign(size, 0);
+
+		const u8* end = src.data() + src.size();
+		return TFE_DeltaCodec::decode(src.data() + sizeof(u32), end, dst.data(), size, SNAPSHOT_WORD_SIZE) == end;
+	}
+
+	TFE_THREADRET TFE_STDCALL snapshotCompressFunc(void* userData)
+	{
+		std::vector<u8> buffer;
+		bool running = true;
+		while (running)
+		{
+			s_signal->wait();
+			// Read the flag before emptying the queue so no entry pushed before stopping is missed.
+			running = s_running.load();
+
+			HistoryEntry* entry;
+			while (s_compressQueue.pop(&entry))
+			{
+				for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+				{
+					compress(entry->changes[r], buffer);
+					entry->changes[r].swap(buffer);
+				}
+				entry->compressed.store(true);
+			}
+		}
+		return (TFE_THREADRET)0;
+	}
+
+	static bool startWorker()
+	{
+		if (s_thread) { return true; }
+		if (!s_signal)
+		{
+			s_signal = Signal::create();
+		}
+		s_running.store(true);
+		s_thread = Thread::create("SnapshotThread", snapshotCompressFunc, nullptr);
+		if (!s_thread || !s_thread->run())
+		{
+			TFE_System::logWrite(LOG_ERROR, "Snapshot", "Cannot start the snapshot compression thread.");
+			delete s_thread;
+			s_thread = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	static void stopWorker()
+	{
+		if (!s_thread) { return; }
+		s_running.store(false);
+		s_signal->fire();
+		s_thread->waitOnExit();
+		delete s_thread;
+		s_thread = nullptr;
+	}
+
+	// Entries are compressed in order, so once the newest is done the worker is idle.
+	static void waitForWorker()
+	{
+		while (!s_history.empty() && !s_history.back()->compressed.load())
+		{
+			s_signal->fire();
+			TFE_System::sleep(1);
+		}
+	}
+
+	static size_t getEntrySize(const HistoryEntry* entry)
+	{
+		return entry->changes[SNAPSHOT_REGION_GAME].size() + entry->changes[SNAPSHOT_REGION_LEVEL].size() + entry->prevState.size();
+	}
+
+	static void trimHistory()
+	{
+		size_t size = getHistorySize();
+		while (!s_history.empty() && (s_history.size() >= SNAPSHOT_HISTORY_MAX || size > SNAPSHOT_HISTORY_MAX_SIZE))
+		{
+			HistoryEntry* entry = s_history.front();
+			if (!entry->compressed.load())
+			{
+				waitForWorker();
+				size = getHistorySize();
+			}
+			size -= getEntrySize(entry);
+			delete entry;
+			s_history.pop_front();
+		}
+	}
+
+	/////////////////////////////////////////////
+	// API
+	/////////////////////////////////////////////
+	void reset()
+	{
+		waitForWorker();
+		for (size_t i = 0; i < s_history.size(); i++)
+		{
+			delete s_history[i];
+		}
+		s_history.clear();
+		for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+		{
+			region_destroySnapshot(s_regionSnapshot[r]);
+			s_regionSnapshot[r] = nullptr;
+		}
+		s_state.clear();
+		s_hasSnapshot = false;
+	}
+
+	void shutdown()
+	{
+		reset();
+		stopWorker();
+		delete s_signal;
+		s_signal = nullptr;
+		s_stateBlocks.clear();
+	}
+
+	bool save()
+	{
+		if (!s_gameRegion || !s_levelRegion || !startWorker()) { return false; }
+
+		HistoryEntry* entry = nullptr;
+		if (s_hasSnapshot)
+		{
+			trimHistory();
+			entry = new HistoryEntry();
+			entry->compressed.store(false);
+		}
+
+		for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+		{
+			if (!s_regionSnapshot[r])
+			{
+				s_regionSnapshot[r] = region_createSnapshot();
+			}
+			region_updateSnapshot(getRegion(r), s_regionSnapshot[r], entry ? &entry->changes[r] : nullptr);
+		}
+
+		if (entry)
+		{
+			entry->prevState.swap(s_state);
+		}
+		s_state.resize(getStateSize());
+		u8* state = s_state.data();
+		for (size_t i = 0; i < s_stateBlocks.size(); i++)
+		{
+			memcpy(state, s_stateBlocks[i].data, s_stateBlocks[i].size);
+			state += s_stateBlocks[i].size;
+		}
+
+		if (entry)
+		{
+			s_history.push_back(entry);
+			s_compressQueue.push(entry);
+			s_signal->fire();
+		}
+		s_hasSnapshot = true;
+		return true;
+	}
+
+	bool restore()
+	{
+		if (!s_hasSnapshot || s_state.size() != getStateSize()) { return false; }
+		// Check both regions before changing either of them.
+		for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+		{
+			if (!region_canRestoreSnapshot(getRegion(r), s_regionSnapshot[r]))
+			{
+				return false;
+			}
+		}
+		for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+		{
+			region_restoreSnapshot(getRegion(r), s_regionSnapshot[r]);
+		}
+
+		const u8* state = s_state.data();
+		for (size_t i = 0; i < s_stateBlocks.size(); i++)
+		{
+			memcpy(s_stateBlocks[i].data, state, s_stateBlocks[i].size);
+			state += s_stateBlocks[i].size;
+		}
+		return true;
+	}
+
+	bool rewind(u32 count)
+	{
+		if (!s_hasSnapshot || count > s_history.size()) { return false; }
+		waitForWorker();
+
+		std::vector<u8> changes;
+		for (u32 i = 0; i < count; i++)
+		{
+			HistoryEntry* entry = s_history.back();
+			for (s32 r = 0; r < SNAPSHOT_REGION_COUNT; r++)
+			{
+				if (!decompress(entry->changes[r], changes) || !region_revertSnapshot(s_regionSnapshot[r], changes.data(), changes.size()))
+				{
+					TFE_System::logWrite(LOG_ERROR, "Snapshot", "The rewind history is corrupt, clearing all snapshots.");
+					reset();
+					return false;
+				}
+			}
+			s_state.swap(entry->prevState);
+			delete entry;
+			s_history.pop_back();
+		}
+		return restore();
+	}
+
+	bool hasSnapshot()
+	{
+		return s_hasSnapshot;
+	}
+
+	u32 getHistoryCount()
+	{
+		return u32(s_history.size());
+	}
+
+	size_t getHistorySize()
+	{
+		size_t size = 0;
+		for (size_t i = 0; i < s_history.size(); i++)
+		{
+			// The size of an entry is only stable once it has been compressed.
+			if (s_history[i]->compressed.load())
+			{
+				size += getEntrySize(s_history[i]);
+			}
+		}
+		return size;
+	}
+}
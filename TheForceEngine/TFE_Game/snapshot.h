@@ -0,0 +1,35 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// The Force Engine Game Snapshots
+// In-memory snapshots of the game and level regions, used for
+// quick-save / quick-load and rewinding while testing levels.
+//
+// Global state that does not live in the regions (task list, game
+// time, random seed, ...) has to be registered so it is saved and
+// restored alongside them.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+#define SNAPSHOT_STATE(var) TFE_Snapshot::registerState(#var, &var, sizeof(var))
+
+namespace TFE_Snapshot
+{
+	// Register global state that is copied as-is when saving and restoring.
+	void registerState(const char* name, void* data, u32 size);
+	// Free the snapshots and unregister all of the state.
+	void shutdown();
+	// Free the snapshots but keep the registered state, for example when the level changes.
+	void reset();
+
+	// Save a snapshot, only the memory that changed since the previous snapshot is copied.
+	// The previous snapshot is kept in the rewind history, which is compressed on a background thread.
+	bool save();
+	// Restore the latest snapshot. Fails if the level changed since it was saved.
+	bool restore();
+	// Restore the snapshot 'count' steps before the latest, newer snapshots are discarded.
+	bool rewind(u32 count);
+
+	bool hasSnapshot();
+	u32  getHistoryCount();
+	size_t getHistorySize();
+}
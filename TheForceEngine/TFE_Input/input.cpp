@@ -335,6 +335,61 @@ namespace TFE_Input
 		return s_bufferedKey[key];
 	}
 
+	static void packBits(const u8* values, u32 count, u32* bits)
+	{
+		memset(bits, 0, sizeof(u32) * ((count + 31) >> 5));
+		for (u32 i = 0; i < count; i++)
+		{
+			if (values[i]) { bits[i >> 5] |= 1u << (i & 31); }
+		}
+	}
+
+	static void unpackBits(const u32* bits, u32 count, u8* values)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			values[i] = (bits[i >> 5] >> (i & 31)) & 1;
+		}
+	}
+
+	void getInputState(InputState* state)
+	{
+		static_assert(sizeof(state->bufferedText) == BUFFERED_TEXT_LEN, "Buffered text size mismatch.");
+		static_assert(CONTROLLER_BUTTON_COUNT <= 32 && MBUTTON_COUNT <= 32, "Too many buttons to store as bits.");
+
+		packBits(s_keyDown, KEY_COUNT, state->keyDown);
+		packBits(s_keyPressed, KEY_COUNT, state->keyPressed);
+		packBits(s_bufferedKey, KEY_COUNT, state->bufferedKey);
+		memcpy(state->bufferedText, s_bufferedText, BUFFERED_TEXT_LEN);
+		packBits(s_buttonDown, CONTROLLER_BUTTON_COUNT, &state->buttonDown);
+		packBits(s_buttonPressed, CONTROLLER_BUTTON_COUNT, &state->buttonPressed);
+		packBits(s_mouseDown, MBUTTON_COUNT, &state->mouseDown);
+		packBits(s_mousePressed, MBUTTON_COUNT, &state->mousePressed);
+		memcpy(state->axis, s_axis, sizeof(f32) * AXIS_COUNT);
+		memcpy(state->mouseWheel, s_mouseWheel, sizeof(s32) * 2);
+		memcpy(state->mouseMove, s_mouseMove, sizeof(s32) * 2);
+		memcpy(state->mouseMoveAccum, s_mouseMoveAccum, sizeof(s32) * 2);
+		memcpy(state->mousePos, s_mousePos, sizeof(s32) * 2);
+	}
+
+	void setInputState(const InputState* state)
+	{
+		unpackBits(state->keyDown, KEY_COUNT, s_keyDown);
+		unpackBits(state->keyPressed, KEY_COUNT, s_keyPressed);
+		unpackBits(state->bufferedKey, KEY_COUNT, s_bufferedKey);
+		memcpy(s_bufferedText, state->bufferedText, BUFFERED_TEXT_LEN);
+		s_bufferedText[BUFFERED_TEXT_LEN - 1] = 0;
+		unpackBits(&state->buttonDown, CONTROLLER_BUTTON_COUNT, s_buttonDown);
+		unpackBits(&state->buttonPressed, CONTROLLER_BUTTON_COUNT, s_buttonPressed);
+		unpackBits(&state->mouseDown, MBUTTON_COUNT, s_mouseDown);
+		unpackBits(&state->mousePressed, MBUTTON_COUNT, s_mousePressed);
+		memcpy(s_axis, state->axis, sizeof(f32) * AXIS_COUNT);
+		memcpy(s_mouseWheel, state->mouseWheel, sizeof(s32) * 2);
+		memcpy(s_mouseMove, state->mouseMove, sizeof(s32) * 2);
+		memcpy(s_mouseMoveAccum, state->mouseMoveAccum, sizeof(s32) * 2);
+		memcpy(s_mousePos, state->mousePos, sizeof(s32) * 2);
+	}
+
 	bool loadKeyNames(const char* path)
 	{
 		FileStream file;
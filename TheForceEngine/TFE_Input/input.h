@@ -16,6 +16,24 @@ typedef void(*KeyBindingCallback)(f32 value);
 
 namespace TFE_Input
 {
+	// The raw input state, used to record and replay input.
+	struct InputState
+	{
+		u32 keyDown[KEY_COUNT / 32];	// one bit per key.
+		u32 keyPressed[KEY_COUNT / 32];
+		u32 bufferedKey[KEY_COUNT / 32];
+		char bufferedText[64];
+		u32 buttonDown;		// controller buttons, one bit per button.
+		u32 buttonPressed;
+		u32 mouseDown;		// mouse buttons, one bit per button.
+		u32 mousePressed;
+		f32 axis[AXIS_COUNT];
+		s32 mouseWheel[2];
+		s32 mouseMove[2];
+		s32 mouseMoveAccum[2];
+		s32 mousePos[2];
+	};
+
 	// Call this once at the end of each frame
 	// to reset transient key events.
 	void endFrame();
@@ -66,6 +84,10 @@ namespace TFE_Input
 	Axis getControllerAnalogDown();
 	MouseButton getMouseButtonPressed();
 	
+	// Copy the full input state or replace it, for example when replaying recorded input.
+	void getInputState(InputState* state);
+	void setInputState(const InputState* state);
+	
 	bool loadKeyNames(const char* path);
 	const char* getControllerAxisName(Axis axis);
 	const char* getControllButtonName(Button button);
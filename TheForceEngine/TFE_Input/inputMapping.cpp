@@ -334,6 +334,16 @@ namespace TFE_Input
 		return s_actions[action];
 	}
 
+	void inputMapping_getActionStates(ActionState* states)
+	{
+		memcpy(states, s_actions, sizeof(ActionState) * IA_COUNT);
+	}
+
+	void inputMapping_setActionStates(const ActionState* states)
+	{
+		memcpy(s_actions, states, sizeof(ActionState) * IA_COUNT);
+	}
+
 	f32 inputMapping_getAnalogAxis(AnalogAxis axis)
 	{
 		if (!(s_inputConfig.controllerFlags & CFLAG_ENABLE))
@@ -170,6 +170,9 @@ namespace TFE_Input
 	void inputMapping_updateInput();
 	void inputMapping_removeState(InputAction action);
 	void inputMapping_endFrame();
+	// Copy or replace the state of all IA_COUNT actions, used to record and replay input.
+	void inputMapping_getActionStates(ActionState* states);
+	void inputMapping_setActionStates(const ActionState* states);
 
 	InputConfig* inputMapping_get();
 	u32 inputMapping_getBindingsForAction(InputAction action, u32* indices, u32 maxIndices);
@@ -0,0 +1,421 @@
+#include "replay.h"
+#include "input.h"
+#include "inputMapping.h"
+#include <TFE_System/system.h>
+#include <TFE_FileSystem/filestream.h>
+#include <TFE_FileSystem/filewriterAsync.h>
+#include <TFE_FileSystem/deltaCodec.h>
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+namespace TFE_Input
+{
+	//////////////////////////////////////////////////////////////////////
+	// File layout
+	//   ReplayHeader
+	//   Start data, ReplayHeader::startDataSize bytes.
+	//   Frames: varint payload size, then the ReplayFrame delta encoded a byte at a time against the previous
+	//           frame (see TFE_DeltaCodec). The first frame is relative to a zeroed frame.
+	//////////////////////////////////////////////////////////////////////
+	enum ReplayConstants
+	{
+		REPLAY_VERSION = 1,
+	};
+
+	enum ReplayMode
+	{
+		REPLAY_NONE = 0,
+		REPLAY_RECORD,
+		REPLAY_PLAY,
+	};
+
+	// Input settings that change how the game interprets the input.
+	struct ReplayInputConfig
+	{
+		u32 controllerFlags;
+		s32 axis[AA_COUNT];
+		f32 ctrlSensitivity[2];
+		u32 mouseFlags;
+		s32 mouseMode;
+		f32 mouseSensitivity[2];
+	};
+
+	struct ReplayHeader
+	{
+		char magic[4];
+		u32 version;
+		u32 actionCount;	// IA_COUNT when recorded.
+		u32 startDataSize;
+		ReplayInputConfig config;
+	};
+
+	struct ReplayFrame
+	{
+		f64 time;		// Relative to the start of the recording.
+		f64 dt;
+		u32 flags;		// See ReplayFrameFlags.
+		u32 hash;		// Game state hash at the end of the frame.
+		InputState input;
+		u8  actions[IA_COUNT];
+	};
+	static const char c_replayMagic[4] = { 'T', 'F', 'R', 'P' };
+
+	static ReplayMode s_mode = REPLAY_NONE;
+	static ReplayStateHashFunc s_hashFunc = nullptr;
+	static ReplayFrame s_frame;
+	static ReplayFrame s_prevFrame;
+	static bool s_frameActive = false;
+	static u32 s_frameIndex = 0;
+	static f64 s_startTime = 0.0;
+
+	// Recording
+	static FileWriterAsync::AsyncFileStream* s_stream = nullptr;
+	static std::vector<u8> s_encodeBuffer;
+
+	// Playback
+	static std::vector<u8> s_data;
+	static size_t s_readPos = 0;
+	static ReplayInputConfig s_savedConfig;
+	static s32 s_divergedFrame = -1;
+	static u64 s_prevFrameTicks = 0;
+	static std::vector<f32> s_frameTimes;
+
+	static void getInputConfig(ReplayInputConfig* config)
+	{
+		const InputConfig* inputConfig = inputMapping_get();
+		config->controllerFlags = inputConfig->controllerFlags;
+		for (s32 i = 0; i < AA_COUNT; i++)
+		{
+			config->axis[i] = s32(inputConfig->axis[i]);
+		}
+		config->ctrlSensitivity[0] = inputConfig->ctrlSensitivity[0];
+		config->ctrlSensitivity[1] = inputConfig->ctrlSensitivity[1];
+		config->mouseFlags = inputConfig->mouseFlags;
+		config->mouseMode = s32(inputConfig->mouseMode);
+		config->mouseSensitivity[0] = inputConfig->mouseSensitivity[0];
+		config->mouseSensitivity[1] = inputConfig->mouseSensitivity[1];
+	}
+
+	static void setInputConfig(const ReplayInputConfig* config)
+	{
+		InputConfig* inputConfig = inputMapping_get();
+		inputConfig->controllerFlags = config->controllerFlags;
+		for (s32 i = 0; i < AA_COUNT; i++)
+		{
+			inputConfig->axis[i] = Axis(config->axis[i]);
+		}
+		inputConfig->ctrlSensitivity[0] = config->ctrlSensitivity[0];
+		inputConfig->ctrlSensitivity[1] = config->ctrlSensitivity[1];
+		inputConfig->mouseFlags = config->mouseFlags;
+		inputConfig->mouseMode = MouseMode(config->mouseMode);
+		inputConfig->mouseSensitivity[0] = config->mouseSensitivity[0];
+		inputConfig->mouseSensitivity[1] = config->mouseSensitivity[1];
+	}
+
+	static void writeFrame()
+	{
+		u8* payload = s_encodeBuffer.data() + TFE_DeltaCodec::MAX_VARINT_SIZE;
+		u8* out = TFE_DeltaCodec::encode((const u8*)&s_frame, (u8*)&s_prevFrame, sizeof(ReplayFrame), 1, payload);
+
+		// Write the payload size in front of the payload.
+		const u32 payloadSize = u32(out - payload);
+		u8 sizeBytes[TFE_DeltaCodec::MAX_VARINT_SIZE];
+		const u32 sizeLen = u32(TFE_DeltaCodec::writeVarint(sizeBytes, payloadSize) - sizeBytes);
+		u8* start = payload - sizeLen;
+		memcpy(start, sizeBytes, sizeLen);
+		FileWriterAsync::writeToStream(s_stream, start, sizeLen + payloadSize);
+	}
+
+	static bool readFrame()
+	{
+		const u8* data = s_data.data() + s_readPos;
+		const u8* dataEnd = s_data.data() + s_data.size();
+		u32 payloadSize;
+		data = TFE_DeltaCodec::readVarint(data, dataEnd, &payloadSize);
+		if (!data || payloadSize > size_t(dataEnd - data))
+		{
+			return false;
+		}
+
+		const u8* end = data + payloadSize;
+		if (TFE_DeltaCodec::decode(data, end, (u8*)&s_prevFrame, sizeof(ReplayFrame), 1) != end)
+		{
+			return false;
+		}
+		s_readPos = size_t(end - s_data.data());
+
+		s_frame = s_prevFrame;
+		return true;
+	}
+
+	static void logFrameTimes()
+	{
+		if (s_frameTimes.empty()) { return; }
+		std::sort(s_frameTimes.begin(), s_frameTimes.end());
+
+		const size_t count = s_frameTimes.size();
+		f64 total = 0.0;
+		for (size_t i = 0; i < count; i++)
+		{
+			total += s_frameTimes[i];
+		}
+		TFE_System::logWrite(LOG_MSG, "Replay", "Frame times (ms): average %0.3f, median %0.3f, 95%% %0.3f, 99%% %0.3f, max %0.3f.",
+			total / f64(count), s_frameTimes[count / 2], s_frameTimes[count * 95 / 100], s_frameTimes[count * 99 / 100], s_frameTimes[count - 1]);
+	}
+
+	bool replay_startRecording(const char* path, const void* startData, u32 startDataSize, ReplayStateHashFunc hashFunc)
+	{
+		if (s_mode != REPLAY_NONE) { return false; }
+		s_stream = FileWriterAsync::openStream(path);
+		if (!s_stream)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Replay", "Cannot open \"%s\" for recording.", path);
+			return false;
+		}
+
+		ReplayHeader header = {};
+		memcpy(header.magic, c_replayMagic, 4);
+		header.version = REPLAY_VERSION;
+		header.actionCount = IA_COUNT;
+		header.startDataSize = startDataSize;
+		getInputConfig(&header.config);
+		FileWriterAsync::writeToStream(s_stream, &header, sizeof(ReplayHeader));
+		if (startDataSize)
+		{
+			FileWriterAsync::writeToStream(s_stream, startData, startDataSize);
+		}
+
+		s_encodeBuffer.resize(TFE_DeltaCodec::MAX_VARINT_SIZE + TFE_DeltaCodec::getMaxEncodedSize(sizeof(ReplayFrame), 1));
+		memset(&s_prevFrame, 0, sizeof(ReplayFrame));
+		s_hashFunc = hashFunc;
+		s_frameActive = false;
+		s_frameIndex = 0;
+		s_startTime = TFE_System::getTime();
+		s_mode = REPLAY_RECORD;
+
+		TFE_System::logWrite(LOG_MSG, "Replay", "Recording input to \"%s\".", path);
+		return true;
+	}
+
+	static bool readHeader(FileStream* file, const char* path, ReplayHeader* header)
+	{
+		if (!file->open(path, FileStream::MODE_READ))
+		{
+			TFE_System::logWrite(LOG_ERROR, "Replay", "Cannot open \"%s\".", path);
+			return false;
+		}
+		if (file->readBuffer(header, sizeof(ReplayHeader)) != sizeof(ReplayHeader) || memcmp(header->magic, c_replayMagic, 4) != 0 ||
+			header->version != REPLAY_VERSION || header->actionCount != IA_COUNT)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Replay", "\"%s\" is not a valid recording or was recorded by a different version.", path);
+			file->close();
+			return false;
+		}
+		return true;
+	}
+
+	bool replay_readStartData(const char* path, void* startData, u32 startDataSize)
+	{
+		FileStream file;
+		ReplayHeader header;
+		if (!readHeader(&file, path, &header)) { return false; }
+
+		bool result = header.startDataSize == startDataSize;
+		if (result && startDataSize)
+		{
+			result = file.readBuffer(startData, startDataSize) == startDataSize;
+		}
+		file.close();
+
+		if (!result)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Replay", "\"%s\" was recorded with a different game.", path);
+		}
+		return result;
+	}
+
+	bool replay_startPlayback(const char* path, ReplayStateHashFunc hashFunc)
+	{
+		if (s_mode != REPLAY_NONE) { return false; }
+
+		FileStream file;
+		ReplayHeader header;
+		if (!readHeader(&file, path, &header)) { return false; }
+
+		const size_t size = file.getSize();
+		const size_t framesStart = sizeof(ReplayHeader) + header.startDataSize;
+		if (size <= framesStart)
+		{
+			TFE_System::logWrite(LOG_ERROR, "Replay", "\"%s\" does not contain any frames.", path);
+			file.close();
+			return false;
+		}
+		s_data.resize(size - framesStart);
+		file.seek(u32(framesStart));
+		file.readBuffer(s_data.data(), u32(s_data.size()));
+		file.close();
+
+		getInputConfig(&s_savedConfig);
+		setInputConfig(&header.config);
+
+		memset(&s_prevFrame, 0, sizeof(ReplayFrame));
+		memset(&s_frame, 0, sizeof(ReplayFrame));
+		s_readPos = 0;
+		s_hashFunc = hashFunc;
+		s_frameActive = false;
+		s_frameIndex = 0;
+		s_divergedFrame = -1;
+		s_prevFrameTicks = 0;
+		s_frameTimes.clear();
+		s_startTime = TFE_System::getTime();
+		s_mode = REPLAY_PLAY;
+
+		TFE_System::logWrite(LOG_MSG, "Replay", "Playing back \"%s\".", path);
+		return true;
+	}
+
+	void replay_stop()
+	{
+		if (s_mode == REPLAY_RECORD)
+		{
+			const size_t size = FileWriterAsync::closeStream(s_stream);
+			s_stream = nullptr;
+			s_encodeBuffer.clear();
+			TFE_System::logWrite(LOG_MSG, "Replay", "Recorded %u frames, %u bytes.", s_frameIndex, u32(size));
+		}
+		else if (s_mode == REPLAY_PLAY)
+		{
+			setInputConfig(&s_savedConfig);
+
+			// Release everything that was held down in the recording.
+			InputState clearState = {};
+			ActionState clearActions[IA_COUNT] = {};
+			setInputState(&clearState);
+			inputMapping_setActionStates(clearActions);
+
+			if (s_divergedFrame < 0)
+			{
+				TFE_System::logWrite(LOG_MSG, "Replay", "Played back %u frames, the game state matched the recording.", s_frameIndex);
+			}
+			else
+			{
+				TFE_System::logWrite(LOG_WARNING, "Replay", "Played back %u frames, the game state diverged from the recording at frame %d.", s_frameIndex, s_divergedFrame);
+			}
+			logFrameTimes();
+
+			s_data.clear();
+			s_frameTimes.clear();
+		}
+		s_mode = REPLAY_NONE;
+		s_hashFunc = nullptr;
+		s_frameActive = false;
+	}
+
+	bool replay_isRecording()
+	{
+		return s_mode == REPLAY_RECORD;
+	}
+
+	bool replay_isPlaying()
+	{
+		return s_mode == REPLAY_PLAY;
+	}
+
+	u32 replay_beginFrame(u32 flags)
+	{
+		if (s_mode == REPLAY_RECORD)
+		{
+			// Clear the padding so it doesn't show up as changes.
+			memset(&s_frame, 0, sizeof(ReplayFrame));
+			s_frame.time = TFE_System::getTime() - s_startTime;
+			s_frame.dt = TFE_System::getDeltaTime();
+			s_frame.flags = flags;
+			getInputState(&s_frame.input);
+
+			// System actions are not replayed.
+			ActionState actions[IA_COUNT];
+			inputMapping_getActionStates(actions);
+			for (u32 i = IAS_COUNT; i < IA_COUNT; i++)
+			{
+				s_frame.actions[i] = u8(actions[i]);
+			}
+			s_frameActive = true;
+			return flags;
+		}
+		else if (s_mode == REPLAY_PLAY)
+		{
+			// Hold the playback while the game is paused for real, such as when the console is open.
+			if (flags & REPLAY_FRAME_PAUSED)
+			{
+				TFE_System::setFrameTime(s_startTime + s_frame.time, 0.0);
+				return s_frame.flags;
+			}
+			if (!readFrame())
+			{
+				TFE_System::logWrite(LOG_ERROR, "Replay", "The recording is corrupt at frame %u.", s_frameIndex);
+				replay_stop();
+				return 0;
+			}
+
+			// Keep the system actions live so the console and system menu can still be used.
+			ActionState actions[IA_COUNT];
+			inputMapping_getActionStates(actions);
+			for (u32 i = IAS_COUNT; i < IA_COUNT; i++)
+			{
+				actions[i] = ActionState(s_frame.actions[i]);
+			}
+			inputMapping_setActionStates(actions);
+			setInputState(&s_frame.input);
+			TFE_System::setFrameTime(s_startTime + s_frame.time, s_frame.dt);
+
+			// Real frame times, from the start of one replayed frame to the next.
+			const u64 ticks = TFE_System::getCurrentTimeInTicks();
+			if (s_prevFrameTicks)
+			{
+				s_frameTimes.push_back(f32(TFE_System::convertFromTicksToSeconds(ticks - s_prevFrameTicks) * 1000.0));
+			}
+			s_prevFrameTicks = ticks;
+
+			s_frameActive = true;
+			return s_frame.flags;
+		}
+		return flags;
+	}
+
+	void replay_endFrame()
+	{
+		if (!s_frameActive) { return; }
+		s_frameActive = false;
+
+		const u32 hash = s_hashFunc ? s_hashFunc() : 0;
+		if (s_mode == REPLAY_RECORD)
+		{
+			s_frame.hash = hash;
+			writeFrame();
+		}
+		else if (s_mode == REPLAY_PLAY && hash != s_frame.hash && s_divergedFrame < 0)
+		{
+			s_divergedFrame = s32(s_frameIndex);
+			TFE_System::logWrite(LOG_WARNING, "Replay", "The game state diverged from the recording at frame %u (time %0.3f).", s_frameIndex, s_frame.time);
+		}
+		s_frameIndex++;
+
+		if (s_mode == REPLAY_PLAY && s_readPos >= s_data.size())
+		{
+			replay_stop();
+		}
+	}
+
+	u32 replay_hash(const void* data, size_t size, u32 hash)
+	{
+		const u8* bytes = (const u8*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// The Force Engine Input Replay
+// Records the input and frame time of every game frame so a play
+// session can be replayed exactly, for example to compare the frame
+// times of different builds on the same firefight.
+//
+// The game provides a block of start data (level, random seed, ...)
+// that is stored in the header, and a hash of its state that is
+// stored every frame. Playback reports the first frame where the
+// hashes differ.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+namespace TFE_Input
+{
+	enum ReplayFrameFlags
+	{
+		REPLAY_FRAME_PAUSED = FLAG_BIT(0),	// The game was paused by the system UI, such as the console.
+	};
+
+	// Returns a hash of the game state, called at the end of every recorded or replayed frame.
+	typedef u32(*ReplayStateHashFunc)();
+
+	static const u32 c_replayHashInit = 2166136261u;
+
+	// 'startData' is stored as-is, the game uses it on playback to setup the same starting state.
+	bool replay_startRecording(const char* path, const void* startData, u32 startDataSize, ReplayStateHashFunc hashFunc);
+	// Read the start data of a recording, so the game can setup the starting state before playback begins.
+	bool replay_readStartData(const char* path, void* startData, u32 startDataSize);
+	// Playback begins with the next frame, real input is ignored by the game until it ends.
+	bool replay_startPlayback(const char* path, ReplayStateHashFunc hashFunc);
+	// Finish the recording or playback, playback also stops by itself after the last frame.
+	void replay_stop();
+
+	bool replay_isRecording();
+	bool replay_isPlaying();
+
+	// Called before the game updates, once the frame time and input are known.
+	// When recording the input and 'flags' are stored, when playing they are replaced by the recorded values
+	// and the recorded flags are returned (see ReplayFrameFlags).
+	u32  replay_beginFrame(u32 flags);
+	// Called after the game updates, the state hash is stored or checked against the recording.
+	void replay_endFrame();
+
+	// FNV-1a, can be chained by passing the previous hash.
+	u32 replay_hash(const void* data, size_t size, u32 hash = c_replayHashInit);
+}
@@ -22,6 +22,8 @@
 #include <TFE_DarkForces/player.h>
 #include <TFE_DarkForces/time.h>
 #include "infTypesInternal.h"
+#include <algorithm>
+#include <assert.h>
 // Include update functions
 #include "infElevatorUpdateFunc.h"
 
@@ -56,6 +58,13 @@ namespace TFE_Jedi
 	static Task* s_infElevTask = nullptr;
 	static Task* s_infTriggerTask = nullptr;
 	static Task* s_teleportTask = nullptr;
+
+	// TFE: Elevators that may need to be updated, in the same order as s_infElevators.
+	// Idle elevators (master off or holding) are removed by the update loop and are added back
+	// when they receive a message, so the update only visits elevators that are moving or waiting on a timed delay.
+	static std::vector<InfElevator*> s_activeElevators;
+	static s32 s_activeElevIter = -1;
+	static u32 s_elevUpdateOrder = 0;
 	
 	static std::vector<char> s_buffer;
 	// Loading
@@ -74,6 +83,9 @@ namespace TFE_Jedi
 	void infElevatorMsgFunc(MessageType msgType);
 	void infTriggerMsgFunc(MessageType msgType);
 	void inf_handleTriggerMsg(InfTrigger* trigger);
+	void inf_addActiveElevator(InfElevator* elev);
+	void inf_removeActiveElevator(InfElevator* elev);
+	void inf_wakeElevator(InfElevator* elev);
 	
 	void deleteElevator(InfElevator* elev);
 	void deleteTrigger(InfTrigger* trigger);
@@ -125,6 +137,9 @@ namespace TFE_Jedi
 	{
 		s_infElevators   = nullptr;
 		s_infElevTask    = nullptr;
+		s_activeElevators.clear();
+		s_activeElevIter = -1;
+		s_elevUpdateOrder = 0;
 		s_teleportTask   = nullptr;
 		s_infTeleports   = nullptr;
 		s_infTriggerTask = nullptr;
@@ -134,7 +149,7 @@ namespace TFE_Jedi
 
 	void inf_createElevatorTask()
 	{
-		s_infElevators = allocator_create(sizeof(InfElevator));
+		s_infElevators = allocator_createSlab(sizeof(InfElevator), 64, "INF Elevator");
 		s_infElevTask = createSubTask("elevator", inf_elevatorTaskFunc, inf_elevatorTaskLocal);
 	}
 
@@ -201,7 +216,11 @@ namespace TFE_Jedi
 	{
 		if (!elev || !elev->stops)
 		{
-			if (elev) { elev->nextTick = s_curTick; }
+			if (elev)
+			{
+				elev->nextTick = s_curTick;
+				inf_wakeElevator(elev);
+			}
 			return;
 		}
 		Stop* stop = (Stop*)allocator_getByIndex(elev->stops, stopIndex);
@@ -243,6 +262,7 @@ namespace TFE_Jedi
 
 		// Setup the next stop.
 		elev->nextStop = inf_advanceStops(elev->stops, 0, 1);
+		inf_wakeElevator(elev);
 	}
 		
 	InfElevator* inf_allocateElevItem(RSector* sector, InfElevatorType type)
@@ -270,6 +290,11 @@ namespace TFE_Jedi
 		elev->sound1 = NULL_SOUND;
 		elev->sound2 = NULL_SOUND;
 
+		// New elevators start in the active set, if they turn out to be idle they are removed on the first update.
+		elev->updateOrder = s_elevUpdateOrder++;
+		elev->active = JFALSE;
+		inf_addActiveElevator(elev);
+
 		if (type > IELEV_CHANGE_WALL_LIGHT)
 		{
 			return elev;
@@ -1205,6 +1230,7 @@ namespace TFE_Jedi
 	// Move back to asset later.
 	JBool inf_load(const char* levelName)
 	{
+		const u64 loadStart = TFE_System::getCurrentTimeInTicks();
 		char levelPath[TFE_MAX_PATH];
 		strcpy(levelPath, levelName);
 		strcat(levelPath, ".INF");
@@ -1394,6 +1420,8 @@ namespace TFE_Jedi
 			}
 		}  // for (s32 i = 0; i < itemCount; i++)
 
+		const f64 loadTime = TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - loadStart);
+		TFE_System::logWrite(LOG_MSG, "level_loadINF", "Loaded INF '%s' with %d items in %0.3f ms.", levelPath, itemCount, loadTime * 1000.0);
 		return JTRUE;
 	}
 
@@ -1419,6 +1447,131 @@ namespace TFE_Jedi
 	{
 		infElevatorMsgFunc(msg);
 	}
+
+	// An elevator is idle if it cannot pass the update check until it receives a message.
+	static JBool inf_isElevatorIdle(InfElevator* elev)
+	{
+		return (!(elev->updateFlags & ELEV_MASTER_ON) || elev->nextTick == DELAY_SLEEP) ? JTRUE : JFALSE;
+	}
+
+	static bool inf_elevatorOrderLess(const InfElevator* a, const InfElevator* b)
+	{
+		return a->updateOrder < b->updateOrder;
+	}
+
+	void inf_addActiveElevator(InfElevator* elev)
+	{
+		if (elev->active) { return; }
+		elev->active = JTRUE;
+
+		// Insert in list order so the update order matches iterating through s_infElevators.
+		std::vector<InfElevator*>::iterator iPos = std::upper_bound(s_activeElevators.begin(), s_activeElevators.end(), elev, inf_elevatorOrderLess);
+		const s32 index = s32(iPos - s_activeElevators.begin());
+		s_activeElevators.insert(iPos, elev);
+
+		// Keep the update loop pointing at the same elevator, like the allocator iterator.
+		if (index <= s_activeElevIter)
+		{
+			s_activeElevIter++;
+		}
+	}
+
+	void inf_removeActiveElevator(InfElevator* elev)
+	{
+		if (!elev->active) { return; }
+		elev->active = JFALSE;
+
+		std::vector<InfElevator*>::iterator iPos = std::lower_bound(s_activeElevators.begin(), s_activeElevators.end(), elev, inf_elevatorOrderLess);
+		assert(iPos != s_activeElevators.end() && *iPos == elev);
+		const s32 index = s32(iPos - s_activeElevators.begin());
+		s_activeElevators.erase(iPos);
+
+		if (index <= s_activeElevIter)
+		{
+			s_activeElevIter--;
+		}
+	}
+
+	void inf_rebuildActiveSet()
+	{
+		s_activeElevators.clear();
+		s_activeElevIter = -1;
+		s_elevUpdateOrder = 0;
+		if (!s_infElevators) { return; }
+
+		// The active flags are restored with the level region, so they describe the set at the time of the snapshot.
+		InfElevator* elev = (InfElevator*)allocator_getHead(s_infElevators);
+		while (elev)
+		{
+			if (elev->active)
+			{
+				s_activeElevators.push_back(elev);
+			}
+			if (elev->updateOrder >= s_elevUpdateOrder)
+			{
+				s_elevUpdateOrder = elev->updateOrder + 1;
+			}
+			elev = (InfElevator*)allocator_getNext(s_infElevators);
+		}
+		std::sort(s_activeElevators.begin(), s_activeElevators.end(), inf_elevatorOrderLess);
+	}
+
+	s32 inf_checkActiveSet()
+	{
+		if (!s_infElevators) { return 0; }
+
+		s32 errorCount = 0;
+		const s32 count = (s32)s_activeElevators.size();
+		for (s32 i = 0; i < count; i++)
+		{
+			// Entries must be unique, in update order and flagged as active.
+			if (!s_activeElevators[i]->active || (i > 0 && !inf_elevatorOrderLess(s_activeElevators[i - 1], s_activeElevators[i])))
+			{
+				errorCount++;
+			}
+		}
+		InfElevator* elev = (InfElevator*)allocator_getHead(s_infElevators);
+		while (elev)
+		{
+			if (elev->active && !std::binary_search(s_activeElevators.begin(), s_activeElevators.end(), elev, inf_elevatorOrderLess))
+			{
+				errorCount++;
+			}
+			elev = (InfElevator*)allocator_getNext(s_infElevators);
+		}
+		return errorCount;
+	}
+
+	InfElevator* inf_getMovingElevator()
+	{
+		const s32 count = (s32)s_activeElevators.size();
+		for (s32 i = 0; i < count; i++)
+		{
+			if (inf_isElevatorMoving(s_activeElevators[i]))
+			{
+				return s_activeElevators[i];
+			}
+		}
+		return nullptr;
+	}
+
+	JBool inf_isElevatorMoving(InfElevator* elev)
+	{
+		return (elev->updateFlags & ELEV_MOVING) && !inf_isElevatorIdle(elev) ? JTRUE : JFALSE;
+	}
+
+	Stop* inf_getElevatorNextStop(InfElevator* elev)
+	{
+		return elev->nextStop;
+	}
+
+	void inf_wakeElevator(InfElevator* elev)
+	{
+		if (!elev->active && !inf_isElevatorIdle(elev))
+		{
+			inf_addActiveElevator(elev);
+		}
+	}
 			
 	// Per frame update.
 	void inf_elevatorTaskFunc(MessageType msg)
@@ -1440,11 +1593,17 @@ namespace TFE_Jedi
 			}
 			else  // id == 0
 			{
-				taskCtx->elev = (InfElevator*)allocator_getHead(s_infElevators);
-				while (taskCtx->elev)
+				// Only elevators in the active set are visited, idle elevators are removed as they are found.
+				s_activeElevIter = 0;
+				while (s_activeElevIter < (s32)s_activeElevators.size())
 				{
+					taskCtx->elev = s_activeElevators[s_activeElevIter];
 					taskCtx->elevDeleted = 0;
-					if ((taskCtx->elev->updateFlags & ELEV_MASTER_ON) && taskCtx->elev->nextTick < s_curTick)
+					if (inf_isElevatorIdle(taskCtx->elev))
+					{
+						inf_removeActiveElevator(taskCtx->elev);
+					}
+					else if ((taskCtx->elev->updateFlags & ELEV_MASTER_ON) && taskCtx->elev->nextTick < s_curTick)
 					{
 						// If not already moving, get started.
 						if (!(taskCtx->elev->updateFlags & ELEV_MOVING) && !taskCtx->elevDeleted)
@@ -1554,8 +1713,9 @@ namespace TFE_Jedi
 					} // ((elev->updateFlags & ELEV_MASTER_ON) && elev->nextTick < s_curTick)
 
 					// Next elevator.
-					taskCtx->elev = (InfElevator*)allocator_getNext(s_infElevators);
+					s_activeElevIter++;
 				} // while (elev)
+				s_activeElevIter = -1;
 			}  // id == 0 (main elevator update loop)
 			task_yield(TASK_NO_DELAY);
 		}  // while (id != -1)
@@ -2563,7 +2723,7 @@ namespace TFE_Jedi
 		}
 	}
 
-	void infElevatorMessageInternal(MessageType msgType)
+	void infElevatorHandleMessage(MessageType msgType)
 	{
 		u32 event = s_msgEvent;
 		InfElevator* elev = (InfElevator*)s_msgTarget;
@@ -2777,6 +2937,14 @@ namespace TFE_Jedi
 		}
 	}
 
+	void infElevatorMessageInternal(MessageType msgType)
+	{
+		InfElevator* elev = (InfElevator*)s_msgTarget;
+		infElevatorHandleMessage(msgType);
+		// Messages such as MSG_TRIGGER, MSG_NEXT_STOP and MSG_MASTER_ON may wake up an idle elevator.
+		inf_wakeElevator(elev);
+	}
+
 	void infElevatorMsgFunc(MessageType msgType)
 	{
 		if (msgType == MSG_FREE)
@@ -2945,6 +3113,7 @@ namespace TFE_Jedi
 			allocator_free(elev->stops);
 		}
 		inf_deleteSectorElevatorLink(elev->sector, elev);
+		inf_removeActiveElevator(elev);
 		allocator_deleteItem(s_infElevators, elev);
 	}
 		
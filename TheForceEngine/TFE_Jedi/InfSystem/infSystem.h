@@ -28,6 +28,8 @@ struct SecObject;
 
 namespace TFE_Jedi
 {
+	struct Stop;
+
 	bool inf_init();
 	void inf_shutdown();
 	void inf_clearState();
@@ -61,6 +63,15 @@ namespace TFE_Jedi
 
 	// Get the moving elevator velocity.
 	void inf_getMovingElevatorVelocity(InfElevator* elev, vec3_fixed* vel, fixed16_16* speed);
+
+	// TFE: The set of elevators to update lives outside of the level region, rebuild it after a snapshot is restored.
+	void inf_rebuildActiveSet();
+	// TFE: Returns the number of elevators whose active flag does not match the set, 0 if it is consistent.
+	s32 inf_checkActiveSet();
+	// TFE: Used to verify that elevators keep moving across snapshot restores.
+	InfElevator* inf_getMovingElevator();
+	JBool inf_isElevatorMoving(InfElevator* elev);
+	Stop* inf_getElevatorNextStop(InfElevator* elev);
 	
 	// ** Loadtime API **
 	// These functions are used at load-time to setup special elevators based on sector flags or load
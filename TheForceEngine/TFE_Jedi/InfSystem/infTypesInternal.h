@@ -187,5 +187,9 @@ namespace TFE_Jedi
 		SoundEffectID loopingSoundID;
 		s32 u54;
 		s32 updateFlags;
+
+		// TFE: Position in the elevator list and whether the elevator is in the active update set.
+		u32 updateOrder;
+		JBool active;
 	};
 }
\ No newline at end of file
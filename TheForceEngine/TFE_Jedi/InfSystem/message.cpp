@@ -13,6 +13,9 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <algorithm>
+#include <ctype.h>
+#include <unordered_map>
+#include <string>
 
 namespace TFE_Jedi
 {
@@ -23,9 +26,25 @@ namespace TFE_Jedi
 	u32 s_msgArg2;
 	u32 s_msgEvent;
 
+	// Case-insensitive index into s_messageAddr, so addresses can be found without walking the whole list.
+	// The addresses themselves still live in the allocator (level memory), the map only holds pointers.
+	typedef std::unordered_map<std::string, MessageAddress*> MessageAddrMap;
+	static MessageAddrMap s_messageAddrMap;
+
+	static std::string message_getKey(const char* name)
+	{
+		std::string key = name;
+		for (size_t i = 0; i < key.length(); i++)
+		{
+			key[i] = tolower(key[i]);
+		}
+		return key;
+	}
+
 	void message_free()
 	{
 		s_messageAddr = nullptr;
+		s_messageAddrMap.clear();
 	}
 
 	void message_addAddress(const char* name, s32 param0, s32 param1, RSector* sector)
@@ -42,18 +61,17 @@ namespace TFE_Jedi
 		msgAddr->param0 = param0;
 		msgAddr->param1 = param1;
 		msgAddr->sector = sector;
+
+		// If names are duplicated, the first address added wins - which matches the original linear search.
+		s_messageAddrMap.insert({ message_getKey(msgAddr->name), msgAddr });
 	}
 
 	MessageAddress* message_getAddress(const char* name)
 	{
-		MessageAddress* msgAddr = (MessageAddress*)allocator_getHead(s_messageAddr);
-		while (msgAddr)
+		MessageAddrMap::iterator iAddr = s_messageAddrMap.find(message_getKey(name));
+		if (iAddr != s_messageAddrMap.end())
 		{
-			if (strcasecmp(name, msgAddr->name) == 0)
-			{
-				return msgAddr;
-			}
-			msgAddr = (MessageAddress*)allocator_getNext(s_messageAddr);
+			return iAddr->second;
 		}
 
 		TFE_System::logWrite(LOG_ERROR, "INF", "Message_GetAddress: ADDRESS NOT FOUND: %s", name);
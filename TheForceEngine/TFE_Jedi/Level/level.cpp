@@ -95,6 +95,7 @@ namespace TFE_Jedi
 		s_fmeCount    = 0;
 		s_soundCount  = 0;
 		s_objectCount = 0;
+		object_clearPool();
 
 		s_controlSector = (RSector*)level_alloc(sizeof(RSector));
 		sector_clear(s_controlSector);
@@ -2,17 +2,37 @@
 #include "level.h"
 #include <TFE_Game/igame.h>
 #include <TFE_Jedi/Memory/allocator.h>
+#include <TFE_Memory/chunkedArray.h>
 #include <TFE_DarkForces/logic.h>
 
 namespace TFE_Jedi
 {
+	enum
+	{
+		OBJECT_POOL_CHUNK_SIZE = 256,
+	};
+
 	JBool s_freeObjLock = JFALSE;
+	// TFE: Objects are allocated from a pool in the level region, so freed objects are reused
+	// rather than leaving holes in the region.
+	static ChunkedArray* s_objectPool = nullptr;
 
 	void computeTransform3x3(fixed16_16* transform, angle14_32 yaw, angle14_32 pitch, angle14_32 roll);
 
+	void object_clearPool()
+	{
+		// The pool memory belongs to the level region, which is cleared between levels.
+		s_objectPool = nullptr;
+	}
+
 	SecObject* allocateObject()
 	{
-		SecObject* obj = (SecObject*)level_alloc(sizeof(SecObject));
+		if (!s_objectPool)
+		{
+			s_objectPool = TFE_Memory::createChunkedArray(sizeof(SecObject), OBJECT_POOL_CHUNK_SIZE, 1, s_levelRegion);
+			TFE_Memory::chunkedArrayTrackUsage(s_objectPool, "Object");
+		}
+		SecObject* obj = (SecObject*)TFE_Memory::allocFromChunkedArray(s_objectPool);
 		obj->yaw = 0;
 		obj->pitch = 0;
 		obj->roll = 0;
@@ -49,7 +69,7 @@ namespace TFE_Jedi
 
 		allocator_free((Allocator*)obj->logic);
 		sector_removeObject(obj);
-		level_free(obj);
+		TFE_Memory::freeToChunkedArray(s_objectPool, obj);
 
 		s_freeObjLock = JFALSE;
 	}
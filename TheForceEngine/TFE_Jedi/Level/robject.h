@@ -102,6 +102,8 @@ namespace TFE_Jedi
 {
 	SecObject* allocateObject();
 	void freeObject(SecObject* obj);
+	// Forget the object pool, called when the level memory has been cleared.
+	void object_clearPool();
 
 	// Spirits
 	void spirit_setData(SecObject* obj);
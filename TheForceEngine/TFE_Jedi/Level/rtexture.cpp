@@ -77,6 +77,7 @@ namespace TFE_Jedi
 		s_buffer.resize(size);
 		file.readBuffer(s_buffer.data(), (u32)size);
 		file.close();
+		TFE_MEMORY_TAG("Textures");
 
 		TextureData* texture = (TextureData*)region_alloc(s_memoryRegion, sizeof(TextureData));
 		const u8* data = s_buffer.data();
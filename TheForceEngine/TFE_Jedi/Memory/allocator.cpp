@@ -1,6 +1,7 @@
 #include "allocator.h"
 #include <TFE_System/system.h>
 #include <TFE_Game/igame.h>
+#include <TFE_Memory/chunkedArray.h>
 
 struct AllocHeader
 {
@@ -18,6 +19,14 @@ struct Allocator
 	s32 size;
 	s32 refCount;
 	s32* u1c;
+
+	// TFE: Live item count, so allocator_getCount() is O(1).
+	s32 count;
+	// TFE: Optional slab storage (see allocator_createSlab()).
+	ChunkedArray* slab;
+	// TFE: Set while the list order matches the slab order (no items have been deleted),
+	// which allows allocator_getByIndex() to skip the list walk.
+	JBool slabOrdered;
 };
 
 namespace TFE_Jedi
@@ -44,6 +53,19 @@ namespace TFE_Jedi
 		res->refCount = 0;
 		res->u1c = nullptr;
 
+		res->count = 0;
+		res->slab = nullptr;
+		res->slabOrdered = JFALSE;
+
+		return res;
+	}
+
+	Allocator* allocator_createSlab(s32 allocSize, s32 itemsPerChunk, const char* name)
+	{
+		Allocator* res = allocator_create(allocSize);
+		res->slab = TFE_Memory::createChunkedArray(res->size, itemsPerChunk, 1, s_levelRegion);
+		TFE_Memory::chunkedArrayTrackUsage(res->slab, name);
+		res->slabOrdered = JTRUE;
 		return res;
 	}
 
@@ -51,11 +73,19 @@ namespace TFE_Jedi
 	{
 		if (!alloc) { return; }
 
-		void* item = allocator_getHead(alloc);
-		while (item)
+		if (alloc->slab)
 		{
-			allocator_deleteItem(alloc, item);
-			item = allocator_getNext(alloc);
+			// Items live inside of the slab chunks, so there is no need to free them individually.
+			TFE_Memory::freeChunkedArray(alloc->slab);
+		}
+		else
+		{
+			void* item = allocator_getHead(alloc);
+			while (item)
+			{
+				allocator_deleteItem(alloc, item);
+				item = allocator_getNext(alloc);
+			}
 		}
 
 		alloc->self = (Allocator*)ALLOC_INVALID_PTR;
@@ -67,7 +97,15 @@ namespace TFE_Jedi
 	{
 		if (!alloc) { return nullptr; }
 
-		AllocHeader* header = (AllocHeader*)level_alloc(alloc->size);
+		AllocHeader* header;
+		if (alloc->slab)
+		{
+			header = (AllocHeader*)TFE_Memory::allocFromChunkedArray(alloc->slab);
+		}
+		else
+		{
+			header = (AllocHeader*)level_alloc(alloc->size);
+		}
 		header->next = ALLOC_INVALID_PTR;
 		header->prev = alloc->tail;
 
@@ -81,6 +119,7 @@ namespace TFE_Jedi
 		{
 			alloc->head = header;
 		}
+		alloc->count++;
 
 		return ((u8*)header + sizeof(AllocHeader));
 	}
@@ -107,21 +146,24 @@ namespace TFE_Jedi
 		{
 			alloc->iterPrev = header->next;
 		}
+		alloc->count--;
 
-		level_free(header);
+		if (alloc->slab)
+		{
+			// Freed slots are reused out of order, so indices no longer map directly to slots.
+			alloc->slabOrdered = JFALSE;
+			TFE_Memory::freeToChunkedArray(alloc->slab, header);
+		}
+		else
+		{
+			level_free(header);
+		}
 	}
 
 	// Random access.
 	s32 allocator_getCount(Allocator* alloc)
 	{
-		s32 count = 0;
-		AllocHeader* header = alloc->head;
-		while (header != ALLOC_INVALID_PTR)
-		{
-			count++;
-			header = header->next;
-		}
-		return count;
+		return alloc->count;
 	}
 
 	void* allocator_getByIndex(Allocator* alloc, s32 index)
@@ -129,6 +171,11 @@ namespace TFE_Jedi
 		if (!alloc) { return nullptr; }
 
 		AllocHeader* header = alloc->head;
+		if (alloc->slabOrdered && index >= 0 && index < alloc->count)
+		{
+			header = (AllocHeader*)TFE_Memory::chunkedArrayGet(alloc->slab, index);
+			index = 0;
+		}
 		while (index > 0 && header != ALLOC_INVALID_PTR)
 		{
 			index--;
@@ -10,6 +10,10 @@ namespace TFE_Jedi
 {
 	// Create and free an allocator.
 	Allocator* allocator_create(s32 allocSize);
+	// Create a slab-backed allocator, items are stored contiguously in chunks of 'itemsPerChunk' items
+	// rather than being allocated one at a time. The API and iteration semantics are otherwise identical.
+	// Slab usage is reported as profiler counters under 'name'.
+	Allocator* allocator_createSlab(s32 allocSize, s32 itemsPerChunk, const char* name);
 	void allocator_free(Allocator* alloc);
 
 	// Allocate and free individual items.
@@ -18,6 +18,8 @@
 #include <TFE_Asset/spriteAsset_Jedi.h>
 #include <TFE_Asset/modelAsset_jedi.h>
 #include <TFE_FrontEndUI/console.h>
+#include <TFE_FileSystem/paths.h>
+#include <TFE_Asset/frameRecording.h>
 
 namespace TFE_Jedi
 {
@@ -34,6 +36,9 @@ namespace TFE_Jedi
 	void clear1dDepth();
 	void console_setSubRenderer(const std::vector<std::string>& args);
 	void console_getSubRenderer(const std::vector<std::string>& args);
+	void console_recordStart(const std::vector<std::string>& args);
+	void console_recordStop(const std::vector<std::string>& args);
+	void console_recordConvert(const std::vector<std::string>& args);
 
 	/////////////////////////////////////////////
 	// Implementation
@@ -59,6 +64,9 @@ namespace TFE_Jedi
 		// Remove temporarily until they do something useful again.
 		CCMD("rsetSubRenderer", console_setSubRenderer, 1, "Set the sub-renderer - valid values are: Classic_Fixed, Classic_Float, Classic_GPU");
 		CCMD("rgetSubRenderer", console_getSubRenderer, 0, "Get the current sub-renderer.");
+		CCMD("recordStart", console_recordStart, 0, "Start a lossless recording of the game view - recordStart recording.tfr");
+		CCMD("recordStop", console_recordStop, 0, "Stop the current recording.");
+		CCMD("recordConvert", console_recordConvert, 2, "Convert a recording to a GIF or to a PNG sequence, based on the extension - recordConvert recording.tfr recording.gif");
 
 		// Setup performance counters.
 		TFE_COUNTER(s_maxAdjoinDepth, "Maximum Adjoin Depth");
@@ -145,6 +153,55 @@ namespace TFE_Jedi
 		TFE_Console::addToHistory(c_subRenderers[s_subRenderer]);
 	}
 
+	void console_recordStart(const std::vector<std::string>& args)
+	{
+		char path[TFE_MAX_PATH];
+		TFE_Paths::getUserFilePath(args.size() >= 2 ? args[1].c_str() : "recording.tfr", path);
+
+		char res[TFE_MAX_PATH + 64];
+		if (vfb_isRecording())
+		{
+			sprintf(res, "Already recording.");
+		}
+		else if (vfb_startRecording(path))
+		{
+			sprintf(res, "Recording to \"%s\".", path);
+		}
+		else
+		{
+			sprintf(res, "Cannot record to \"%s\".", path);
+		}
+		TFE_Console::addToHistory(res);
+	}
+
+	void console_recordStop(const std::vector<std::string>& args)
+	{
+		if (vfb_isRecording())
+		{
+			vfb_stopRecording();
+			TFE_Console::addToHistory("Recording stopped.");
+		}
+	}
+
+	void console_recordConvert(const std::vector<std::string>& args)
+	{
+		if (args.size() < 3) { return; }
+		char srcPath[TFE_MAX_PATH], dstPath[TFE_MAX_PATH];
+		TFE_Paths::getUserFilePath(args[1].c_str(), srcPath);
+		TFE_Paths::getUserFilePath(args[2].c_str(), dstPath);
+
+		char res[2 * TFE_MAX_PATH + 64];
+		if (TFE_FrameRecording::convert(srcPath, dstPath))
+		{
+			sprintf(res, "Converted \"%s\" to \"%s\".", srcPath, dstPath);
+		}
+		else
+		{
+			sprintf(res, "Cannot convert \"%s\", see the log for details.", srcPath);
+		}
+		TFE_Console::addToHistory(res);
+	}
+
 	JBool render_setResolution()
 	{
 		TFE_Settings_Graphics* graphics = TFE_Settings::getGraphicsSettings();
@@ -3,6 +3,9 @@
 #include "virtualFramebuffer.h"
 #include <TFE_RenderBackend/renderBackend.h>
 #include <TFE_Settings/settings.h>
+#include <TFE_System/system.h>
+#include <TFE_Asset/gifWriter.h>
+#include <TFE_Asset/frameRecording.h>
 
 namespace TFE_Jedi
 {
@@ -21,6 +24,11 @@ namespace TFE_Jedi
 	static fixed16_16 s_yScale = ONE_16;
 
 	static ScreenRect s_screenRect[VFB_RECT_COUNT];
+	static u32 s_palette[256];
+	static u32 s_gifWidth = 0;
+	static u32 s_gifHeight = 0;
+	static u32 s_deltaWidth = 0;
+	static u32 s_deltaHeight = 0;
 
 	void vfb_createVirtualDisplay(u32 width, u32 height);
 		
@@ -116,6 +124,11 @@ namespace TFE_Jedi
 
 	void vfb_setPalette(const u32* palette)
 	{
+		// Keep a copy for recording.
+		if (palette)
+		{
+			memcpy(s_palette, palette, sizeof(u32) * 256);
+		}
 		TFE_RenderBackend::setPalette(palette);
 	}
 
@@ -144,6 +157,64 @@ namespace TFE_Jedi
 	void vfb_swap()
 	{
 		TFE_RenderBackend::updateVirtualDisplay(s_curFrameBuffer, s_width * s_height);
+		// Frames are skipped while the resolution differs from the start of the recording.
+		if (s_gifWidth && s_width == s_gifWidth && s_height == s_gifHeight)
+		{
+			TFE_GIF::addIndexedFrame(s_curFrameBuffer, s_palette, TFE_System::getTime());
+		}
+		if (s_deltaWidth && s_width == s_deltaWidth && s_height == s_deltaHeight)
+		{
+			TFE_FrameRecording::addFrame(s_curFrameBuffer, s_palette, TFE_System::getTime());
+		}
+	}
+
+	////////////////////////////
+	// Recording
+	////////////////////////////
+	bool vfb_startGifRecording(const char* path)
+	{
+		if (!s_curFrameBuffer || !TFE_GIF::startIndexedRecording(path, s_width, s_height))
+		{
+			return false;
+		}
+		s_gifWidth = s_width;
+		s_gifHeight = s_height;
+		return true;
+	}
+
+	void vfb_stopGifRecording()
+	{
+		s_gifWidth = 0;
+		s_gifHeight = 0;
+		TFE_GIF::endIndexedRecording();
+	}
+
+	bool vfb_isGifRecording()
+	{
+		return s_gifWidth != 0;
+	}
+
+	bool vfb_startRecording(const char* path)
+	{
+		if (!s_curFrameBuffer || !TFE_FrameRecording::startRecording(path, s_width, s_height))
+		{
+			return false;
+		}
+		s_deltaWidth = s_width;
+		s_deltaHeight = s_height;
+		return true;
+	}
+
+	void vfb_stopRecording()
+	{
+		s_deltaWidth = 0;
+		s_deltaHeight = 0;
+		TFE_FrameRecording::endRecording();
+	}
+
+	bool vfb_isRecording()
+	{
+		return s_deltaWidth != 0;
 	}
 
 	////////////////////////////
@@ -48,6 +48,18 @@ namespace TFE_Jedi
 	// Frame rendering is done, copy the results to GPU memory.
 	void vfb_swap();
 
+	////////////////////////////
+	// Recording
+	////////////////////////////
+	// Record the 8-bit frames and palette directly to a GIF, this does not use the GPU.
+	bool vfb_startGifRecording(const char* path);
+	void vfb_stopGifRecording();
+	bool vfb_isGifRecording();
+	// Lossless recording of the 8-bit frames, see TFE_FrameRecording.
+	bool vfb_startRecording(const char* path);
+	void vfb_stopRecording();
+	bool vfb_isRecording();
+
 	////////////////////////////
 	// Query
 	////////////////////////////
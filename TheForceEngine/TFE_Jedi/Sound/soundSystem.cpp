@@ -43,6 +43,8 @@ namespace TFE_Jedi
 		{
 			return NULL_SOUND;
 		}
+		// 2D sounds are player sounds, such as weapons, and are kept over distant 3D sounds.
+		setSourcePriority(source, SOUND_PRIORITY_HIGH);
 		playSource(source);
 
 		s32 slot = getSourceSlot(source);
@@ -64,6 +66,7 @@ namespace TFE_Jedi
 		SoundSource* source = createSoundSource(SOUND_2D, 1.0f, 0.5f, buffer);
 		if (!source) { return NULL_SOUND; }
 
+		setSourcePriority(source, SOUND_PRIORITY_HIGH);
 		playSource(source, true);
 		s32 slot = getSourceSlot(source);
 		assert(slot >= 0);
@@ -5,6 +5,7 @@
 #include <TFE_DarkForces/time.h>
 #include <TFE_System/system.h>
 #include <TFE_Game/igame.h>
+#include <TFE_Game/snapshot.h>
 #include <TFE_System/profiler.h>
 #include <stdarg.h>
 #include <tuple>
@@ -598,6 +599,17 @@ namespace TFE_Jedi
 		return s_taskCount;
 	}
 
+	void task_registerSnapshotState()
+	{
+		SNAPSHOT_STATE(s_rootTask);
+		SNAPSHOT_STATE(s_taskIter);
+		SNAPSHOT_STATE(s_curTask);
+		SNAPSHOT_STATE(s_currentMsg);
+		SNAPSHOT_STATE(s_curContext);
+		SNAPSHOT_STATE(s_taskCount);
+		SNAPSHOT_STATE(s_frameActiveTaskCount);
+	}
+
 	s32 ctxGetIP()
 	{
 		assert(s_curContext->level >= 0 && s_curContext->level < TASK_MAX_LEVELS);
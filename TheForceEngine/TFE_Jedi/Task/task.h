@@ -66,6 +66,8 @@ namespace TFE_Jedi
 	void task_setMinStepInterval(f64 minIntervalInSec);
 
 	s32 task_getCount();
+	// Register the task list state with TFE_Snapshot, the tasks themselves live in the game region.
+	void task_registerSnapshotState();
 }
 ////////////////////////////////////////////////////////////////////////
 // Task Function API:
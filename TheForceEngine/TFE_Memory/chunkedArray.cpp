@@ -2,6 +2,7 @@
 
 #include "chunkedArray.h"
 #include <TFE_System/system.h>
+#include <TFE_System/profiler.h>
 #include <TFE_Memory/memoryRegion.h>
 #include <assert.h>
 #include <stdio.h>
@@ -28,6 +29,8 @@ struct ChunkedArray
 	u8** chunks;
 	u8** freeSlots;
 	MemoryRegion* region;
+	// TFE: Index into the pool usage list, -1 if usage is not tracked (see chunkedArrayTrackUsage()).
+	s32 usageIndex;
 };
 
 namespace TFE_Memory
@@ -35,8 +38,23 @@ namespace TFE_Memory
 	enum
 	{
 		FREE_SLOT_STEP = 32,
+		MAX_TRACKED_ARRAYS = 32,
+		// Leaves room for the " Pool Capacity" suffix within the 64 character profiler counter names.
+		MAX_USAGE_NAME_LEN = 49,
 	};
+
+	struct ChunkedArrayUsage
+	{
+		char name[MAX_USAGE_NAME_LEN + 1];
+		s32 used;		// Elements currently allocated.
+		s32 capacity;	// Elements that fit in the allocated chunks.
+	};
+	// Fixed size so the counter addresses stay valid.
+	static ChunkedArrayUsage s_usage[MAX_TRACKED_ARRAYS];
+	static s32 s_usageCount = 0;
+
 	void addFreeSlot(ChunkedArray* arr, u8* ptr);
+	void updateUsage(ChunkedArray* arr);
 
 	void serialize(ChunkedArray* arr, FileStream* file)
 	{
@@ -65,6 +83,7 @@ namespace TFE_Memory
 
 		size_t size = size_t(&arr->chunks) - sizeof(arr);
 		file->readBuffer(arr, (u32)size);
+		arr->usageIndex = -1;
 
 		arr->chunks = (u8**)region_realloc(region, arr->chunks, sizeof(u8*) * arr->chunkCount);
 		const u32 chunkAllocSize = arr->elemPerChunk * arr->elemSize;
@@ -93,6 +112,7 @@ namespace TFE_Memory
 
 	ChunkedArray* createChunkedArray(u32 elemSize, u32 elemPerChunk, u32 initChunkCount, MemoryRegion* region)
 	{
+		TFE_MEMORY_TAG("Chunked Array");
 		ChunkedArray* arr = (ChunkedArray*)region_alloc(region, sizeof(ChunkedArray));
 		memset(arr, 0, sizeof(ChunkedArray));
 		
@@ -107,6 +127,7 @@ namespace TFE_Memory
 		arr->freeSlotCount = 0;
 		arr->freeSlotCapacity = 0;
 		arr->freeSlots = nullptr;
+		arr->usageIndex = -1;
 
 		const u32 chunkAllocSize = elemPerChunk * elemSize;
 		for (u32 i = 0; i < initChunkCount; i++)
@@ -120,6 +141,11 @@ namespace TFE_Memory
 	void freeChunkedArray(ChunkedArray* arr)
 	{
 		if (!arr) { return; }
+		if (arr->usageIndex >= 0)
+		{
+			s_usage[arr->usageIndex].used = 0;
+			s_usage[arr->usageIndex].capacity = 0;
+		}
 
 		for (u32 i = 0; i < arr->chunkCount; i++)
 		{
@@ -135,6 +161,7 @@ namespace TFE_Memory
 		if (arr->freeSlotCount)
 		{
 			arr->freeSlotCount--;
+			updateUsage(arr);
 			return arr->freeSlots[arr->freeSlotCount];
 		}
 		s32 elementIndex = arr->elemCount;
@@ -144,6 +171,7 @@ namespace TFE_Memory
 		const u32 newChunkCount = newChunkIndex + 1;
 		if (newChunkCount > arr->chunkCount)
 		{
+			TFE_MEMORY_TAG("Chunked Array");
 			arr->chunks = (u8**)region_realloc(arr->region, arr->chunks, sizeof(u8*) * newChunkCount);
 
 			const u32 chunkAllocSize = arr->elemPerChunk * arr->elemSize;
@@ -153,6 +181,7 @@ namespace TFE_Memory
 			}
 			arr->chunkCount = newChunkCount;
 		}
+		updateUsage(arr);
 
 		const u32 index = elementIndex - newChunkIndex*arr->elemPerChunk;
 		assert(index < arr->elemPerChunk);
@@ -165,17 +194,19 @@ namespace TFE_Memory
 		
 #ifdef _VERIFY_CHUNKED_ARR_FREE
 		// First verify that the memory is contained within the chunked array.
+		// Note that chunks are not necessarily in address order.
+		bool found = false;
 		for (s32 i = arr->chunkCount - 1; i >= 0; i--)
 		{
-			if (ptr >= arr->chunks[i])
+			if (ptr >= arr->chunks[i] && ptr < arr->chunks[i] + arr->elemPerChunk * arr->elemSize)
 			{
-				assert(ptr < arr->chunks[i] + arr->elemPerChunk * arr->elemSize);
-				// Then find the index.
-				u32 index = u32((u8*)ptr - arr->chunks[i]) / arr->elemSize;
-				assert(index < arr->elemPerChunk);
+				// Then verify that it points at the start of an element.
+				assert(u32((u8*)ptr - arr->chunks[i]) % arr->elemSize == 0);
+				found = true;
 				break;
 			}
 		}
+		assert(found);
 		// Then verify that it hasn't already been freed.
 		for (u32 i = 0; i < arr->freeSlotCount; i++)
 		{
@@ -184,6 +215,7 @@ namespace TFE_Memory
 #endif
 
 		addFreeSlot(arr, (u8*)ptr);
+		updateUsage(arr);
 	}
 
 	void chunkedArrayClear(ChunkedArray* arr)
@@ -194,6 +226,7 @@ namespace TFE_Memory
 		{
 			memset(arr->chunks[i], 0, arr->elemPerChunk * arr->elemSize);
 		}
+		updateUsage(arr);
 	}
 
 	u32 chunkedArraySize(ChunkedArray* arr)
@@ -210,10 +243,57 @@ namespace TFE_Memory
 		return arr->chunks[chunkId] + elemId*arr->elemSize;
 	}
 
+	void chunkedArrayTrackUsage(ChunkedArray* arr, const char* name)
+	{
+		if (!arr) { return; }
+
+		s32 index = -1;
+		for (s32 i = 0; i < s_usageCount; i++)
+		{
+			if (strcmp(s_usage[i].name, name) == 0)
+			{
+				index = i;
+				break;
+			}
+		}
+		if (index < 0)
+		{
+			if (s_usageCount >= MAX_TRACKED_ARRAYS)
+			{
+				TFE_System::logWrite(LOG_WARNING, "ChunkedArray", "Too many tracked arrays, usage of '%s' will not be reported.", name);
+				return;
+			}
+			index = s_usageCount;
+			s_usageCount++;
+
+			ChunkedArrayUsage* usage = &s_usage[index];
+			strncpy(usage->name, name, sizeof(usage->name) - 1);
+			usage->name[sizeof(usage->name) - 1] = 0;
+
+			char counterName[64];
+			snprintf(counterName, sizeof(counterName), "%s Pool Used", usage->name);
+			TFE_COUNTER(usage->used, counterName);
+			snprintf(counterName, sizeof(counterName), "%s Pool Capacity", usage->name);
+			TFE_COUNTER(usage->capacity, counterName);
+		}
+		// Arrays created later with the same name, such as when a level is reloaded, take over the counters.
+		arr->usageIndex = index;
+		updateUsage(arr);
+	}
+
+	void updateUsage(ChunkedArray* arr)
+	{
+		if (arr->usageIndex < 0) { return; }
+		// Computed from the array state rather than counted, so it stays correct if the memory is restored from a snapshot.
+		s_usage[arr->usageIndex].used = s32(arr->elemCount - arr->freeSlotCount);
+		s_usage[arr->usageIndex].capacity = s32(arr->chunkCount * arr->elemPerChunk);
+	}
+
 	void addFreeSlot(ChunkedArray* arr, u8* ptr)
 	{
 		if (arr->freeSlotCount + 1 >= arr->freeSlotCapacity)
 		{
+			TFE_MEMORY_TAG("Chunked Array");
 			arr->freeSlotCapacity += FREE_SLOT_STEP;
 			arr->freeSlots = (u8**)region_realloc(arr->region, arr->freeSlots, sizeof(u8*) * arr->freeSlotCapacity);
 		}
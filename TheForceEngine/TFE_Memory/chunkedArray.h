@@ -28,4 +28,8 @@ namespace TFE_Memory
 	ChunkedArray* restore(FileStream* file, MemoryRegion* region);
 
 	s32 getSlotIndex(ChunkedArray* arr, u8* ptr);
+
+	// Report the used and allocated element counts as the profiler counters "<name> Pool Used" and "<name> Pool Capacity".
+	// Only the most recent array tracked under a given name is reported.
+	void chunkedArrayTrackUsage(ChunkedArray* arr, const char* name);
 }
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <algorithm>
+#ifdef TFE_MEMORY_ANALYTICS
+#include <map>
+#endif
 
 // #define _VERIFY_MEMORY
 
@@ -19,6 +22,14 @@
 #define VERIFY_MEMORY()
 #endif
 
+#ifdef TFE_MEMORY_ANALYTICS
+#define RECORD_ALLOC(region, reqBin, bin, mem) recordAlloc(region, reqBin, bin, mem)
+#define RECORD_EVENT(region, counter) region->counter++
+#else
+#define RECORD_ALLOC(region, reqBin, bin, mem)
+#define RECORD_EVENT(region, counter)
+#endif
+
 using namespace TFE_Jedi;
 
 enum
@@ -33,6 +44,7 @@ enum
 	MAX_BLOCK_SIZE  = 16 * 1024 * 1024,
 	RELATIVE_NON_NULL_BIT = 1u,
 	SHARED_HEADER_SIZE = 8,	// 8 bytes are shared between RegionAllocHeader{} and AllocHeaderFree{}
+	SNAPSHOT_PAGE_SIZE = 4096,
 };
 
 struct RegionAllocHeader
@@ -40,7 +52,7 @@ struct RegionAllocHeader
 	u32 size;
 	u8  free;
 	u8  bin;
-	u8  pad8[2];
+	u8  pad8[2];	// Holds the allocation tag when TFE_MEMORY_ANALYTICS is defined.
 	u64 pad; // pad to 16 bytes.
 };
 
@@ -80,6 +92,29 @@ struct MemoryRegion
 	size_t blockCount;
 	size_t blockSize;
 	size_t maxBlocks;
+	u32 clearCount;		// Incremented whenever the contents are thrown away, so stale snapshots are not restored.
+#ifdef TFE_MEMORY_ANALYTICS
+	u32 newBlockCount;
+	u32 failedAllocCount;
+	u32 binAllocCount[ALLOC_BIN_COUNT];
+	u32 binLargerCount[ALLOC_BIN_COUNT];
+#endif
+};
+
+struct RegionSnapshot
+{
+	u32 clearCount;
+	u32 blockCount;
+	size_t blockSize;
+	std::vector<u8*> blocks;
+};
+
+// Stored at the start of the changes written by region_updateSnapshot(), followed by (u32 page, page XOR previous page).
+struct SnapshotChangeHeader
+{
+	u32 clearCount;
+	u32 blockCount;
+	u32 blockSize;
 };
 
 static_assert(sizeof(RegionAllocHeader) == 16, "RegionAllocHeader is the wrong size.");
@@ -93,11 +128,16 @@ namespace TFE_Memory
 	static const u32 c_relativeOffsetMask = (1u << c_relativeBlockShift) - 1u;
 
 	void freeSlot(RegionAllocHeader* alloc, RegionAllocHeader* next, MemoryBlock* block);
+	void resetBlock(MemoryRegion* region, MemoryBlock* block);
 	size_t alloc_align(size_t baseSize);
 	s32  getBinFromSize(u32 size);
 	bool allocateNewBlock(MemoryRegion* region);
 	void removeHeaderFromFreelist(MemoryBlock* block, RegionAllocHeader* header);
 	void insertBlockIntoFreelist(MemoryBlock* block, RegionAllocHeader* header);
+#ifdef TFE_MEMORY_ANALYTICS
+	void resetAnalytics(MemoryRegion* region);
+	void recordAlloc(MemoryRegion* region, s32 reqBin, s32 bin, void* mem);
+#endif
 
 	void verifyMemory(MemoryRegion* region)
 	{
@@ -155,6 +195,10 @@ namespace TFE_Memory
 		region->blockCount = 0;
 		region->blockSize = blockSize;
 		region->maxBlocks = maxSize ? (maxSize + blockSize - 1) / blockSize : 0;
+		region->clearCount = 0;
+#ifdef TFE_MEMORY_ANALYTICS
+		resetAnalytics(region);
+#endif
 		if (!allocateNewBlock(region))
 		{
 			free(region);
@@ -166,20 +210,28 @@ namespace TFE_Memory
 		return region;
 	}
 
+	void resetBlock(MemoryRegion* region, MemoryBlock* block)
+	{
+		block->sizeFree = u32(region->blockSize);
+		block->count = 1;
+
+		RegionAllocHeader* header = (RegionAllocHeader*)((u8*)block + sizeof(MemoryBlock));
+		header->size = block->sizeFree;
+		header->free = 0;
+		memset(block->freeListBins, 0, sizeof(AllocHeaderFree*)*ALLOC_BIN_COUNT);
+		insertBlockIntoFreelist(block, header);
+	}
+
 	void region_clear(MemoryRegion* region)
 	{
 		assert(region);
+		region->clearCount++;
+#ifdef TFE_MEMORY_ANALYTICS
+		resetAnalytics(region);
+#endif
 		for (s32 i = 0; i < region->blockCount; i++)
 		{
-			MemoryBlock* block = region->memBlocks[i];
-			block->sizeFree = u32(region->blockSize);
-			block->count = 1;
-
-			RegionAllocHeader* header = (RegionAllocHeader*)((u8*)block + sizeof(MemoryBlock));
-			header->size = block->sizeFree;
-			header->free = 0;
-			memset(block->freeListBins, 0, sizeof(AllocHeaderFree*)*ALLOC_BIN_COUNT);
-			insertBlockIntoFreelist(block, header);
+			resetBlock(region, region->memBlocks[i]);
 			VERIFY_MEMORY();
 		}
 	}
@@ -255,6 +307,7 @@ namespace TFE_Memory
 						VERIFY_MEMORY();
 						void* mem = allocFromHeader(block, (RegionAllocHeader*)header, (u32)size);
 						VERIFY_MEMORY();
+						RECORD_ALLOC(region, bin, b, mem);
 						return mem;
 					}
 					header = header->binNext;
@@ -266,6 +319,7 @@ namespace TFE_Memory
 		{
 			if (allocateNewBlock(region))
 			{
+				RECORD_EVENT(region, newBlockCount);
 				VERIFY_MEMORY();
 				void* mem = region_alloc(region, size);
 				VERIFY_MEMORY();
@@ -274,6 +328,7 @@ namespace TFE_Memory
 		}
 		
 		// We are all out of memory...
+		RECORD_EVENT(region, failedAllocCount);
 		TFE_System::logWrite(LOG_ERROR, "MemoryRegion", "Failed to allocate %u bytes in region '%s'.", size, region->name);
 		return nullptr;
 	}
@@ -526,13 +581,21 @@ namespace TFE_Memory
 		if (!region)
 		{
 			region = (MemoryRegion*)malloc(sizeof(MemoryRegion));
-			region->blockArrCapacity = 0;
+			if (region)
+			{
+				region->blockArrCapacity = 0;
+				region->clearCount = 0;
+#ifdef TFE_MEMORY_ANALYTICS
+				resetAnalytics(region);
+#endif
+			}
 		}
 		if (!region)
 		{
 			TFE_System::logWrite(LOG_ERROR, "MemoryRegion", "Failed to allocate region.");
 			return nullptr;
 		}
+		region->clearCount++;
 
 		size_t blockAllocStart = 0;
 		file->readBuffer(region->name, 32);
@@ -631,6 +694,161 @@ namespace TFE_Memory
 		return region;
 	}
 
+	RegionSnapshot* region_createSnapshot()
+	{
+		RegionSnapshot* snapshot = new RegionSnapshot();
+		snapshot->clearCount = 0;
+		snapshot->blockCount = 0;
+		snapshot->blockSize = 0;
+		return snapshot;
+	}
+
+	void region_destroySnapshot(RegionSnapshot* snapshot)
+	{
+		if (!snapshot) { return; }
+		for (size_t b = 0; b < snapshot->blocks.size(); b++)
+		{
+			free(snapshot->blocks[b]);
+		}
+		delete snapshot;
+	}
+
+	size_t region_updateSnapshot(MemoryRegion* region, RegionSnapshot* snapshot, std::vector<u8>* changes)
+	{
+		if (!region || !snapshot) { return 0; }
+
+		if (changes)
+		{
+			const SnapshotChangeHeader header = { snapshot->clearCount, snapshot->blockCount, u32(snapshot->blockSize) };
+			const u8* headerBytes = (const u8*)&header;
+			changes->insert(changes->end(), headerBytes, headerBytes + sizeof(SnapshotChangeHeader));
+		}
+		// The copies are useless if the block size changed, start over.
+		if (snapshot->blockSize != region->blockSize)
+		{
+			for (size_t b = 0; b < snapshot->blocks.size(); b++)
+			{
+				free(snapshot->blocks[b]);
+			}
+			snapshot->blocks.clear();
+			snapshot->blockSize = region->blockSize;
+		}
+
+		const size_t blockBytes = sizeof(MemoryBlock) + region->blockSize;
+		const u32 pagesPerBlock = u32((blockBytes + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE);
+		while (snapshot->blocks.size() < region->blockCount)
+		{
+			snapshot->blocks.push_back((u8*)calloc(1, blockBytes));
+		}
+
+		size_t copied = 0;
+		for (u32 b = 0; b < region->blockCount; b++)
+		{
+			const u8* src = (const u8*)region->memBlocks[b];
+			u8* dst = snapshot->blocks[b];
+			for (u32 p = 0; p < pagesPerBlock; p++)
+			{
+				const size_t offset = size_t(p) * SNAPSHOT_PAGE_SIZE;
+				const size_t size = std::min(size_t(SNAPSHOT_PAGE_SIZE), blockBytes - offset);
+				if (memcmp(src + offset, dst + offset, size) == 0) { continue; }
+
+				if (changes)
+				{
+					const u32 pageIndex = b * pagesPerBlock + p;
+					const size_t start = changes->size();
+					changes->resize(start + sizeof(u32) + size);
+					u8* out = changes->data() + start;
+					memcpy(out, &pageIndex, sizeof(u32));
+					out += sizeof(u32);
+					for (size_t i = 0; i < size; i++)
+					{
+						out[i] = src[offset + i] ^ dst[offset + i];
+					}
+				}
+				memcpy(dst + offset, src + offset, size);
+				copied += size;
+			}
+		}
+		snapshot->clearCount = region->clearCount;
+		snapshot->blockCount = u32(region->blockCount);
+		return copied;
+	}
+
+	bool region_revertSnapshot(RegionSnapshot* snapshot, const u8* changes, size_t size)
+	{
+		if (!snapshot || size < sizeof(SnapshotChangeHeader)) { return false; }
+
+		SnapshotChangeHeader header;
+		memcpy(&header, changes, sizeof(SnapshotChangeHeader));
+		if (header.blockSize != snapshot->blockSize && header.blockCount)
+		{
+			return false;
+		}
+
+		const size_t blockBytes = sizeof(MemoryBlock) + snapshot->blockSize;
+		const u32 pagesPerBlock = u32((blockBytes + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE);
+		const u8* data = changes + sizeof(SnapshotChangeHeader);
+		const u8* end = changes + size;
+		while (data + sizeof(u32) <= end)
+		{
+			u32 pageIndex;
+			memcpy(&pageIndex, data, sizeof(u32));
+			data += sizeof(u32);
+
+			const u32 b = pageIndex / pagesPerBlock;
+			const size_t offset = size_t(pageIndex % pagesPerBlock) * SNAPSHOT_PAGE_SIZE;
+			const size_t pageSize = std::min(size_t(SNAPSHOT_PAGE_SIZE), blockBytes - offset);
+			if (b >= snapshot->blocks.size() || data + pageSize > end)
+			{
+				return false;
+			}
+
+			u8* dst = snapshot->blocks[b] + offset;
+			for (size_t i = 0; i < pageSize; i++)
+			{
+				dst[i] ^= data[i];
+			}
+			data += pageSize;
+		}
+		snapshot->clearCount = header.clearCount;
+		snapshot->blockCount = header.blockCount;
+		return true;
+	}
+
+	bool region_canRestoreSnapshot(MemoryRegion* region, const RegionSnapshot* snapshot)
+	{
+		if (!region || !snapshot || !snapshot->blockCount) { return false; }
+		return snapshot->clearCount == region->clearCount && snapshot->blockSize == region->blockSize && snapshot->blockCount <= region->blockCount;
+	}
+
+	bool region_restoreSnapshot(MemoryRegion* region, const RegionSnapshot* snapshot)
+	{
+		if (!region_canRestoreSnapshot(region, snapshot)) { return false; }
+
+		// Only the pages that changed since the snapshot are copied back.
+		const size_t blockBytes = sizeof(MemoryBlock) + region->blockSize;
+		for (u32 b = 0; b < snapshot->blockCount; b++)
+		{
+			u8* dst = (u8*)region->memBlocks[b];
+			const u8* src = snapshot->blocks[b];
+			for (size_t offset = 0; offset < blockBytes; offset += SNAPSHOT_PAGE_SIZE)
+			{
+				const size_t size = std::min(size_t(SNAPSHOT_PAGE_SIZE), blockBytes - offset);
+				if (memcmp(dst + offset, src + offset, size))
+				{
+					memcpy(dst + offset, src + offset, size);
+				}
+			}
+		}
+		// Blocks allocated after the snapshot was taken are kept, but empty.
+		for (size_t b = snapshot->blockCount; b < region->blockCount; b++)
+		{
+			resetBlock(region, region->memBlocks[b]);
+		}
+		VERIFY_MEMORY();
+		return true;
+	}
+
 	void freeSlot(RegionAllocHeader* alloc, RegionAllocHeader* next, MemoryBlock* block)
 	{
 		block->sizeFree += alloc->size;
@@ -775,6 +993,220 @@ namespace TFE_Memory
 		return true;
 	}
 
+#ifdef TFE_MEMORY_ANALYTICS
+	//////////////////////////////////////////////////////////////
+	// Analytics
+	//////////////////////////////////////////////////////////////
+	static_assert(REGION_BIN_COUNT == ALLOC_BIN_COUNT, "REGION_BIN_COUNT must match ALLOC_BIN_COUNT.");
+
+	enum
+	{
+		TAG_UNTAGGED = 0,
+		TAG_MAX_COUNT = 0xffff,
+	};
+
+	struct RegionTag
+	{
+		const char* name;	// Scope name or source file.
+		s32 line;			// Source line for call sites, -1 for scope tags.
+	};
+
+	// Tags are stored as an index in the allocation header, names and files are expected to be string literals.
+	static std::vector<RegionTag> s_tags;
+	static std::map<std::pair<const char*, s32>, u16> s_tagMap;
+	static u16 s_scopeTag = TAG_UNTAGGED;
+	static u16 s_callSiteTag = TAG_UNTAGGED;
+
+	// Bin ranges, including the allocation header, see getBinFromSize().
+	static const u32 c_binMinSize[ALLOC_BIN_COUNT] = { 0, 32, 65, 129, 257, 513 };
+	static const u32 c_binMaxSize[ALLOC_BIN_COUNT] = { 31, 64, 128, 256, 512, 0xffffffffu };
+
+	u16 getTag(const char* name, s32 line)
+	{
+		if (s_tags.empty())
+		{
+			s_tags.push_back({ "untagged", -1 });
+		}
+
+		const std::pair<const char*, s32> key(name, line);
+		std::map<std::pair<const char*, s32>, u16>::iterator iTag = s_tagMap.find(key);
+		if (iTag != s_tagMap.end())
+		{
+			return iTag->second;
+		}
+		if (s_tags.size() >= TAG_MAX_COUNT)
+		{
+			return TAG_UNTAGGED;
+		}
+
+		const u16 tag = u16(s_tags.size());
+		s_tags.push_back({ name, line });
+		s_tagMap[key] = tag;
+		return tag;
+	}
+
+	std::string getTagName(u16 tag)
+	{
+		if (tag >= s_tags.size()) { return "untagged"; }
+
+		const RegionTag& regionTag = s_tags[tag];
+		if (regionTag.line < 0)
+		{
+			return regionTag.name;
+		}
+		// Call sites are shown as "file.cpp:line" without the path.
+		const char* fileName = regionTag.name;
+		for (const char* c = regionTag.name; *c; c++)
+		{
+			if (*c == '/' || *c == '\\') { fileName = c + 1; }
+		}
+		char name[256];
+		snprintf(name, 256, "%s:%d", fileName, regionTag.line);
+		return name;
+	}
+
+	u16 getHeaderTag(const RegionAllocHeader* header)
+	{
+		u16 tag;
+		memcpy(&tag, header->pad8, sizeof(u16));
+		return tag;
+	}
+
+	RegionTagScope::RegionTagScope(const char* name)
+	{
+		prevTag = s_scopeTag;
+		s_scopeTag = getTag(name, -1);
+	}
+
+	RegionTagScope::~RegionTagScope()
+	{
+		s_scopeTag = prevTag;
+	}
+
+	void resetAnalytics(MemoryRegion* region)
+	{
+		region->newBlockCount = 0;
+		region->failedAllocCount = 0;
+		memset(region->binAllocCount, 0, sizeof(u32) * ALLOC_BIN_COUNT);
+		memset(region->binLargerCount, 0, sizeof(u32) * ALLOC_BIN_COUNT);
+	}
+
+	void recordAlloc(MemoryRegion* region, s32 reqBin, s32 bin, void* mem)
+	{
+		region->binAllocCount[reqBin]++;
+		if (bin > reqBin)
+		{
+			region->binLargerCount[reqBin]++;
+		}
+
+		RegionAllocHeader* header = (RegionAllocHeader*)((u8*)mem - sizeof(RegionAllocHeader));
+		const u16 tag = s_scopeTag != TAG_UNTAGGED ? s_scopeTag : s_callSiteTag;
+		memcpy(header->pad8, &tag, sizeof(u16));
+	}
+
+	void* region_allocTagged(MemoryRegion* region, size_t size, const char* file, s32 line)
+	{
+		const u16 prevTag = s_callSiteTag;
+		s_callSiteTag = getTag(file, line);
+		void* mem = region_alloc(region, size);
+		s_callSiteTag = prevTag;
+		return mem;
+	}
+
+	void* region_reallocTagged(MemoryRegion* region, void* ptr, size_t size, const char* file, s32 line)
+	{
+		const u16 prevTag = s_callSiteTag;
+		s_callSiteTag = getTag(file, line);
+		void* mem = region_realloc(region, ptr, size);
+		s_callSiteTag = prevTag;
+		return mem;
+	}
+
+	const char* region_getName(MemoryRegion* region)
+	{
+		return region ? region->name : "";
+	}
+
+	void region_getStats(MemoryRegion* region, RegionStats* stats)
+	{
+		memset(stats, 0, sizeof(RegionStats));
+		if (!region) { return; }
+
+		stats->used = region_getMemoryUsed(region);
+		stats->capacity = region_getMemoryCapacity(region);
+		for (size_t i = 0; i < region->blockCount; i++)
+		{
+			MemoryBlock* block = region->memBlocks[i];
+			u8* mem = (u8*)block + sizeof(MemoryBlock);
+			for (u32 a = 0; a < block->count; a++)
+			{
+				RegionAllocHeader* header = (RegionAllocHeader*)mem;
+				if (header->free)
+				{
+					const s32 bin = getBinFromSize(header->size);
+					stats->freeBytes += header->size;
+					stats->largestFree = std::max(stats->largestFree, size_t(header->size));
+					stats->freeSlotCount++;
+					stats->binFreeSlots[bin]++;
+					stats->binFreeBytes[bin] += header->size;
+				}
+				else
+				{
+					stats->liveAllocCount++;
+				}
+				mem += header->size;
+			}
+		}
+		stats->fragmentation = stats->freeBytes ? 1.0f - f32(f64(stats->largestFree) / f64(stats->freeBytes)) : 0.0f;
+
+		stats->newBlockCount = region->newBlockCount;
+		stats->failedAllocCount = region->failedAllocCount;
+		memcpy(stats->binAllocCount, region->binAllocCount, sizeof(u32) * ALLOC_BIN_COUNT);
+		memcpy(stats->binLargerCount, region->binLargerCount, sizeof(u32) * ALLOC_BIN_COUNT);
+	}
+
+	void region_getLiveAllocationsByTag(MemoryRegion* region, std::vector<RegionTagStats>* tags)
+	{
+		tags->clear();
+		if (!region) { return; }
+
+		std::vector<RegionTagStats> tagStats(std::max(s_tags.size(), size_t(1)));
+		for (size_t i = 0; i < region->blockCount; i++)
+		{
+			MemoryBlock* block = region->memBlocks[i];
+			u8* mem = (u8*)block + sizeof(MemoryBlock);
+			for (u32 a = 0; a < block->count; a++)
+			{
+				RegionAllocHeader* header = (RegionAllocHeader*)mem;
+				if (!header->free)
+				{
+					u16 tag = getHeaderTag(header);
+					// Tags from a region restored from disk may not exist in this session.
+					if (tag >= tagStats.size()) { tag = TAG_UNTAGGED; }
+					tagStats[tag].count++;
+					tagStats[tag].size += header->size;
+				}
+				mem += header->size;
+			}
+		}
+
+		for (size_t t = 0; t < tagStats.size(); t++)
+		{
+			if (!tagStats[t].count) { continue; }
+			tagStats[t].tag = getTagName(u16(t));
+			tags->push_back(tagStats[t]);
+		}
+		std::sort(tags->begin(), tags->end(), [](const RegionTagStats& a, const RegionTagStats& b) { return a.size > b.size; });
+	}
+
+	void region_getBinRange(s32 bin, u32* minSize, u32* maxSize)
+	{
+		bin = std::max(0, std::min(bin, s32(ALLOC_BIN_LAST)));
+		*minSize = c_binMinSize[bin];
+		*maxSize = c_binMaxSize[bin];
+	}
+#endif
+
 	// 20k allocations and 1250 deallocations:
 	// Malloc = 0.005514 sec.
 	// Region = 0.000991 sec.
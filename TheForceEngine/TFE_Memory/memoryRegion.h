@@ -9,10 +9,26 @@
 #include <string>
 
 struct MemoryRegion;
+struct RegionSnapshot;
 typedef u32 RelativePointer;
 
 #define NULL_RELATIVE_POINTER 0
 
+// Allocation analytics: tags, per-bin histograms and fragmentation metrics.
+// Only compiled into debug builds, add TFE_MEMORY_ANALYTICS to the preprocessor defines to enable it in other builds.
+#if defined(_DEBUG) && !defined(TFE_MEMORY_ANALYTICS)
+#define TFE_MEMORY_ANALYTICS 1
+#endif
+
+#define TFE_MEMORY_PASTE(x, y) x ## y
+#define TFE_MEMORY_PASTE2(x, y) TFE_MEMORY_PASTE(x, y)
+#ifdef TFE_MEMORY_ANALYTICS
+// Attribute allocations made until the end of the current scope to a subsystem, such as TFE_MEMORY_TAG("INF").
+#define TFE_MEMORY_TAG(name) TFE_Memory::RegionTagScope TFE_MEMORY_PASTE2(__memoryTag, __LINE__)(name)
+#else
+#define TFE_MEMORY_TAG(name)
+#endif
+
 namespace TFE_Memory
 {
 	MemoryRegion* region_create(const char* name, size_t blockSize, size_t maxSize = 0u);
@@ -30,11 +46,74 @@ namespace TFE_Memory
 	RelativePointer region_getRelativePointer(MemoryRegion* region, void* ptr);
 	void* region_getRealPointer(MemoryRegion* region, RelativePointer ptr);
 
-	// TODO: Support writing to and restoring from streams in memory.
 	bool region_serializeToDisk(MemoryRegion* region, FileStream* file);
 	// Restore a region from disk. If 'region' is NULL then a new region is allocated,
 	// otherwise it will attempt to reuse the existing region.
 	MemoryRegion* region_restoreFromDisk(MemoryRegion* region, FileStream* file);
 
+	// In-memory snapshots, used for quick-saves and rewinding.
+	// A snapshot holds a copy of each block, updating it only copies the pages that changed since the last update.
+	// Snapshots are restored in place so pointers into the region stay valid, which means restoring fails if the
+	// region has been cleared since the snapshot was taken.
+	RegionSnapshot* region_createSnapshot();
+	void region_destroySnapshot(RegionSnapshot* snapshot);
+	// Returns the number of bytes copied. If 'changes' is not null, the changed pages XOR their previous contents are
+	// appended so that region_revertSnapshot() can step the snapshot back to its previous state.
+	size_t region_updateSnapshot(MemoryRegion* region, RegionSnapshot* snapshot, std::vector<u8>* changes = nullptr);
+	bool region_revertSnapshot(RegionSnapshot* snapshot, const u8* changes, size_t size);
+	bool region_canRestoreSnapshot(MemoryRegion* region, const RegionSnapshot* snapshot);
+	bool region_restoreSnapshot(MemoryRegion* region, const RegionSnapshot* snapshot);
+
 	void region_test();
+
+#ifdef TFE_MEMORY_ANALYTICS
+	enum
+	{
+		REGION_BIN_COUNT = 6,
+	};
+
+	struct RegionStats
+	{
+		size_t used;
+		size_t capacity;
+		size_t freeBytes;
+		size_t largestFree;		// Largest free slot, including the header.
+		f32 fragmentation;		// External fragmentation: 1 - largestFree / freeBytes.
+		u32 liveAllocCount;
+		u32 freeSlotCount;
+		u32 newBlockCount;		// Blocks added after the region was created.
+		u32 failedAllocCount;
+		// Per-bin histograms, by the bin of the requested size.
+		u32 binFreeSlots[REGION_BIN_COUNT];
+		size_t binFreeBytes[REGION_BIN_COUNT];
+		u32 binAllocCount[REGION_BIN_COUNT];		// Allocations since the region was created or cleared.
+		u32 binLargerCount[REGION_BIN_COUNT];		// Allocations that had to be taken from a larger bin.
+	};
+
+	struct RegionTagStats
+	{
+		std::string tag;
+		u32 count;
+		size_t size;
+	};
+
+	// Allocations use the innermost scope tag, then the call site if known.
+	struct RegionTagScope
+	{
+		RegionTagScope(const char* name);
+		~RegionTagScope();
+		u16 prevTag;
+	};
+
+	// Used by the game_alloc(), level_alloc() and res_alloc() macros to tag allocations with their call site.
+	void* region_allocTagged(MemoryRegion* region, size_t size, const char* file, s32 line);
+	void* region_reallocTagged(MemoryRegion* region, void* ptr, size_t size, const char* file, s32 line);
+
+	const char* region_getName(MemoryRegion* region);
+	void region_getStats(MemoryRegion* region, RegionStats* stats);
+	// Live allocations grouped by tag, largest first.
+	void region_getLiveAllocationsByTag(MemoryRegion* region, std::vector<RegionTagStats>* tags);
+	// Returns the allocation size range [minSize, maxSize] of a bin, including the header.
+	void region_getBinRange(s32 bin, u32* minSize, u32* maxSize);
+#endif
 }
\ No newline at end of file
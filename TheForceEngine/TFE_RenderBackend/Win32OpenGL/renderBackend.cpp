@@ -42,6 +42,7 @@ namespace TFE_RenderBackend
 	static u32 s_virtualWidthUi;
 	static u32 s_virtualWidth3d;
 
+	static bool s_headless = false;
 	static bool s_widescreen = false;
 	static bool s_asyncFrameBuffer = true;
 	static bool s_gpuColorConvert = false;
@@ -108,6 +109,16 @@ namespace TFE_RenderBackend
 		
 	bool init(const WindowState& state)
 	{
+		s_headless = (state.flags & WINFLAG_HEADLESS) != 0;
+		if (s_headless)
+		{
+			// Keep the window state so the game can still query the display size.
+			m_windowState = state;
+			m_window = nullptr;
+			TFE_System::logWrite(LOG_MSG, "RenderBackend", "Running headless, no window or GPU device is created.");
+			return true;
+		}
+
 		m_window = createWindow(state);
 		m_windowState = state;
 
@@ -136,6 +147,7 @@ namespace TFE_RenderBackend
 
 	void destroy()
 	{
+		if (s_headless) { return; }
 		delete s_screenCapture;
 
 		// TODO: Move effect destruction into post effect system.
@@ -152,18 +164,26 @@ namespace TFE_RenderBackend
 		m_window = nullptr;
 	}
 
+	bool isHeadless()
+	{
+		return s_headless;
+	}
+
 	bool getVsyncEnabled()
 	{
+		if (s_headless) { return false; }
 		return SDL_GL_GetSwapInterval() > 0;
 	}
 
 	void enableVsync(bool enable)
 	{
+		if (s_headless) { return; }
 		SDL_GL_SetSwapInterval(enable ? 1 : 0);
 	}
 
 	void setClearColor(const f32* color)
 	{
+		if (s_headless) { return; }
 		glClearColor(color[0], color[1], color[2], color[3]);
 		glClearDepth(0.0f);
 
@@ -172,6 +192,7 @@ namespace TFE_RenderBackend
 		
 	void swap(bool blitVirtualDisplay)
 	{
+		if (s_headless) { return; }
 		// Blit the texture or render target to the screen.
 		if (blitVirtualDisplay) { drawVirtualDisplay(); }
 		else { glClear(GL_COLOR_BUFFER_BIT); }
@@ -204,11 +225,13 @@ namespace TFE_RenderBackend
 		
 	void startGifRecording(const char* path)
 	{
+		if (s_headless) { return; }
 		s_screenCapture->beginRecording(path);
 	}
 
 	void stopGifRecording()
 	{
+		if (s_headless) { return; }
 		s_screenCapture->endRecording();
 	}
 
@@ -363,6 +386,7 @@ namespace TFE_RenderBackend
 
 	void clearWindow()
 	{
+		if (s_headless) { return; }
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
@@ -423,6 +447,7 @@ namespace TFE_RenderBackend
 		s_widescreen = (vdispInfo.flags & VDISP_WIDESCREEN) != 0;
 		s_asyncFrameBuffer = (vdispInfo.flags & VDISP_ASYNC_FRAMEBUFFER) != 0;
 		s_gpuColorConvert = (vdispInfo.flags & VDISP_GPU_COLOR_CONVERT) != 0;
+		if (s_headless) { return true; }
 
 		s_virtualDisplay = new DynamicTexture();
 		if (s_gpuColorConvert)
@@ -489,12 +514,13 @@ namespace TFE_RenderBackend
 	void updateVirtualDisplay(const void* buffer, size_t size)
 	{
 		TFE_ZONE("Update Virtual Display");
+		if (s_headless) { return; }
 		s_virtualDisplay->update(buffer, size);
 	}
 		
 	void setPalette(const u32* palette)
 	{
-		if (palette && getGPUColorConvert())
+		if (palette && getGPUColorConvert() && !s_headless)
 		{
 			TFE_ZONE("Update Palette");
 			s_palette->update(palette, 256 * sizeof(u32));
@@ -503,6 +529,7 @@ namespace TFE_RenderBackend
 
 	void setColorCorrection(bool enabled, const ColorCorrection* color/* = nullptr*/)
 	{
+		if (s_headless) { return; }
 		if (s_postEffectBlit->featureEnabled(BLIT_GPU_COLOR_CORRECTION) != enabled)
 		{
 			if (enabled) { s_postEffectBlit->enableFeatures(BLIT_GPU_COLOR_CORRECTION); }
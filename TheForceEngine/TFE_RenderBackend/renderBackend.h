@@ -18,6 +18,7 @@ enum WindowFlags
 {
 	WINFLAG_FULLSCREEN = 1 << 0,
 	WINFLAG_VSYNC = 1 << 1,
+	WINFLAG_HEADLESS = 1 << 2,	// No window or GPU device, the game runs but nothing is presented (see isHeadless()).
 };
 
 enum DisplayMode
@@ -91,6 +92,8 @@ namespace TFE_RenderBackend
 {
 	bool init(const WindowState& state);
 	void destroy();
+	// True when initialized with WINFLAG_HEADLESS, nothing is presented. The game may skip drawing that does not affect gameplay.
+	bool isHeadless();
 	bool getVsyncEnabled();
 	void enableVsync(bool enable);
 
@@ -307,6 +307,11 @@ namespace TFE_Settings
 		writeHeader(settings, c_sectionNames[SECTION_SOUND]);
 		writeKeyValue_Float(settings, "soundFxVolume", s_soundSettings.soundFxVolume);
 		writeKeyValue_Float(settings, "musicVolume", s_soundSettings.musicVolume);
+		writeKeyValue_Int(settings, "resampleQuality", s_soundSettings.resampleQuality);
+		writeKeyValue_Int(settings, "floatSampleBudget", s_soundSettings.floatSampleBudget);
+		writeKeyValue_Bool(settings, "midiSynth", s_soundSettings.midiSynth);
+		writeKeyValue_Int(settings, "midiSynthVoices", s_soundSettings.midiSynthVoices);
+		writeKeyValue_String(settings, "soundFont", s_soundSettings.soundFont);
 	}
 
 	void writeGameSettings(FileStream& settings)
@@ -594,6 +599,26 @@ namespace TFE_Settings
 		{
 			s_soundSettings.musicVolume = parseFloat(value);
 		}
+		else if (strcasecmp("resampleQuality", key) == 0)
+		{
+			s_soundSettings.resampleQuality = parseInt(value);
+		}
+		else if (strcasecmp("floatSampleBudget", key) == 0)
+		{
+			s_soundSettings.floatSampleBudget = parseInt(value);
+		}
+		else if (strcasecmp("midiSynth", key) == 0)
+		{
+			s_soundSettings.midiSynth = parseBool(value);
+		}
+		else if (strcasecmp("midiSynthVoices", key) == 0)
+		{
+			s_soundSettings.midiSynthVoices = parseInt(value);
+		}
+		else if (strcasecmp("soundFont", key) == 0)
+		{
+			strcpy(s_soundSettings.soundFont, value);
+		}
 	}
 
 	void parseGame(const char* key, const char* value)
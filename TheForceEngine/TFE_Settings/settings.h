@@ -80,6 +80,11 @@ struct TFE_Settings_Sound
 {
 	f32 soundFxVolume = 1.0f;
 	f32 musicVolume = 1.0f;
+	s32 resampleQuality = 1;	// 0 = linear, 1 = 8-tap sinc, 2 = 16-tap sinc (see ResampleQuality in audioSystem.h).
+	s32 floatSampleBudget = 64;	// Memory in MB for sound effects converted to float at load time, beyond this they are converted while mixing.
+	bool midiSynth = true;		// Play music with the built-in SoundFont synthesizer rather than an external Midi device.
+	s32 midiSynthVoices = 64;	// Maximum synthesizer polyphony, which bounds its CPU cost.
+	char soundFont[TFE_MAX_PATH] = "SoundFonts/SYNTHGM.sf2";	// Absolute or relative to the program folder.
 };
 
 struct TFE_Game
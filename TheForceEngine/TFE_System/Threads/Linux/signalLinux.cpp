@@ -0,0 +1,67 @@
+#include "signalLinux.h"
+#include <time.h>
+#include <errno.h>
+
+SignalLinux::SignalLinux()
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	// Use the monotonic clock for timeouts so they are not affected by changes to the system time.
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&m_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	m_signaled = false;
+}
+
+SignalLinux::~SignalLinux()
+{
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+void SignalLinux::fire()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_signaled = true;
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool SignalLinux::wait(u32 timeOutInMS, bool reset)
+{
+	timespec deadline;
+	if (timeOutInMS != TIMEOUT_INFINITE)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec  += timeOutInMS / 1000;
+		deadline.tv_nsec += (timeOutInMS % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	s32 res = 0;
+	while (!m_signaled && res != ETIMEDOUT)
+	{
+		res = (timeOutInMS == TIMEOUT_INFINITE) ? pthread_cond_wait(&m_cond, &m_mutex) : pthread_cond_timedwait(&m_cond, &m_mutex, &deadline);
+	}
+	const bool signaled = m_signaled;
+	//reset the signal so it can be used again but only if it was signaled.
+	if (signaled && reset)
+	{
+		m_signaled = false;
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	return signaled;
+}
+
+//factory
+Signal* Signal::create()
+{
+	return new SignalLinux();
+}
@@ -0,0 +1,59 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////
+// Single producer, single consumer lock-free queue.
+// One thread may push() and one (other) thread may pop(), neither
+// thread ever blocks - push() fails if the queue is full and pop()
+// fails if it is empty.
+// Capacity must be a power of two.
+//////////////////////////////////////////////////////////////////////
+#include <TFE_System/types.h>
+
+template <typename T, u32 Capacity>
+class SpscQueue
+{
+public:
+	SpscQueue()
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two.");
+		m_head.store(0, std::memory_order_relaxed);
+		m_tail.store(0, std::memory_order_relaxed);
+	}
+
+	// Producer thread only.
+	bool push(const T& item)
+	{
+		const u32 tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= Capacity)
+		{
+			return false;
+		}
+		m_items[tail & (Capacity - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer thread only.
+	bool pop(T* item)
+	{
+		const u32 head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		*item = m_items[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate when called while the other thread is active.
+	u32 getCount() const
+	{
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+	}
+
+private:
+	T m_items[Capacity];
+	// The head and tail are kept on seperate cache lines to avoid false sharing between the threads.
+	alignas(64) atomic_u32 m_head;
+	alignas(64) atomic_u32 m_tail;
+};
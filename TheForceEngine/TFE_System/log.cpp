@@ -2,6 +2,8 @@
 #include <cstring>
 
 #include <TFE_System/system.h>
+#include <TFE_System/Threads/thread.h>
+#include <TFE_System/Threads/signal.h>
 #include <TFE_FileSystem/filestream.h>
 #include <TFE_FileSystem/paths.h>
 #include <TFE_FrontEndUI/frontEndUi.h>
@@ -9,17 +11,59 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <algorithm>
+#include <thread>
 
 #ifdef _WIN32
 	#include <Windows.h>
 	#include <io.h>
 #endif
 
+// Messages are formatted by the calling thread and pushed into a lock-free multi-producer ring buffer,
+// which is drained by a background thread that writes to disk. Messages may span several consecutive slots,
+// producers reserve all of the slots of a message at once.
 namespace TFE_System
 {
+	enum LogConstants
+	{
+		LOG_SLOT_SIZE = 256,
+		LOG_SLOT_DATA = LOG_SLOT_SIZE - 8,
+		LOG_SLOT_COUNT = 2048,				// Must be a power of two.
+		LOG_MAX_MESSAGE = 32768,
+		LOG_FLUSH_INTERVAL_MS = 250,
+		LOG_DRAIN_SIZE = (LOG_MAX_MESSAGE / LOG_SLOT_DATA + 2) * LOG_SLOT_DATA,
+		LOG_TAG_SLOTS = 64,
+		LOG_TAG_RATE_LIMIT = 32,			// Warnings and errors per tag per second, beyond that they are suppressed.
+	};
+
+	struct LogSlot
+	{
+		atomic_u32 sequence;
+		u32 pad;
+		char data[LOG_SLOT_DATA];
+	};
+
+	// Stored at the start of the first slot of each message.
+	struct LogHeader
+	{
+		u16 type;
+		u16 slotCount;
+		u32 length;
+	};
+
+	// Counts messages per tag in the current second, tags that hash to the same slot share the limit.
+	struct TagRate
+	{
+		atomic_u32 window;
+		atomic_u32 count;
+		atomic_u32 suppressed;
+	};
+
 	static FileStream s_logFile;
-	static char s_workStr[32768];
-	static char s_msgStr[32768];
+	static thread_local char s_workStr[LOG_MAX_MESSAGE];
+	static thread_local char s_msgStr[LOG_MAX_MESSAGE];
 	static const char* c_typeNames[]=
 	{
 		"",			//LOG_MSG = 0,
@@ -28,50 +72,319 @@ namespace TFE_System
 		"Critical", //LOG_CRITICAL,
 	};
 
+	static LogSlot s_logSlots[LOG_SLOT_COUNT];
+	static atomic_u32 s_enqueuePos(0);
+	static u32 s_dequeuePos = 0;
+	static atomic_u32 s_writtenPos(0);		// Messages before this position are written and flushed.
+	static std::atomic_flag s_drainLock = ATOMIC_FLAG_INIT;
+	static char s_drainStr[LOG_DRAIN_SIZE];
+
+	static Thread* s_logThread = nullptr;
+	static Signal* s_logSignal = nullptr;
+	static atomic_bool s_logThreadRunning(false);
+	static TagRate s_tagRates[LOG_TAG_SLOTS];
+
+	TFE_THREADRET TFE_STDCALL logWriterFunc(void* userData);
+	bool logDrain(bool forceFlush, u32 maxSpins = 0xffffffff);
+	void installCrashHandler();
+	u32  logPush(LogWriteType type, const char* str, u32 length);
+
 	bool logOpen(const char* filename)
 	{
 		char logPath[TFE_MAX_PATH];
 		TFE_Paths::appendPath(PATH_USER_DOCUMENTS, filename, logPath);
 
-		return s_logFile.open(logPath, FileStream::MODE_WRITE);
+		for (u32 i = 0; i < LOG_SLOT_COUNT; i++)
+		{
+			s_logSlots[i].sequence.store(i);
+		}
+		if (!s_logFile.open(logPath, FileStream::MODE_WRITE))
+		{
+			return false;
+		}
+
+		// Without the thread messages are written directly by logWrite().
+		s_logSignal = Signal::create();
+		s_logThreadRunning.store(true);
+		s_logThread = s_logSignal ? Thread::create("LogThread", logWriterFunc, nullptr) : nullptr;
+		if (!s_logThread || !s_logThread->run())
+		{
+			// The thread never started, so logClose() must not wait on it.
+			s_logThreadRunning.store(false);
+			delete s_logThread;
+			s_logThread = nullptr;
+		}
+		installCrashHandler();
+		return true;
 	}
 
 	void logClose()
 	{
+		if (s_logThread)
+		{
+			s_logThreadRunning.store(false);
+			s_logSignal->fire();
+			s_logThread->waitOnExit();
+			delete s_logThread;
+			s_logThread = nullptr;
+		}
+		delete s_logSignal;
+		s_logSignal = nullptr;
+
+		logDrain(true);
 		s_logFile.close();
 	}
 
+	// Reserve 'slotCount' consecutive slots, returns false if the buffer is full.
+	bool logReserve(u32 slotCount, u32* pos)
+	{
+		u32 start = s_enqueuePos.load(std::memory_order_relaxed);
+		while (1)
+		{
+			// The slots are released in order, so if the last slot is free all of them are.
+			const u32 last = start + slotCount - 1;
+			const u32 seq = s_logSlots[last & (LOG_SLOT_COUNT - 1)].sequence.load(std::memory_order_acquire);
+			const s32 diff = s32(seq - last);
+			if (diff == 0)
+			{
+				if (s_enqueuePos.compare_exchange_weak(start, start + slotCount, std::memory_order_relaxed))
+				{
+					*pos = start;
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				start = s_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Copy the message into the ring buffer, returns the position after the message.
+	u32 logPush(LogWriteType type, const char* str, u32 length)
+	{
+		LogHeader header = { u16(type), 0, length };
+		const u32 totalSize = u32(sizeof(LogHeader)) + length;
+		header.slotCount = u16((totalSize + LOG_SLOT_DATA - 1) / LOG_SLOT_DATA);
+
+		u32 pos;
+		while (!logReserve(header.slotCount, &pos))
+		{
+			// The buffer is full, wake the writer and wait for space.
+			if (s_logSignal) { s_logSignal->fire(); }
+			std::this_thread::yield();
+		}
+
+		// Fill the slots, the first slot is published last so the writer sees the whole message at once.
+		for (s32 s = header.slotCount - 1; s >= 0; s--)
+		{
+			LogSlot& slot = s_logSlots[(pos + s) & (LOG_SLOT_COUNT - 1)];
+			u32 offset = s * LOG_SLOT_DATA;
+			u32 dst = 0;
+			if (s == 0)
+			{
+				memcpy(slot.data, &header, sizeof(LogHeader));
+				dst = sizeof(LogHeader);
+			}
+			else
+			{
+				offset -= sizeof(LogHeader);
+			}
+			const u32 size = std::min(u32(LOG_SLOT_DATA) - dst, length - offset);
+			memcpy(slot.data + dst, str + offset, size);
+			slot.sequence.store(pos + s + 1, std::memory_order_release);
+		}
+		return pos + header.slotCount;
+	}
+
+	// Read all of the messages that are ready and write them to disk, only one thread drains at a time.
+	// Returns false if another thread was draining for longer than 'maxSpins'.
+	bool logDrain(bool forceFlush, u32 maxSpins)
+	{
+		for (u32 spin = 0; s_drainLock.test_and_set(std::memory_order_acquire); spin++)
+		{
+			if (spin >= maxSpins) { return false; }
+			std::this_thread::yield();
+		}
+
+		bool flush = forceFlush;
+		while (1)
+		{
+			LogSlot& first = s_logSlots[s_dequeuePos & (LOG_SLOT_COUNT - 1)];
+			if (first.sequence.load(std::memory_order_acquire) != s_dequeuePos + 1)
+			{
+				break;
+			}
+
+			LogHeader header;
+			memcpy(&header, first.data, sizeof(LogHeader));
+			for (u32 s = 0, offset = 0; s < header.slotCount; s++)
+			{
+				LogSlot& slot = s_logSlots[(s_dequeuePos + s) & (LOG_SLOT_COUNT - 1)];
+				memcpy(s_drainStr + offset, slot.data, LOG_SLOT_DATA);
+				offset += LOG_SLOT_DATA;
+				slot.sequence.store(s_dequeuePos + s + LOG_SLOT_COUNT, std::memory_order_release);
+			}
+			s_dequeuePos += header.slotCount;
+
+			char* msg = s_drainStr + sizeof(LogHeader);
+			msg[header.length] = 0;
+			s_logFile.writeBuffer(msg, header.length);
+			//Make sure to flush the file to disk if a crash is likely.
+			flush |= (header.type == LOG_ERROR || header.type == LOG_CRITICAL);
+			//Write to the debugger or terminal output.
+			#ifdef _WIN32
+				OutputDebugStringA(msg);
+			#else
+				fputs(msg, stdout);
+			#endif
+		}
+
+		if (flush)
+		{
+			s_logFile.flush();
+		}
+		s_writtenPos.store(s_dequeuePos, std::memory_order_release);
+		s_drainLock.clear(std::memory_order_release);
+		return true;
+	}
+
+	TFE_THREADRET TFE_STDCALL logWriterFunc(void* userData)
+	{
+		while (s_logThreadRunning.load())
+		{
+			// Regular messages are flushed when the thread wakes up on its own.
+			const bool signaled = s_logSignal->wait(LOG_FLUSH_INTERVAL_MS);
+			logDrain(!signaled);
+		}
+		return (TFE_THREADRET)0;
+	}
+
+	// Returns true if the message should be written, and the number of messages suppressed since the last one.
+	bool logRateLimit(const char* tag, u32* suppressed)
+	{
+		u32 hash = 2166136261u;
+		for (const char* c = tag; *c; c++)
+		{
+			hash = (hash ^ u8(*c)) * 16777619u;
+		}
+		TagRate& rate = s_tagRates[hash & (LOG_TAG_SLOTS - 1)];
+
+		const u32 window = u32(time(nullptr));
+		*suppressed = 0;
+		if (rate.window.exchange(window) != window)
+		{
+			rate.count.store(0);
+			*suppressed = rate.suppressed.exchange(0);
+		}
+		const u32 count = rate.count++;
+		if (count > LOG_TAG_RATE_LIMIT)
+		{
+			rate.suppressed++;
+			return false;
+		}
+		// The message at the limit is replaced by a notice.
+		if (count == LOG_TAG_RATE_LIMIT)
+		{
+			sprintf(s_workStr, "[%s] Too many messages, suppressing the rest of this second.\r\n", tag);
+			logPush(LOG_MSG, s_workStr, (u32)strlen(s_workStr));
+			rate.suppressed++;
+			return false;
+		}
+		return true;
+	}
+
+	// Write everything that is still in the buffer before the program goes down.
+	void logFlushOnCrash()
+	{
+		if (!s_logFile.isOpen()) { return; }
+		// Give up if the crash happened while writing.
+		logDrain(true, 1000);
+	}
+
+#ifdef _WIN32
+	LONG WINAPI logCrashFilter(EXCEPTION_POINTERS* info)
+	{
+		logFlushOnCrash();
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	void installCrashHandler()
+	{
+		SetUnhandledExceptionFilter(logCrashFilter);
+	}
+#else
+	void logCrashSignal(int sig)
+	{
+		logFlushOnCrash();
+		// Let the default handler terminate the program.
+		::signal(sig, SIG_DFL);
+		raise(sig);
+	}
+
+	void installCrashHandler()
+	{
+		::signal(SIGSEGV, logCrashSignal);
+		::signal(SIGABRT, logCrashSignal);
+		::signal(SIGFPE, logCrashSignal);
+		::signal(SIGILL, logCrashSignal);
+	}
+#endif
+
 	void logWrite(LogWriteType type, const char* tag, const char* str, ...)
 	{
 		if (type >= LOG_COUNT || !s_logFile.isOpen() || !tag || !str) { return; }
 
+		// Repeated warnings and errors are limited per tag, regular and critical messages are always written.
+		u32 suppressed = 0;
+		if ((type == LOG_WARNING || type == LOG_ERROR) && !logRateLimit(tag, &suppressed))
+		{
+			return;
+		}
+		if (suppressed)
+		{
+			sprintf(s_workStr, "[%s] %u messages suppressed.\r\n", tag, suppressed);
+			logPush(LOG_MSG, s_workStr, (u32)strlen(s_workStr));
+		}
+
 		//Handle the variable input, "printf" style messages
 		va_list arg;
 		va_start(arg, str);
-		vsprintf(s_msgStr, str, arg);
+		vsnprintf(s_msgStr, LOG_MAX_MESSAGE, str, arg);
 		va_end(arg);
 		//Format the message
 		if (type != LOG_MSG)
 		{
-			sprintf(s_workStr, "[%s : %s] %s\r\n", c_typeNames[type], tag, s_msgStr);
+			snprintf(s_workStr, LOG_MAX_MESSAGE, "[%s : %s] %s\r\n", c_typeNames[type], tag, s_msgStr);
 		}
 		else
 		{
-			sprintf(s_workStr, "[%s] %s\r\n", tag, s_msgStr);
+			snprintf(s_workStr, LOG_MAX_MESSAGE, "[%s] %s\r\n", tag, s_msgStr);
+		}
+
+		//Queue the message for the writer thread.
+		const u32 endPos = logPush(type, s_workStr, (u32)strlen(s_workStr));
+		if (!s_logThreadRunning.load())
+		{
+			logDrain(false);
 		}
-		//Write to disk
-		s_logFile.writeBuffer(s_workStr, (u32)strlen(s_workStr));
-		//Make sure to flush the file to disk if a crash is likely.
-		//if (type == LOG_ERROR || type == LOG_CRITICAL)
+		else if (type == LOG_CRITICAL)
 		{
-			s_logFile.flush();
+			// Critical messages are on disk before returning.
+			s_logSignal->fire();
+			while (s32(s_writtenPos.load(std::memory_order_acquire) - endPos) < 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+		else if (type == LOG_ERROR)
+		{
+			s_logSignal->fire();
 		}
-		//Write to the debugger or terminal output.
-		#ifdef _WIN32
-			OutputDebugStringA(s_workStr);
-		#else
-			printf(s_workStr);
-		#endif
 		//Critical log messages also act as asserts in the debugger.
 		if (type == LOG_CRITICAL)
 		{
@@ -1,36 +1,110 @@
 #include <cstring>
 
 #include "profiler.h"
+#include <TFE_System/Threads/spscQueue.h>
+#include <TFE_FileSystem/filestream.h>
+#include <TFE_FileSystem/paths.h>
 #include <assert.h>
 #include <algorithm>
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 
-// TODO: Support call "paths" - with seperate time per path.
-
+// Each thread records zone begin and end events into its own lock-free queue, which is only written by that thread.
+// At the end of the frame the main thread replays the events of every thread to compute the zone times and timelines.
 namespace TFE_Profiler
 {
 	#define ZONE_BUFFER_COUNT 2
 	#define MAX_ZONE_STACK 256
+	#define MAX_ZONES 4096
+	#define MAX_ZONE_PATHS 16384
+	#define MAX_PROFILER_THREADS 32
+	#define THREAD_EVENT_CAPACITY (1 << 17)
+	#define OVERHEAD_TEST_COUNT 50000
 	
 	struct Zone
 	{
 		u32  id;
-		u32  level = 0;
-		u32  parent = NULL_ZONE;
-		u64  path;
-		u64  frame;
 		char name[64];
 		char func[64];
 		u32  lineNumber;
+	};
 
+	// A zone reached through a specific call path, the same zone under different parents is timed separately.
+	struct ZonePath
+	{
+		u32  zone;
+		u32  parent;		// The parent path.
+		u32  level;
+		u32  thread;
+		u64  frame;
+		u64  linkFrame;		// The last frame the path was linked into the zone tree.
+
+		u64  ticksInZone;	// Inclusive time, accumulated during the frame and converted to timeInZone at the end.
+		s64  ticksSelf;		// Exclusive time, the time not spent in child zones.
+		u64  ticksSelfTotal;	// Exclusive time since the last folded stack dump.
 		f64  timeInZone[ZONE_BUFFER_COUNT];
 		f64  timeInZoneAve;
+		f64  timeSelfAve;
 		f64  fractOfParentAve;
 
-		u32  child = NULL_ZONE;
-		u32  sibling = NULL_ZONE;
+		u32  child;
+		u32  sibling;
+	};
+
+	enum ZoneEventType
+	{
+		ZONE_EVENT_BEGIN = 0,
+		ZONE_EVENT_END,
+		ZONE_EVENT_RESET,	// A new thread took over the buffer.
+	};
+
+	struct ZoneEvent
+	{
+		u64 time;
+		u32 id;
+		u32 type;
+	};
+
+	struct ThreadData
+	{
+		char name[64];
+		SpscQueue<ZoneEvent, THREAD_EVENT_CAPACITY> events;
+		atomic_u32 droppedEvents;
+		atomic_bool released;		// Set when the thread exits so the buffer can be reused.
+
+		// Replay state, only accessed by the main thread.
+		u32 index;
+		u32 level;
+		u32 stack[MAX_ZONE_STACK];
+		u32 stackPath[MAX_ZONE_STACK];
+		u64 stackTime[MAX_ZONE_STACK];
+		u32 maxDepth[ZONE_BUFFER_COUNT];
+		u32 dropped[ZONE_BUFFER_COUNT];
+		std::vector<TFE_ZoneInterval> intervals[ZONE_BUFFER_COUNT];
+	};
+
+	// Zones and counters recorded for a trace, times are in ticks.
+	struct TraceZone
+	{
+		u64 begin;
+		u64 end;
+		u32 zoneId;
+		u32 thread;
+	};
+
+	struct TraceCounter
+	{
+		u64 time;
+		u32 counter;
+		s32 value;
+	};
+
+	struct TraceFrame
+	{
+		u64 begin;
+		u64 end;
 	};
 
 	struct Counter
@@ -43,12 +117,17 @@ namespace TFE_Profiler
 	};
 
 	typedef std::map<std::string, u32> ZoneMap;
+	typedef std::unordered_map<u64, u32> PathMap;
 	typedef std::vector<Zone> ZoneList;
+	typedef std::vector<ZonePath> PathList;
 	typedef std::vector<u32> SortedZoneList;
 	typedef std::vector<Counter> CounterList;
 
 	static ZoneMap  s_zoneMap;
 	static ZoneList s_zoneList;
+	// Paths are only accessed by the main thread.
+	static PathMap  s_pathMap;
+	static PathList s_pathList;
 	static SortedZoneList s_sortedZoneList;
 	static SortedZoneList s_roots;
 
@@ -59,101 +138,358 @@ namespace TFE_Profiler
 	static f64 s_frameTime;
 	static u32 s_readBuffer = 0;
 	static u32 s_writeBuffer = 1;
-	static u32 s_level;
-	static u32 s_maxLevel;
-	static u32 s_zoneStack[MAX_ZONE_STACK];
 	static u64 s_currentFrame = 1;
-	static u64 s_currentPath;
+	static f64 s_zoneOverhead = 0.0;
+
+	// Trace capture.
+	static u32  s_traceRequest = 0;		// Frame count of a trace that starts at the next frame.
+	static u32  s_traceFramesLeft = 0;
+	static bool s_traceActive = false;
+	static u64  s_traceStart;
+	static char s_tracePath[TFE_MAX_PATH];
+	static char s_traceRequestPath[TFE_MAX_PATH];
+	static std::vector<TraceZone> s_traceZones;
+	static std::vector<TraceCounter> s_traceCounters;
+	static std::vector<TraceFrame> s_traceFrames;
+
+	void writeTrace();
+
+	// Threads and zones may be registered from any thread, which is rare, so a simple spin lock is used.
+	static std::atomic_flag s_registerLock = ATOMIC_FLAG_INIT;
+	static ThreadData* s_threads[MAX_PROFILER_THREADS];
+	static atomic_u32 s_threadCount(0);
+	static thread_local ThreadData* s_threadData = nullptr;
+
+	// Releases the thread buffer when the thread exits.
+	struct ThreadExit
+	{
+		ThreadData* thread = nullptr;
+		~ThreadExit()
+		{
+			if (thread) { thread->released.store(true); }
+		}
+	};
+	static thread_local ThreadExit s_threadExit;
+
+	void lockRegistration()
+	{
+		while (s_registerLock.test_and_set(std::memory_order_acquire));
+	}
+
+	void unlockRegistration()
+	{
+		s_registerLock.clear(std::memory_order_release);
+	}
+
+	ThreadData* registerThread()
+	{
+		lockRegistration();
+		// Reuse the buffer of a thread that has exited once all of its events have been read.
+		const u32 count = s_threadCount.load();
+		for (u32 i = 0; i < count; i++)
+		{
+			ThreadData* thread = s_threads[i];
+			if (thread->released.load() && thread->events.getCount() == 0)
+			{
+				sprintf(thread->name, "Thread %u", i);
+				thread->droppedEvents.store(0);
+				thread->released.store(false);
+				unlockRegistration();
+
+				const ZoneEvent evt = { TFE_System::getCurrentTimeInTicks(), NULL_ZONE, ZONE_EVENT_RESET };
+				thread->events.push(evt);
+				s_threadData = thread;
+				s_threadExit.thread = thread;
+				return thread;
+			}
+		}
+
+		const u32 index = count;
+		if (index >= MAX_PROFILER_THREADS)
+		{
+			unlockRegistration();
+			return nullptr;
+		}
+
+		ThreadData* thread = new ThreadData();
+		sprintf(thread->name, "Thread %u", index);
+		thread->droppedEvents.store(0);
+		thread->released.store(false);
+		thread->index = index;
+		thread->level = 0;
+		for (u32 b = 0; b < ZONE_BUFFER_COUNT; b++)
+		{
+			thread->maxDepth[b] = 0;
+			thread->dropped[b] = 0;
+		}
+		s_threads[index] = thread;
+		s_threadCount.store(index + 1);
+		unlockRegistration();
+
+		s_threadData = thread;
+		s_threadExit.thread = thread;
+		return thread;
+	}
+
+	void setThreadName(const char* name)
+	{
+		ThreadData* thread = s_threadData ? s_threadData : registerThread();
+		if (!thread) { return; }
+
+		strncpy(thread->name, name, sizeof(thread->name) - 1);
+		thread->name[sizeof(thread->name) - 1] = 0;
+	}
 
-	void addZoneChild(u32 parentId, u32 zoneId)
+	void pushEvent(u32 id, u32 type)
 	{
-		Zone& parent = s_zoneList[parentId];
-		Zone& zone = s_zoneList[zoneId];
+		ThreadData* thread = s_threadData ? s_threadData : registerThread();
+		if (!thread) { return; }
+
+		const ZoneEvent evt = { TFE_System::getCurrentTimeInTicks(), id, type };
+		if (!thread->events.push(evt))
+		{
+			thread->droppedEvents++;
+		}
+	}
+
+	void addPathChild(u32 parentId, u32 pathId)
+	{
+		ZonePath& parent = s_pathList[parentId];
+		ZonePath& path = s_pathList[pathId];
 		// This has already been added.
-		if (zone.sibling != NULL_ZONE)
+		if (path.sibling != NULL_ZONE)
 		{
 			return;
 		}
 
-		if (parent.child == zoneId)
+		if (parent.child == pathId)
 		{
 			return;
 		}
 		else if (parent.child == NULL_ZONE)
 		{
-			parent.child = zoneId;
+			parent.child = pathId;
 		}
 		else
 		{
-			Zone* child = &s_zoneList[parent.child];
+			ZonePath* child = &s_pathList[parent.child];
 			while (1)
 			{
-				if (child->sibling == zoneId)
+				if (child->sibling == pathId)
 				{
 					return;
 				}
 				else if (child->sibling == NULL_ZONE)
 				{
-					child->sibling = zoneId;
+					child->sibling = pathId;
 					break;
 				}
-				child = &s_zoneList[child->sibling];
+				child = &s_pathList[child->sibling];
 			};
 		}
 	}
 
-	u32 beginZone(const char* name, const char* func, u32 lineNumber)
+	// Find or add the path of a zone under the parent path, root paths are kept per thread.
+	u32 getZonePath(u32 parentPath, u32 zoneId, u32 threadIndex)
 	{
-		ZoneMap::iterator iZone = s_zoneMap.find(name);
-		u32 id = 0;
-
-		if (iZone == s_zoneMap.end())
+		const u64 parentKey = parentPath != NULL_ZONE ? parentPath : (0xffff0000u | threadIndex);
+		const u64 key = (parentKey << 32ull) | u64(zoneId);
+		PathMap::iterator iPath = s_pathMap.find(key);
+		if (iPath != s_pathMap.end())
+		{
+			return iPath->second;
+		}
+		if (s_pathList.size() >= MAX_ZONE_PATHS)
 		{
-			id = (u32)s_zoneList.size();
+			return NULL_ZONE;
+		}
+
+		const u32 id = (u32)s_pathList.size();
+		ZonePath path = {};
+		path.zone = zoneId;
+		path.parent = parentPath;
+		path.level = parentPath != NULL_ZONE ? s_pathList[parentPath].level + 1 : 0;
+		path.thread = threadIndex;
+		path.child = NULL_ZONE;
+		path.sibling = NULL_ZONE;
+
+		s_pathList.push_back(path);
+		s_pathMap[key] = id;
+		return id;
+	}
 
-			Zone zone;
-			zone.id = id;
-			zone.path = s_currentPath;
-			zone.timeInZone[s_readBuffer]  = 0;
-			zone.timeInZone[s_writeBuffer] = 0;
-			zone.timeInZoneAve = 0.0;
-			zone.fractOfParentAve = 0.0;
-			zone.frame = 0;
-			
-			s_zoneList.push_back(zone);
-			s_zoneMap[name] = id;
+	// Called once per call site, so the cost of the lookup and copies does not matter.
+	u32 registerZone(const char* name, const char* func, u32 lineNumber)
+	{
+		lockRegistration();
+		ZoneMap::iterator iZone = s_zoneMap.find(name);
+		if (iZone != s_zoneMap.end())
+		{
+			unlockRegistration();
+			return iZone->second;
 		}
-		else
+		// The list never grows past its reserved size so zones can be registered while the main thread reads it.
+		if (s_zoneList.empty())
 		{
-			id = iZone->second;
+			s_zoneList.reserve(MAX_ZONES);
+		}
+		if (s_zoneList.size() >= MAX_ZONES)
+		{
+			unlockRegistration();
+			return NULL_ZONE;
 		}
 
-		Zone& zone = s_zoneList[id];
-		strcpy(zone.name, name);
-		strcpy(zone.func, func);
+		const u32 id = (u32)s_zoneList.size();
+		Zone zone;
+		zone.id = id;
+		strncpy(zone.name, name, sizeof(zone.name) - 1);
+		strncpy(zone.func, func, sizeof(zone.func) - 1);
+		zone.name[sizeof(zone.name) - 1] = 0;
+		zone.func[sizeof(zone.func) - 1] = 0;
 		zone.lineNumber = lineNumber;
-		zone.level = s_level;
 
-		zone.parent = s_level > 0 ? s_zoneStack[s_level - 1] : NULL_ZONE;
-		if (zone.parent == NULL_ZONE)
+		s_zoneList.push_back(zone);
+		s_zoneMap[name] = id;
+		unlockRegistration();
+		return id;
+	}
+
+	void beginZone(u32 id)
+	{
+		if (id == NULL_ZONE) { return; }
+		pushEvent(id, ZONE_EVENT_BEGIN);
+	}
+
+	void endZone(u32 id)
+	{
+		if (id == NULL_ZONE) { return; }
+		pushEvent(id, ZONE_EVENT_END);
+	}
+
+	f64 measureZoneOverhead()
+	{
+		static const u32 id = registerZone("Zone Overhead Test", __FUNCTION__, __LINE__);
+
+		// Record the test events into a scratch thread so they never show up in the results.
+		static ThreadData* scratch = nullptr;
+		if (!scratch)
 		{
-			s_roots.push_back(id);
+			scratch = new ThreadData();
+			scratch->droppedEvents.store(0);
+			scratch->released.store(false);
 		}
-		else
+		ThreadData* curThread = s_threadData;
+		s_threadData = scratch;
+
+		const u64 start = TFE_System::getCurrentTimeInTicks();
+		for (u32 i = 0; i < OVERHEAD_TEST_COUNT; i++)
 		{
-			addZoneChild(zone.parent, zone.id);
+			TFE_Profiler_Zone zone(id);
 		}
+		const u64 totalTicks = TFE_System::getCurrentTimeInTicks() - start;
 
-		s_zoneStack[s_level] = id;
-		s_level++;
+		s_threadData = curThread;
+		ZoneEvent evt;
+		while (scratch->events.pop(&evt));
 
-		return id;
+		s_zoneOverhead = TFE_System::convertFromTicksToSeconds(totalTicks) * 1.0e9 / f64(OVERHEAD_TEST_COUNT);
+		return s_zoneOverhead;
+	}
+
+	f64 getZoneOverhead()
+	{
+		return s_zoneOverhead;
 	}
 
-	void endZone(u32 id, u64 dt)
+	// Link the path into the tree the first time it ends in a frame.
+	void linkZonePath(u32 pathId)
 	{
-		s_zoneList[id].timeInZone[s_writeBuffer] += TFE_System::convertFromTicksToSeconds(dt);
-		s_level--;
+		ZonePath& path = s_pathList[pathId];
+		if (path.linkFrame == s_currentFrame) { return; }
+
+		path.linkFrame = s_currentFrame;
+		if (path.parent == NULL_ZONE)
+		{
+			s_roots.push_back(pathId);
+		}
+		else
+		{
+			addPathChild(path.parent, pathId);
+		}
+	}
+
+	// Replay the events recorded by a thread since the last frame, zones are counted in the frame they end.
+	void replayThreadEvents(ThreadData* thread, u64 frameEnd)
+	{
+		std::vector<TFE_ZoneInterval>& intervals = thread->intervals[s_writeBuffer];
+		intervals.clear();
+		thread->maxDepth[s_writeBuffer] = 0;
+		thread->dropped[s_writeBuffer] = thread->droppedEvents.exchange(0);
+
+		ZoneEvent evt;
+		while (thread->events.pop(&evt))
+		{
+			if (evt.type == ZONE_EVENT_RESET)
+			{
+				thread->level = 0;
+				continue;
+			}
+			else if (evt.type == ZONE_EVENT_BEGIN)
+			{
+				if (thread->level < MAX_ZONE_STACK)
+				{
+					// Zones under a path that could not be added are not timed.
+					const u32 parentPath = thread->level > 0 ? thread->stackPath[thread->level - 1] : NULL_ZONE;
+					const bool untimed = thread->level > 0 && parentPath == NULL_ZONE;
+					thread->stack[thread->level] = evt.id;
+					thread->stackPath[thread->level] = untimed ? NULL_ZONE : getZonePath(parentPath, evt.id, thread->index);
+					thread->stackTime[thread->level] = evt.time;
+				}
+				thread->level++;
+				continue;
+			}
+
+			// Discard unmatched zones, which only happens if events were dropped.
+			while (thread->level > 0 && (thread->level > MAX_ZONE_STACK || thread->stack[thread->level - 1] != evt.id))
+			{
+				thread->level--;
+			}
+			if (thread->level == 0) { continue; }
+			thread->level--;
+
+			const u32 level = thread->level;
+			const u64 beginTime = thread->stackTime[level];
+			const u32 pathId = thread->stackPath[level];
+			if (pathId != NULL_ZONE)
+			{
+				const u64 dt = evt.time - beginTime;
+				ZonePath& path = s_pathList[pathId];
+				path.ticksInZone += dt;
+				path.ticksSelf += dt;
+				if (path.parent != NULL_ZONE)
+				{
+					s_pathList[path.parent].ticksSelf -= dt;
+				}
+				linkZonePath(pathId);
+			}
+
+			if (s_traceActive && evt.time >= s_traceStart)
+			{
+				s_traceZones.push_back({ std::max(beginTime, s_traceStart), evt.time, evt.id, thread->index });
+			}
+
+			// Zones from other threads may overlap the frame boundaries, so clip them to the frame.
+			if (evt.time > s_frameBegin)
+			{
+				TFE_ZoneInterval interval;
+				interval.zoneId = evt.id;
+				interval.depth = level;
+				interval.start = TFE_System::convertFromTicksToSeconds(std::max(beginTime, s_frameBegin) - s_frameBegin);
+				interval.end = TFE_System::convertFromTicksToSeconds(std::min(evt.time, frameEnd) - s_frameBegin);
+				intervals.push_back(interval);
+				thread->maxDepth[s_writeBuffer] = std::max(thread->maxDepth[s_writeBuffer], level);
+			}
+		}
 	}
 
 	void addCounter(const char* name, s32* counter)
@@ -177,15 +513,18 @@ namespace TFE_Profiler
 	void frameBegin()
 	{
 		std::swap(s_readBuffer, s_writeBuffer);
-		s_level = 0;
-		s_maxLevel = 0;
 		s_roots.clear();
+		// The thread that runs the frame is the main thread.
+		if (!s_threadData)
+		{
+			setThreadName("Main");
+		}
 
 		// Swap buffers, s_readBuffer is safe to read in the middle of the next frame.
-		const size_t zoneCount = s_zoneList.size();
-		for (size_t i = 0; i < zoneCount; i++)
+		const size_t pathCount = s_pathList.size();
+		for (size_t i = 0; i < pathCount; i++)
 		{
-			s_zoneList[i].timeInZone[s_writeBuffer] = 0;
+			s_pathList[i].timeInZone[s_writeBuffer] = 0;
 		}
 
 		// Copy counter values from the frame, so that the results can be used
@@ -197,39 +536,57 @@ namespace TFE_Profiler
 		}
 
 		s_frameBegin = TFE_System::getCurrentTimeInTicks();
+		if (s_traceRequest && !s_traceActive)
+		{
+			strcpy(s_tracePath, s_traceRequestPath);
+			s_traceFramesLeft = s_traceRequest;
+			s_traceRequest = 0;
+			s_traceStart = s_frameBegin;
+			s_traceActive = true;
+			s_traceZones.clear();
+			s_traceCounters.clear();
+			s_traceFrames.clear();
+		}
 	}
 
 	void traverseZoneTree(u32 id)
 	{
 		if (id == NULL_ZONE) { return; }
-		Zone* zone = &s_zoneList[id];
-		// Make sure zones are only inserted once for now.
-		if (zone->frame != s_currentFrame)
+		ZonePath* path = &s_pathList[id];
+		// Make sure paths are only inserted once.
+		if (path->frame != s_currentFrame)
 		{
 			s_sortedZoneList.push_back(id);
 		}
-		zone->frame = s_currentFrame;
+		path->frame = s_currentFrame;
 		
-		while (zone->child != NULL_ZONE)
+		while (path->child != NULL_ZONE)
 		{
-			traverseZoneTree(zone->child);
-			zone = &s_zoneList[zone->child];
+			traverseZoneTree(path->child);
+			path = &s_pathList[path->child];
 		}
 
-		zone = &s_zoneList[id];
-		while (zone->sibling != NULL_ZONE)
+		path = &s_pathList[id];
+		while (path->sibling != NULL_ZONE)
 		{
-			traverseZoneTree(zone->sibling);
-			zone = &s_zoneList[zone->sibling];
+			traverseZoneTree(path->sibling);
+			path = &s_pathList[path->sibling];
 		}
 	}
 
 	void frameEnd()
 	{
-		s_frameTime = TFE_System::convertFromTicksToSeconds(TFE_System::getCurrentTimeInTicks() - s_frameBegin);
-		const size_t zoneCount = s_zoneList.size();
+		const u64 frameEndTime = TFE_System::getCurrentTimeInTicks();
+		s_frameTime = TFE_System::convertFromTicksToSeconds(frameEndTime - s_frameBegin);
 		const f64 expBlend = 0.99;
 
+		// Gather the zones from all of the threads.
+		const u32 threadCount = s_threadCount.load();
+		for (u32 t = 0; t < threadCount; t++)
+		{
+			replayThreadEvents(s_threads[t], frameEndTime);
+		}
+
 		// Sort Zones
 		s_sortedZoneList.clear();
 		const size_t rootCount = s_roots.size();
@@ -238,31 +595,214 @@ namespace TFE_Profiler
 			traverseZoneTree(s_roots[r]);
 		}
 
-		// First compute delta times for each zone.
-		for (size_t i = 0; i < zoneCount; i++)
+		// First compute delta times for each path.
+		const size_t pathCount = s_pathList.size();
+		for (size_t i = 0; i < pathCount; i++)
 		{
-			s_zoneList[i].timeInZoneAve = expBlend * s_zoneList[i].timeInZoneAve + (1.0 - expBlend)*s_zoneList[i].timeInZone[s_writeBuffer];
+			ZonePath& path = s_pathList[i];
+			const u64 ticksSelf = u64(std::max(path.ticksSelf, s64(0)));
+			path.timeInZone[s_writeBuffer] = TFE_System::convertFromTicksToSeconds(path.ticksInZone);
+			path.timeInZoneAve = expBlend * path.timeInZoneAve + (1.0 - expBlend)*path.timeInZone[s_writeBuffer];
+			path.timeSelfAve = expBlend * path.timeSelfAve + (1.0 - expBlend)*TFE_System::convertFromTicksToSeconds(ticksSelf);
+			path.ticksSelfTotal += ticksSelf;
+			path.ticksInZone = 0;
+			// Children that end before a parent that spans frames are taken out of the parent's next frame.
+			path.ticksSelf = std::min(path.ticksSelf, s64(0));
 		}
 
 		// Then handle percentage of parent and clear
-		for (size_t i = 0; i < zoneCount; i++)
+		for (size_t i = 0; i < pathCount; i++)
 		{
-			f64 parentTime = (s_zoneList[i].parent != NULL_ZONE) ? s_zoneList[s_zoneList[i].parent].timeInZone[s_writeBuffer] : s_frameTime;
-			s_zoneList[i].fractOfParentAve = expBlend * s_zoneList[i].fractOfParentAve + (1.0 - expBlend)*s_zoneList[i].timeInZone[s_writeBuffer] / parentTime;
-			// Handle the rare case the parentTime = 0 causing s_zoneList[i].fractOfParentAve to become NAN. Once that happens it will never fix itself
+			ZonePath& path = s_pathList[i];
+			f64 parentTime = (path.parent != NULL_ZONE) ? s_pathList[path.parent].timeInZone[s_writeBuffer] : s_frameTime;
+			path.fractOfParentAve = expBlend * path.fractOfParentAve + (1.0 - expBlend)*path.timeInZone[s_writeBuffer] / parentTime;
+			// Handle the rare case the parentTime = 0 causing path.fractOfParentAve to become NAN. Once that happens it will never fix itself
 			// because we are doing an average. So fix it manually.
-			if (isnan(s_zoneList[i].fractOfParentAve))
+			if (isnan(path.fractOfParentAve))
 			{
-				s_zoneList[i].fractOfParentAve = 0.0;
+				path.fractOfParentAve = 0.0;
 			}
 
-			s_zoneList[i].child = NULL_ZONE;
-			s_zoneList[i].sibling = NULL_ZONE;
+			path.child = NULL_ZONE;
+			path.sibling = NULL_ZONE;
+		}
+
+		if (s_traceActive)
+		{
+			s_traceFrames.push_back({ s_frameBegin, frameEndTime });
+			const u32 counterCount = (u32)s_counterList.size();
+			for (u32 i = 0; i < counterCount; i++)
+			{
+				s_traceCounters.push_back({ frameEndTime, i, *s_counterList[i].ptr });
+			}
+
+			s_traceFramesLeft--;
+			if (!s_traceFramesLeft)
+			{
+				writeTrace();
+			}
 		}
 
 		s_currentFrame++;
 	}
 
+	// Copy a zone or thread name into a folded stack, ';' separates the frames.
+	void appendFoldedName(std::string& stack, const char* name)
+	{
+		for (; *name; name++)
+		{
+			stack.push_back(*name == ';' ? ':' : *name);
+		}
+	}
+
+	// Write the exclusive time of each path since the last dump in microseconds, one line per path:
+	// "Thread;Zone;Child 1234", which is the folded format read by flamegraph.pl and similar tools.
+	bool writeFoldedStacks(const char* filePath)
+	{
+		FileStream file;
+		if (!file.open(filePath, FileStream::MODE_WRITE))
+		{
+			TFE_System::logWrite(LOG_ERROR, "Profiler", "Cannot write folded stacks \"%s\".", filePath);
+			return false;
+		}
+
+		std::string stack;
+		u32 pathStack[MAX_ZONE_STACK + 1];
+		const size_t pathCount = s_pathList.size();
+		for (size_t i = 0; i < pathCount; i++)
+		{
+			ZonePath& path = s_pathList[i];
+			const u64 timeUs = u64(TFE_System::convertFromTicksToSeconds(path.ticksSelfTotal) * 1.0e6);
+			path.ticksSelfTotal = 0;
+			if (!timeUs) { continue; }
+
+			u32 depth = 0;
+			for (u32 p = u32(i); p != NULL_ZONE && depth <= MAX_ZONE_STACK; p = s_pathList[p].parent)
+			{
+				pathStack[depth++] = p;
+			}
+
+			stack.clear();
+			appendFoldedName(stack, path.thread < s_threadCount.load() ? s_threads[path.thread]->name : "Unknown");
+			for (s32 d = s32(depth) - 1; d >= 0; d--)
+			{
+				stack.push_back(';');
+				appendFoldedName(stack, s_zoneList[s_pathList[pathStack[d]].zone].name);
+			}
+			file.writeString("%s %llu\n", stack.c_str(), (unsigned long long)timeUs);
+		}
+		file.close();
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Trace capture
+	//////////////////////////////////////////////////////////////////////
+	bool startTrace(const char* path, u32 frameCount)
+	{
+		if (s_traceActive || s_traceRequest || !frameCount) { return false; }
+
+		strncpy(s_traceRequestPath, path, TFE_MAX_PATH - 1);
+		s_traceRequestPath[TFE_MAX_PATH - 1] = 0;
+		s_traceRequest = frameCount;
+		return true;
+	}
+
+	void stopTrace()
+	{
+		s_traceRequest = 0;
+		if (s_traceActive)
+		{
+			writeTrace();
+		}
+	}
+
+	bool isTraceActive()
+	{
+		return s_traceActive || s_traceRequest;
+	}
+
+	f64 traceTime(u64 ticks)
+	{
+		return TFE_System::convertFromTicksToSeconds(ticks - s_traceStart) * 1.0e6;
+	}
+
+	// Copy a name into a JSON string, escaping the characters that need it.
+	const char* jsonString(const char* str)
+	{
+		static char s_jsonStr[256];
+		u32 len = 0;
+		for (; *str && len < sizeof(s_jsonStr) - 2; str++)
+		{
+			if (*str == '"' || *str == '\\')
+			{
+				s_jsonStr[len++] = '\\';
+			}
+			s_jsonStr[len++] = (u8)*str >= 32 ? *str : ' ';
+		}
+		s_jsonStr[len] = 0;
+		return s_jsonStr;
+	}
+
+	// Write the trace as Chrome trace-event JSON, which can be opened in Perfetto or chrome://tracing.
+	void writeTrace()
+	{
+		s_traceActive = false;
+		s_traceFramesLeft = 0;
+
+		FileStream file;
+		if (!file.open(s_tracePath, FileStream::MODE_WRITE))
+		{
+			TFE_System::logWrite(LOG_ERROR, "Profiler", "Cannot write trace \"%s\".", s_tracePath);
+			return;
+		}
+
+		// Frames are shown on their own track after the threads.
+		const u32 frameTrack = MAX_PROFILER_THREADS;
+		file.writeString("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		file.writeString("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"The Force Engine\"}}");
+
+		const u32 threadCount = s_threadCount.load();
+		for (u32 t = 0; t < threadCount; t++)
+		{
+			file.writeString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", t, jsonString(s_threads[t]->name));
+			file.writeString(",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", t, t);
+		}
+		file.writeString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Frames\"}}", frameTrack);
+
+		const size_t frameCount = s_traceFrames.size();
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			const TraceFrame& frame = s_traceFrames[f];
+			file.writeString(",\n{\"name\":\"Frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%0.3f,\"dur\":%0.3f}",
+				u32(f), frameTrack, traceTime(frame.begin), traceTime(frame.end) - traceTime(frame.begin));
+		}
+
+		const size_t zoneCount = s_traceZones.size();
+		for (size_t z = 0; z < zoneCount; z++)
+		{
+			const TraceZone& zone = s_traceZones[z];
+			file.writeString(",\n{\"name\":\"%s\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%0.3f,\"dur\":%0.3f}",
+				jsonString(s_zoneList[zone.zoneId].name), zone.thread, traceTime(zone.begin), traceTime(zone.end) - traceTime(zone.begin));
+		}
+
+		const size_t counterCount = s_traceCounters.size();
+		for (size_t c = 0; c < counterCount; c++)
+		{
+			const TraceCounter& counter = s_traceCounters[c];
+			file.writeString(",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%0.3f,\"args\":{\"value\":%d}}",
+				jsonString(s_counterList[counter.counter].name), traceTime(counter.time), counter.value);
+		}
+
+		file.writeString("\n]}\n");
+		file.close();
+
+		TFE_System::logWrite(LOG_MSG, "Profiler", "Wrote %u frames, %u zones to trace \"%s\".", u32(frameCount), u32(zoneCount), s_tracePath);
+		s_traceZones.clear();
+		s_traceCounters.clear();
+		s_traceFrames.clear();
+	}
+
 	u32 getZoneCount()
 	{
 		return (u32)s_sortedZoneList.size();
@@ -272,15 +812,41 @@ namespace TFE_Profiler
 	{
 		if (index >= (u32)s_sortedZoneList.size()) { return; }
 
-		Zone& zone = s_zoneList[s_sortedZoneList[index]];
+		const ZonePath& path = s_pathList[s_sortedZoneList[index]];
+		Zone& zone = s_zoneList[path.zone];
 		info->name = zone.name;
 		info->func = zone.func;
-		info->level = zone.level;
+		info->zoneId = path.zone;
+		info->level = path.level;
 		info->lineNumber = zone.lineNumber;
-		info->timeInZone = zone.timeInZone[s_readBuffer];
-		info->timeInZoneAve = zone.timeInZoneAve;
-		info->fractOfParentAve = zone.fractOfParentAve;
-		info->parentId = zone.parent;
+		info->timeInZone = path.timeInZone[s_readBuffer];
+		info->timeInZoneAve = path.timeInZoneAve;
+		info->timeSelfAve = path.timeSelfAve;
+		info->fractOfParentAve = path.fractOfParentAve;
+		info->parentId = path.parent;
+		info->thread = path.thread;
+	}
+
+	const char* getZoneName(u32 id)
+	{
+		return id < (u32)s_zoneList.size() ? s_zoneList[id].name : "";
+	}
+
+	u32 getThreadCount()
+	{
+		return s_threadCount.load();
+	}
+
+	void getThreadInfo(u32 index, TFE_ThreadInfo* info)
+	{
+		if (index >= s_threadCount.load()) { return; }
+
+		ThreadData* thread = s_threads[index];
+		info->name = thread->name;
+		info->maxDepth = thread->maxDepth[s_readBuffer];
+		info->droppedEvents = thread->dropped[s_readBuffer];
+		info->intervalCount = (u32)thread->intervals[s_readBuffer].size();
+		info->intervals = thread->intervals[s_readBuffer].data();
 	}
 
 	f64 getTimeInFrame()
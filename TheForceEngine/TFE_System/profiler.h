@@ -3,7 +3,8 @@
 // The Force Engine Profiler
 // Simple "zone" based profiler.
 // Add TFE_PROFILE_ENABLED to preprocessor defines in the build to enable.
-// Currently does not respect the call path, that is TODO.
+// Zones are timed per call path, so the same zone under different
+// parents shows up separately.
 //////////////////////////////////////////////////////////////////////
 
 #include "types.h"
@@ -14,12 +15,16 @@
 #define TOKENPASTE(x, y) x ## y
 #define TOKENPASTE2(x, y) TOKENPASTE(x, y)
 #ifdef  TFE_PROFILE_ENABLED
-#define TFE_ZONE(name)  TFE_Profiler_Zone TOKENPASTE2(__localZone, __LINE__)(name, __FUNCTION__, __LINE__)
-#define TFE_ZONE_BEGIN(varName, name)  TFE_Profiler_ZoneManual varName(name, __FUNCTION__, __LINE__)
+// Each call site registers its zone once through a function-local static, entering the zone then only reads the time and pushes the id.
+#define TFE_ZONE(name)  static const u32 TOKENPASTE2(__localZoneId, __LINE__) = TFE_Profiler::registerZone(name, __FUNCTION__, __LINE__); \
+                        TFE_Profiler_Zone TOKENPASTE2(__localZone, __LINE__)(TOKENPASTE2(__localZoneId, __LINE__))
+#define TFE_ZONE_BEGIN(varName, name)  static const u32 TOKENPASTE2(varName, _zoneId) = TFE_Profiler::registerZone(name, __FUNCTION__, __LINE__); \
+                                       TFE_Profiler_ZoneManual varName(TOKENPASTE2(varName, _zoneId))
 #define TFE_ZONE_END(varName)  varName.end()
 #define TFE_FRAME_BEGIN() TFE_Profiler::frameBegin()
 #define TFE_FRAME_END() TFE_Profiler::frameEnd()
 #define TFE_COUNTER(varName, name) TFE_Profiler::addCounter(name, &varName)
+#define TFE_THREAD_NAME(name) TFE_Profiler::setThreadName(name)
 #else
 #define TFE_ZONE(name)
 #define TFE_ZONE_BEGIN(varName, name)
@@ -27,6 +32,7 @@
 #define TFE_FRAME_BEGIN()
 #define TFE_FRAME_END()
 #define TFE_COUNTER(varName, name)
+#define TFE_THREAD_NAME(name)
 #endif
 
 #define NULL_ZONE 0xffffffff
@@ -36,12 +42,33 @@ struct TFE_ZoneInfo
 {
 	char* name;
 	char* func;
+	u32  zoneId;
 	u32  lineNumber;
 	u32  level;
-	u32  parentId;
-	f64  timeInZone;
+	u32  parentId;			// The parent path.
+	f64  timeInZone;		// Inclusive of child zones.
 	f64  timeInZoneAve;
+	f64  timeSelfAve;		// Exclusive, the time not spent in child zones.
 	f64  fractOfParentAve;
+	u32  thread;
+};
+
+// A zone instance on a thread timeline, times are in seconds from the start of the frame.
+struct TFE_ZoneInterval
+{
+	u32  zoneId;
+	u32  depth;
+	f64  start;
+	f64  end;
+};
+
+struct TFE_ThreadInfo
+{
+	const char* name;
+	u32  maxDepth;
+	u32  droppedEvents;		// Events that did not fit in the thread buffer during the frame.
+	u32  intervalCount;
+	const TFE_ZoneInterval* intervals;
 };
 
 struct TFE_CounterInfo
@@ -53,8 +80,12 @@ struct TFE_CounterInfo
 namespace TFE_Profiler
 {
 	// The main profiling API is used through Macros which can be disabled based on build flags.
-	u32  beginZone(const char* name, const char* func, u32 lineNumber);
-	void endZone(u32 id, u64 dt);
+	// Zones with the same name share an id. Zones may be used from any thread, each thread records into its own buffer.
+	u32  registerZone(const char* name, const char* func, u32 lineNumber);
+	void beginZone(u32 id);
+	void endZone(u32 id);
+	// Optional, the name shown for the calling thread.
+	void setThreadName(const char* name);
 		
 	void frameBegin();
 	void frameEnd();
@@ -64,48 +95,63 @@ namespace TFE_Profiler
 	// Profile data API, this is used directly.
 	f64  getTimeInFrame();
 
+	// Zone paths in tree order.
 	u32  getZoneCount();
 	void getZoneInfo(u32 index, TFE_ZoneInfo* info);
+	const char* getZoneName(u32 id);
+
+	// Per-thread timelines of the previous frame.
+	u32  getThreadCount();
+	void getThreadInfo(u32 index, TFE_ThreadInfo* info);
 	
 	u32  getCounterCount();
 	void getCounterInfo(u32 index, TFE_CounterInfo* info);
+
+	// Record the zones, counters and frames of the next 'frameCount' frames and write them as Chrome trace-event JSON.
+	// The trace is written when the last frame ends or stopTrace() is called.
+	bool startTrace(const char* path, u32 frameCount);
+	void stopTrace();
+	bool isTraceActive();
+
+	// Write the exclusive time per call path since the last call as folded stacks for flamegraph tools.
+	bool writeFoldedStacks(const char* path);
+
+	// Measure the cost of entering and leaving a zone in nanoseconds, the result is also returned by getZoneOverhead().
+	f64  measureZoneOverhead();
+	f64  getZoneOverhead();
 }
 
 class TFE_Profiler_Zone
 {
 public:
-	TFE_Profiler_Zone(const char* name, const char* func, u32 lineNumber)
+	TFE_Profiler_Zone(u32 id)
 	{
-		m_time = TFE_System::getCurrentTimeInTicks();
-		m_id = TFE_Profiler::beginZone(name, func, lineNumber);
+		m_id = id;
+		TFE_Profiler::beginZone(id);
 	}
 
 	~TFE_Profiler_Zone()
 	{
-		const u64 deltaTime = TFE_System::getCurrentTimeInTicks() - m_time;
-		TFE_Profiler::endZone(m_id, deltaTime);
+		TFE_Profiler::endZone(m_id);
 	}
 private:
-	u64 m_time;
-	s32 m_id;
+	u32 m_id;
 };
 
 class TFE_Profiler_ZoneManual
 {
 public:
-	TFE_Profiler_ZoneManual(const char* name, const char* func, u32 lineNumber)
+	TFE_Profiler_ZoneManual(u32 id)
 	{
-		m_time = TFE_System::getCurrentTimeInTicks();
-		m_id = TFE_Profiler::beginZone(name, func, lineNumber);
+		m_id = id;
+		TFE_Profiler::beginZone(id);
 	}
 
 	void end()
 	{
-		const u64 deltaTime = TFE_System::getCurrentTimeInTicks() - m_time;
-		TFE_Profiler::endZone(m_id, deltaTime);
+		TFE_Profiler::endZone(m_id);
 	}
 private:
-	u64 m_time;
-	s32 m_id;
+	u32 m_id;
 };
 #endif
@@ -28,6 +28,15 @@ namespace TFE_System
 	static f64 s_dt = 1.0 / 60.0;		// This is just to handle the first frame, so any reasonable value will work.
 	static const f64 c_maxDt = 0.05;	// 20 fps
 
+	// Fixed time step, the time is then advanced by the step each frame.
+	static f64 s_fixedDt = 0.0;
+	static f64 s_fixedStartTime = 0.0;
+	static u64 s_fixedFrame = 0;
+
+	// Time of the current frame when replaying recorded input.
+	static bool s_frameTimeOverride = false;
+	static f64 s_frameTime = 0.0;
+
 	static bool s_synced = false;
 	static bool s_resetStartTime = false;
 	static bool s_quitMessagePosted = false;
@@ -86,8 +95,60 @@ namespace TFE_System
 		return dt;
 	}
 
+	void setFixedTimeStep(f64 timeStep)
+	{
+		// Keep the time continuous when switching modes.
+		const f64 time = getTime();
+		const bool wasFixed = s_fixedDt > 0.0;
+		if (timeStep > c_maxDt)
+		{
+			TFE_System::logWrite(LOG_WARNING, "System", "The fixed time step of %0.3f ms is too large, using the maximum of %0.3f ms.", timeStep * 1000.0, c_maxDt * 1000.0);
+		}
+		s_fixedDt = std::min(std::max(timeStep, 0.0), c_maxDt);
+		if (s_fixedDt > 0.0)
+		{
+			s_fixedStartTime = time;
+			s_fixedFrame = 0;
+			TFE_System::logWrite(LOG_MSG, "System", "Using a fixed time step of %0.3f ms.", s_fixedDt * 1000.0);
+		}
+		else if (wasFixed)
+		{
+			s_time = SDL_GetPerformanceCounter();
+			s_startTime = s_time - u64(time / s_freq);
+		}
+	}
+
+	f64 getFixedTimeStep()
+	{
+		return s_fixedDt;
+	}
+
+	void setFrameTime(f64 time, f64 dt)
+	{
+		s_frameTimeOverride = true;
+		s_frameTime = time;
+		s_dt = dt;
+	}
+
 	void update()
 	{
+		s_frameTimeOverride = false;
+		if (s_fixedDt > 0.0)
+		{
+			if (s_resetStartTime)
+			{
+				s_fixedStartTime = 0.0;
+				s_fixedFrame = 0;
+				s_resetStartTime = false;
+			}
+			else
+			{
+				s_fixedFrame++;
+			}
+			s_dt = s_fixedDt;
+			return;
+		}
+
 		// This assumes that SDL_GetPerformanceCounter() is monotonic.
 		// However if errors do occur, the dt clamp later should limit the side effects.
 		const u64 curTime = SDL_GetPerformanceCounter();
@@ -142,6 +203,14 @@ namespace TFE_System
 	// Get time since "start time"
 	f64 getTime()
 	{
+		if (s_frameTimeOverride)
+		{
+			return s_frameTime;
+		}
+		if (s_fixedDt > 0.0)
+		{
+			return s_fixedStartTime + f64(s_fixedFrame) * s_fixedDt;
+		}
 		const u64 uDt = s_time - s_startTime;
 		return f64(uDt) * s_freq;
 	}
@@ -29,6 +29,15 @@ namespace TFE_System
 
 	void update();
 	f64 updateThreadLocal(u64* localTime);
+	// Step game time by a fixed amount each frame regardless of the real frame time, so a session
+	// can be reproduced exactly (including the audio output). Set to 0 to use the real time.
+	// Like the real frame time the step is limited to 0.05 seconds (20 fps), larger values are clamped
+	// with a warning - check getFixedTimeStep() for the step in use.
+	void setFixedTimeStep(f64 timeStep);
+	f64  getFixedTimeStep();
+	// Replace the time and delta time of the current frame, used when replaying recorded input.
+	// The override only lasts until the next update().
+	void setFrameTime(f64 time, f64 dt);
 
 	// Timing
 	// --- The current time and delta time are determined once per frame, during the update() function.
@@ -6,6 +6,7 @@
 #include <TFE_Memory/memoryRegion.h>
 #include <TFE_Game/igame.h>
 #include <TFE_Jedi/InfSystem/infSystem.h>
+#include <TFE_Jedi/Renderer/virtualFramebuffer.h>
 //#include <TFE_Editor/editor.h>
 #include <TFE_FileSystem/fileutil.h>
 #include <TFE_Audio/audioSystem.h>
@@ -13,6 +14,7 @@
 #include <TFE_Polygon/polygon.h>
 #include <TFE_RenderBackend/renderBackend.h>
 #include <TFE_Input/inputMapping.h>
+#include <TFE_Input/replay.h>
 #include <TFE_Settings/settings.h>
 #include <TFE_System/system.h>
 #include <TFE_Jedi/Task/task.h>
@@ -55,6 +57,13 @@ static u32  s_monitorWidth = 1280;
 static u32  s_monitorHeight = 720;
 static char s_screenshotTime[TFE_MAX_PATH];
 static IGame* s_curGame = nullptr;
+static bool s_nullAudio = false;
+static char s_audioWavPath[TFE_MAX_PATH] = "";
+static u32  s_traceFrames = 0;
+static char s_tracePath[TFE_MAX_PATH] = "";
+static bool s_replayPaused = false;
+static bool s_headless = false;
+static u32  s_headlessMaxFrames = 0;
 
 void parseOption(const char* name, const std::vector<const char*>& values, bool longName);
 
@@ -144,6 +153,7 @@ void handleEvent(SDL_Event& Event)
 				{
 					static u64 _gifIndex = 0;
 					static bool _recording = false;
+					static bool _recordingIndexed = false;
 
 					if (!_recording)
 					{
@@ -154,12 +164,24 @@ void handleEvent(SDL_Event& Event)
 						sprintf(gifPath, "%stfe_gif_%s_%llu.gif", screenshotDir, s_screenshotTime, _gifIndex);
 						_gifIndex++;
 
-						TFE_RenderBackend::startGifRecording(gifPath);
+						// In-game the 8-bit framebuffer is recorded directly, otherwise the final image is read back from the GPU.
+						_recordingIndexed = s_curGame && TFE_Jedi::vfb_startGifRecording(gifPath);
+						if (!_recordingIndexed)
+						{
+							TFE_RenderBackend::startGifRecording(gifPath);
+						}
 						_recording = true;
 					}
 					else
 					{
-						TFE_RenderBackend::stopGifRecording();
+						if (_recordingIndexed)
+						{
+							TFE_Jedi::vfb_stopGifRecording();
+						}
+						else
+						{
+							TFE_RenderBackend::stopGifRecording();
+						}
 						_recording = false;
 					}
 				}
@@ -229,6 +251,21 @@ void handleEvent(SDL_Event& Event)
 
 bool sdlInit()
 {
+	if (s_headless)
+	{
+		// No window, display or controllers, the display size is only used to setup the game resolution.
+		if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0) { return false; }
+
+		TFE_Settings_Window* windowSettings = TFE_Settings::getWindowSettings();
+		s_displayWidth     = windowSettings->width;
+		s_displayHeight    = windowSettings->height;
+		s_baseWindowWidth  = windowSettings->baseWidth;
+		s_baseWindowHeight = windowSettings->baseHeight;
+		s_monitorWidth     = s_displayWidth;
+		s_monitorHeight    = s_displayHeight;
+		return true;
+	}
+
 	// Audio is handled outside of SDL2.
 	// Using the Force Engine Audio system for sound mixing, FluidSynth for Midi handling and rtAudio for audio I/O.
 	const int code = SDL_Init(SDL_INIT_TIMER | SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_GAMECONTROLLER);
@@ -358,6 +395,100 @@ bool systemMenuKeyCombo()
 	return inputMapping_getActionState(IAS_SYSTEM_MENU) == STATE_PRESSED;
 }
 
+// Record or replay the input used by the game this frame.
+// The console pauses the game, so that is recorded as well and the game is paused the same way on playback.
+void replayBeginFrame(bool isConsoleOpen)
+{
+	const u32 flags = TFE_Input::replay_beginFrame(isConsoleOpen ? TFE_Input::REPLAY_FRAME_PAUSED : 0);
+	if (!isConsoleOpen)
+	{
+		const bool paused = TFE_Input::replay_isPlaying() && (flags & TFE_Input::REPLAY_FRAME_PAUSED);
+		if (paused != s_replayPaused)
+		{
+			s_curGame->pauseGame(paused);
+			s_replayPaused = paused;
+		}
+	}
+}
+
+// Run the game as fast as possible without a window, audio device or frame pacing, for soak tests.
+// The input comes from a demo (--playdemo) or there is none, and the game advances a fixed number of ticks
+// per frame (see the game's handling of --headless).
+void runHeadless(int argc, char* argv[])
+{
+	setAppState(APP_STATE_GAME, argc, argv);
+	if (!s_curGame)
+	{
+		TFE_System::logWrite(LOG_ERROR, "Headless", "Cannot start the game.");
+		return;
+	}
+
+	MemoryRegion* regions[] = { s_gameRegion, s_levelRegion, s_resRegion };
+	const char* regionNames[] = { "Game", "Level", "Resources" };
+	size_t peakMemory[TFE_ARRAYSIZE(regions)] = { 0 };
+	s32 peakTasks = 0;
+	u64 taskSum = 0;
+	u64 ticks = 0;
+	u32 frames = 0;
+	u32 prevTick = s_curGame->getCurrentTick();
+
+	TFE_System::logWrite(LOG_MSG, "Headless", "Headless simulation started.");
+	const f64 gameStart = TFE_System::getTime();
+	const u64 realStart = SDL_GetPerformanceCounter();
+	while (!TFE_System::quitMessagePosted() && (!s_headlessMaxFrames || frames < s_headlessMaxFrames))
+	{
+		TFE_System::update();
+		inputMapping_updateInput();
+
+		if (TFE_Input::replay_isRecording() || TFE_Input::replay_isPlaying() || s_replayPaused)
+		{
+			replayBeginFrame(false);
+		}
+		s_curGame->loopGame();
+		const bool endInputFrame = TFE_Jedi::task_run() != 0;
+		TFE_Input::replay_endFrame();
+		TFE_Audio::updateOutput(TFE_System::getDeltaTime());
+
+		if (endInputFrame)
+		{
+			TFE_Input::endFrame();
+			inputMapping_endFrame();
+		}
+
+		// Ignore large jumps, which happen when the game time is reset such as when a demo starts.
+		const u32 tick = s_curGame->getCurrentTick();
+		if (tick >= prevTick && tick - prevTick <= 64)
+		{
+			ticks += tick - prevTick;
+		}
+		prevTick = tick;
+
+		for (s32 i = 0; i < TFE_ARRAYSIZE(regions); i++)
+		{
+			if (!regions[i]) { continue; }
+			peakMemory[i] = std::max(peakMemory[i], TFE_Memory::region_getMemoryUsed(regions[i]));
+		}
+		const s32 taskCount = TFE_Jedi::task_getCount();
+		peakTasks = std::max(peakTasks, taskCount);
+		taskSum += taskCount;
+		frames++;
+	}
+	const f64 realTime = f64(SDL_GetPerformanceCounter() - realStart) / f64(SDL_GetPerformanceFrequency());
+	const f64 gameTime = TFE_System::getTime() - gameStart;
+	const f64 invRealTime = realTime > 0.0 ? 1.0 / realTime : 0.0;
+
+	TFE_System::logWrite(LOG_MSG, "Headless", "%u frames in %0.2f seconds, %0.1f frames per second.", frames, realTime, f64(frames) * invRealTime);
+	TFE_System::logWrite(LOG_MSG, "Headless", "%llu game ticks, %0.1f ticks per second.", ticks, f64(ticks) * invRealTime);
+	TFE_System::logWrite(LOG_MSG, "Headless", "%0.2f seconds of game time, %0.1fx real time.", gameTime, gameTime * invRealTime);
+	for (s32 i = 0; i < TFE_ARRAYSIZE(regions); i++)
+	{
+		if (!regions[i]) { continue; }
+		TFE_System::logWrite(LOG_MSG, "Headless", "Peak %s memory: %0.2f MB, capacity %0.2f MB.", regionNames[i],
+			f64(peakMemory[i]) / (1024.0 * 1024.0), f64(TFE_Memory::region_getMemoryCapacity(regions[i])) / (1024.0 * 1024.0));
+	}
+	TFE_System::logWrite(LOG_MSG, "Headless", "Tasks: peak %d, average %0.1f.", peakTasks, frames ? f64(taskSum) / f64(frames) : 0.0);
+}
+
 void parseCommandLine(s32 argc, char* argv[])
 {
 	if (argc < 1) { return; }
@@ -496,6 +627,7 @@ int main(int argc, char* argv[])
 	u32 windowFlags = 0;
 	if (windowSettings->fullscreen) { TFE_System::logWrite(LOG_MSG, "Display", "Fullscreen enabled."); windowFlags |= WINFLAG_FULLSCREEN; }
 	if (graphics->vsync) { TFE_System::logWrite(LOG_MSG, "Display", "Vertical Sync enabled."); windowFlags |= WINFLAG_VSYNC; }
+	if (s_headless) { windowFlags = WINFLAG_HEADLESS; }
 	
 	WindowState windowState =
 	{
@@ -516,14 +648,34 @@ int main(int argc, char* argv[])
 		TFE_System::logClose();
 		return PROGRAM_ERROR;
 	}
-	TFE_FrontEndUI::initConsole();
-	TFE_Audio::init();
+	if (!s_headless)
+	{
+		TFE_FrontEndUI::initConsole();
+	}
+	TFE_Audio::init(s_nullAudio);
+	if (s_audioWavPath[0])
+	{
+		TFE_Audio::startWavCapture(s_audioWavPath);
+	}
+#ifdef TFE_PROFILE_ENABLED
+	if (s_traceFrames)
+	{
+		if (!s_tracePath[0])
+		{
+			TFE_Paths::appendPath(PATH_USER_DOCUMENTS, "trace.json", s_tracePath);
+		}
+		TFE_Profiler::startTrace(s_tracePath, s_traceFrames);
+	}
+#endif
 	TFE_MidiPlayer::init();
 	TFE_Polygon::init();
 	TFE_Image::init();
 	TFE_Jedi::inf_init();
 	TFE_Palette::createDefault256();
-	TFE_FrontEndUI::init();
+	if (!s_headless)
+	{
+		TFE_FrontEndUI::init();
+	}
 	game_init();
 	inputMapping_startup();
 
@@ -534,6 +686,13 @@ int main(int argc, char* argv[])
 	const ColorCorrection colorCorrection = { graphics->brightness, graphics->contrast, graphics->saturation, graphics->gamma };
 	TFE_RenderBackend::setColorCorrection(graphics->colorCorrection, &colorCorrection);
 
+	// Headless runs replace the game loop.
+	if (s_headless)
+	{
+		runHeadless(argc, argv);
+		s_loop = false;
+	}
+
 	// Game loop
 	u32 frame = 0u;
 	bool showPerf = false;
@@ -656,14 +815,20 @@ int main(int argc, char* argv[])
 			}
 			else
 			{
+				if (TFE_Input::replay_isRecording() || TFE_Input::replay_isPlaying() || s_replayPaused)
+				{
+					replayBeginFrame(isConsoleOpen);
+				}
 				s_curGame->loopGame();
 				endInputFrame = TFE_Jedi::task_run() != 0;
+				TFE_Input::replay_endFrame();
 			}
 		}
 		else
 		{
 			TFE_RenderBackend::clearWindow();
 		}
+		TFE_Audio::updateOutput(TFE_System::getDeltaTime());
 		TFE_FrontEndUI::draw(s_curState == APP_STATE_MENU || s_curState == APP_STATE_NO_GAME_DATA, s_curState == APP_STATE_NO_GAME_DATA);
 
 		bool swap = s_curState != APP_STATE_EDITOR && (s_curState != APP_STATE_MENU || TFE_FrontEndUI::isConfigMenuOpen());
@@ -689,6 +854,15 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	// Finish any recordings so the files are complete.
+	if (TFE_Jedi::vfb_isGifRecording())
+	{
+		TFE_Jedi::vfb_stopGifRecording();
+	}
+	if (TFE_Jedi::vfb_isRecording())
+	{
+		TFE_Jedi::vfb_stopRecording();
+	}
 	if (s_curGame)
 	{
 		freeGame(s_curGame);
@@ -777,5 +951,50 @@ void parseOption(const char* name, const std::vector<const char*>& values, bool
 			// --nocutscenes
 			TFE_System::logWrite(LOG_MSG, "CommandLine", "Disable cutscenes and title screen.");
 		}
+		else if (strcasecmp(name, "nullaudio") == 0)		// Do not use the audio device, for headless machines.
+		{
+			// --nullaudio
+			s_nullAudio = true;
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Use the null audio device.");
+		}
+		else if (strcasecmp(name, "audiowav") == 0 && values.size() >= 1)	// Write the audio output to a WAV file.
+		{
+			// --audiowav output.wav
+			strncpy(s_audioWavPath, values[0], TFE_MAX_PATH - 1);
+			s_audioWavPath[TFE_MAX_PATH - 1] = 0;
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Write audio to: %s", s_audioWavPath);
+		}
+		else if (strcasecmp(name, "fixedstep") == 0 && values.size() >= 1)	// Step game time at a fixed rate.
+		{
+			// --fixedstep 60
+			char* endPtr = nullptr;
+			const f64 rate = strtod(values[0], &endPtr);
+			TFE_System::setFixedTimeStep(rate > 0.0 ? 1.0 / rate : 0.0);
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Fixed time step: %0.2f fps", rate);
+		}
+		else if (strcasecmp(name, "playdemo") == 0 && values.size() >= 1)	// Play a demo and exit, handled by the game.
+		{
+			// --playdemo fight.tfd
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Demo to play: %s", values[0]);
+		}
+		else if (strcasecmp(name, "headless") == 0)	// Run the game logic as fast as possible, without a window or audio device.
+		{
+			// --headless [ticks per frame] [max frames], the ticks per frame are handled by the game.
+			s_headless = true;
+			s_nullAudio = true;
+			s_headlessMaxFrames = values.size() >= 2 ? (u32)strtoul(values[1], nullptr, 10) : 0;
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Headless mode, max frames: %u.", s_headlessMaxFrames);
+		}
+		else if (strcasecmp(name, "trace") == 0 && values.size() >= 1)	// Record a profiler trace from startup.
+		{
+			// --trace 300 [trace.json]
+			s_traceFrames = (u32)strtoul(values[0], nullptr, 10);
+			if (values.size() >= 2)
+			{
+				strncpy(s_tracePath, values[1], TFE_MAX_PATH - 1);
+				s_tracePath[TFE_MAX_PATH - 1] = 0;
+			}
+			TFE_System::logWrite(LOG_MSG, "CommandLine", "Record a profiler trace of %u frames.", s_traceFrames);
+		}
 	}
 }
\ No newline at end of file